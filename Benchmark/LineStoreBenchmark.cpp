@@ -0,0 +1,90 @@
+// Compares ImTextEdit::LineStore with the std::vector<Line> the editor used before it. Build it with the editor:
+//   g++ -std=c++17 -O2 -I.. -I<imgui> LineStoreBenchmark.cpp ../ImTextEdit.cpp ../RegexDFA.cpp <imgui sources> -lpthread
+
+#include "ImTextEdit.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef ImTextEdit::Line Line;
+
+static const size_t s_Lines = 200000;
+static const size_t s_Edits = 1000;
+static const size_t s_Lookups = 10000000;
+
+static double Now()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static Line MakeLine(size_t aIndex)
+{
+	std::string text = "    value_" + std::to_string(aIndex) + " = compute(value_" + std::to_string(aIndex / 2) + ");";
+	Line line;
+	line.assign(text.data(), text.data() + text.size());
+	return line;
+}
+
+// the line lookups and the GetText walk are the same for both stores
+template<typename TLines>
+static void Run(const char* aName, TLines& aLines, void (*aInsert)(TLines&, size_t, Line&&), void (*aErase)(TLines&, size_t))
+{
+	std::mt19937 rng(1);
+	double start = Now();
+
+	for (size_t i = 0; i < s_Lines; i++)
+		aLines.push_back(MakeLine(i));
+
+	double filled = Now();
+
+	// edits anywhere in the document, like typing Enter or deleting lines
+	for (size_t i = 0; i < s_Edits; i++)
+		aInsert(aLines, rng() % aLines.size(), MakeLine(i));
+
+	for (size_t i = 0; i < s_Edits; i++)
+		aErase(aLines, rng() % aLines.size());
+
+	double edited = Now();
+
+	size_t sum = 0;
+	for (size_t i = 0; i < s_Lookups; i++)
+		sum += aLines[rng() % aLines.size()].size();
+
+	double looked = Now();
+
+	std::string text;
+	for (auto& line : aLines)
+	{
+		text.append((const char*)line.GetChars(), line.size());
+		text.push_back('\n');
+	}
+
+	double joined = Now();
+
+	printf("%-12s fill %8.1f ms  insert+erase %8.1f ms  lookup %8.1f ms  text %8.1f ms  (%zu, %zu)\n", aName,
+		filled - start, edited - filled, looked - edited, joined - looked, sum, text.size());
+}
+
+int main()
+{
+	printf("%zu lines, %zu inserts and %zu erases at random lines, %zu random lookups, one GetText walk\n", s_Lines, s_Edits, s_Edits, s_Lookups);
+
+	{
+		std::vector<Line> lines;
+		Run<std::vector<Line>>("vector", lines,
+			[](std::vector<Line>& aLines, size_t aIndex, Line&& aLine) { aLines.insert(aLines.begin() + aIndex, std::move(aLine)); },
+			[](std::vector<Line>& aLines, size_t aIndex) { aLines.erase(aLines.begin() + aIndex); });
+	}
+
+	{
+		ImTextEdit::LineStore lines;
+		Run<ImTextEdit::LineStore>("LineStore", lines,
+			[](ImTextEdit::LineStore& aLines, size_t aIndex, Line&& aLine) { aLines.insert(aIndex, std::move(aLine)); },
+			[](ImTextEdit::LineStore& aLines, size_t aIndex) { aLines.erase(aIndex); });
+	}
+
+	return 0;
+}
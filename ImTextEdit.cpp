@@ -7,6 +7,34 @@
 #include <regex>
 #include <cmath>
 #include <stack>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "ImTextEdit.h"
 
@@ -17,45 +45,14 @@
 // TODO
 // - multiline comments vs single-line: latter is blocking start of a ML
 
-template<class InputIt1, class InputIt2, class BinaryPredicate>
-bool Equals(InputIt1 first1, InputIt1 last1, InputIt2 first2, InputIt2 last2, BinaryPredicate p)
-{
-	for (; first1 != last1 && first2 != last2; ++first1, ++first2) 
-	{
-		if (!p(*first1, *first2))
-			return false;
-	}
-
-	return first1 == last1 && first2 == last2;
-}
-
-int IsBracket(char ch)
-{
-	if (ch == '(' || ch == '[' || ch == '{')
-		return 1;
-	if (ch == ')' || ch == ']' || ch == '}')
-		return 2;
-	return 0;
-}
-
-bool IsClosingBracket(char open, char actual)
-{
-	return (open == '{' && actual == '}') || (open == '[' && actual == ']') || (open == '(' && actual == ')');
-}
-
-bool IsOpeningBracket(char close, char actual)
-{
-	return (close == '}' && actual == '{') || (close == ']' && actual == '[') || (close == ')' && actual == '(');
-}
-
 ImTextEdit::ImTextEdit()
 	: m_LineSpacing(1.0f), m_UndoIndex(0), m_InsertSpaces(false), m_TabSize(4), m_HighlightBrackets(false), m_Autocomplete(true), m_ACOpened(false), m_HighlightLine(true), m_HorizontalScroll(true), m_CompleteBraces(true), m_ShowLineNumbers(true),
-	  m_SmartIndent(true), m_Overwrite(false), m_ReadOnly(false), m_WithinRender(false), m_ScrollToCursor(false), m_ScrollToTop(false), m_TextChanged(false), m_ColorizerEnabled(true), m_TextStart(20.0f), m_LeftMargin(s_DebugDataSpace + s_LineNumberSpace),
-	  m_CursorPositionChanged(false), m_ColorRangeMin(0), m_ColorRangeMax(0), m_SelectionMode(SelectionMode::Normal), m_CheckComments(true), m_LastClick(-1.0f), m_HandleKeyboardInputs(true), m_HandleMouseInputs(true),
-	  m_IgnoreImGuiChild(false), m_ShowWhitespaces(false), m_DebugBar(false), m_DebugCurrentLineUpdated(false), m_DebugCurrentLine(-1), m_Path(""), OnContentUpdate(nullptr), m_FuncTooltips(true), m_UIScale(1.0f), m_UIFontSize(18.0f),
+	  m_SmartIndent(true), m_Overwrite(false), m_ReadOnly(false), m_Viewer(false), m_ViewerReadOnly(false), m_Follow(false), m_FollowPinned(true), m_FollowMaxLines(0), m_FollowDropped(0), m_WithinRender(false), m_ScrollToCursor(false), m_ScrollToTop(false), m_TextChanged(false), m_ColorizerEnabled(true), m_TextStart(20.0f), m_LeftMargin(s_DebugDataSpace + s_LineNumberSpace),
+	  m_CursorPositionChanged(false), m_VisibleLineBegin(0), m_VisibleLineEnd(0), m_ColorizerFrameBudget(2000), m_ColorizeResumeLine(-1), m_ColorizeResumeOffset(0), m_SelectionMode(SelectionMode::Normal), m_LexDirtyLine(0), m_LexDirtyEnd(0), m_LastClick(-1.0f), m_HandleKeyboardInputs(true), m_HandleMouseInputs(true),
+	  m_IgnoreImGuiChild(false), m_ShowWhitespaces(false), m_LayoutGeneration(1), m_LayoutFont(nullptr), m_LayoutFontSize(0.0f), m_LayoutTabSize(0), m_LayoutShowWhitespaces(false), m_LayoutColorizerEnabled(false), m_DocumentVersion(0), m_DebugBar(false), m_DebugCurrentLineUpdated(false), m_DebugCurrentLine(-1), m_Path(""), OnContentUpdate(nullptr), m_FuncTooltips(true), m_UIScale(1.0f), m_UIFontSize(18.0f),
 	  m_EditorFontSize(18.0f), m_ActiveAutocomplete(false), m_ReadyForAutocomplete(false), m_RequestAutocomplete(false), m_ScrollbarMarkers(false), m_AutoindentOnPaste(false), m_FunctionDeclarationTooltip(false), m_FunctionDeclarationTooltipEnabled(false),
-	  m_IsSnippet(false), m_SnippetTagSelected(0), m_Sidebar(true), m_HasSearch(true), m_ReplaceIndex(0), m_FoldEnabled(true), m_FoldLastIteration(0), m_FoldSorted(false), m_LastScroll(0.0f),
-	  m_StartTime(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
+	  m_IsSnippet(false), m_SnippetTagSelected(0), m_Sidebar(true), m_HasSearch(true), m_ReplaceIndex(0), m_FoldEnabled(true), m_FoldIndexDirty(true), m_LastScroll(0.0f),
+	  m_StartTime(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()), m_RenderCacheEnabled(true)
 {
 	memset(m_FindWord, 0, 256 * sizeof(char));
 	memset(m_ReplaceWord, 0, 256 * sizeof(char));
@@ -82,6 +79,9 @@ ImTextEdit::ImTextEdit()
 	SetPalette(GetDarkPalette());
 	SetLanguageDefinition(LanguageDefinition::HLSL());
 	m_Lines.push_back(Line());
+	m_Brackets.Reset(1);
+	m_LineWidths.Reset(1);
+	m_TextOffsets.Reset(m_Lines);
 
 	m_Shortcuts = GetDefaultShortcuts();
 }
@@ -149,1262 +149,2575 @@ const std::vector<ImTextEdit::Shortcut> ImTextEdit::GetDefaultShortcuts()
 	ret[(int)ImTextEdit::ShortcutID::DuplicateLine] = ImTextEdit::Shortcut(0x44, -1, 0, 1, 0);                 // CTRL+D
 	ret[(int)ImTextEdit::ShortcutID::CommentLines] = ImTextEdit::Shortcut(0x4B, -1, 0, 1, 1);                  // CTRL+SHIFT+K
 	ret[(int)ImTextEdit::ShortcutID::UncommentLines] = ImTextEdit::Shortcut(0x55, -1, 0, 1, 1);                // CTRL+SHIFT+U
+	ret[(int)ImTextEdit::ShortcutID::JumpToMatchingBracket] = ImTextEdit::Shortcut(0xDD, -1, 0, 1, 0);         // CTRL+]
 
 	return ret;
 }
 
 ImTextEdit::~ImTextEdit()
 {
+	StopColorizerThread();
 }
 
-void ImTextEdit::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
+size_t ImTextEdit::Line::GetPreprocessorStart() const
 {
-	m_LanguageDefinition = aLanguageDef;
-	m_RegexList.clear();
+	// the lexer marks everything from the preprocessor char to the end of the line
+	if (m_Flags.empty())
+		return m_Chars.size();
 
-	for (auto& r : m_LanguageDefinition.TokenRegexStrings)
-		m_RegexList.push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
+	size_t index = 0;
+	while (index < m_Chars.size() && !IsPreprocessor(index))
+		index++;
 
-	Colorize();
+	return index;
 }
 
-void ImTextEdit::SetPalette(const td_Palette & aValue)
+void ImTextEdit::Line::insert(Iterator aWhere, const Glyph& aGlyph)
 {
-	m_PaletteBase = aValue;
+	size_t index = aWhere.m_Index;
+	m_LexState.Valid = false;
+	m_Layout.Generation = 0;
+	m_Offsets.Generation = 0;
+	m_Metrics.Valid = false;
+
+	m_Chars.insert(m_Chars.begin() + index, aGlyph.Character);
+	m_Colors.insert(m_Colors.begin() + index, (uint8_t)aGlyph.ColorIndex);
+
+	for (auto it = std::lower_bound(m_Folds.begin(), m_Folds.end(), (uint32_t)index); it != m_Folds.end(); ++it)
+		(*it)++;
+
+	if (!m_Flags.empty())
+		InsertFlags(index, 1);
+
+	SetComment(index, aGlyph.Comment);
+	SetMultiLineComment(index, aGlyph.MultiLineComment);
+	SetPreprocessor(index, aGlyph.Preprocessor);
 }
 
-std::string ImTextEdit::GetText(const Coordinates & aStart, const Coordinates & aEnd) const
+void ImTextEdit::Line::insert(Iterator aWhere, Iterator aFirst, Iterator aLast)
 {
-	std::string result;
+	// inserting a part of the line into itself: work on a copy of the source
+	if (aFirst.m_Line == this)
+	{
+		Line copy = *this;
+		insert(aWhere, Iterator(&copy, aFirst.m_Index), Iterator(&copy, aLast.m_Index));
+		return;
+	}
 
-	auto lstart = aStart.Line;
-	auto lend = aEnd.Line;
-	auto istart = GetCharacterIndex(aStart);
-	auto iend = GetCharacterIndex(aEnd);
-	size_t s = 0;
+	const Line& source = *aFirst.m_Line;
+	size_t index = aWhere.m_Index;
+	size_t count = aLast.m_Index - aFirst.m_Index;
 
-	for (size_t i = lstart; i < lend; i++)
-		s += m_Lines[i].size();
+	if (count == 0)
+		return;
 
-	result.reserve(s + s / 8);
+	m_LexState.Valid = false;
+	m_Layout.Generation = 0;
+	m_Offsets.Generation = 0;
+	m_Metrics.Valid = false;
 
-	while (istart < iend || lstart < lend)
-	{
-		if (lstart >= (int)m_Lines.size())
-			break;
+	m_Chars.insert(m_Chars.begin() + index, source.m_Chars.begin() + aFirst.m_Index, source.m_Chars.begin() + aLast.m_Index);
+	m_Colors.insert(m_Colors.begin() + index, source.m_Colors.begin() + aFirst.m_Index, source.m_Colors.begin() + aLast.m_Index);
 
-		auto& line = m_Lines[lstart];
+	// folded braces come along with the glyphs
+	auto foldsEnd = std::lower_bound(m_Folds.begin(), m_Folds.end(), (uint32_t)index);
+	for (auto it = foldsEnd; it != m_Folds.end(); ++it)
+		*it += (uint32_t)count;
 
-		if (istart < (int)line.size())
-		{
-			result += line[istart].Character;
-			istart++;
-		}
-		else
+	auto sourceFirst = std::lower_bound(source.m_Folds.begin(), source.m_Folds.end(), (uint32_t)aFirst.m_Index);
+	auto sourceLast = std::lower_bound(sourceFirst, source.m_Folds.end(), (uint32_t)aLast.m_Index);
+	foldsEnd = m_Folds.insert(foldsEnd, sourceFirst, sourceLast);
+	for (auto it = sourceFirst; it != sourceLast; ++it, ++foldsEnd)
+		*foldsEnd = *it - (uint32_t)aFirst.m_Index + (uint32_t)index;
+
+	if (!m_Flags.empty())
+		InsertFlags(index, count);
+
+	if (!source.m_Flags.empty())
+	{
+		for (size_t i = 0; i < count; i++)
 		{
-			istart = 0;
-			if (!(lstart == lend-1 && iend == -1))
-				result += '\n';
-			++lstart;
+			SetComment(index + i, source.IsComment(aFirst.m_Index + i));
+			SetMultiLineComment(index + i, source.IsMultiLineComment(aFirst.m_Index + i));
+			SetPreprocessor(index + i, source.IsPreprocessor(aFirst.m_Index + i));
 		}
 	}
-
-	return result;
 }
 
-ImTextEdit::Coordinates ImTextEdit::GetActualCursorCoordinates() const
+void ImTextEdit::Line::insert(Iterator aWhere, const char* aBegin, const char* aEnd)
 {
-	return SanitizeCoordinates(m_State.CursorPosition);
-}
+	if (aBegin == aEnd)
+		return;
 
-ImTextEdit::Coordinates ImTextEdit::SanitizeCoordinates(const Coordinates & aValue) const
-{
-	auto line = aValue.Line;
-	auto column = aValue.Column;
+	m_LexState.Valid = false;
+	m_Layout.Generation = 0;
+	m_Offsets.Generation = 0;
+	m_Metrics.Valid = false;
 
-	if (line >= (int)m_Lines.size())
+	size_t index = aWhere.m_Index;
+	size_t size = m_Chars.size();
+
+	if (memchr(aBegin, '\r', aEnd - aBegin) == nullptr)
 	{
-		if (m_Lines.empty())
-		{
-			line = 0;
-			column = 0;
-		}
-		else
+		m_Chars.insert(m_Chars.begin() + index, (const td_Char*)aBegin, (const td_Char*)aEnd);
+	}
+	else
+	{
+		std::vector<td_Char> chars;
+		chars.reserve(aEnd - aBegin);
+
+		for (const char* it = aBegin; it < aEnd; ++it)
 		{
-			line = (int)m_Lines.size() - 1;
-			column = GetLineMaxColumn(line);
+			if (*it != '\r')
+				chars.push_back((td_Char)*it);
 		}
 
-		return Coordinates(line, column);
+		m_Chars.insert(m_Chars.begin() + index, chars.begin(), chars.end());
 	}
-	else
+
+	size_t count = m_Chars.size() - size;
+	m_Colors.insert(m_Colors.begin() + index, count, (uint8_t)PaletteIndex::Default);
+
+	for (auto it = std::lower_bound(m_Folds.begin(), m_Folds.end(), (uint32_t)index); it != m_Folds.end(); ++it)
+		*it += (uint32_t)count;
+
+	if (!m_Flags.empty())
+		InsertFlags(index, count);
+}
+
+void ImTextEdit::Line::erase(Iterator aFirst, Iterator aLast)
+{
+	if (aFirst.m_Index >= aLast.m_Index)
+		return;
+
+	m_LexState.Valid = false;
+	m_Layout.Generation = 0;
+	m_Offsets.Generation = 0;
+	m_Metrics.Valid = false;
+
+	if (!m_Flags.empty())
+		EraseFlags(aFirst.m_Index, aLast.m_Index);
+
+	if (!m_Folds.empty())
 	{
-		column = std::max<int>(0, m_Lines.empty() ? 0 : std::min(column, GetLineMaxColumn(line)));
-		return Coordinates(line, column);
+		auto first = std::lower_bound(m_Folds.begin(), m_Folds.end(), (uint32_t)aFirst.m_Index);
+		auto last = std::lower_bound(first, m_Folds.end(), (uint32_t)aLast.m_Index);
+		for (auto it = last; it != m_Folds.end(); ++it)
+			*it -= (uint32_t)(aLast.m_Index - aFirst.m_Index);
+		m_Folds.erase(first, last);
 	}
+
+	m_Chars.erase(m_Chars.begin() + aFirst.m_Index, m_Chars.begin() + aLast.m_Index);
+	m_Colors.erase(m_Colors.begin() + aFirst.m_Index, m_Colors.begin() + aLast.m_Index);
 }
 
-// https://en.wikipedia.org/wiki/UTF-8
-// We assume that the char is a standalone character (<128) or a leading byte of an UTF-8 code sequence (non-10xxxxxx code)
-static int UTF8CharLength(ImTextEdit::td_Char c)
+void ImTextEdit::Line::reserve(size_t aCount)
 {
-	if ((c & 0xFE) == 0xFC)
-		return 6;
-	if ((c & 0xFC) == 0xF8)
-		return 5;
-	if ((c & 0xF8) == 0xF0)
-		return 4;
-	else if ((c & 0xF0) == 0xE0)
-		return 3;
-	else if ((c & 0xE0) == 0xC0)
-		return 2;
-
-	return 1;
+	m_Chars.reserve(aCount);
+	m_Colors.reserve(aCount);
 }
 
-// "Borrowed" from ImGui source
-static inline int ImTextCharToUtf8(char* buf, int buf_size, unsigned int c)
+void ImTextEdit::Line::clear()
 {
-	if (c < 0x80)
-	{
-		buf[0] = (char)c;
+	m_LexState.Valid = false;
+	m_Layout = LineLayout();
+	m_Offsets = LineOffsets();
+	m_Metrics = LineMetrics();
+	m_Chars.clear();
+	m_Colors.clear();
+	m_Flags.clear();
+	m_Folds.clear();
+}
 
-		return 1;
-	}
+void ImTextEdit::Line::assign(const char* aBegin, const char* aEnd)
+{
+	clear();
 
-	if (c < 0x800)
+	// carriage returns are dropped like SetText does, most lines don't have any
+	if (memchr(aBegin, '\r', aEnd - aBegin) == nullptr)
 	{
-		if (buf_size < 2)
-			return 0;
-
-		buf[0] = (char)(0xc0 + (c >> 6));
-		buf[1] = (char)(0x80 + (c & 0x3f));
-		
-		return 2;
+		m_Chars.assign((const td_Char*)aBegin, (const td_Char*)aEnd);
 	}
-	
-	if (c >= 0xdc00 && c < 0xe000)
+	else
 	{
-		return 0;
+		m_Chars.reserve(aEnd - aBegin);
+		for (const char* it = aBegin; it < aEnd; ++it)
+		{
+			if (*it != '\r')
+				m_Chars.push_back((td_Char)*it);
+		}
 	}
-	
-	if (c >= 0xd800 && c < 0xdc00)
-	{
-		if (buf_size < 4)
-			return 0;
 
-		buf[0] = (char)(0xf0 + (c >> 18));
-		buf[1] = (char)(0x80 + ((c >> 12) & 0x3f));
-		buf[2] = (char)(0x80 + ((c >> 6) & 0x3f));
-		buf[3] = (char)(0x80 + ((c) & 0x3f));
-		
-		return 4;
-	}
+	m_Colors.assign(m_Chars.size(), (uint8_t)PaletteIndex::Default);
+}
 
-	//else if (c < 0x10000)
-	{
-		if (buf_size < 3)
-			return 0;
+void ImTextEdit::Line::SetFolded(size_t aIndex, bool aValue)
+{
+	auto it = std::lower_bound(m_Folds.begin(), m_Folds.end(), (uint32_t)aIndex);
+	bool folded = it != m_Folds.end() && *it == aIndex;
 
-		buf[0] = (char)(0xe0 + (c >> 12));
-		buf[1] = (char)(0x80 + ((c >> 6) & 0x3f));
-		buf[2] = (char)(0x80 + ((c) & 0x3f));
-		
-		return 3;
-	}
+	if (aValue && !folded)
+		m_Folds.insert(it, (uint32_t)aIndex);
+	else if (!aValue && folded)
+		m_Folds.erase(it);
 }
 
-void ImTextEdit::Advance(Coordinates & aCoordinates) const
+size_t ImTextEdit::Line::GetMemoryUsage() const
 {
-	if (aCoordinates.Line < (int)m_Lines.size())
+	return sizeof(Line) + m_Chars.capacity() + m_Colors.capacity() + m_Flags.capacity() * sizeof(uint64_t) +
+		m_Layout.Runs.capacity() * sizeof(LineLayout::Run) + m_Layout.Tabs.capacity() * sizeof(ImVec2) + m_Layout.Spaces.capacity() * sizeof(float) +
+		m_Offsets.X.capacity() * sizeof(float) + m_Offsets.Column.capacity() * sizeof(int) + m_Folds.capacity() * sizeof(uint32_t) +
+		(m_Metrics.Tabs.capacity() + m_Metrics.TabEnds.capacity()) * sizeof(uint32_t);
+}
+
+void ImTextEdit::Line::InsertFlags(size_t aIndex, size_t aCount)
+{
+	// m_Chars already contains the inserted glyphs, shift the bits from aIndex up by aCount a word at a time.
+	// Bits past the end of the line are always 0, so nothing has to be cleared above the last glyph
+	size_t words = (m_Chars.size() + 63) / 64;
+	m_Flags.resize(words * FlagCount, 0);
+
+	size_t first = aIndex >> 6;
+	size_t wordShift = aCount >> 6;
+	int bitShift = (int)(aCount & 63);
+	uint64_t low = ((uint64_t)1 << (aIndex & 63)) - 1; // bits of the first word before aIndex stay
+
+	for (int f = 0; f < FlagCount; f++)
 	{
-		auto& line = m_Lines[aCoordinates.Line];
-		auto cindex = GetCharacterIndex(aCoordinates);
+		uint64_t* plane = m_Flags.data() + f;
 
-		if (cindex + 1 < (int)line.size())
+		// word aWord of the plane with the bits before aIndex cleared
+		auto moved = [&](size_t aWord) -> uint64_t
 		{
-			auto delta = UTF8CharLength(line[cindex].Character);
-			cindex = std::min(cindex + delta, (int)line.size() - 1);
-		}
-		else
+			if (aWord < first)
+				return 0;
+			return aWord == first ? plane[aWord * FlagCount] & ~low : plane[aWord * FlagCount];
+		};
+
+		uint64_t kept = plane[first * FlagCount] & low;
+
+		// top down, every word only reads the words below it
+		for (size_t w = words; w-- > first;)
 		{
-			++aCoordinates.Line;
-			cindex = 0;
+			uint64_t word = w >= wordShift ? moved(w - wordShift) << bitShift : 0;
+
+			if (bitShift != 0 && w >= wordShift + 1)
+				word |= moved(w - wordShift - 1) >> (64 - bitShift);
+
+			plane[w * FlagCount] = word;
 		}
-		
-		aCoordinates.Column = GetCharacterColumn(aCoordinates.Line, cindex);
+
+		plane[first * FlagCount] |= kept;
 	}
 }
 
-void ImTextEdit::DeleteRange(const Coordinates& aStart, const Coordinates& aEnd)
+void ImTextEdit::Line::EraseFlags(size_t aStart, size_t aEnd)
 {
-	assert(aEnd >= aStart);
-	assert(!m_ReadOnly);
-
-	if (aEnd == aStart)
+	// called before m_Chars shrinks, shift the bits from aEnd down to aStart a word at a time. The bits
+	// shifted in above the new end come from past the old end, so they are 0
+	if (aStart >= aEnd)
 		return;
 
-	auto start = GetCharacterIndex(aStart);
-	auto end = GetCharacterIndex(aEnd);
+	size_t count = m_Chars.size();
+	size_t words = (count + 63) / 64;
+	size_t removed = aEnd - aStart;
 
-	if (aStart.Line == aEnd.Line)
-	{
-		auto& line = m_Lines[aStart.Line];
-		auto n = GetLineMaxColumn(aStart.Line);
-		
-		if (aEnd.Column >= n)
-			line.erase(line.begin() + start, line.end());
-		else
-			line.erase(line.begin() + start, line.begin() + end);
+	size_t first = aStart >> 6;
+	size_t wordShift = removed >> 6;
+	int bitShift = (int)(removed & 63);
+	uint64_t low = ((uint64_t)1 << (aStart & 63)) - 1;
 
-		RemoveFolds(aStart, aEnd);
-	}
-	else
+	for (int f = 0; f < FlagCount; f++)
 	{
-		auto& firstLine = m_Lines[aStart.Line];
-		auto& lastLine = m_Lines[aEnd.Line];
-
-		// remove the folds
-		RemoveFolds(aStart, aEnd);
+		uint64_t* plane = m_Flags.data() + f;
+		auto word = [&](size_t aWord) -> uint64_t { return aWord < words ? plane[aWord * FlagCount] : 0; };
 
-		firstLine.erase(firstLine.begin() + start, firstLine.end());
-		lastLine.erase(lastLine.begin(), lastLine.begin() + end);
-		
-		if (aStart.Line < aEnd.Line)
-			firstLine.insert(firstLine.end(), lastLine.begin(), lastLine.end());
+		uint64_t kept = plane[first * FlagCount] & low;
 
-		if (aStart.Line < aEnd.Line)
+		// bottom up, every word only reads the words above it
+		for (size_t w = first; w < words; w++)
 		{
-			// remove the actual lines
-			RemoveLine(aStart.Line + 1, aEnd.Line + 1);
+			uint64_t shifted = word(w + wordShift) >> bitShift;
+
+			if (bitShift != 0)
+				shifted |= word(w + wordShift + 1) << (64 - bitShift);
+
+			plane[w * FlagCount] = shifted;
 		}
+
+		plane[first * FlagCount] = (plane[first * FlagCount] & ~low) | kept;
 	}
 
-	if (m_ScrollbarMarkers)
+	m_Flags.resize(FlagWordCount(count - removed));
+}
+
+static inline int CountTrailingZeros(uint32_t aValue)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, aValue);
+	return (int)index;
+#else
+	return __builtin_ctz(aValue);
+#endif
+}
+
+// calls aCallback with every '\n' in [aBegin, aEnd), 32 or 16 bytes at a time where AVX2 or SSE2 is available
+template<typename TCallback>
+static void ForEachNewline(const char* aBegin, const char* aEnd, TCallback&& aCallback)
+{
+	const char* it = aBegin;
+
+#ifdef __AVX2__
+	const __m256i newlines = _mm256_set1_epi8('\n');
+
+	for (; aEnd - it >= 32; it += 32)
 	{
-		for (int i = 0; i < m_ChangedLines.size(); i++)
-		{
-			if (m_ChangedLines[i] > aEnd.Line)
-			{
-				m_ChangedLines[i] -= (aEnd.Line - aStart.Line);
-			}
-			else if (m_ChangedLines[i] > aStart.Line && m_ChangedLines[i] < aEnd.Line)
-			{
-				m_ChangedLines.erase(m_ChangedLines.begin() + i);
-				i--;
-			}
-		}
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)it), newlines));
+
+		for (; mask != 0; mask &= mask - 1)
+			aCallback(it + CountTrailingZeros(mask));
 	}
+#endif
 
-	m_TextChanged = true;
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128i newline = _mm_set1_epi8('\n');
 
-	if (OnContentUpdate != nullptr)
-		OnContentUpdate(this);
+	for (; aEnd - it >= 16; it += 16)
+	{
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)it), newline));
+
+		for (; mask != 0; mask &= mask - 1)
+			aCallback(it + CountTrailingZeros(mask));
+	}
+#endif
+
+	for (; it < aEnd; ++it)
+	{
+		if (*it == '\n')
+			aCallback(it);
+	}
 }
 
-int ImTextEdit::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue, bool indent)
+// splits [0, aCount) into one range per core and calls aCallback(first, last) for each of them on its own thread,
+// the calling thread takes the first range. Jobs with less than aMinPerThread items per range stay on one thread
+template<typename TCallback>
+static void ParallelFor(size_t aCount, size_t aMinPerThread, TCallback&& aCallback)
 {
-	assert(!m_ReadOnly);
+	size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), aCount / std::max<size_t>(aMinPerThread, 1));
 
-	int autoIndentStart = 0;
-	for (int i = 0; i < m_Lines[aWhere.Line].size() && indent; i++)
+	if (threads <= 1)
 	{
-		td_Char ch = m_Lines[aWhere.Line][i].Character;
-		
-		if (ch == ' ')
-			autoIndentStart++;
-		else if (ch == '\t')
-			autoIndentStart += m_TabSize;
-		else
-			break;
+		aCallback((size_t)0, aCount);
+		return;
 	}
 
-	int cindex = GetCharacterIndex(aWhere);
-	int totalLines = 0;
-	int autoIndent = autoIndentStart;
-	
-	while (*aValue != '\0')
+	size_t step = (aCount + threads - 1) / threads;
+	std::vector<std::thread> workers;
+
+	for (size_t first = step; first < aCount; first += step)
 	{
-		assert(!m_Lines.empty());
+		size_t last = std::min(first + step, aCount);
+		workers.emplace_back([&aCallback, first, last]() { aCallback(first, last); });
+	}
 
-		if (*aValue == '\r')
-		{
-			// skip
-			++aValue;
-		}
-		else if (*aValue == '\n')
-		{
-			if (cindex < (int)m_Lines[aWhere.Line].size() && cindex >= 0)
-			{
-				// normal stuff
-				auto& newLine = InsertLine(aWhere.Line + 1, aWhere.Column);
-				auto& line = m_Lines[aWhere.Line];
-				newLine.insert(newLine.begin(), line.begin() + cindex, line.end());
-				line.erase(line.begin() + cindex, line.end());
+	aCallback((size_t)0, step);
 
-				// folding
-				for (int b = 0; b < m_FoldBegin.size(); b++)
-				{
-					if (m_FoldBegin[b].Line == aWhere.Line + 1 && m_FoldBegin[b].Column >= aWhere.Column)
-						m_FoldBegin[b].Column = std::max<int>(0, m_FoldBegin[b].Column - aWhere.Column);
-				}
+	for (auto& worker : workers)
+		worker.join();
+}
 
-				for (int b = 0; b < m_FoldEnd.size(); b++)
-				{
-					if (m_FoldEnd[b].Line == aWhere.Line + 1 && m_FoldEnd[b].Column >= aWhere.Column)
-						m_FoldEnd[b].Column = std::max<int>(0, m_FoldEnd[b].Column - aWhere.Column);
-				}
-			}
-			else
-			{
-				InsertLine(aWhere.Line + 1, aWhere.Column);
-			}
+// offsets of every '\n' in aText, large texts are scanned in chunks on several threads
+static void FindLineEnds(const char* aText, size_t aSize, std::vector<size_t>& aEnds)
+{
+	static const size_t chunkSize = 1 << 20;
 
-			++aWhere.Line;
-			cindex = 0;
-			aWhere.Column = 0;
-			++totalLines;
-			++aValue;
+	size_t chunks = (aSize + chunkSize - 1) / chunkSize;
+	std::vector<std::vector<size_t>> found(chunks);
 
-			if (indent)
-			{
-				bool lineIsAlreadyIndent = (isspace(*aValue) && *aValue != '\n' && *aValue != '\r');
+	ParallelFor(chunks, 4, [&](size_t aFirst, size_t aLast)
+	{
+		for (size_t c = aFirst; c < aLast; c++)
+		{
+			const char* begin = aText + c * chunkSize;
+			const char* end = aText + std::min((c + 1) * chunkSize, aSize);
 
-				// first check if we need to "unindent"
-				const char* bracketSearch = aValue;
-				
-				while (*bracketSearch != '\0' && isspace(*bracketSearch) && *bracketSearch != '\n')
-					bracketSearch++;
-				
-				if (*bracketSearch == '}')
-					autoIndent = std::max(0, autoIndent - m_TabSize);
+			ForEachNewline(begin, end, [&](const char* aNewline) { found[c].push_back(aNewline - aText); });
+		}
+	});
 
-				int actualAutoIndent = autoIndent;
-				
-				if (lineIsAlreadyIndent)
-				{
-					actualAutoIndent = autoIndentStart;
+	size_t count = 0;
+	for (auto& ends : found)
+		count += ends.size();
 
-					const char* aValueCopy = aValue;
-					
-					while (isspace(*aValueCopy) && *aValueCopy != '\n' && *aValueCopy != '\r' && *aValueCopy != 0)
-					{
-						actualAutoIndent = std::max(0, actualAutoIndent - m_TabSize);
-						aValueCopy++;
-					}
-				}
+	aEnds.clear();
+	aEnds.reserve(count + 1);
 
-				// add tabs
-				int tabCount = actualAutoIndent / m_TabSize;
-				int spaceCount = actualAutoIndent - tabCount * m_TabSize;
-				
-				if (m_InsertSpaces)
-				{
-					tabCount = 0;
-					spaceCount = actualAutoIndent;
-				}
+	for (auto& ends : found)
+		aEnds.insert(aEnds.end(), ends.begin(), ends.end());
+}
 
-				cindex = tabCount + spaceCount;
-				aWhere.Column = actualAutoIndent;
+ImTextEdit::MappedFile::MappedFile()
+	: m_Data(nullptr), m_Size(0)
+#ifdef _WIN32
+	, m_Mapping(nullptr)
+#endif
+{
+}
 
-				// folding
-				for (int b = 0; b < m_FoldBegin.size(); b++)
-				{
-					if (m_FoldBegin[b].Line == aWhere.Line && m_FoldBegin[b].Column >= aWhere.Column)
-						m_FoldBegin[b].Column += spaceCount + tabCount * m_TabSize;
-				}
+ImTextEdit::MappedFile::~MappedFile()
+{
+	Close();
+}
 
-				for (int b = 0; b < m_FoldEnd.size(); b++)
-				{
-					if (m_FoldEnd[b].Line == aWhere.Line && m_FoldEnd[b].Column >= aWhere.Column)
-						m_FoldEnd[b].Column += spaceCount + tabCount * m_TabSize;
-				}
+bool ImTextEdit::MappedFile::Open(const std::string& aPath)
+{
+	Close();
 
-				// insert the spaces/tabs
-				while (spaceCount-- > 0)
-				{
-					m_Lines[aWhere.Line].insert(m_Lines[aWhere.Line].begin(), Glyph(' ', PaletteIndex::Default));
-					
-					for (int i = 0; i < m_SnippetTagStart.size(); i++)
-					{
-						if (m_SnippetTagStart[i].Line == aWhere.Line)
-						{
-							m_SnippetTagStart[i].Column++;
-							m_SnippetTagEnd[i].Column++;
-						}
-					}
-				}
-				
-				while (tabCount-- > 0)
-				{
-					m_Lines[aWhere.Line].insert(m_Lines[aWhere.Line].begin(), Glyph('\t', PaletteIndex::Default));
-					
-					for (int i = 0; i < m_SnippetTagStart.size(); i++)
-					{
-						if (m_SnippetTagStart[i].Line == aWhere.Line)
-						{
-							m_SnippetTagStart[i].Column += m_TabSize;
-							m_SnippetTagEnd[i].Column += m_TabSize;
-						}
-					}
-				}
-			}
-		}
-		else
-		{
-			char aValueOld = *aValue;
-			bool isTab = (aValueOld == '\t');
-			auto& line = m_Lines[aWhere.Line];
-			auto d = UTF8CharLength(aValueOld);
-			int foldOffset = 0;
-			
-			while (d-- > 0 && *aValue != '\0')
-			{
-				foldOffset += (*aValue == '\t') ? m_TabSize : 1;
-				line.insert(line.begin() + cindex++, Glyph(*aValue++, PaletteIndex::Default));
-			}
+#ifdef _WIN32
+	HANDLE file = CreateFileA(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
 
-			// shift old fold info
-			for (int i = 0; i < m_FoldBegin.size(); i++)
-			{
-				if (m_FoldBegin[i].Line == aWhere.Line && m_FoldBegin[i].Column >= aWhere.Column)
-					m_FoldBegin[i].Column += foldOffset;
-			}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
 
-			for (int i = 0; i < m_FoldEnd.size(); i++)
-			{
-				if (m_FoldEnd[i].Line == aWhere.Line && m_FoldEnd[i].Column >= aWhere.Column)
-					m_FoldEnd[i].Column += foldOffset;
-			}
+	// an empty file can't be mapped, there is nothing to read anyway
+	if (size.QuadPart > 0)
+	{
+		m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
 
-			// insert new fold info
-			if (aValueOld == '{')
-			{
-				autoIndent += m_TabSize;
+		if (m_Mapping != nullptr)
+			m_Data = (const char*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+	}
 
-				m_FoldBegin.push_back(aWhere);
-				m_FoldSorted = false;
-			}
-			else if (aValueOld == '}')
-			{
-				autoIndent = std::max(0, autoIndent - m_TabSize);
+	// the mapping keeps the file open
+	CloseHandle(file);
 
-				m_FoldEnd.push_back(aWhere);
-				m_FoldSorted = false;
-			}
+	if (size.QuadPart > 0 && m_Data == nullptr)
+	{
+		Close();
+		return false;
+	}
 
-			aWhere.Column += (isTab ? m_TabSize : 1);
-		}
+	m_Size = (size_t)size.QuadPart;
+#else
+	int file = open(aPath.c_str(), O_RDONLY);
+	if (file == -1)
+		return false;
+
+	struct stat info;
+	if (fstat(file, &info) != 0)
+	{
+		close(file);
+		return false;
 	}
 
-	if (m_ScrollbarMarkers)
+	// an empty file can't be mapped, there is nothing to read anyway
+	if (info.st_size > 0)
 	{
-		bool changeExists = false;
-		
-		for (int i = 0; i < m_ChangedLines.size(); i++)
+		void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+		if (data == MAP_FAILED)
 		{
-			if (m_ChangedLines[i] == aWhere.Line)
-			{
-				changeExists = true;
-				break;
-			}
+			close(file);
+			return false;
 		}
 
-		if (!changeExists)
-			m_ChangedLines.push_back(aWhere.Line);
+		m_Data = (const char*)data;
+		m_Size = (size_t)info.st_size;
 	}
 
-	m_TextChanged = true;
-
-	if (OnContentUpdate != nullptr)
-		OnContentUpdate(this);
+	// the mapping keeps the file open
+	close(file);
+#endif
 
-	return totalLines;
+	return true;
 }
 
-void ImTextEdit::AddUndo(UndoRecord& aValue)
+void ImTextEdit::MappedFile::Close()
 {
-	assert(!m_ReadOnly);
-	//printf("AddUndo: (@%d.%d) +\'%s' [%d.%d .. %d.%d], -\'%s', [%d.%d .. %d.%d] (@%d.%d)\n",
-	//	aValue.mBefore.mCursorPosition.mLine, aValue.mBefore.mCursorPosition.mColumn,
-	//	aValue.mAdded.c_str(), aValue.mAddedStart.mLine, aValue.mAddedStart.mColumn, aValue.mAddedEnd.mLine, aValue.mAddedEnd.mColumn,
-	//	aValue.mRemoved.c_str(), aValue.mRemovedStart.mLine, aValue.mRemovedStart.mColumn, aValue.mRemovedEnd.mLine, aValue.mRemovedEnd.mColumn,
-	//	aValue.mAfter.mCursorPosition.mLine, aValue.mAfter.mCursorPosition.mColumn
-	//	);
-
-	m_UndoBuffer.resize((size_t)(m_UndoIndex + 1));
-	m_UndoBuffer.back() = aValue;
-	++m_UndoIndex;
+#ifdef _WIN32
+	if (m_Data != nullptr)
+		UnmapViewOfFile(m_Data);
+	if (m_Mapping != nullptr)
+		CloseHandle(m_Mapping);
+
+	m_Mapping = nullptr;
+#else
+	if (m_Data != nullptr)
+		munmap((void*)m_Data, m_Size);
+#endif
+
+	m_Data = nullptr;
+	m_Size = 0;
 }
 
-ImTextEdit::Coordinates ImTextEdit::ScreenPosToCoordinates(const ImVec2& aPosition) const
+void ImTextEdit::MappedFile::Release(const char* aBegin, const char* aEnd) const
 {
-	ImVec2 origin = m_UICursorPos;
-	ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+#ifdef _WIN32
+	// the working set of a mapped view is trimmed by the system on its own
+	(void)aBegin;
+	(void)aEnd;
+#else
+	// reading a page can map the cached pages around it too, up to a whole huge page. The mapping is private
+	// and never written, dropped pages are simply read from the file again, so all of those can go
+	const uintptr_t window = 2 << 20;
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t begin = std::max((uintptr_t)aBegin & ~(window - 1), (uintptr_t)m_Data);
+	uintptr_t end = std::min(((uintptr_t)aEnd + window - 1) & ~(window - 1), ((uintptr_t)m_Data + m_Size + page - 1) & ~(page - 1));
+
+	if (begin < end)
+		madvise((void*)begin, end - begin, MADV_DONTNEED);
+#endif
+}
 
-	int lineNo = std::max(0, (int)floor(local.y / m_CharAdvance.y));
-	int columnCoord = 0;
+ImTextEdit::Line& ImTextEdit::LineStore::insert(size_t aIndex, Line&& aLine)
+{
+	assert(aIndex <= m_Size);
+	assert(m_ResidentLimit == 0);
 
-	// check for folds
-	if (m_FoldEnabled)
+	// appending starts a new block once the last one is full, so loading a file produces full blocks
+	if (m_Blocks.empty() || (aIndex == m_Size && m_Blocks.back().GetCount() >= s_BlockSize))
 	{
-		auto foldLineStart = 0;
-		auto foldLineEnd = std::min<int>((int)m_Lines.size() - 1, lineNo);
-	
-		while (foldLineStart < foldLineEnd)
-		{
-			// check if line is folded
-			for (int i = 0; i < m_FoldBegin.size(); i++)
-			{
-				if (m_FoldBegin[i].Line == foldLineStart)
-				{
-					if (i < m_Fold.size() && m_Fold[i])
-					{
-						int foldCon = m_FoldConnection[i];
+		m_Blocks.emplace_back();
+		m_Blocks.back().Start = m_Size;
+	}
 
-						if (foldCon != -1 && foldCon < m_FoldEnd.size())
-						{
-							int diff = m_FoldEnd[foldCon].Line - m_FoldBegin[i].Line;
-							lineNo += diff;
-							foldLineEnd = std::min<int>((int)m_Lines.size() - 1, foldLineEnd + diff);
-						}
+	size_t block = (aIndex == m_Size) ? m_Blocks.size() - 1 : FindBlock(aIndex);
+	Load(block);
 
-						break;
-					}
-				}
-			}
+	auto& lines = m_Blocks[block].Lines;
+	size_t local = aIndex - m_Blocks[block].Start;
 
-			foldLineStart++;
-		}
-	}
+	lines.insert(lines.begin() + local, std::move(aLine));
+	m_Size++;
 
-	if (lineNo >= 0 && lineNo < (int)m_Lines.size())
+	// split the block in half once it grows to twice the block size
+	if (lines.size() >= 2 * s_BlockSize)
 	{
-		auto& line = m_Lines.at(lineNo);
-
-		int columnIndex = 0;
-		float columnX = 0.0f;
+		Block tail;
+		tail.Lines.assign(std::make_move_iterator(lines.begin() + s_BlockSize), std::make_move_iterator(lines.end()));
+		lines.erase(lines.begin() + s_BlockSize, lines.end());
 
-		while ((size_t)columnIndex < line.size())
-		{
-			float columnWidth = 0.0f;
+		tail.Fresh = m_Blocks[block].Fresh;
+		if (tail.Fresh)
+			m_FreshBlocks++;
 
-			if (line[columnIndex].Character == '\t')
-			{
-				float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
-				float oldX = columnX;
-				float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(m_TabSize) * spaceSize))) * (float(m_TabSize) * spaceSize);
-				columnWidth = newColumnX - oldX;
-				
-				if (m_TextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX = newColumnX;
-				columnCoord = (columnCoord / m_TabSize) * m_TabSize + m_TabSize;
-				columnIndex++;
-			}
-			else
-			{
-				char buf[7];
-				auto d = UTF8CharLength(line[columnIndex].Character);
-				int i = 0;
-				while (i < 6 && d-- > 0)
-					buf[i++] = line[columnIndex++].Character;
-				buf[i] = '\0';
-				columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
-				
-				if (m_TextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				
-				columnX += columnWidth;
-				columnCoord++;
-			}
-		}
+		m_Blocks.insert(m_Blocks.begin() + block + 1, std::move(tail));
 	}
 
-	return SanitizeCoordinates(Coordinates(lineNo, columnCoord));
+	UpdateBlockStarts(block);
+
+	return (*this)[aIndex];
 }
-ImTextEdit::Coordinates ImTextEdit::MousePosToCoordinates(const ImVec2& aPosition) const
+
+void ImTextEdit::LineStore::insert(size_t aIndex, std::vector<Line>&& aLines)
 {
-	ImVec2 origin = m_UICursorPos;
-	ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+	assert(aIndex <= m_Size);
+	assert(m_ResidentLimit == 0);
 
-	int lineNo = std::max(0, (int)floor(local.y / m_CharAdvance.y));
-	int columnCoord = 0;
-	int modifier = 0;
+	if (aLines.empty())
+		return;
 
-	// check for folds
-	if (m_FoldEnabled)
+	if (m_Blocks.empty())
 	{
-		auto foldLineStart = 0;
-		auto foldLineEnd = std::min<int>((int)m_Lines.size() - 1, lineNo);
-	
-		while (foldLineStart < foldLineEnd)
-		{
-			// check if line is folded
-			for (int i = 0; i < m_FoldBegin.size(); i++)
-			{
-				if (m_FoldBegin[i].Line == foldLineStart)
-				{
-					if (i < m_Fold.size() && m_Fold[i])
-					{
-						int foldCon = m_FoldConnection[i];
+		m_Blocks.emplace_back();
+		m_Blocks.back().Start = m_Size;
+	}
 
-						if (foldCon != -1 && foldCon < m_FoldEnd.size())
-						{
-							int diff = m_FoldEnd[foldCon].Line - m_FoldBegin[i].Line;
-							lineNo += diff;
-							foldLineEnd = std::min<int>((int)m_Lines.size() - 1, foldLineEnd + diff);
-						}
+	size_t block = (aIndex == m_Size) ? m_Blocks.size() - 1 : FindBlock(aIndex);
+	Load(block);
 
-						break;
-					}
-				}
-			}
+	auto& lines = m_Blocks[block].Lines;
+	size_t local = aIndex - m_Blocks[block].Start;
 
-			foldLineStart++;
-		}
-	}
+	lines.insert(lines.begin() + local, std::make_move_iterator(aLines.begin()), std::make_move_iterator(aLines.end()));
+	m_Size += aLines.size();
 
-	if (lineNo >= 0 && lineNo < (int)m_Lines.size())
+	// cut the block into blocks of the block size at once, the last one takes the rest
+	if (lines.size() >= 2 * s_BlockSize)
 	{
-		auto& line = m_Lines.at(lineNo);
+		std::vector<Line> all = std::move(lines);
+		size_t count = all.size() / s_BlockSize;
+		bool fresh = m_Blocks[block].Fresh;
 
-		int columnIndex = 0;
-		float columnX = 0.0f;
+		std::vector<Block> tails(count - 1);
 
-		while ((size_t)columnIndex < line.size())
+		for (size_t i = 1; i < count; i++)
 		{
-			float columnWidth = 0.0f;
+			auto first = all.begin() + i * s_BlockSize;
+			auto last = (i + 1 == count) ? all.end() : first + s_BlockSize;
 
-			if (line[columnIndex].Character == '\t')
-			{
-				float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
-				float oldX = columnX;
-				float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(m_TabSize) * spaceSize))) * (float(m_TabSize) * spaceSize);
-				columnWidth = newColumnX - oldX;
-				
-				if (m_TextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				
-				columnX = newColumnX;
-				columnCoord = (columnCoord / m_TabSize) * m_TabSize + m_TabSize;
-				columnIndex++;
-				modifier += 3;
-			}
-			else
-			{
-				char buf[7];
-				auto d = UTF8CharLength(line[columnIndex].Character);
-				int i = 0;
+			tails[i - 1].Lines.assign(std::make_move_iterator(first), std::make_move_iterator(last));
+			tails[i - 1].Fresh = fresh;
 
-				while (i < 6 && d-- > 0)
-					buf[i++] = line[columnIndex++].Character;
-				
-				buf[i] = '\0';
-				columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
-				
-				if (m_TextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				
-				columnX += columnWidth;
-				columnCoord++;
-			}
+			if (fresh)
+				m_FreshBlocks++;
 		}
+
+		all.resize(s_BlockSize);
+		m_Blocks[block].Lines = std::move(all);
+		m_Blocks.insert(m_Blocks.begin() + block + 1, std::make_move_iterator(tails.begin()), std::make_move_iterator(tails.end()));
 	}
 
-	return SanitizeCoordinates(Coordinates(lineNo, columnCoord - modifier));
+	UpdateBlockStarts(block);
 }
 
-ImTextEdit::Coordinates ImTextEdit::FindWordStart(const Coordinates & aFrom) const
+void ImTextEdit::LineStore::erase(size_t aStart, size_t aEnd)
 {
-	Coordinates at = aFrom;
-	
-	if (at.Line >= (int)m_Lines.size())
-		return at;
-
-	auto& line = m_Lines[at.Line];
-	auto cindex = GetCharacterIndex(at);
+	assert(aStart <= aEnd && aEnd <= m_Size);
+	assert(m_ResidentLimit == 0);
 
-	if (cindex >= (int)line.size())
-		return at;
+	if (aStart == aEnd)
+		return;
 
-	while (cindex > 0 && isspace(line[cindex].Character))
-		--cindex;
+	size_t first = FindBlock(aStart);
+	size_t block = first;
+	size_t local = aStart - m_Blocks[block].Start;
+	size_t count = aEnd - aStart;
 
-	auto cstart = (PaletteIndex)line[cindex].ColorIndex;
-	while (cindex > 0)
+	while (count > 0)
 	{
-		auto c = line[cindex].Character;
+		size_t n = std::min(count, m_Blocks[block].GetCount() - local);
 
-		if ((c & 0xC0) != 0x80)	// not UTF code sequence 10xxxxxx
+		// a block that goes away as a whole doesn't have to be loaded first
+		if (n == m_Blocks[block].GetCount())
 		{
-			if (c <= 32 && isspace(c))
-			{
-				cindex++;
-				break;
-			}
-		
-			if (cstart != (PaletteIndex)line[size_t(cindex - 1)].ColorIndex)
-				break;
+			RemoveBlock(block);
 		}
-		--cindex;
+		else
+		{
+			Load(block);
+
+			auto& lines = m_Blocks[block].Lines;
+			lines.erase(lines.begin() + local, lines.begin() + local + n);
+			block++;
+		}
+
+		count -= n;
+		local = 0;
 	}
-	return Coordinates(at.Line, GetCharacterColumn(at.Line, cindex));
+
+	m_Size -= aEnd - aStart;
+	m_LastBlock = 0;
+
+	if (first < m_Blocks.size())
+		MergeBlock(first);
+
+	if (first > 0)
+		first--;
+
+	UpdateBlockStarts(first);
 }
 
-ImTextEdit::Coordinates ImTextEdit::FindWordEnd(const Coordinates & aFrom) const
+void ImTextEdit::LineStore::resize(size_t aCount)
 {
-	Coordinates at = aFrom;
-	
-	if (at.Line >= (int)m_Lines.size())
-		return at;
+	if (aCount < m_Size)
+		erase(aCount, m_Size);
 
-	auto& line = m_Lines[at.Line];
-	auto cindex = GetCharacterIndex(at);
+	while (m_Size < aCount)
+		push_back(Line());
+}
 
-	if (cindex >= (int)line.size())
-		return at;
+void ImTextEdit::LineStore::Reset(size_t aCount)
+{
+	clear();
 
-	bool prevspace = (bool)isspace(line[cindex].Character);
-	auto cstart = (PaletteIndex)line[cindex].ColorIndex;
-	while (cindex < (int)line.size())
+	m_Blocks.resize((aCount + s_BlockSize - 1) / s_BlockSize);
+
+	for (size_t i = 0; i < m_Blocks.size(); i++)
 	{
-		auto c = line[cindex].Character;
-		auto d = UTF8CharLength(c);
+		m_Blocks[i].Start = i * s_BlockSize;
+		m_Blocks[i].Lines.resize(std::min((size_t)s_BlockSize, aCount - i * s_BlockSize));
+	}
 
-		if (cstart != (PaletteIndex)line[cindex].ColorIndex)
-			break;
-
-		if (prevspace != !!isspace(c))
-		{
-			if (isspace(c))
-				while (cindex < (int)line.size() && isspace(line[cindex].Character))
-					++cindex;
-			break;
-		}
-
-		cindex += d;
-	}
-	return Coordinates(aFrom.Line, GetCharacterColumn(aFrom.Line, cindex));
+	m_Size = aCount;
 }
 
-ImTextEdit::Coordinates ImTextEdit::FindNextWord(const Coordinates & aFrom) const
+void ImTextEdit::LineStore::clear()
 {
-	Coordinates at = aFrom;
-	
-	if (at.Line >= (int)m_Lines.size())
-		return at;
+	m_Blocks.clear();
+	m_Size = 0;
+	m_LastBlock = 0;
+	m_UnloadedBlocks = 0;
+	m_FreshBlocks = 0;
+	m_File.reset();
+	m_ResidentLimit = 0;
+	m_Resident.clear();
+}
 
-	// skip to the next non-word character
-	auto cindex = GetCharacterIndex(aFrom);
-	bool isword = false;
-	bool skip = false;
+void ImTextEdit::LineStore::Map(const std::shared_ptr<MappedFile>& aFile)
+{
+	clear();
 
-	if (cindex < (int)m_Lines[at.Line].size())
+	if (aFile->GetSize() == 0)
 	{
-		auto& line = m_Lines[at.Line];
-		isword = isalnum(line[cindex].Character);
-		skip = isword;
+		push_back(Line());
+		return;
 	}
 
-	while (!isword || skip)
+	const char* text = aFile->GetData();
+	const char* lineStart = text;
+
+	m_Blocks.emplace_back();
+	m_Blocks.back().Text = text;
+	m_Blocks.back().Ends.reserve(s_BlockSize);
+
+	// only the line ends are stored, line i of a block starts after the newline that ends line i - 1
+	auto addLine = [&](const char* aLineEnd)
 	{
-		if (at.Line >= m_Lines.size())
+		Block* block = &m_Blocks.back();
+
+		// the offsets have to fit 32 bits, a block full of very long lines ends early
+		if (block->Ends.size() >= s_BlockSize || (size_t)(aLineEnd - block->Text) > UINT32_MAX)
 		{
-			auto l = std::max(0, (int) m_Lines.size() - 1);
-			return Coordinates(l, GetLineMaxColumn(l));
+			m_Blocks.emplace_back();
+			block = &m_Blocks.back();
+			block->Start = m_Size;
+			block->Text = lineStart;
+			block->Ends.reserve(s_BlockSize);
 		}
 
-		auto& line = m_Lines[at.Line];
+		assert((size_t)(aLineEnd - block->Text) <= UINT32_MAX);
 
-		if (cindex < (int)line.size())
-		{
-			isword = isalnum(line[cindex].Character);
+		block->Ends.push_back((uint32_t)(aLineEnd - block->Text));
+		lineStart = aLineEnd + 1;
+		m_Size++;
+	};
 
-			if (isword && !skip)
-				return Coordinates(at.Line, GetCharacterColumn(at.Line, cindex));
+	// the scanned pages aren't needed until their lines are loaded, don't keep the whole file in memory
+	static const size_t sliceSize = 64 << 20;
 
-			if (!isword)
-				skip = false;
+	for (size_t offset = 0; offset < aFile->GetSize(); offset += sliceSize)
+	{
+		const char* begin = text + offset;
+		const char* end = text + std::min(offset + sliceSize, aFile->GetSize());
 
-			cindex++;
-		}
-		else
-		{
-			cindex = 0;
-			++at.Line;
-			skip = false;
-			isword = false;
-		}
+		ForEachNewline(begin, end, addLine);
+		aFile->Release(begin, end);
 	}
 
-	return at;
+	// the last line doesn't end with a newline
+	addLine(text + aFile->GetSize());
+
+	m_UnloadedBlocks = m_Blocks.size();
+	m_File = aFile;
 }
 
-int ImTextEdit::GetCharacterIndex(const Coordinates& aCoordinates) const
+size_t ImTextEdit::LineStore::GetRunEnd(size_t aIndex, bool& aLoaded) const
 {
-	if (aCoordinates.Line >= m_Lines.size())
-		return -1;
+	aLoaded = true;
 
-	auto& line = m_Lines[aCoordinates.Line];
-	int c = 0;
-	int i = 0;
-	
-	for (; i < line.size() && c < aCoordinates.Column;)
-	{
-		if (line[i].Character == '\t')
-			c = (c / m_TabSize) * m_TabSize + m_TabSize;
-		else
-			++c;
+	if (aIndex >= m_Size)
+		return aIndex;
+	if (m_UnloadedBlocks == 0)
+		return m_Size;
 
-		i += UTF8CharLength(line[i].Character);
-	}
+	size_t block = FindBlock(aIndex);
+	aLoaded = m_Blocks[block].Text == nullptr;
 
-	return i;
+	while (block < m_Blocks.size() && (m_Blocks[block].Text == nullptr) == aLoaded)
+		block++;
+
+	return block < m_Blocks.size() ? m_Blocks[block].Start : m_Size;
 }
 
-int ImTextEdit::GetCharacterColumn(int aLine, int aIndex) const
+bool ImTextEdit::LineStore::GetMappedText(size_t aIndex, const char*& aBegin, const char*& aEnd) const
 {
-	if (aLine >= m_Lines.size())
-		return 0;
+	if (m_UnloadedBlocks == 0)
+		return false;
 
-	auto& line = m_Lines[aLine];
-	int col = 0;
-	int i = 0;
-	
-	while (i < aIndex && i < (int)line.size())
-	{
-		auto c = line[i].Character;
-		i += UTF8CharLength(c);
-	
-		if (c == '\t')
-			col = (col / m_TabSize) * m_TabSize + m_TabSize;
-		else
-			col++;
-	}
-	
-	return col;
-}
+	auto& block = m_Blocks[FindBlock(aIndex)];
+	if (block.Text == nullptr)
+		return false;
 
-int ImTextEdit::GetLineCharacterCount(int aLine) const
-{
-	if (aLine >= m_Lines.size())
-		return 0;
+	size_t local = aIndex - block.Start;
+	aBegin = block.Text + (local == 0 ? 0 : block.Ends[local - 1] + 1);
+	aEnd = block.Text + block.Ends[local];
 
-	auto& line = m_Lines[aLine];
-	int c = 0;
-	
-	for (unsigned i = 0; i < line.size(); c++)
-		i += UTF8CharLength(line[i].Character);
-	
-	return c;
+	return true;
 }
 
-int ImTextEdit::GetLineMaxColumn(int aLine) const
+bool ImTextEdit::LineStore::TakeLoaded(size_t& aStart, size_t& aEnd)
 {
-	if (aLine >= m_Lines.size())
-		return 0;
+	if (m_FreshBlocks == 0)
+		return false;
 
-	auto& line = m_Lines[aLine];
-	int col = 0;
-	
-	for (unsigned i = 0; i < line.size();)
+	for (auto& block : m_Blocks)
 	{
-		auto c = line[i].Character;
+		if (block.Fresh)
+		{
+			block.Fresh = false;
+			m_FreshBlocks--;
 
-		if (c == '\t')
-			col = (col / m_TabSize) * m_TabSize + m_TabSize;
-		else
-			col++;
-		
-		i += UTF8CharLength(c);
+			aStart = block.Start;
+			aEnd = block.Start + block.GetCount();
+			return true;
+		}
 	}
-	return col;
-}
-
-bool ImTextEdit::IsOnWordBoundary(const Coordinates & aAt) const
-{
-	if (aAt.Line >= (int)m_Lines.size() || aAt.Column == 0)
-		return true;
-
-	auto& line = m_Lines[aAt.Line];
-	auto cindex = GetCharacterIndex(aAt);
-	
-	if (cindex >= (int)line.size())
-		return true;
-
-	if (m_ColorizerEnabled)
-		return line[cindex].ColorIndex != line[size_t(cindex - 1)].ColorIndex;
 
-	return isspace(line[cindex].Character) != isspace(line[cindex - 1].Character);
+	assert(false);
+	return false;
 }
 
-void ImTextEdit::RemoveLine(int aStart, int aEnd)
+void ImTextEdit::LineStore::LoadBlock(size_t aBlock) const
 {
-	assert(!m_ReadOnly);
-	assert(aEnd >= aStart);
-	assert(m_Lines.size() > (size_t)(aEnd - aStart));
+	auto& block = m_Blocks[aBlock];
+	block.Lines.resize(block.Ends.size());
 
-	td_ErrorMarkers etmp;
+	const char* begin = block.Text;
 
-	for (auto& i : m_ErrorMarkers)
+	for (size_t i = 0; i < block.Ends.size(); i++)
 	{
-		td_ErrorMarkers::value_type e(i.first >= aStart ? i.first - 1 : i.first, i.second);
-		
-		if (e.first >= aStart && e.first <= aEnd)
-			continue;
-		
-		etmp.insert(e);
+		const char* end = block.Text + block.Ends[i];
+		block.Lines[i].assign(begin, end);
+		begin = end + 1;
 	}
-	
-	m_ErrorMarkers = std::move(etmp);
 
-	auto btmp = m_Breakpoints;
-	m_Breakpoints.clear();
-	
-	for (auto i : btmp)
+	// the text is in the lines now
+	m_File->Release(block.Text, block.Text + block.Ends.back());
+
+	if (m_ResidentLimit > 0)
 	{
-		if (i.Line >= aStart && i.Line <= aEnd)
-		{
-			RemoveBreakpoint(i.Line);
-			continue;
-		}
-		
-		AddBreakpoint(i.Line >= aStart ? i.Line - 1 : i.Line, i.UseCondition, i.Condition, i.Enabled);
+		block.Source = block.Text;
+		block.LastUse = ++m_UseClock;
+		m_Resident.push_back(aBlock);
 	}
-
-	m_Lines.erase(m_Lines.begin() + aStart, m_Lines.begin() + aEnd);
-	assert(!m_Lines.empty());
-
-	// remove scrollbar markers
-	if (m_ScrollbarMarkers)
+	else
 	{
-		for (int i = 0; i < m_ChangedLines.size(); i++)
-		{
-			if (m_ChangedLines[i] > aEnd)
-			{
-				m_ChangedLines[i] -= (aEnd - aStart);
-			}
-			else if (m_ChangedLines[i] >= aStart && m_ChangedLines[i] <= aEnd)
-			{
-				m_ChangedLines.erase(m_ChangedLines.begin() + i);
-				i--;
-			}
-		}
+		std::vector<uint32_t>().swap(block.Ends);
 	}
 
-	m_TextChanged = true;
+	block.Text = nullptr;
 
-	if (OnContentUpdate != nullptr)
-		OnContentUpdate(this);
+	block.Fresh = true;
+	m_FreshBlocks++;
+
+	if (--m_UnloadedBlocks == 0 && m_ResidentLimit == 0)
+		m_File.reset();
 }
 
-void ImTextEdit::RemoveLine(int aIndex)
+void ImTextEdit::LineStore::Touch(size_t aStart, size_t aEnd)
 {
-	assert(!m_ReadOnly);
-	assert(m_Lines.size() > 1);
+	if (m_ResidentLimit == 0 || aStart >= std::min(aEnd, m_Size))
+		return;
 
-	td_ErrorMarkers etmp;
+	m_UseClock++;
 
-	for (auto& i : m_ErrorMarkers)
-	{
-		td_ErrorMarkers::value_type e(i.first > aIndex ? i.first - 1 : i.first, i.second);
-		
-		if (e.first - 1 == aIndex)
-			continue;
-		
-		etmp.insert(e);
-	}
+	for (size_t block = FindBlock(aStart); block < m_Blocks.size() && m_Blocks[block].Start < aEnd; block++)
+		m_Blocks[block].LastUse = m_UseClock;
+}
 
-	m_ErrorMarkers = std::move(etmp);
+void ImTextEdit::LineStore::Evict(std::vector<std::pair<size_t, size_t>>& aEvicted)
+{
+	if (m_ResidentLimit == 0 || m_Resident.size() <= m_ResidentLimit)
+		return;
 
-	auto btmp = m_Breakpoints;
-	m_Breakpoints.clear();
+	// most recently used first, the ones past the limit go
+	std::sort(m_Resident.begin(), m_Resident.end(), [this](size_t a, size_t b) { return m_Blocks[a].LastUse > m_Blocks[b].LastUse; });
 
-	for (auto i : btmp)
+	size_t kept = m_ResidentLimit;
+
+	for (size_t i = m_ResidentLimit; i < m_Resident.size(); i++)
 	{
-		if (i.Line == aIndex)
+		auto& block = m_Blocks[m_Resident[i]];
+
+		// the folds are only stored in the lines
+		bool folded = std::any_of(block.Lines.begin(), block.Lines.end(), [](const Line& aLine) { return !aLine.GetFolds().empty(); });
+
+		if (folded)
 		{
-			RemoveBreakpoint(i.Line);
+			m_Resident[kept++] = m_Resident[i];
 			continue;
 		}
 
-		AddBreakpoint(i.Line >= aIndex ? i.Line - 1 : i.Line, i.UseCondition, i.Condition, i.Enabled);
-	}
-
-	m_Lines.erase(m_Lines.begin() + aIndex);
-	assert(!m_Lines.empty());
+		aEvicted.push_back(std::make_pair(block.Start, block.Start + block.Lines.size()));
 
-	// remove folds
-	RemoveFolds(Coordinates(aIndex, 0), Coordinates(aIndex, 100000));
+		std::vector<Line>().swap(block.Lines);
+		block.Text = block.Source;
+		block.Source = nullptr;
+		m_UnloadedBlocks++;
 
-	// move/remove scrollbar markers
-	if (m_ScrollbarMarkers)
-	{
-		for (int i = 0; i < m_ChangedLines.size(); i++)
+		if (block.Fresh)
 		{
-			if (m_ChangedLines[i] > aIndex)
-			{
-				m_ChangedLines[i]--;
-			}
-			else if (m_ChangedLines[i] == aIndex)
-			{
-				m_ChangedLines.erase(m_ChangedLines.begin() + i);
-				i--;
-			}
-
+			block.Fresh = false;
+			m_FreshBlocks--;
 		}
 	}
 
-	m_TextChanged = true;
+	m_Resident.resize(kept);
+}
 
-	if (OnContentUpdate != nullptr)
-		OnContentUpdate(this);
+void ImTextEdit::LineStore::RemoveBlock(size_t aBlock)
+{
+	if (m_Blocks[aBlock].Fresh)
+		m_FreshBlocks--;
+
+	if (m_Blocks[aBlock].Text != nullptr && --m_UnloadedBlocks == 0)
+		m_File.reset();
+
+	m_Blocks.erase(m_Blocks.begin() + aBlock);
 }
 
-ImTextEdit::Line& ImTextEdit::InsertLine(int aIndex, int column)
+void ImTextEdit::LineStore::UpdateBlockStarts(size_t aFromBlock)
 {
-	assert(!m_ReadOnly);
+	size_t start = 0;
 
-	auto& result = *m_Lines.insert(m_Lines.begin() + aIndex, Line());
+	if (aFromBlock > 0 && aFromBlock <= m_Blocks.size())
+		start = m_Blocks[aFromBlock - 1].Start + m_Blocks[aFromBlock - 1].GetCount();
 
-	// folding
-	for (int b = 0; b < m_FoldBegin.size(); b++)
+	for (size_t i = aFromBlock; i < m_Blocks.size(); i++)
 	{
-		if (m_FoldBegin[b].Line > aIndex - 1 || (m_FoldBegin[b].Line == aIndex - 1 && m_FoldBegin[b].Column >= column))
-			m_FoldBegin[b].Line++;
+		m_Blocks[i].Start = start;
+		start += m_Blocks[i].GetCount();
 	}
+}
+
+void ImTextEdit::LineStore::MergeBlock(size_t aBlock)
+{
+	// fold a block that shrank a lot into its predecessor so blocks don't degrade into single lines
+	if (aBlock == 0 || m_Blocks[aBlock].GetCount() >= s_BlockSize / 4)
+		return;
+
+	// not worth loading a block just to merge it
+	if (m_Blocks[aBlock].Text != nullptr || m_Blocks[aBlock - 1].Text != nullptr)
+		return;
+
+	auto& prev = m_Blocks[aBlock - 1].Lines;
+	auto& lines = m_Blocks[aBlock].Lines;
+
+	if (prev.size() + lines.size() >= 2 * s_BlockSize)
+		return;
 
-	for (int b = 0; b < m_FoldEnd.size(); b++)
+	prev.insert(prev.end(), std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+
+	if (m_Blocks[aBlock].Fresh && !m_Blocks[aBlock - 1].Fresh)
 	{
-		if (m_FoldEnd[b].Line > aIndex - 1 || (m_FoldEnd[b].Line == aIndex - 1 && m_FoldEnd[b].Column >= column))
-			m_FoldEnd[b].Line++;
+		m_Blocks[aBlock - 1].Fresh = true;
+		m_FreshBlocks++;
 	}
 
-	// error markers
-	td_ErrorMarkers etmp;
+	RemoveBlock(aBlock);
+}
 
-	for (auto& i : m_ErrorMarkers)
-		etmp.insert(td_ErrorMarkers::value_type(i.first >= aIndex ? i.first + 1 : i.first, i.second));
-	
-	m_ErrorMarkers = std::move(etmp);
+void ImTextEdit::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
+{
+	m_LanguageDefinition = aLanguageDef;
 
-	// breakpoints
-	auto btmp = m_Breakpoints;
-	m_Breakpoints.clear();
+	auto context = std::make_shared<ColorizerContext>();
+	context->Language = aLanguageDef;
+	context->Identifiers.Build(context->Language);
 
-	for (auto i : btmp)
-		RemoveBreakpoint(i.Line);
-	
-	for (auto i : btmp)
-		AddBreakpoint(i.Line >= aIndex ? i.Line + 1 : i.Line, i.UseCondition, i.Condition, i.Enabled);
+	std::vector<std::string> patterns;
+	for (auto& r : context->Language.TokenRegexStrings)
+		patterns.push_back(r.first);
 
-	return result;
+	if (!patterns.empty() && !context->TokenDFA.Build(patterns))
+	{
+		for (auto& r : context->Language.TokenRegexStrings)
+			context->RegexList.push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
+	}
+
+	m_ColorizerContext = context;
+
+	Colorize();
 }
 
-std::string ImTextEdit::GetWordUnderCursor() const
+void ImTextEdit::SetPalette(const td_Palette & aValue)
 {
-	auto c = GetCursorPosition();
-	c.Column = std::max(c.Column - 1, 0);
+	m_PaletteBase = aValue;
+}
 
-	return GetWordAt(c);
+std::string ImTextEdit::GetText(const Coordinates & aStart, const Coordinates & aEnd) const
+{
+	std::string result;
+	ForEachChunk(aStart, aEnd, [&](const char* aData, size_t aSize) { result.append(aData, aSize); });
+
+	return result;
 }
 
-std::string ImTextEdit::GetWordAt(const Coordinates & aCoords) const
+void ImTextEdit::ForEachChunk(const Coordinates & aStart, const Coordinates & aEnd, const td_TextSink & aCallback) const
 {
-	auto start = FindWordStart(aCoords);
-	auto end = FindWordEnd(aCoords);
+	if (aStart.Line < 0 || aStart.Line >= (int)m_Lines.size())
+		return;
 
-	std::string r;
+	// past the last line means up to the end of the document, without a newline after the last line
+	bool toEnd = aEnd.Line >= (int)m_Lines.size();
+	int lastLine = toEnd ? (int)m_Lines.size() - 1 : aEnd.Line;
+	int istart = GetCharacterIndex(aStart);
+	int iend = toEnd ? -1 : GetCharacterIndex(aEnd);
 
-	auto istart = GetCharacterIndex(start);
-	auto iend = GetCharacterIndex(end);
+	// spans that follow each other in memory are passed as one, a mapped block usually ends up in a single call
+	const char* pending = nullptr;
+	size_t pendingSize = 0;
 
-	for (auto it = istart; it < iend; ++it)
-		r.push_back(m_Lines[aCoords.Line][it].Character);
+	auto add = [&](const char* aData, size_t aSize)
+	{
+		if (aSize == 0)
+			return;
 
-	return r;
-}
+		if (pending != nullptr && pending + pendingSize == aData)
+		{
+			pendingSize += aSize;
+			return;
+		}
 
-ImU32 ImTextEdit::GetGlyphColor(const Glyph & aGlyph) const
-{
-	if (!m_ColorizerEnabled)
-		return m_Palette[(int)PaletteIndex::Default];
+		if (pendingSize > 0)
+			aCallback(pending, pendingSize);
 
-	if (aGlyph.Comment)
-		return m_Palette[(int)PaletteIndex::Comment];
-	
-	if (aGlyph.MultiLineComment)
-		return m_Palette[(int)PaletteIndex::MultiLineComment];
-	
-	auto const color = m_Palette[(int)aGlyph.ColorIndex];
-	
-	if (aGlyph.Preprocessor)
+		pending = aData;
+		pendingSize = aSize;
+	};
+
+	static const char newline = '\n';
+
+	for (int i = aStart.Line; i <= lastLine; i++)
 	{
-		const auto ppcolor = m_Palette[(int)PaletteIndex::Preprocessor];
-		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
-		const int c1 = (((ppcolor >> 8) & 0xff) + ((color >> 8) & 0xff)) / 2;
-		const int c2 = (((ppcolor >> 16) & 0xff) + ((color >> 16) & 0xff)) / 2;
-		const int c3 = (((ppcolor >> 24) & 0xff) + ((color >> 24) & 0xff)) / 2;
+		const char* begin;
+		const char* end;
 
-		return ImU32(c0 | (c1 << 8) | (c2 << 16) | (c3 << 24));
+		// the first and a partial last line were loaded by GetCharacterIndex
+		if (m_Lines.GetMappedText(i, begin, end))
+		{
+			for (const char* it = begin; it < end;)
+			{
+				const char* cr = (const char*)memchr(it, '\r', end - it);
+				if (cr == nullptr)
+					cr = end;
+
+				add(it, cr - it);
+				it = cr + 1;
+			}
+
+			// the newline is still in the file right after the line
+			if (i < lastLine)
+				add(end, 1);
+
+			continue;
+		}
+
+		auto& line = m_Lines[i];
+		size_t from = i == aStart.Line ? (size_t)istart : 0;
+		size_t to = (i == lastLine && !toEnd) ? std::min((size_t)iend, line.size()) : line.size();
+
+		if (from < to)
+			add((const char*)line.GetChars() + from, to - from);
+
+		if (i < lastLine)
+			add(&newline, 1);
 	}
 
-	return color;
+	if (pendingSize > 0)
+		aCallback(pending, pendingSize);
 }
 
-ImTextEdit::Coordinates ImTextEdit::FindFirst(const std::string& what, const Coordinates& fromWhere)
+void ImTextEdit::WriteText(const td_TextSink & aSink) const
 {
-	if (fromWhere.Line < 0 || fromWhere.Line >= m_Lines.size())
-		return Coordinates(m_Lines.size(), 0);
+	ForEachChunk(Coordinates(), Coordinates((int)m_Lines.size(), 0), aSink);
+}
 
-	std::string textSrc = GetText(fromWhere, Coordinates((int)m_Lines.size(), 0));
+ImTextEdit::Coordinates ImTextEdit::GetActualCursorCoordinates() const
+{
+	return SanitizeCoordinates(m_State.CursorPosition);
+}
 
-	size_t index = 0;
-	size_t loc = textSrc.find(what);
-	Coordinates ret = fromWhere;
+ImTextEdit::Coordinates ImTextEdit::SanitizeCoordinates(const Coordinates & aValue) const
+{
+	auto line = aValue.Line;
+	auto column = aValue.Column;
 
-	while (loc != std::string::npos)
+	if (line >= (int)m_Lines.size())
 	{
-		for (; index < loc; index++)
+		if (m_Lines.empty())
 		{
-			if (textSrc[index] == '\n')
-			{
-				ret.Column = 0;
-				ret.Line++;
-			}
-			else
-			{
-				ret.Column++;
-			}
+			line = 0;
+			column = 0;
 		}
-
-		ret.Column = GetCharacterColumn(ret.Line, ret.Column); // ret.Column is currently character index, convert it to character column
-
-		if (GetWordAt(ret) == what)
-			return ret;
 		else
-			loc = textSrc.find(what, loc + 1);
+		{
+			line = (int)m_Lines.size() - 1;
+			column = GetLineMaxColumn(line);
+		}
+
+		return Coordinates(line, column);
+	}
+	else
+	{
+		column = std::max<int>(0, m_Lines.empty() ? 0 : std::min(column, GetLineMaxColumn(line)));
+		return Coordinates(line, column);
 	}
+}
 
-	return Coordinates(m_Lines.size(), 0);
+// https://en.wikipedia.org/wiki/UTF-8
+// We assume that the char is a standalone character (<128) or a leading byte of an UTF-8 code sequence (non-10xxxxxx code)
+static int UTF8CharLength(ImTextEdit::td_Char c)
+{
+	if ((c & 0xFE) == 0xFC)
+		return 6;
+	if ((c & 0xFC) == 0xF8)
+		return 5;
+	if ((c & 0xF8) == 0xF0)
+		return 4;
+	else if ((c & 0xF0) == 0xE0)
+		return 3;
+	else if ((c & 0xE0) == 0xC0)
+		return 2;
+
+	return 1;
 }
 
-void ImTextEdit::HandleKeyboardInputs()
+const ImTextEdit::LineMetrics& ImTextEdit::Line::GetMetrics(int aTabSize) const
 {
-	ImGuiIO& io = ImGui::GetIO();
-	auto shift = io.KeyShift;
-	auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
-	auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+	auto& metrics = m_Metrics;
 
-	if (ImGui::IsWindowFocused())
+	if (!metrics.Valid)
 	{
-		if (ImGui::IsWindowHovered())
-			ImGui::SetMouseCursor(ImGuiMouseCursor_TextInput);
-		//ImGui::CaptureKeyboardFromApp(true);
-
-		io.WantCaptureKeyboard = true;
-		io.WantTextInput = true;
+		metrics.Tabs.clear();
+		metrics.Characters = 0;
+		metrics.Ascii = true;
+		metrics.TabSize = 0;
 
-		ShortcutID actionID = ShortcutID::Count;
-		for (int i = 0; i < m_Shortcuts.size(); i++)
+		for (size_t i = 0; i < m_Chars.size(); metrics.Characters++)
 		{
-			auto sct = m_Shortcuts[i];
+			auto c = m_Chars[i];
 
-			if (sct.Key1 == -1)
-				continue;
-				
-			ShortcutID curActionID = ShortcutID::Count;
-			bool additionalChecks = true;
+			if (c == '\t')
+				metrics.Tabs.push_back((uint32_t)i);
+			else if (c & 0x80)
+				metrics.Ascii = false;
 
-			int sc1 = ::GetAsyncKeyState(sct.Key1) & 0x8000 ? sct.Key1 : -1;
+			i += UTF8CharLength(c);
+		}
 
-			if ((ImGui::IsKeyPressed(sc1) || (sc1 == VK_RETURN && ImGui::IsKeyPressed(VK_RETURN))) && ((sct.Key2 != -1 && ImGui::IsKeyPressed(sct.Key2)) || sct.Key2 == -1))
-			{
-				if ((sct.Ctrl == ctrl) && (sct.Alt == alt) && (sct.Shift == shift))
-				{
-					// PRESSED:
-					curActionID = (ImTextEdit::ShortcutID)i;
-					
-					switch (curActionID)
-					{
-						case ShortcutID::Paste:
-						case ShortcutID::Cut:
-						case ShortcutID::Redo: 
-						case ShortcutID::Undo:
-						case ShortcutID::ForwardDelete:
-						case ShortcutID::BackwardDelete:
-						case ShortcutID::DeleteLeft:
-						case ShortcutID::DeleteRight:
-						case ShortcutID::ForwardDeleteWord:
-						case ShortcutID::BackwardDeleteWord:
-							additionalChecks = !IsReadOnly();
-							break;
-						default:
-							break;
-					}
-				}
-			}
+		metrics.Valid = true;
+	}
 
-			if (additionalChecks && curActionID != ShortcutID::Count)
-				actionID = curActionID;
-		}
+	if (metrics.Ascii && metrics.TabSize != aTabSize)
+	{
+		metrics.TabEnds.resize(metrics.Tabs.size());
+		metrics.TabSize = aTabSize;
 
-		int keyCount = 0;
-		bool keepACOpened = false, functionTooltipState = m_FunctionDeclarationTooltip;
-		bool hasWrittenALetter = false;
-		if (actionID != ShortcutID::Count)
+		uint32_t column = 0, index = 0;
+
+		for (size_t k = 0; k < metrics.Tabs.size(); k++)
 		{
-			if (actionID != ShortcutID::Indent)
-				m_IsSnippet = false;
-			
-			switch (actionID)
-			{
-				case ShortcutID::Undo:
-					Undo();
-					break;
-				case ShortcutID::Redo:
-					Redo();
-					break;
-				case ShortcutID::MoveUp:
-					MoveUp(1, false);
-					break;
-				case ShortcutID::SelectUp:
-					MoveUp(1, true);
-					break;
-				case ShortcutID::MoveDown:
-					MoveDown(1, false);
-					break;
-				case ShortcutID::SelectDown:
-					MoveDown(1, true);
-					break;
-				case ShortcutID::MoveLeft:
-					MoveLeft(1, false, false);
-					break;
-				case ShortcutID::SelectLeft:
-					MoveLeft(1, true, false);
-					break;
-				case ShortcutID::MoveWordLeft:
-					MoveLeft(1, false, true);
-					break;
-				case ShortcutID::SelectWordLeft:
-					MoveLeft(1, true, true);
-					break;
-				case ShortcutID::MoveRight:
-					MoveRight(1, false, false);
-					break;
-				case ShortcutID::SelectRight:
-					MoveRight(1, true, false);
-					break;
-				case ShortcutID::MoveWordRight:
-					MoveRight(1, false, true);
-					break;
-				case ShortcutID::SelectWordRight:
-					MoveRight(1, true, true);
-					break;
-				case ShortcutID::MoveTop:
-					MoveTop(false);
-					break;
+			column += metrics.Tabs[k] - index;
+			column = (column / aTabSize) * aTabSize + aTabSize;
+			index = metrics.Tabs[k] + 1;
+			metrics.TabEnds[k] = column;
+		}
+	}
+
+	return metrics;
+}
+
+int ImTextEdit::LineMetrics::GetColumn(size_t aIndex, size_t aSize) const
+{
+	assert(Ascii && Valid);
+	aIndex = std::min(aIndex, aSize);
+
+	// the columns continue one per byte after the last tab before aIndex
+	size_t k = std::lower_bound(Tabs.begin(), Tabs.end(), (uint32_t)aIndex) - Tabs.begin();
+
+	if (k == 0)
+		return (int)aIndex;
+
+	return (int)(TabEnds[k - 1] + (aIndex - Tabs[k - 1] - 1));
+}
+
+size_t ImTextEdit::LineMetrics::GetIndex(int aColumn, size_t aSize) const
+{
+	assert(Ascii && Valid);
+
+	if (aColumn <= 0)
+		return 0;
+
+	// the last tab that ends at or before aColumn, the bytes after it are one column each
+	size_t k = std::upper_bound(TabEnds.begin(), TabEnds.end(), (uint32_t)aColumn) - TabEnds.begin();
+	size_t begin = k > 0 ? Tabs[k - 1] + 1 : 0;
+	size_t index = begin + (aColumn - (k > 0 ? TabEnds[k - 1] : 0));
+
+	// a column inside the next tab resolves to the character after it
+	if (k < Tabs.size())
+		return index <= Tabs[k] ? index : Tabs[k] + 1;
+
+	return std::min(index, aSize);
+}
+
+// "Borrowed" from ImGui source
+static inline int ImTextCharToUtf8(char* buf, int buf_size, unsigned int c)
+{
+	if (c < 0x80)
+	{
+		buf[0] = (char)c;
+
+		return 1;
+	}
+
+	if (c < 0x800)
+	{
+		if (buf_size < 2)
+			return 0;
+
+		buf[0] = (char)(0xc0 + (c >> 6));
+		buf[1] = (char)(0x80 + (c & 0x3f));
+		
+		return 2;
+	}
+	
+	if (c >= 0xdc00 && c < 0xe000)
+	{
+		return 0;
+	}
+	
+	if (c >= 0xd800 && c < 0xdc00)
+	{
+		if (buf_size < 4)
+			return 0;
+
+		buf[0] = (char)(0xf0 + (c >> 18));
+		buf[1] = (char)(0x80 + ((c >> 12) & 0x3f));
+		buf[2] = (char)(0x80 + ((c >> 6) & 0x3f));
+		buf[3] = (char)(0x80 + ((c) & 0x3f));
+		
+		return 4;
+	}
+
+	//else if (c < 0x10000)
+	{
+		if (buf_size < 3)
+			return 0;
+
+		buf[0] = (char)(0xe0 + (c >> 12));
+		buf[1] = (char)(0x80 + ((c >> 6) & 0x3f));
+		buf[2] = (char)(0x80 + ((c) & 0x3f));
+		
+		return 3;
+	}
+}
+
+void ImTextEdit::Advance(Coordinates & aCoordinates) const
+{
+	if (aCoordinates.Line < (int)m_Lines.size())
+	{
+		auto& line = m_Lines[aCoordinates.Line];
+		auto cindex = GetCharacterIndex(aCoordinates);
+
+		if (cindex + 1 < (int)line.size())
+		{
+			auto delta = UTF8CharLength(line[cindex].Character);
+			cindex = std::min(cindex + delta, (int)line.size() - 1);
+		}
+		else
+		{
+			++aCoordinates.Line;
+			cindex = 0;
+		}
+		
+		aCoordinates.Column = GetCharacterColumn(aCoordinates.Line, cindex);
+	}
+}
+
+void ImTextEdit::DeleteRange(const Coordinates& aStart, const Coordinates& aEnd)
+{
+	assert(aEnd >= aStart);
+	assert(!m_ReadOnly);
+
+	if (aEnd == aStart)
+		return;
+
+	auto start = GetCharacterIndex(aStart);
+	auto end = GetCharacterIndex(aEnd);
+
+	if (aStart.Line == aEnd.Line)
+	{
+		auto& line = m_Lines[aStart.Line];
+		auto n = GetLineMaxColumn(aStart.Line);
+		
+		if (aEnd.Column >= n)
+			line.erase(line.begin() + start, line.end());
+		else
+			line.erase(line.begin() + start, line.begin() + end);
+	}
+	else
+	{
+		auto& firstLine = m_Lines[aStart.Line];
+		auto& lastLine = m_Lines[aEnd.Line];
+
+		firstLine.erase(firstLine.begin() + start, firstLine.end());
+		lastLine.erase(lastLine.begin(), lastLine.begin() + end);
+		
+		if (aStart.Line < aEnd.Line)
+			firstLine.insert(firstLine.end(), lastLine.begin(), lastLine.end());
+
+		if (aStart.Line < aEnd.Line)
+		{
+			// remove the actual lines
+			RemoveLine(aStart.Line + 1, aEnd.Line + 1);
+		}
+	}
+
+	OnLinesChanged(aStart.Line, aStart.Line + 1);
+
+	if (m_ScrollbarMarkers)
+	{
+		for (int i = 0; i < m_ChangedLines.size(); i++)
+		{
+			if (m_ChangedLines[i] > aEnd.Line)
+			{
+				m_ChangedLines[i] -= (aEnd.Line - aStart.Line);
+			}
+			else if (m_ChangedLines[i] > aStart.Line && m_ChangedLines[i] < aEnd.Line)
+			{
+				m_ChangedLines.erase(m_ChangedLines.begin() + i);
+				i--;
+			}
+		}
+	}
+
+	m_TextChanged = true;
+
+	if (OnContentUpdate != nullptr)
+		OnContentUpdate(this);
+}
+
+int ImTextEdit::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue, bool indent)
+{
+	assert(!m_ReadOnly);
+
+	int autoIndentStart = 0;
+	for (int i = 0; i < m_Lines[aWhere.Line].size() && indent; i++)
+	{
+		td_Char ch = m_Lines[aWhere.Line][i].Character;
+		
+		if (ch == ' ')
+			autoIndentStart++;
+		else if (ch == '\t')
+			autoIndentStart += m_TabSize;
+		else
+			break;
+	}
+
+	int cindex = GetCharacterIndex(aWhere);
+	int autoIndent = autoIndentStart;
+
+	// moves aWhere.Column over the characters of [aBegin, aEnd) and follows their braces for the auto indent
+	auto advance = [&](const char* aBegin, const char* aEnd)
+	{
+		for (const char* it = aBegin; it < aEnd;)
+		{
+			if (*it == '\r')
+			{
+				++it;
+				continue;
+			}
+
+			if (*it == '{')
+				autoIndent += m_TabSize;
+			else if (*it == '}')
+				autoIndent = std::max(0, autoIndent - m_TabSize);
+
+			aWhere.Column += (*it == '\t' ? m_TabSize : 1);
+			it += std::min<ptrdiff_t>(UTF8CharLength(*it), aEnd - it);
+		}
+	};
+
+	// the text is split at its newlines once. The first line goes into the line at aWhere, the others are
+	// inserted together after it and the last one gets the rest of that line
+	const char* end = aValue + strlen(aValue);
+	const char* lineEnd = (const char*)memchr(aValue, '\n', end - aValue);
+
+	if (lineEnd == nullptr)
+		lineEnd = end;
+
+	auto& line = m_Lines[aWhere.Line];
+	Line rest;
+
+	if (lineEnd != end && cindex < (int)line.size() && cindex >= 0)
+	{
+		rest.insert(rest.begin(), line.begin() + cindex, line.end());
+		line.erase(line.begin() + cindex, line.end());
+	}
+
+	line.insert(line.begin() + cindex, aValue, lineEnd);
+	advance(aValue, lineEnd);
+	OnLinesChanged(aWhere.Line, aWhere.Line + 1);
+
+	std::vector<Line> lines;
+	std::vector<int> indents; // columns added by the auto indent to each new line
+
+	while (lineEnd != end)
+	{
+		aValue = lineEnd + 1;
+		lineEnd = (const char*)memchr(aValue, '\n', end - aValue);
+
+		if (lineEnd == nullptr)
+			lineEnd = end;
+
+		lines.emplace_back();
+		aWhere.Column = 0;
+
+		if (indent)
+		{
+			bool lineIsAlreadyIndent = (isspace(*aValue) && *aValue != '\n' && *aValue != '\r');
+
+			// first check if we need to "unindent"
+			const char* bracketSearch = aValue;
+			
+			while (*bracketSearch != '\0' && isspace(*bracketSearch) && *bracketSearch != '\n')
+				bracketSearch++;
+			
+			if (*bracketSearch == '}')
+				autoIndent = std::max(0, autoIndent - m_TabSize);
+
+			int actualAutoIndent = autoIndent;
+			
+			if (lineIsAlreadyIndent)
+			{
+				actualAutoIndent = autoIndentStart;
+
+				const char* aValueCopy = aValue;
+				
+				while (isspace(*aValueCopy) && *aValueCopy != '\n' && *aValueCopy != '\r' && *aValueCopy != 0)
+				{
+					actualAutoIndent = std::max(0, actualAutoIndent - m_TabSize);
+					aValueCopy++;
+				}
+			}
+
+			// add tabs
+			int tabCount = actualAutoIndent / m_TabSize;
+			int spaceCount = actualAutoIndent - tabCount * m_TabSize;
+			
+			if (m_InsertSpaces)
+			{
+				tabCount = 0;
+				spaceCount = actualAutoIndent;
+			}
+
+			aWhere.Column = actualAutoIndent;
+
+			// the tabs come before the spaces
+			std::string whitespace = std::string(tabCount, '\t') + std::string(spaceCount, ' ');
+			lines.back().append(whitespace.data(), whitespace.data() + whitespace.size());
+			indents.push_back(tabCount * m_TabSize + spaceCount);
+		}
+
+		lines.back().append(aValue, lineEnd);
+		advance(aValue, lineEnd);
+	}
+
+	int totalLines = (int)lines.size();
+
+	if (totalLines > 0)
+	{
+		lines.back().insert(lines.back().end(), rest.begin(), rest.end());
+		InsertLines(aWhere.Line + 1, std::move(lines));
+
+		// snippet tags on the new lines move with their indentation
+		for (int i = 0; i < (int)m_SnippetTagStart.size() && !indents.empty(); i++)
+		{
+			int index = m_SnippetTagStart[i].Line - aWhere.Line - 1;
+
+			if (index >= 0 && index < (int)indents.size())
+			{
+				m_SnippetTagStart[i].Column += indents[index];
+				m_SnippetTagEnd[i].Column += indents[index];
+			}
+		}
+
+		aWhere.Line += totalLines;
+	}
+
+	if (m_ScrollbarMarkers)
+	{
+		bool changeExists = false;
+		
+		for (int i = 0; i < m_ChangedLines.size(); i++)
+		{
+			if (m_ChangedLines[i] == aWhere.Line)
+			{
+				changeExists = true;
+				break;
+			}
+		}
+
+		if (!changeExists)
+			m_ChangedLines.push_back(aWhere.Line);
+	}
+
+	m_TextChanged = true;
+
+	if (OnContentUpdate != nullptr)
+		OnContentUpdate(this);
+
+	return totalLines;
+}
+
+void ImTextEdit::AddUndo(UndoRecord& aValue)
+{
+	assert(!m_ReadOnly);
+	//printf("AddUndo: (@%d.%d) +\'%s' [%d.%d .. %d.%d], -\'%s', [%d.%d .. %d.%d] (@%d.%d)\n",
+	//	aValue.mBefore.mCursorPosition.mLine, aValue.mBefore.mCursorPosition.mColumn,
+	//	aValue.mAdded.c_str(), aValue.mAddedStart.mLine, aValue.mAddedStart.mColumn, aValue.mAddedEnd.mLine, aValue.mAddedEnd.mColumn,
+	//	aValue.mRemoved.c_str(), aValue.mRemovedStart.mLine, aValue.mRemovedStart.mColumn, aValue.mRemovedEnd.mLine, aValue.mRemovedEnd.mColumn,
+	//	aValue.mAfter.mCursorPosition.mLine, aValue.mAfter.mCursorPosition.mColumn
+	//	);
+
+	m_UndoBuffer.resize((size_t)(m_UndoIndex + 1));
+	m_UndoBuffer.back() = aValue;
+	++m_UndoIndex;
+}
+
+ImTextEdit::Coordinates ImTextEdit::ScreenPosToCoordinates(const ImVec2& aPosition) const
+{
+	ImVec2 origin = m_UICursorPos;
+	ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+
+	int lineNo = std::max(0, (int)floor(local.y / m_CharAdvance.y));
+	int columnCoord = 0;
+
+	// the row under the mouse, skipping folded lines
+	if (m_FoldEnabled)
+		lineNo = m_FoldIndex.RowToLine(lineNo);
+
+	if (lineNo >= 0 && lineNo < (int)m_Lines.size())
+	{
+		auto& line = m_Lines.at(lineNo);
+
+		if (auto offsets = GetLineOffsets(lineNo))
+			return SanitizeCoordinates(Coordinates(lineNo, offsets->Column[HitTestOffsets(line, *offsets, local.x - m_TextStart)]));
+
+		auto& advances = GetAdvances();
+		const td_Char* chars = line.GetChars();
+		const float x = local.x - m_TextStart;
+		size_t columnIndex = 0;
+		float columnX = 0.0f;
+
+		while (columnIndex < line.size())
+		{
+			if (chars[columnIndex] == '\t')
+			{
+				float newColumnX = advances.GetTabStop(columnX);
+
+				if (columnX + (newColumnX - columnX) * 0.5f > x)
+					break;
+
+				columnX = newColumnX;
+				columnCoord = (columnCoord / m_TabSize) * m_TabSize + m_TabSize;
+				columnIndex++;
+			}
+			else if (advances.GetPitch() > 0.0f && chars[columnIndex] >= 32 && chars[columnIndex] < 127)
+			{
+				// fixed pitch: the character under x is found with a division
+				const float pitch = advances.GetPitch();
+				int count = (int)AdvanceTable::CountPrintable(chars + columnIndex, chars + line.size());
+				int hit = std::max(0, std::min(count, (int)std::floor((x - columnX) / pitch - 0.5f) + 1));
+
+				columnIndex += hit;
+				columnCoord += hit;
+				columnX += hit * pitch;
+
+				if (hit < count)
+					break;
+			}
+			else
+			{
+				int length = std::min<int>(UTF8CharLength(chars[columnIndex]), (int)(line.size() - columnIndex));
+				float columnWidth = advances.Get(chars + columnIndex, length);
+
+				if (columnX + columnWidth * 0.5f > x)
+					break;
+
+				columnIndex += length;
+				columnX += columnWidth;
+				columnCoord++;
+			}
+		}
+	}
+
+	return SanitizeCoordinates(Coordinates(lineNo, columnCoord));
+}
+ImTextEdit::Coordinates ImTextEdit::MousePosToCoordinates(const ImVec2& aPosition) const
+{
+	ImVec2 origin = m_UICursorPos;
+	ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+
+	int lineNo = std::max(0, (int)floor(local.y / m_CharAdvance.y));
+	int columnCoord = 0;
+	int modifier = 0;
+
+	// the row under the mouse, skipping folded lines
+	if (m_FoldEnabled)
+		lineNo = m_FoldIndex.RowToLine(lineNo);
+
+	if (lineNo >= 0 && lineNo < (int)m_Lines.size())
+	{
+		auto& line = m_Lines.at(lineNo);
+
+		if (auto offsets = GetLineOffsets(lineNo))
+		{
+			size_t hit = HitTestOffsets(line, *offsets, local.x - m_TextStart);
+			modifier = 3 * (int)std::count(line.GetChars(), line.GetChars() + hit, '\t');
+			return SanitizeCoordinates(Coordinates(lineNo, std::max(0, offsets->Column[hit] - modifier)));
+		}
+
+		auto& advances = GetAdvances();
+		const td_Char* chars = line.GetChars();
+		const float x = local.x - m_TextStart;
+		size_t columnIndex = 0;
+		float columnX = 0.0f;
+
+		while (columnIndex < line.size())
+		{
+			if (chars[columnIndex] == '\t')
+			{
+				float newColumnX = advances.GetTabStop(columnX);
+
+				if (columnX + (newColumnX - columnX) * 0.5f > x)
+					break;
+
+				columnX = newColumnX;
+				columnCoord = (columnCoord / m_TabSize) * m_TabSize + m_TabSize;
+				columnIndex++;
+				modifier += 3;
+			}
+			else if (advances.GetPitch() > 0.0f && chars[columnIndex] >= 32 && chars[columnIndex] < 127)
+			{
+				// fixed pitch: the character under x is found with a division
+				const float pitch = advances.GetPitch();
+				int count = (int)AdvanceTable::CountPrintable(chars + columnIndex, chars + line.size());
+				int hit = std::max(0, std::min(count, (int)std::floor((x - columnX) / pitch - 0.5f) + 1));
+
+				columnIndex += hit;
+				columnCoord += hit;
+				columnX += hit * pitch;
+
+				if (hit < count)
+					break;
+			}
+			else
+			{
+				int length = std::min<int>(UTF8CharLength(chars[columnIndex]), (int)(line.size() - columnIndex));
+				float columnWidth = advances.Get(chars + columnIndex, length);
+
+				if (columnX + columnWidth * 0.5f > x)
+					break;
+
+				columnIndex += length;
+				columnX += columnWidth;
+				columnCoord++;
+			}
+		}
+	}
+
+	return SanitizeCoordinates(Coordinates(lineNo, std::max(0, columnCoord - modifier)));
+}
+
+ImTextEdit::Coordinates ImTextEdit::FindWordStart(const Coordinates & aFrom) const
+{
+	Coordinates at = aFrom;
+	
+	if (at.Line >= (int)m_Lines.size())
+		return at;
+
+	auto& line = m_Lines[at.Line];
+	auto cindex = GetCharacterIndex(at);
+
+	if (cindex >= (int)line.size())
+		return at;
+
+	while (cindex > 0 && isspace(line[cindex].Character))
+		--cindex;
+
+	auto cstart = (PaletteIndex)line[cindex].ColorIndex;
+	while (cindex > 0)
+	{
+		auto c = line[cindex].Character;
+
+		if ((c & 0xC0) != 0x80)	// not UTF code sequence 10xxxxxx
+		{
+			if (c <= 32 && isspace(c))
+			{
+				cindex++;
+				break;
+			}
+		
+			if (cstart != (PaletteIndex)line[size_t(cindex - 1)].ColorIndex)
+				break;
+		}
+		--cindex;
+	}
+	return Coordinates(at.Line, GetCharacterColumn(at.Line, cindex));
+}
+
+ImTextEdit::Coordinates ImTextEdit::FindWordEnd(const Coordinates & aFrom) const
+{
+	Coordinates at = aFrom;
+	
+	if (at.Line >= (int)m_Lines.size())
+		return at;
+
+	auto& line = m_Lines[at.Line];
+	auto cindex = GetCharacterIndex(at);
+
+	if (cindex >= (int)line.size())
+		return at;
+
+	bool prevspace = (bool)isspace(line[cindex].Character);
+	auto cstart = (PaletteIndex)line[cindex].ColorIndex;
+	while (cindex < (int)line.size())
+	{
+		auto c = line[cindex].Character;
+		auto d = UTF8CharLength(c);
+
+		if (cstart != (PaletteIndex)line[cindex].ColorIndex)
+			break;
+
+		if (prevspace != !!isspace(c))
+		{
+			if (isspace(c))
+				while (cindex < (int)line.size() && isspace(line[cindex].Character))
+					++cindex;
+			break;
+		}
+
+		cindex += d;
+	}
+	return Coordinates(aFrom.Line, GetCharacterColumn(aFrom.Line, cindex));
+}
+
+ImTextEdit::Coordinates ImTextEdit::FindNextWord(const Coordinates & aFrom) const
+{
+	Coordinates at = aFrom;
+	
+	if (at.Line >= (int)m_Lines.size())
+		return at;
+
+	// skip to the next non-word character
+	auto cindex = GetCharacterIndex(aFrom);
+	bool isword = false;
+	bool skip = false;
+
+	if (cindex < (int)m_Lines[at.Line].size())
+	{
+		auto& line = m_Lines[at.Line];
+		isword = isalnum(line[cindex].Character);
+		skip = isword;
+	}
+
+	while (!isword || skip)
+	{
+		if (at.Line >= m_Lines.size())
+		{
+			auto l = std::max(0, (int) m_Lines.size() - 1);
+			return Coordinates(l, GetLineMaxColumn(l));
+		}
+
+		auto& line = m_Lines[at.Line];
+
+		if (cindex < (int)line.size())
+		{
+			isword = isalnum(line[cindex].Character);
+
+			if (isword && !skip)
+				return Coordinates(at.Line, GetCharacterColumn(at.Line, cindex));
+
+			if (!isword)
+				skip = false;
+
+			cindex++;
+		}
+		else
+		{
+			cindex = 0;
+			++at.Line;
+			skip = false;
+			isword = false;
+		}
+	}
+
+	return at;
+}
+
+int ImTextEdit::GetCharacterIndex(const Coordinates& aCoordinates) const
+{
+	if (aCoordinates.Line >= m_Lines.size())
+		return -1;
+
+	auto& metrics = m_Lines[aCoordinates.Line].GetMetrics(m_TabSize);
+	if (metrics.Ascii)
+		return (int)metrics.GetIndex(aCoordinates.Column, m_Lines[aCoordinates.Line].size());
+
+	// the first character that starts at or after the column
+	if (auto offsets = GetLineOffsets(aCoordinates.Line))
+		return (int)(std::lower_bound(offsets->Column.begin(), offsets->Column.end() - 1, aCoordinates.Column) - offsets->Column.begin());
+
+	auto& line = m_Lines[aCoordinates.Line];
+	int c = 0;
+	int i = 0;
+	
+	for (; i < line.size() && c < aCoordinates.Column;)
+	{
+		if (line[i].Character == '\t')
+			c = (c / m_TabSize) * m_TabSize + m_TabSize;
+		else
+			++c;
+
+		i += UTF8CharLength(line[i].Character);
+	}
+
+	return i;
+}
+
+int ImTextEdit::GetCharacterColumn(int aLine, int aIndex) const
+{
+	if (aLine >= m_Lines.size())
+		return 0;
+
+	auto& metrics = m_Lines[aLine].GetMetrics(m_TabSize);
+	if (metrics.Ascii)
+		return metrics.GetColumn(std::max(0, aIndex), m_Lines[aLine].size());
+
+	// the column after the character aIndex - 1 is in
+	if (auto offsets = GetLineOffsets(aLine))
+	{
+		if (aIndex <= 0)
+			return 0;
+
+		auto& columns = offsets->Column;
+		size_t index = std::min<size_t>(aIndex, columns.size() - 1);
+		return *std::upper_bound(columns.begin() + index, columns.end() - 1, columns[index - 1]);
+	}
+
+	auto& line = m_Lines[aLine];
+	int col = 0;
+	int i = 0;
+	
+	while (i < aIndex && i < (int)line.size())
+	{
+		auto c = line[i].Character;
+		i += UTF8CharLength(c);
+	
+		if (c == '\t')
+			col = (col / m_TabSize) * m_TabSize + m_TabSize;
+		else
+			col++;
+	}
+	
+	return col;
+}
+
+const ImTextEdit::TextOffsetIndex& ImTextEdit::GetTextOffsets() const
+{
+	if (m_TextOffsets.GetLineCount() != (int)m_Lines.size())
+		m_TextOffsets.Reset(m_Lines);
+
+	return m_TextOffsets;
+}
+
+size_t ImTextEdit::CoordinatesToOffset(const Coordinates& aPosition) const
+{
+	auto& offsets = GetTextOffsets();
+	int line = std::max(0, std::min(aPosition.Line, (int)m_Lines.size() - 1));
+
+	return offsets.GetLineStart(line, false) + GetCharacterIndex(Coordinates(line, aPosition.Column));
+}
+
+ImTextEdit::Coordinates ImTextEdit::OffsetToCoordinates(size_t aOffset) const
+{
+	auto& offsets = GetTextOffsets();
+	int line = offsets.FindLine(aOffset, false);
+	size_t index = std::min(aOffset - offsets.GetLineStart(line, false), m_Lines[line].size());
+
+	return Coordinates(line, GetCharacterColumn(line, (int)index));
+}
+
+size_t ImTextEdit::CoordinatesToCharacterOffset(const Coordinates& aPosition) const
+{
+	auto& offsets = GetTextOffsets();
+	int line = std::max(0, std::min(aPosition.Line, (int)m_Lines.size() - 1));
+	int index = GetCharacterIndex(Coordinates(line, aPosition.Column));
+
+	const td_Char* chars = m_Lines[line].GetChars();
+	size_t characters = 0;
+
+	for (int i = 0; i < index; characters++)
+		i += UTF8CharLength(chars[i]);
+
+	return offsets.GetLineStart(line, true) + characters;
+}
+
+ImTextEdit::Coordinates ImTextEdit::CharacterOffsetToCoordinates(size_t aOffset) const
+{
+	auto& offsets = GetTextOffsets();
+	int line = offsets.FindLine(aOffset, true);
+	size_t characters = aOffset - offsets.GetLineStart(line, true);
+
+	auto& text = m_Lines[line];
+	size_t index = 0;
+
+	for (; index < text.size() && characters > 0; characters--)
+		index = std::min(text.size(), index + UTF8CharLength(text.GetChar(index)));
+
+	return Coordinates(line, GetCharacterColumn(line, (int)index));
+}
+
+int ImTextEdit::GetLineCharacterCount(int aLine) const
+{
+	if (aLine >= m_Lines.size())
+		return 0;
+
+	return (int)m_Lines[aLine].GetMetrics(m_TabSize).Characters;
+}
+
+int ImTextEdit::GetLineMaxColumn(int aLine) const
+{
+	if (aLine >= m_Lines.size())
+		return 0;
+
+	// without tabs every character is one column
+	auto& metrics = m_Lines[aLine].GetMetrics(m_TabSize);
+	if (metrics.Ascii)
+		return metrics.GetColumn(m_Lines[aLine].size(), m_Lines[aLine].size());
+	if (metrics.Tabs.empty())
+		return (int)metrics.Characters;
+
+	if (auto offsets = GetLineOffsets(aLine))
+		return offsets->Column.back();
+
+	auto& line = m_Lines[aLine];
+	int col = 0;
+	
+	for (unsigned i = 0; i < line.size();)
+	{
+		auto c = line[i].Character;
+
+		if (c == '\t')
+			col = (col / m_TabSize) * m_TabSize + m_TabSize;
+		else
+			col++;
+		
+		i += UTF8CharLength(c);
+	}
+	return col;
+}
+
+bool ImTextEdit::IsOnWordBoundary(const Coordinates & aAt) const
+{
+	if (aAt.Line >= (int)m_Lines.size() || aAt.Column == 0)
+		return true;
+
+	auto& line = m_Lines[aAt.Line];
+	auto cindex = GetCharacterIndex(aAt);
+	
+	if (cindex >= (int)line.size())
+		return true;
+
+	if (m_ColorizerEnabled)
+		return line[cindex].ColorIndex != line[size_t(cindex - 1)].ColorIndex;
+
+	return isspace(line[cindex].Character) != isspace(line[cindex - 1].Character);
+}
+
+void ImTextEdit::RemoveLine(int aStart, int aEnd)
+{
+	assert(!m_ReadOnly);
+	assert(aEnd >= aStart);
+	assert(m_Lines.size() > (size_t)(aEnd - aStart));
+
+	td_ErrorMarkers etmp;
+
+	for (auto& i : m_ErrorMarkers)
+	{
+		td_ErrorMarkers::value_type e(i.first >= aStart ? i.first - 1 : i.first, i.second);
+		
+		if (e.first >= aStart && e.first <= aEnd)
+			continue;
+		
+		etmp.insert(e);
+	}
+	
+	m_ErrorMarkers = std::move(etmp);
+
+	auto btmp = m_Breakpoints;
+	m_Breakpoints.clear();
+	
+	for (auto i : btmp)
+	{
+		if (i.Line >= aStart && i.Line <= aEnd)
+		{
+			RemoveBreakpoint(i.Line);
+			continue;
+		}
+		
+		AddBreakpoint(i.Line >= aStart ? i.Line - 1 : i.Line, i.UseCondition, i.Condition, i.Enabled);
+	}
+
+	m_Lines.erase(aStart, aEnd);
+	assert(!m_Lines.empty());
+	OnLinesRemoved(aStart, aEnd);
+
+	// remove scrollbar markers
+	if (m_ScrollbarMarkers)
+	{
+		for (int i = 0; i < m_ChangedLines.size(); i++)
+		{
+			if (m_ChangedLines[i] > aEnd)
+			{
+				m_ChangedLines[i] -= (aEnd - aStart);
+			}
+			else if (m_ChangedLines[i] >= aStart && m_ChangedLines[i] <= aEnd)
+			{
+				m_ChangedLines.erase(m_ChangedLines.begin() + i);
+				i--;
+			}
+		}
+	}
+
+	m_TextChanged = true;
+
+	if (OnContentUpdate != nullptr)
+		OnContentUpdate(this);
+}
+
+void ImTextEdit::RemoveLine(int aIndex)
+{
+	assert(!m_ReadOnly);
+	assert(m_Lines.size() > 1);
+
+	td_ErrorMarkers etmp;
+
+	for (auto& i : m_ErrorMarkers)
+	{
+		td_ErrorMarkers::value_type e(i.first > aIndex ? i.first - 1 : i.first, i.second);
+		
+		if (e.first - 1 == aIndex)
+			continue;
+		
+		etmp.insert(e);
+	}
+
+	m_ErrorMarkers = std::move(etmp);
+
+	auto btmp = m_Breakpoints;
+	m_Breakpoints.clear();
+
+	for (auto i : btmp)
+	{
+		if (i.Line == aIndex)
+		{
+			RemoveBreakpoint(i.Line);
+			continue;
+		}
+
+		AddBreakpoint(i.Line >= aIndex ? i.Line - 1 : i.Line, i.UseCondition, i.Condition, i.Enabled);
+	}
+
+	m_Lines.erase(aIndex);
+	assert(!m_Lines.empty());
+	OnLinesRemoved(aIndex, aIndex + 1);
+
+	// move/remove scrollbar markers
+	if (m_ScrollbarMarkers)
+	{
+		for (int i = 0; i < m_ChangedLines.size(); i++)
+		{
+			if (m_ChangedLines[i] > aIndex)
+			{
+				m_ChangedLines[i]--;
+			}
+			else if (m_ChangedLines[i] == aIndex)
+			{
+				m_ChangedLines.erase(m_ChangedLines.begin() + i);
+				i--;
+			}
+
+		}
+	}
+
+	m_TextChanged = true;
+
+	if (OnContentUpdate != nullptr)
+		OnContentUpdate(this);
+}
+
+ImTextEdit::Line& ImTextEdit::InsertLine(int aIndex)
+{
+	std::vector<Line> lines(1);
+	InsertLines(aIndex, std::move(lines));
+
+	return m_Lines[aIndex];
+}
+
+void ImTextEdit::InsertLines(int aIndex, std::vector<Line>&& aLines)
+{
+	assert(!m_ReadOnly);
+
+	int count = (int)aLines.size();
+	m_Lines.insert(aIndex, std::move(aLines));
+	OnLinesInserted(aIndex, count);
+
+	// error markers
+	td_ErrorMarkers etmp;
+
+	for (auto& i : m_ErrorMarkers)
+		etmp.insert(td_ErrorMarkers::value_type(i.first >= aIndex ? i.first + count : i.first, i.second));
+	
+	m_ErrorMarkers = std::move(etmp);
+
+	// breakpoints
+	auto btmp = m_Breakpoints;
+	m_Breakpoints.clear();
+
+	for (auto i : btmp)
+		RemoveBreakpoint(i.Line);
+	
+	for (auto i : btmp)
+		AddBreakpoint(i.Line >= aIndex ? i.Line + count : i.Line, i.UseCondition, i.Condition, i.Enabled);
+}
+
+std::string ImTextEdit::GetWordUnderCursor() const
+{
+	auto c = GetCursorPosition();
+	c.Column = std::max(c.Column - 1, 0);
+
+	return GetWordAt(c);
+}
+
+std::string ImTextEdit::GetWordAt(const Coordinates & aCoords) const
+{
+	auto start = FindWordStart(aCoords);
+	auto end = FindWordEnd(aCoords);
+
+	std::string r;
+
+	auto istart = GetCharacterIndex(start);
+	auto iend = GetCharacterIndex(end);
+
+	for (auto it = istart; it < iend; ++it)
+		r.push_back(m_Lines[aCoords.Line][it].Character);
+
+	return r;
+}
+
+ImU32 ImTextEdit::GetGlyphColor(const Glyph & aGlyph) const
+{
+	if (!m_ColorizerEnabled)
+		return m_Palette[(int)PaletteIndex::Default];
+
+	if (aGlyph.Comment)
+		return m_Palette[(int)PaletteIndex::Comment];
+	
+	if (aGlyph.MultiLineComment)
+		return m_Palette[(int)PaletteIndex::MultiLineComment];
+	
+	auto const color = m_Palette[(int)aGlyph.ColorIndex];
+	
+	if (aGlyph.Preprocessor)
+	{
+		const auto ppcolor = m_Palette[(int)PaletteIndex::Preprocessor];
+		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
+		const int c1 = (((ppcolor >> 8) & 0xff) + ((color >> 8) & 0xff)) / 2;
+		const int c2 = (((ppcolor >> 16) & 0xff) + ((color >> 16) & 0xff)) / 2;
+		const int c3 = (((ppcolor >> 24) & 0xff) + ((color >> 24) & 0xff)) / 2;
+
+		return ImU32(c0 | (c1 << 8) | (c2 << 16) | (c3 << 24));
+	}
+
+	return color;
+}
+
+ImTextEdit::AdvanceTable::AdvanceTable()
+	: m_Font(nullptr), m_FontSize(0.0f), m_TabSize(0), m_Generation(0), m_Pitch(0.0f)
+{
+	std::fill(m_Ascii, m_Ascii + 128, 0.0f);
+}
+
+bool ImTextEdit::AdvanceTable::Update(const ImFont* aFont, float aFontSize, int aTabSize)
+{
+	if (aFont == m_Font && aFontSize == m_FontSize && aTabSize == m_TabSize)
+		return false;
+
+	m_Font = aFont;
+	m_FontSize = aFontSize;
+	m_TabSize = aTabSize;
+	m_Other.clear();
+
+	if (++m_Generation == 0)
+		m_Generation = 1;
+
+	for (int c = 0; c < 128; c++)
+	{
+		char buf[2] = { (char)c, '\0' };
+		m_Ascii[c] = aFont->CalcTextSizeA(aFontSize, FLT_MAX, -1.0f, buf, buf + 1, nullptr).x;
+	}
+
+	m_Pitch = m_Ascii[' '];
+
+	for (int c = 33; c < 127 && m_Pitch > 0.0f; c++)
+	{
+		if (m_Ascii[c] != m_Pitch)
+			m_Pitch = 0.0f;
+	}
+
+	return true;
+}
+
+float ImTextEdit::AdvanceTable::Measure(const td_Char* aBegin, const td_Char* aEnd) const
+{
+	float width = 0.0f;
+
+	for (const td_Char* it = aBegin; it < aEnd;)
+	{
+		if (m_Pitch > 0.0f)
+		{
+			size_t count = CountPrintable(it, aEnd);
+			width += count * m_Pitch;
+			it += count;
+
+			if (it == aEnd)
+				break;
+		}
+
+		int length = std::min<int>(UTF8CharLength(*it), (int)(aEnd - it));
+		width += Get(it, length);
+		it += length;
+	}
+
+	return width;
+}
+
+float ImTextEdit::AdvanceTable::GetOther(const td_Char* aChar, int aLength) const
+{
+	uint64_t key = 0;
+	for (int i = 0; i < aLength; i++)
+		key = (key << 8) | aChar[i];
+
+	auto it = m_Other.find(key);
+	if (it != m_Other.end())
+		return it->second;
+
+	const char* text = (const char*)aChar;
+	float width = m_Font->CalcTextSizeA(m_FontSize, FLT_MAX, -1.0f, text, text + aLength, nullptr).x;
+	m_Other[key] = width;
+	return width;
+}
+
+const ImTextEdit::AdvanceTable& ImTextEdit::GetAdvances() const
+{
+	m_Advances.Update(ImGui::GetFont(), ImGui::GetFontSize(), m_TabSize);
+	return m_Advances;
+}
+
+const ImTextEdit::LineOffsets* ImTextEdit::GetLineOffsets(int aLine) const
+{
+	auto& line = m_Lines[aLine];
+
+	if (line.size() < s_LineOffsetsMinLength)
+		return nullptr;
+
+	auto& advances = GetAdvances();
+	auto& offsets = line.GetOffsets();
+
+	if (offsets.Generation == advances.GetGeneration())
+		return &offsets;
+
+	const td_Char* chars = line.GetChars();
+	const size_t size = line.size();
+
+	offsets.X.resize(size + 1);
+	offsets.Column.resize(size + 1);
+
+	float x = 0.0f;
+	int column = 0;
+
+	for (size_t i = 0; i < size;)
+	{
+		if (chars[i] == '\t')
+		{
+			offsets.X[i] = x;
+			offsets.Column[i] = column;
+			x = advances.GetTabStop(x);
+			column = (column / m_TabSize) * m_TabSize + m_TabSize;
+			i++;
+		}
+		else
+		{
+			size_t length = std::min<size_t>(UTF8CharLength(chars[i]), size - i);
+
+			for (size_t k = 0; k < length; k++)
+			{
+				offsets.X[i + k] = x;
+				offsets.Column[i + k] = column;
+			}
+
+			x += advances.Get(chars + i, (int)length);
+			column++;
+			i += length;
+		}
+	}
+
+	offsets.X[size] = x;
+	offsets.Column[size] = column;
+	offsets.Generation = advances.GetGeneration();
+	return &offsets;
+}
+
+size_t ImTextEdit::HitTestOffsets(const Line& aLine, const LineOffsets& aOffsets, float aX)
+{
+	// same result as walking the line: the first character whose middle is right of aX
+	const td_Char* chars = aLine.GetChars();
+	const size_t size = aLine.size();
+
+	size_t next = std::upper_bound(aOffsets.X.begin(), aOffsets.X.begin() + size, aX) - aOffsets.X.begin();
+
+	if (next == 0)
+		return 0;
+
+	// everything before the character under aX ends left of it
+	size_t start = next - 1;
+	while (start > 0 && (chars[start] & 0xC0) == 0x80)
+		start--;
+
+	size_t end = std::min<size_t>(start + UTF8CharLength(chars[start]), size);
+	return (aOffsets.X[start] + aOffsets.X[end]) * 0.5f > aX ? start : end;
+}
+
+ImTextEdit::LineLayout& ImTextEdit::GetLineLayout(int aLine)
+{
+	auto& line = m_Lines[aLine];
+	auto& layout = line.GetLayout();
+
+	if (layout.Generation == m_LayoutGeneration)
+		return layout;
+
+	layout.Runs.clear();
+	layout.Tabs.clear();
+	layout.Spaces.clear();
+
+	auto& advances = GetAdvances();
+	const td_Char* chars = line.GetChars();
+
+	float x = 0.0f;
+	size_t runBegin = 0;
+	ImU32 runColor = 0;
+
+	auto endRun = [&](size_t aEnd)
+	{
+		if (runBegin >= aEnd)
+			return;
+
+		float width = advances.Measure(chars + runBegin, chars + aEnd);
+		layout.Runs.push_back({ (uint32_t)runBegin, (uint32_t)aEnd, runColor, x, width });
+		x += width;
+	};
+
+	// same splitting as the glyph by glyph drawing: a run ends at a color change or whitespace
+	for (size_t i = 0; i < line.size();)
+	{
+		auto c = line.GetChar(i);
+
+		if (c == '\t')
+		{
+			endRun(i);
+			float next = advances.GetTabStop(x);
+			layout.Tabs.push_back(ImVec2(x, next));
+			x = next;
+			runBegin = ++i;
+		}
+		else if (c == ' ')
+		{
+			endRun(i);
+			if (m_ShowWhitespaces)
+				layout.Spaces.push_back(x);
+			x += advances.GetSpace();
+			runBegin = ++i;
+		}
+		else
+		{
+			auto color = GetGlyphColor(line[i]);
+
+			if (runBegin < i && color != runColor)
+			{
+				endRun(i);
+				runBegin = i;
+			}
+
+			runColor = color;
+			i = std::min(line.size(), i + UTF8CharLength(c));
+		}
+	}
+
+	endRun(line.size());
+
+	layout.Width = x;
+	layout.Generation = m_LayoutGeneration;
+
+	if (m_LineWidths.GetLineCount() != (int)m_Lines.size())
+		m_LineWidths.Reset((int)m_Lines.size());
+	m_LineWidths.Set(aLine, x);
+
+	return layout;
+}
+
+ImTextEdit::Coordinates ImTextEdit::FindFirst(const std::string& what, const Coordinates& fromWhere)
+{
+	if (fromWhere.Line < 0 || fromWhere.Line >= m_Lines.size())
+		return Coordinates(m_Lines.size(), 0);
+
+	std::string textSrc = GetText(fromWhere, Coordinates((int)m_Lines.size(), 0));
+
+	size_t index = 0;
+	size_t loc = textSrc.find(what);
+	Coordinates ret = fromWhere;
+
+	while (loc != std::string::npos)
+	{
+		for (; index < loc; index++)
+		{
+			if (textSrc[index] == '\n')
+			{
+				ret.Column = 0;
+				ret.Line++;
+			}
+			else
+			{
+				ret.Column++;
+			}
+		}
+
+		ret.Column = GetCharacterColumn(ret.Line, ret.Column); // ret.Column is currently character index, convert it to character column
+
+		if (GetWordAt(ret) == what)
+			return ret;
+		else
+			loc = textSrc.find(what, loc + 1);
+	}
+
+	return Coordinates(m_Lines.size(), 0);
+}
+
+void ImTextEdit::HandleKeyboardInputs()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	auto shift = io.KeyShift;
+	auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
+	auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+
+	if (ImGui::IsWindowFocused())
+	{
+		if (ImGui::IsWindowHovered())
+			ImGui::SetMouseCursor(ImGuiMouseCursor_TextInput);
+		//ImGui::CaptureKeyboardFromApp(true);
+
+		io.WantCaptureKeyboard = true;
+		io.WantTextInput = true;
+
+		ShortcutID actionID = ShortcutID::Count;
+		for (int i = 0; i < m_Shortcuts.size(); i++)
+		{
+			auto sct = m_Shortcuts[i];
+
+			if (sct.Key1 == -1)
+				continue;
+				
+			ShortcutID curActionID = ShortcutID::Count;
+			bool additionalChecks = true;
+
+			int sc1 = ::GetAsyncKeyState(sct.Key1) & 0x8000 ? sct.Key1 : -1;
+
+			if ((ImGui::IsKeyPressed(sc1) || (sc1 == VK_RETURN && ImGui::IsKeyPressed(VK_RETURN))) && ((sct.Key2 != -1 && ImGui::IsKeyPressed(sct.Key2)) || sct.Key2 == -1))
+			{
+				if ((sct.Ctrl == ctrl) && (sct.Alt == alt) && (sct.Shift == shift))
+				{
+					// PRESSED:
+					curActionID = (ImTextEdit::ShortcutID)i;
+					
+					switch (curActionID)
+					{
+						case ShortcutID::Paste:
+						case ShortcutID::Cut:
+						case ShortcutID::Redo: 
+						case ShortcutID::Undo:
+						case ShortcutID::ForwardDelete:
+						case ShortcutID::BackwardDelete:
+						case ShortcutID::DeleteLeft:
+						case ShortcutID::DeleteRight:
+						case ShortcutID::ForwardDeleteWord:
+						case ShortcutID::BackwardDeleteWord:
+							additionalChecks = !IsReadOnly();
+							break;
+						default:
+							break;
+					}
+				}
+			}
+
+			if (additionalChecks && curActionID != ShortcutID::Count)
+				actionID = curActionID;
+		}
+
+		int keyCount = 0;
+		bool keepACOpened = false, functionTooltipState = m_FunctionDeclarationTooltip;
+		bool hasWrittenALetter = false;
+		if (actionID != ShortcutID::Count)
+		{
+			if (actionID != ShortcutID::Indent)
+				m_IsSnippet = false;
+			
+			switch (actionID)
+			{
+				case ShortcutID::Undo:
+					Undo();
+					break;
+				case ShortcutID::Redo:
+					Redo();
+					break;
+				case ShortcutID::MoveUp:
+					MoveUp(1, false);
+					break;
+				case ShortcutID::SelectUp:
+					MoveUp(1, true);
+					break;
+				case ShortcutID::MoveDown:
+					MoveDown(1, false);
+					break;
+				case ShortcutID::SelectDown:
+					MoveDown(1, true);
+					break;
+				case ShortcutID::MoveLeft:
+					MoveLeft(1, false, false);
+					break;
+				case ShortcutID::SelectLeft:
+					MoveLeft(1, true, false);
+					break;
+				case ShortcutID::MoveWordLeft:
+					MoveLeft(1, false, true);
+					break;
+				case ShortcutID::SelectWordLeft:
+					MoveLeft(1, true, true);
+					break;
+				case ShortcutID::MoveRight:
+					MoveRight(1, false, false);
+					break;
+				case ShortcutID::SelectRight:
+					MoveRight(1, true, false);
+					break;
+				case ShortcutID::MoveWordRight:
+					MoveRight(1, false, true);
+					break;
+				case ShortcutID::SelectWordRight:
+					MoveRight(1, true, true);
+					break;
+				case ShortcutID::MoveTop:
+					MoveTop(false);
+					break;
 				case ShortcutID::SelectTop:
 					MoveTop(true);
 					break;
@@ -1471,6 +2784,9 @@ void ImTextEdit::HandleKeyboardInputs()
 				case ShortcutID::SelectAll:
 					SelectAll();
 					break;
+				case ShortcutID::JumpToMatchingBracket:
+					MoveToMatchingBracket(false);
+					break;
 				case ShortcutID::AutocompleteOpen:
 					if (m_Autocomplete && !m_IsSnippet)
 						BuildSuggestions(&keepACOpened);
@@ -1490,3270 +2806,4791 @@ void ImTextEdit::HandleKeyboardInputs()
 				case ShortcutID::NewLine:
 					EnterCharacter('\n', false);
 					break;
-				case ShortcutID::Indent:
-					if (m_IsSnippet)
+				case ShortcutID::Indent:
+					if (m_IsSnippet)
+					{
+						do
+						{
+							m_SnippetTagSelected++;
+							if (m_SnippetTagSelected >= m_SnippetTagStart.size())
+								m_SnippetTagSelected = 0;
+						}
+						while (!m_SnippetTagHighlight[m_SnippetTagSelected]);
+
+						m_SnippetTagLength = 0;
+						m_SnippetTagPreviousLength = m_SnippetTagEnd[m_SnippetTagSelected].Column - m_SnippetTagStart[m_SnippetTagSelected].Column;
+
+						SetSelection(m_SnippetTagStart[m_SnippetTagSelected], m_SnippetTagEnd[m_SnippetTagSelected]);
+						SetCursorPosition(m_SnippetTagEnd[m_SnippetTagSelected]);
+					}
+					else
+					{
+						EnterCharacter('\t', false);
+					}
+					break;
+				case ShortcutID::Unindent:
+					EnterCharacter('\t', true);
+					break;
+				case ShortcutID::Find:
+					m_FindOpened = m_HasSearch;
+					m_FindJustOpened = m_HasSearch;
+					m_ReplaceOpened = false;
+					break;
+				case ShortcutID::Replace:
+					m_FindOpened = m_HasSearch;
+					m_FindJustOpened = m_HasSearch;
+					m_ReplaceOpened = m_HasSearch;
+					break;
+				case ShortcutID::DebugStep:
+					if (OnDebuggerAction)
+						OnDebuggerAction(this, ImTextEdit::DebugAction::Step);
+					break;
+				case ShortcutID::DebugStepInto:
+					if (OnDebuggerAction)
+						OnDebuggerAction(this, ImTextEdit::DebugAction::StepInto);
+					break;
+				case ShortcutID::DebugStepOut:
+					if (OnDebuggerAction)
+						OnDebuggerAction(this, ImTextEdit::DebugAction::StepOut);
+					break;
+				case ShortcutID::DebugContinue:
+					if (OnDebuggerAction)
+						OnDebuggerAction(this, ImTextEdit::DebugAction::Continue);
+					break;
+				case ShortcutID::DebugStop:
+					if (OnDebuggerAction)
+						OnDebuggerAction(this, ImTextEdit::DebugAction::Stop);
+					break;
+				case ShortcutID::DebugJumpHere:
+					if (OnDebuggerJump)
+						OnDebuggerJump(this, GetCursorPosition().Line);
+					break;
+				case ShortcutID::DebugBreakpoint:
+					if (OnBreakpointUpdate)
+					{
+						int line = GetCursorPosition().Line + 1;
+
+						if (HasBreakpoint(line))
+							RemoveBreakpoint(line);
+						else AddBreakpoint(line);
+					}
+					break;
+				case ShortcutID::DuplicateLine:
+				{
+					/*ImTextEdit::UndoRecord undo;
+					undo.Before = m_State;
+
+					auto oldLine = m_Lines[m_State.CursorPosition.Line];
+					auto& line = InsertLine(m_State.CursorPosition.Line);
+
+					undo.Added += '\n';
+
+					for (auto& glyph : oldLine)
+					{
+						line.push_back(glyph);
+						undo.Added += glyph.Character;
+					}
+					
+					m_State.CursorPosition.Line++;
+
+					undo.AddedStart = ImTextEdit::Coordinates(m_State.CursorPosition.Line - 1, m_State.CursorPosition.Column);
+					undo.AddedEnd = m_State.CursorPosition;
+
+					undo.After = m_State;
+
+					AddUndo(undo);*/
+					break;
+				}
+				case ShortcutID::CommentLines:
+				{
+					for (int l = m_State.SelectionStart.Line; l <= m_State.SelectionEnd.Line && l < m_Lines.size(); l++)
+					{
+						m_Lines[l].insert(m_Lines[l].begin(), ImTextEdit::Glyph('/', ImTextEdit::PaletteIndex::Comment));
+						m_Lines[l].insert(m_Lines[l].begin(), ImTextEdit::Glyph('/', ImTextEdit::PaletteIndex::Comment));
+					}
+
+					OnLinesChanged(m_State.SelectionStart.Line, m_State.SelectionEnd.Line + 1);
+					Colorize(m_State.SelectionStart.Line, m_State.SelectionEnd.Line - m_State.SelectionStart.Line + 1);
+					break;
+				}
+				case ShortcutID::UncommentLines:
+				{
+					for (int l = m_State.SelectionStart.Line; l <= m_State.SelectionEnd.Line && l < m_Lines.size(); l++)
+					{
+						if (m_Lines[l].size() >= 2)
+						{
+							if (m_Lines[l][0].Character == '/' && m_Lines[l][1].Character == '/')
+								m_Lines[l].erase(m_Lines[l].begin(), m_Lines[l].begin() + 2);
+						}
+					}
+
+					OnLinesChanged(m_State.SelectionStart.Line, m_State.SelectionEnd.Line + 1);
+					Colorize(m_State.SelectionStart.Line, m_State.SelectionEnd.Line - m_State.SelectionStart.Line + 1);
+					break;
+				}
+			}
+		}
+		else if (!IsReadOnly())
+		{
+			for (int i = 0; i < io.InputQueueCharacters.Size; i++)
+			{
+				auto c = (unsigned char)io.InputQueueCharacters[i];
+
+				if (c != 0 && (c == '\n' || c >= 32))
+				{
+					EnterCharacter((char)c, shift);
+
+					if (c == '.')
+						BuildMemberSuggestions(&keepACOpened);
+
+					if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+						hasWrittenALetter = true;
+
+					if (m_IsSnippet)
+					{
+						m_SnippetTagLength++;
+						m_SnippetTagEnd[m_SnippetTagSelected].Column = m_SnippetTagStart[m_SnippetTagSelected].Column + m_SnippetTagLength;
+					
+						Coordinates curCursor = GetCursorPosition();
+						SetSelection(m_SnippetTagStart[m_SnippetTagSelected], m_SnippetTagEnd[m_SnippetTagSelected]);
+						std::string curWord = GetSelectedText();
+						std::unordered_map<int, int> modif;
+						modif[curCursor.Line] = 0;
+
+						for (int j = 0; j < m_SnippetTagStart.size(); j++)
+						{
+							if (j != m_SnippetTagSelected)
+							{
+								m_SnippetTagStart[j].Column += modif[m_SnippetTagStart[j].Line];
+								m_SnippetTagEnd[j].Column += modif[m_SnippetTagStart[j].Line];
+							}
+
+							if (m_SnippetTagID[j] == m_SnippetTagID[m_SnippetTagSelected])
+							{
+								modif[m_SnippetTagStart[j].Line] += m_SnippetTagLength - m_SnippetTagPreviousLength;
+
+								if (j != m_SnippetTagSelected)
+								{
+									SetSelection(m_SnippetTagStart[j], m_SnippetTagEnd[j]);
+									Backspace();
+									AppendText(curWord);
+									m_SnippetTagEnd[j].Column = m_SnippetTagStart[j].Column + m_SnippetTagLength;
+								}
+							}
+						}
+
+						SetSelection(curCursor, curCursor);
+						SetCursorPosition(curCursor);
+						EnsureCursorVisible();
+						m_SnippetTagPreviousLength = m_SnippetTagLength;
+					}
+
+					keyCount++;
+				}
+			}
+			io.InputQueueCharacters.resize(0);
+		}
+
+		// active auto-complete
+		if (m_RequestAutocomplete && m_ReadyForAutocomplete && !m_IsSnippet)
+		{
+			BuildSuggestions(&keepACOpened);
+			m_RequestAutocomplete = false;
+			m_ReadyForAutocomplete = false;
+		}
+
+		if ((m_ACOpened && !keepACOpened) || m_FunctionDeclarationTooltip)
+		{
+			for (size_t i = 0; i < ImGuiKey_COUNT; i++)
+				keyCount += ImGui::IsKeyPressed(ImGui::GetKeyIndex(i));
+
+			if (keyCount != 0)
+			{
+				if (functionTooltipState == m_FunctionDeclarationTooltip)
+					m_FunctionDeclarationTooltip = false;
+
+				m_ACOpened = false;
+
+				if (!hasWrittenALetter)
+					m_ACObject = "";
+			}
+		}
+	}
+}
+
+void ImTextEdit::HandleMouseInputs()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	auto shift = io.KeyShift;
+	auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
+	auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+
+	if (ImGui::IsWindowHovered())
+	{
+		auto click = ImGui::IsMouseClicked(0);
+	
+		if ((!shift || (shift && click)) && !alt)
+		{
+			auto doubleClick = ImGui::IsMouseDoubleClicked(0);
+			auto t = ImGui::GetTime();
+			auto tripleClick = click && !doubleClick && (m_LastClick != -1.0f && (t - m_LastClick) < io.MouseDoubleClickTime);
+
+			if (click || doubleClick || tripleClick)
+			{
+				m_IsSnippet = false;
+				m_FunctionDeclarationTooltip = false;
+			}
+
+			if (tripleClick) // Left mouse button triple click
+			{
+				if (!ctrl)
+				{
+					m_State.CursorPosition = m_InteractiveStart = m_InteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
+					m_SelectionMode = SelectionMode::Line;
+					SetSelection(m_InteractiveStart, m_InteractiveEnd, m_SelectionMode);
+				}
+
+				m_LastClick = -1.0f;
+			}
+			else if (doubleClick) // Left mouse button double click
+			{
+				if (!ctrl)
+				{
+					m_State.CursorPosition = m_InteractiveStart = m_InteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
+					if (m_SelectionMode == SelectionMode::Line)
+						m_SelectionMode = SelectionMode::Normal;
+					else
+						m_SelectionMode = SelectionMode::Word;
+					SetSelection(m_InteractiveStart, m_InteractiveEnd, m_SelectionMode);
+					m_State.CursorPosition = m_State.SelectionEnd;
+				}
+
+				m_LastClick = (float)ImGui::GetTime();
+			}
+			else if (click)  // Mouse button click
+			{
+				ImVec2 pos = ImGui::GetMousePos();
+
+				if (pos.x - m_UICursorPos.x < ImGui::GetStyle().WindowPadding.x + EditorCalculateSize(s_DebugDataSpace))
+				{
+					Coordinates lineInfo = ScreenPosToCoordinates(ImGui::GetMousePos());
+					lineInfo.Line += 1;
+
+					if (HasBreakpoint(lineInfo.Line))
+						RemoveBreakpoint(lineInfo.Line);
+					else
+						AddBreakpoint(lineInfo.Line);
+				}
+				else
+				{
+					m_ACOpened = false;
+					m_ACObject = "";
+
+					auto tcoords = ScreenPosToCoordinates(ImGui::GetMousePos());
+					
+					if (!shift)
+						m_InteractiveStart = tcoords;
+					
+					m_State.CursorPosition = m_InteractiveEnd = tcoords;
+
+					if (ctrl && !shift)
+						m_SelectionMode = SelectionMode::Word;
+					else
+						m_SelectionMode = SelectionMode::Normal;
+
+					SetSelection(m_InteractiveStart, m_InteractiveEnd, m_SelectionMode);
+
+					m_LastClick = (float)ImGui::GetTime();
+				}
+			}
+			else if (ImGui::IsMouseDragging(0) && ImGui::IsMouseDown(0)) // Mouse left button dragging (=> update selection)
+			{
+				io.WantCaptureMouse = true;
+				m_State.CursorPosition = m_InteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
+				SetSelection(m_InteractiveStart, m_InteractiveEnd, m_SelectionMode);
+
+				float mx = ImGui::GetMousePos().x;
+
+				if (mx > m_FindOrigin.x + m_WindowWidth - 50 && mx < m_FindOrigin.x + m_WindowWidth)
+					ImGui::SetScrollX(ImGui::GetScrollX() + 1.0f);
+				else if (mx > m_FindOrigin.x && mx < m_FindOrigin.x + m_TextStart + 50)
+					ImGui::SetScrollX(ImGui::GetScrollX() - 1.0f);
+			}
+
+		}
+	}
+}
+
+bool ImTextEdit::HasBreakpoint(int line)
+{
+	for (const auto& bkpt : m_Breakpoints)
+		if (bkpt.Line == line)
+			return true;
+
+	return false;
+}
+
+void ImTextEdit::AddBreakpoint(int line, bool useCondition, std::string condition, bool enabled)
+{
+	RemoveBreakpoint(line);
+
+	Breakpoint bkpt;
+	bkpt.Line = line;
+	bkpt.Condition = condition;
+	bkpt.Enabled = enabled;
+	bkpt.UseCondition = useCondition;
+
+	if (OnBreakpointUpdate)
+		OnBreakpointUpdate(this, line, useCondition, condition, enabled);
+
+	m_Breakpoints.push_back(bkpt);
+	InvalidateRenderCache();
+}
+
+void ImTextEdit::RemoveBreakpoint(int line)
+{
+	for (int i = 0; i < m_Breakpoints.size(); i++)
+	{
+		if (m_Breakpoints[i].Line == line)
+		{
+			m_Breakpoints.erase(m_Breakpoints.begin() + i);
+			InvalidateRenderCache();
+			break;
+		}
+	}
+
+	if (OnBreakpointRemove)
+		OnBreakpointRemove(this, line);
+}
+
+void ImTextEdit::SetBreakpointEnabled(int line, bool enable)
+{
+	for (int i = 0; i < m_Breakpoints.size(); i++)
+	{
+		if (m_Breakpoints[i].Line == line)
+		{
+			m_Breakpoints[i].Enabled = enable;
+			InvalidateRenderCache();
+		
+			if (OnBreakpointUpdate)
+				OnBreakpointUpdate(this, line, m_Breakpoints[i].UseCondition, m_Breakpoints[i].Condition, enable);
+			
+			break;
+		}
+	}
+}
+
+ImTextEdit::Breakpoint& ImTextEdit::GetBreakpoint(int line)
+{
+	for (int i = 0; i < m_Breakpoints.size(); i++)
+	{
+		if (m_Breakpoints[i].Line == line)
+			return m_Breakpoints[i];
+	}
+}
+
+// fnv-1a over the bytes of a value
+template<typename T>
+static inline uint64_t HashRenderState(uint64_t aHash, const T& aValue)
+{
+	const unsigned char* bytes = (const unsigned char*)&aValue;
+
+	for (size_t i = 0; i < sizeof(T); i++)
+		aHash = (aHash ^ bytes[i]) * 1099511628211ull;
+
+	return aHash;
+}
+
+void ImTextEdit::ReplayRenderCache(ImDrawList* aDrawList)
+{
+	const int vtxCount = (int)m_RenderCache.Vertices.size();
+	const int idxCount = (int)m_RenderCache.Indices.size();
+
+	if (idxCount == 0)
+		return;
+
+	aDrawList->PrimReserve(idxCount, vtxCount);
+
+	// PrimReserve may have started a new vertex offset, so the base is read afterwards
+	const unsigned int base = aDrawList->_VtxCurrentIdx;
+	std::copy(m_RenderCache.Vertices.begin(), m_RenderCache.Vertices.end(), aDrawList->_VtxWritePtr);
+
+	for (int i = 0; i < idxCount; i++)
+		aDrawList->_IdxWritePtr[i] = (ImDrawIdx)(base + m_RenderCache.Indices[i]);
+
+	aDrawList->_VtxWritePtr += vtxCount;
+	aDrawList->_IdxWritePtr += idxCount;
+	aDrawList->_VtxCurrentIdx += vtxCount;
+}
+
+void ImTextEdit::RenderInternal(const char* aTitle)
+{
+	/* Compute m_CharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
+	const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
+	m_CharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * m_LineSpacing);
+
+	/* Update palette with the current alpha from style */
+	bool layoutChanged = false;
+
+	for (int i = 0; i < (int)PaletteIndex::Max; ++i)
+	{
+		auto color = ImGui::ColorConvertU32ToFloat4(m_PaletteBase[i]);
+		color.w *= ImGui::GetStyle().Alpha;
+		auto packed = ImGui::ColorConvertFloat4ToU32(color);
+		layoutChanged |= m_Palette[i] != packed;
+		m_Palette[i] = packed;
+	}
+
+	// the cached line layouts are only valid for the palette, font and tab size they were built with
+	if (layoutChanged || m_LayoutFont != ImGui::GetFont() || m_LayoutFontSize != ImGui::GetFontSize() || m_LayoutTabSize != m_TabSize ||
+		m_LayoutShowWhitespaces != m_ShowWhitespaces || m_LayoutColorizerEnabled != m_ColorizerEnabled)
+	{
+		m_LayoutFont = ImGui::GetFont();
+		m_LayoutFontSize = ImGui::GetFontSize();
+		m_LayoutTabSize = m_TabSize;
+		m_LayoutShowWhitespaces = m_ShowWhitespaces;
+		m_LayoutColorizerEnabled = m_ColorizerEnabled;
+
+		if (++m_LayoutGeneration == 0)
+			m_LayoutGeneration = 1;
+
+		// every line is measured again once it is laid out with the new font
+		m_LineWidths.Reset((int)m_Lines.size());
+	}
+
+	assert(m_LineBuffer.empty());
+	m_Focused = ImGui::IsWindowFocused() || m_FindFocused || m_ReplaceFocused;
+
+	auto contentSize = ImGui::GetWindowContentRegionMax();
+	auto drawList = ImGui::GetWindowDrawList();
+
+	if (m_ScrollToTop)
+	{
+		m_ScrollToTop = false;
+		ImGui::SetScrollY(0.f);
+	}
+
+	ImVec2 cursorScreenPos = m_UICursorPos = ImGui::GetCursorScreenPos();
+	auto scrollX = ImGui::GetScrollX();
+	auto scrollY = m_LastScroll = ImGui::GetScrollY();
+
+	if (m_Follow)
+	{
+		// stay at the bottom while the view is there, otherwise keep the shown lines in place when old ones are dropped
+		m_FollowPinned = scrollY >= ImGui::GetScrollMaxY() - m_CharAdvance.y;
+
+		if (m_FollowDropped > 0 && !m_FollowPinned)
+		{
+			scrollY = m_LastScroll = std::max(0.0f, scrollY - m_FollowDropped * m_CharAdvance.y);
+			ImGui::SetScrollY(scrollY);
+		}
+	}
+
+	m_FollowDropped = 0;
+
+	// the content region doesn't move with the scroll position, the lines past it are never shown
+	int pageSize = (int)ceil(contentSize.y / m_CharAdvance.y);
+	auto lineNo = (int)floor(scrollY / m_CharAdvance.y);
+	auto globalLineMax = (int)m_Lines.size();
+	auto lineMax = std::max<int>(0, std::min<int>((int)m_Lines.size() - 1, lineNo + pageSize));
+	int totalLinesFolded = 0;
+
+	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
+	char buf[16];
+	snprintf(buf, 16, " %3d ", globalLineMax);
+	m_TextStart = (ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + m_LeftMargin) * m_Sidebar;
+
+	// render
+	GetPageSize();
+	if (!m_Lines.empty())
+	{
+		auto& advances = GetAdvances();
+		float spaceSize = advances.GetSpace();
+		
+		// find bracket pairs to highlight, the columns are glyph indices here
+		bool highlightBrackets = false;
+		Coordinates highlightBracketCoord = m_State.CursorPosition, highlightBracketCursor = m_State.CursorPosition;
+		if (m_HighlightBrackets && m_State.SelectionStart == m_State.SelectionEnd)
+		{
+			Coordinates cursor = GetCorrectCursorPosition();
+			int index = GetCharacterIndex(cursor);
+			int matchLine, matchIndex;
+
+			for (int i : { index - 1, index })
+			{
+				if (FindMatchingBracket(cursor.Line, i, matchLine, matchIndex))
+				{
+					highlightBrackets = true;
+					highlightBracketCursor = Coordinates(cursor.Line, i);
+					highlightBracketCoord = Coordinates(matchLine, matchIndex);
+					break;
+				}
+			}
+		}
+
+		// fold info
+		int hoverFoldWeight = 0;
+		int linesFolded = 0;
+		uint64_t curTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		
+		if (m_FoldEnabled)
+		{
+			UpdateFoldIndex();
+
+			// lineNo is the first visible row so far
+			int firstRow = lineNo;
+			lineNo = m_FoldIndex.RowToLine(firstRow);
+			linesFolded = lineNo - firstRow;
+			totalLinesFolded = m_FoldIndex.GetHiddenCount();
+			lineMax = std::max<int>(0, std::min<int>((int)m_Lines.size() - 1, m_FoldIndex.RowToLine(firstRow + pageSize)));
+		}
+
+		// the colorizer works on these lines first
+		const ImVec2 windowPos = ImGui::GetWindowPos();
+		const float windowBottom = windowPos.y + ImGui::GetWindowHeight();
+		m_VisibleLineBegin = m_VisibleLineEnd = lineNo;
+
+		// x range of the text that is inside the window, relative to the start of the text
+		const float clipLeft = windowPos.x - (cursorScreenPos.x + m_TextStart);
+		const float clipRight = clipLeft + ImGui::GetWindowWidth();
+
+		// the mouse only matters to the line under it and to the fold buttons in the gutter
+		int hoverRow = -1;
+		ImVec2 hoverGutter(-1.0f, -1.0f);
+		ImVec2 mousePos = ImGui::GetMousePos();
+
+		if (ImGui::IsMousePosValid() && mousePos.x >= windowPos.x && mousePos.y >= windowPos.y && mousePos.x < windowPos.x + ImGui::GetWindowWidth() && mousePos.y < windowBottom)
+		{
+			hoverRow = (int)floor((mousePos.y - cursorScreenPos.y) / m_CharAdvance.y);
+
+			if (mousePos.x < cursorScreenPos.x + scrollX + m_TextStart)
+				hoverGutter = mousePos;
+		}
+
+		// everything the line loop below draws depends on, the edits themselves call InvalidateRenderCache
+		bool focused = ImGui::IsWindowFocused();
+		uint64_t renderHash = HashRenderState(14695981039346656037ull, drawList);
+		renderHash = HashRenderState(renderHash, drawList->GetClipRectMin());
+		renderHash = HashRenderState(renderHash, drawList->GetClipRectMax());
+		renderHash = HashRenderState(renderHash, m_DocumentVersion);
+		renderHash = HashRenderState(renderHash, m_LayoutGeneration);
+		renderHash = HashRenderState(renderHash, cursorScreenPos);
+		renderHash = HashRenderState(renderHash, ImVec2(scrollX, scrollY));
+		renderHash = HashRenderState(renderHash, contentSize);
+		renderHash = HashRenderState(renderHash, ImVec2(m_TextStart, windowBottom));
+		renderHash = HashRenderState(renderHash, m_CharAdvance);
+		renderHash = HashRenderState(renderHash, ImGui::GetColorU32(ImGuiCol_WindowBg));
+		renderHash = HashRenderState(renderHash, m_State.SelectionStart);
+		renderHash = HashRenderState(renderHash, m_State.SelectionEnd);
+		renderHash = HashRenderState(renderHash, m_State.CursorPosition);
+		renderHash = HashRenderState(renderHash, highlightBracketCoord);
+		renderHash = HashRenderState(renderHash, highlightBracketCursor);
+		renderHash = HashRenderState(renderHash, m_DebugCurrentLine);
+		renderHash = HashRenderState(renderHash, hoverRow);
+		renderHash = HashRenderState(renderHash, hoverGutter);
+
+		// cursor blink phase, see below
+		int flags = (focused << 0) | ((focused && curTime - m_StartTime > 400) << 1) | (highlightBrackets << 2) | (m_IsSnippet << 3) | (m_Sidebar << 4) |
+			(m_ShowLineNumbers << 5) | (m_FoldEnabled << 6) | (m_HighlightLine << 7) | (m_ShowWhitespaces << 8);
+		renderHash = HashRenderState(renderHash, flags);
+
+		bool replayed = false;
+		bool hoverDrawn = false;    // tooltips and hover highlights have to be drawn again on the next frame
+		bool cursorDrawn = false;
+		const int vtxStart = drawList->VtxBuffer.Size;
+		const int idxStart = drawList->IdxBuffer.Size;
+		const int cmdCount = drawList->CmdBuffer.Size;
+		const unsigned int vtxBase = drawList->_VtxCurrentIdx;
+
+		if (m_RenderCacheEnabled && m_RenderCache.Valid && m_RenderCache.Hash == renderHash)
+		{
+			ReplayRenderCache(drawList);
+			m_VisibleLineBegin = m_RenderCache.VisibleLineBegin;
+			m_VisibleLineEnd = m_RenderCache.VisibleLineEnd;
+
+			if (m_RenderCache.CursorDrawn && curTime - m_StartTime > 800)
+				m_StartTime = curTime;
+
+			m_RenderStats.FramesCached++;
+			replayed = true;
+		}
+
+		// render
+		while (!replayed && lineNo <= lineMax)
+		{
+			ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, cursorScreenPos.y + (lineNo - linesFolded) * m_CharAdvance.y);
+
+			if (lineStartScreenPos.y < windowBottom)
+				m_VisibleLineEnd = lineNo + 1;
+			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + m_TextStart, lineStartScreenPos.y);
+
+			auto* line = &m_Lines[lineNo];
+			Coordinates lineStartCoord(lineNo, 0);
+			Coordinates lineEndCoord(lineNo, GetLineMaxColumn(lineNo));
+
+			// check if line is folded
+			bool lineFolded = false;
+			int lineNew = 0;
+			Coordinates lineFoldStart, lineFoldEnd;
+			int lineFoldStartCIndex = 0;
+
+			if (m_FoldEnabled)
+			{
+				int brace = GetFoldBrace(lineNo);
+				int endLine, endIndex;
+
+				// the index only hides lines of folds that have an end
+				if (brace != -1 && line->IsFolded(brace) && FindMatchingBracket(lineNo, brace, endLine, endIndex))
+				{
+					lineFolded = true;
+					lineFoldStartCIndex = brace;
+					lineFoldStart = Coordinates(lineNo, GetCharacterColumn(lineNo, brace));
+					lineFoldEnd = Coordinates(endLine, GetCharacterColumn(endLine, endIndex));
+				}
+			}
+
+			// Draw selection for the current line
+			float sstart = -1.0f;
+			float ssend = -1.0f;
+			assert(m_State.SelectionStart <= m_State.SelectionEnd);
+			
+			if (m_State.SelectionStart <= lineEndCoord)
+				sstart = m_State.SelectionStart > lineStartCoord ? TextDistanceToLineStart(m_State.SelectionStart) : 0.0f;
+			
+			if (m_State.SelectionEnd > lineStartCoord)
+				ssend = TextDistanceToLineStart(m_State.SelectionEnd < lineEndCoord ? m_State.SelectionEnd : lineEndCoord);
+			
+			if (m_State.SelectionEnd.Line > lineNo)
+				ssend += m_CharAdvance.x;
+			
+			if (sstart != -1 && ssend != -1 && sstart < ssend)
+			{
+				ImVec2 vstart(lineStartScreenPos.x + m_TextStart + sstart, lineStartScreenPos.y);
+				ImVec2 vend(lineStartScreenPos.x + m_TextStart + ssend, lineStartScreenPos.y + m_CharAdvance.y);
+				drawList->AddRectFilled(vstart, vend, m_Palette[(int)PaletteIndex::Selection]);
+			}
+
+			// draw snippet stuff
+			if (m_IsSnippet)
+			{
+				unsigned int oldColor = m_Palette[(int)PaletteIndex::Selection];
+				unsigned int alpha = (oldColor & 0xFF000000) >> 25;
+				unsigned int newColor = (oldColor & 0x00FFFFFF) | (alpha << 24);
+
+				for (int i = 0; i < m_SnippetTagStart.size(); i++)
+				{
+					if (m_SnippetTagStart[i].Line == lineNo && m_SnippetTagHighlight[i])
+					{
+						float tstart = TextDistanceToLineStart(m_SnippetTagStart[i]);
+						float tend = TextDistanceToLineStart(m_SnippetTagEnd[i]);
+
+						ImVec2 vstart(lineStartScreenPos.x + m_TextStart + tstart, lineStartScreenPos.y);
+						ImVec2 vend(lineStartScreenPos.x + m_TextStart + tend, lineStartScreenPos.y + m_CharAdvance.y);
+						drawList->AddRectFilled(vstart, vend, newColor);
+					}
+				}
+			}
+
+			auto start = ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y);
+
+			// Draw error markers
+			auto errorIt = m_ErrorMarkers.find(lineNo + 1);
+
+			if (errorIt != m_ErrorMarkers.end())
+			{
+				auto end = ImVec2(lineStartScreenPos.x + contentSize.x + 2.0f * scrollX, lineStartScreenPos.y + m_CharAdvance.y);
+				drawList->AddRectFilled(start, end, m_Palette[(int)PaletteIndex::ErrorMarker]);
+
+				if (ImGui::IsMouseHoveringRect(lineStartScreenPos, end))
+				{
+					hoverDrawn = true;
+					ImGui::BeginTooltip();
+					ImGui::PushStyleColor(ImGuiCol_Text, ImGui::ColorConvertU32ToFloat4(m_Palette[(int)PaletteIndex::ErrorMessage]));
+					ImGui::Text("Error at line %d:", errorIt->first);
+					ImGui::PopStyleColor();
+					ImGui::Separator();
+					ImGui::PushStyleColor(ImGuiCol_Text, ImGui::ColorConvertU32ToFloat4(m_Palette[(int)PaletteIndex::ErrorMessage]));
+					ImGui::Text("%s", errorIt->second.c_str());
+					ImGui::PopStyleColor();
+					ImGui::EndTooltip();
+				}
+			}
+
+			// Highlight the current line (where the cursor is)
+			if (m_State.CursorPosition.Line == lineNo)
+			{
+				// Highlight the current line (where the cursor is)
+				if (m_HighlightLine && !HasSelection())
+				{
+					auto end = ImVec2(start.x + contentSize.x + scrollX, start.y + m_CharAdvance.y + 2.0f);
+					drawList->AddRectFilled(start, end, m_Palette[(int)(focused ? PaletteIndex::CurrentLineFill : PaletteIndex::CurrentLineFillInactive)]);
+					drawList->AddRect(start, end, m_Palette[(int)PaletteIndex::CurrentLineEdge], 1.0f);
+				}
+
+				// Render the cursor
+				if (focused)
+				{
+					auto elapsed = curTime - m_StartTime;
+					if (elapsed > 400)
+					{
+						cursorDrawn = true;
+						float width = 1.0f;
+						auto cindex = GetCharacterIndex(m_State.CursorPosition);
+						float cx = TextDistanceToLineStart(m_State.CursorPosition);
+
+						if (m_Overwrite && cindex < (int)line->size())
+						{
+							auto c = (*line)[cindex].Character;
+
+							if (c == '\t')
+								width = advances.GetTabStop(cx) - cx;
+							else
+								width = advances.Get(line->GetChars() + cindex, std::min<int>(UTF8CharLength(c), (int)line->size() - cindex));
+						}
+
+						ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
+						ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + m_CharAdvance.y);
+						drawList->AddRectFilled(cstart, cend, m_Palette[(int)PaletteIndex::Cursor]);
+
+						if (elapsed > 800)
+							m_StartTime = curTime;
+					}
+				}
+			}
+
+			// highlight the user defined lines
+			if (m_HighlightLine)
+			{
+				if (std::find(m_HighlightedLines.begin(), m_HighlightedLines.end(), lineNo) != m_HighlightedLines.end())
+				{
+					auto end = ImVec2(start.x + contentSize.x + scrollX, start.y + m_CharAdvance.y);
+					drawList->AddRectFilled(start, end, m_Palette[(int)(PaletteIndex::CurrentLineFill)]);
+				}
+			}
+
+			// text
+			if (!lineFolded)
+			{
+				auto& layout = GetLineLayout(lineNo);
+				const char* chars = (const char*)line->GetChars();
+
+				// highlight brackets
+				if (highlightBrackets)
+				{
+					for (auto& coord : { highlightBracketCoord, highlightBracketCursor })
+					{
+						if (coord.Line != lineNo || coord.Column < 0 || coord.Column >= (int)line->size())
+							continue;
+
+						// brackets are never whitespace, so the glyph is inside one of the runs
+						auto run = std::upper_bound(layout.Runs.begin(), layout.Runs.end(), (uint32_t)coord.Column, [](uint32_t index, const LineLayout::Run& r) { return index < r.End; });
+
+						if (run == layout.Runs.end() || run->Begin > (uint32_t)coord.Column)
+							continue;
+
+						float x = run->X + advances.Measure(line->GetChars() + run->Begin, line->GetChars() + coord.Column);
+						const ImVec2 p1(textScreenPos.x + x, textScreenPos.y);
+						const ImVec2 p2(textScreenPos.x + x + ImGui::GetFont()->GetCharAdvance(line->GetChar(coord.Column)), textScreenPos.y + ImGui::GetFontSize());
+						drawList->AddRectFilled(p1, p2, m_Palette[(int)PaletteIndex::Selection]);
+					}
+				}
+
+				// only the runs that reach into the window
+				auto runBegin = std::lower_bound(layout.Runs.begin(), layout.Runs.end(), clipLeft, [](const LineLayout::Run& r, float x) { return r.X + r.Width < x; });
+				auto runEnd = std::lower_bound(runBegin, layout.Runs.end(), clipRight, [](const LineLayout::Run& r, float x) { return r.X < x; });
+				auto offsets = runBegin != runEnd ? GetLineOffsets(lineNo) : nullptr;
+
+				for (auto run = runBegin; run != runEnd; ++run)
+				{
+					uint32_t begin = run->Begin, end = run->End;
+					float x = run->X;
+
+					// a long run is cut down to the characters inside the window too
+					if (offsets != nullptr && (run->X < clipLeft || run->X + run->Width > clipRight))
+					{
+						const float* xs = offsets->X.data();
+						const float base = xs[run->Begin] - run->X;
+
+						if (run->X < clipLeft)
+						{
+							begin = (uint32_t)(std::upper_bound(xs + run->Begin, xs + run->End, base + clipLeft) - xs);
+							begin = std::max(run->Begin, begin - 1);
+							while (begin > run->Begin && (chars[begin] & 0xC0) == 0x80)
+								begin--;
+							x = xs[begin] - base;
+						}
+
+						if (run->X + run->Width > clipRight)
+							end = (uint32_t)(std::lower_bound(xs + begin, xs + run->End, base + clipRight) - xs);
+					}
+
+					drawList->AddText(ImVec2(textScreenPos.x + x, textScreenPos.y), run->Color, chars + begin, chars + end);
+				}
+
+				if (m_ShowWhitespaces)
+				{
+					const auto s = ImGui::GetFontSize();
+					const auto y = textScreenPos.y + s * 0.5f;
+					auto tabBegin = std::lower_bound(layout.Tabs.begin(), layout.Tabs.end(), clipLeft, [](const ImVec2& t, float x) { return t.y < x; });
+					auto tabEnd = std::lower_bound(tabBegin, layout.Tabs.end(), clipRight, [](const ImVec2& t, float x) { return t.x < x; });
+
+					for (auto tab = tabBegin; tab != tabEnd; ++tab)
+					{
+						const auto x1 = textScreenPos.x + tab->x + 1.0f;
+						const auto x2 = textScreenPos.x + tab->y - 1.0f;
+						const ImVec2 p1(x1, y);
+						const ImVec2 p2(x2, y);
+						const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
+						const ImVec2 p4(x2 - s * 0.2f, y + s * 0.2f);
+						drawList->AddLine(p1, p2, 0x90909090);
+						drawList->AddLine(p2, p3, 0x90909090);
+						drawList->AddLine(p2, p4, 0x90909090);
+					}
+
+					auto spaceBegin = std::lower_bound(layout.Spaces.begin(), layout.Spaces.end(), clipLeft - spaceSize);
+					auto spaceEnd = std::lower_bound(spaceBegin, layout.Spaces.end(), clipRight);
+
+					for (auto x = spaceBegin; x != spaceEnd; ++x)
+						drawList->AddCircleFilled(ImVec2(textScreenPos.x + *x + spaceSize * 0.5f, y), 1.5f, 0x80808080, 4);
+				}
+			}
+			else
+			{
+				// a folded line continues with the end of the fold, draw it glyph by glyph
+				auto prevColor = line->empty() ? m_Palette[(int)PaletteIndex::Default] : GetGlyphColor((*line)[0]);
+				ImVec2 bufferOffset;
+			
+				for (int i = 0; i < line->size();)
+				{
+					auto glyph = (*line)[i];
+					auto color = GetGlyphColor(glyph);
+
+					if ((color != prevColor || glyph.Character == '\t' || glyph.Character == ' ') && !m_LineBuffer.empty())
+					{
+						const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
+						drawList->AddText(newOffset, prevColor, m_LineBuffer.c_str());
+						auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, m_LineBuffer.c_str(), nullptr, nullptr);
+						bufferOffset.x += textSize.x;
+						m_LineBuffer.clear();
+					}
+
+					prevColor = color;
+
+					// highlight brackets
+					if (highlightBrackets)
+					{
+						if ((lineNo == highlightBracketCoord.Line && i == highlightBracketCoord.Column) || (lineNo == highlightBracketCursor.Line && i == highlightBracketCursor.Column))
+						{
+							const ImVec2 p1(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
+							const ImVec2 p2(textScreenPos.x + bufferOffset.x + ImGui::GetFont()->GetCharAdvance(m_Lines[highlightBracketCoord.Line][highlightBracketCoord.Column].Character), textScreenPos.y + bufferOffset.y + ImGui::GetFontSize());
+							drawList->AddRectFilled(p1, p2, m_Palette[(int)PaletteIndex::Selection]);
+						}
+					}
+
+					// tab, space, etc...
+					if (glyph.Character == '\t')
+					{
+						auto oldX = bufferOffset.x;
+						bufferOffset.x = advances.GetTabStop(bufferOffset.x);
+						++i;
+
+						if (m_ShowWhitespaces)
+						{
+							const auto s = ImGui::GetFontSize();
+							const auto x1 = textScreenPos.x + oldX + 1.0f;
+							const auto x2 = textScreenPos.x + bufferOffset.x - 1.0f;
+							const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+							const ImVec2 p1(x1, y);
+							const ImVec2 p2(x2, y);
+							const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
+							const ImVec2 p4(x2 - s * 0.2f, y + s * 0.2f);
+							drawList->AddLine(p1, p2, 0x90909090);
+							drawList->AddLine(p2, p3, 0x90909090);
+							drawList->AddLine(p2, p4, 0x90909090);
+						}
+					}
+					else if (glyph.Character == ' ')
+					{
+						if (m_ShowWhitespaces)
+						{
+							const auto s = ImGui::GetFontSize();
+							const auto x = textScreenPos.x + bufferOffset.x + spaceSize * 0.5f;
+							const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+							drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
+						}
+
+						bufferOffset.x += spaceSize;
+						i++;
+					}
+					else
+					{
+						auto l = UTF8CharLength(glyph.Character);
+					
+						while (l-- > 0)
+							m_LineBuffer.push_back((*line)[i++].Character);
+					}
+
+					// skip if folded
+					if (lineFolded && lineFoldStartCIndex == i - 1)
+					{
+						i = GetCharacterIndex(lineFoldEnd);
+						lineNew = lineFoldEnd.Line;
+						line = &m_Lines[lineNew];
+						lineFolded = false;
+
+						if (!m_LineBuffer.empty())
+						{
+							// render the actual text
+							const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
+							auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, m_LineBuffer.c_str(), nullptr, nullptr);
+							drawList->AddText(newOffset, prevColor, m_LineBuffer.c_str());
+							m_LineBuffer.clear();
+							bufferOffset.x += textSize.x;
+
+							// render the [...] when folded
+							const ImVec2 offsetFoldBox(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
+							drawList->AddText(offsetFoldBox, m_Palette[(int)PaletteIndex::Default], " ... ");
+							textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ... ", nullptr, nullptr);
+							drawList->AddRect(ImVec2(textScreenPos.x + bufferOffset.x + m_CharAdvance.x / 2.0f, textScreenPos.y + bufferOffset.y),
+											  ImVec2(textScreenPos.x + bufferOffset.x + textSize.x - m_CharAdvance.x / 2.0f, textScreenPos.y + bufferOffset.y + m_CharAdvance.y),
+											  m_Palette[(int)PaletteIndex::Default]);
+							bufferOffset.x += textSize.x;
+						}
+					}
+
+				}
+
+				if (!m_LineBuffer.empty())
+				{
+					const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
+					drawList->AddText(newOffset, prevColor, m_LineBuffer.c_str());
+					m_LineBuffer.clear();
+				}
+			}
+
+			// side bar
+			if (m_Sidebar)
+			{
+				drawList->AddRectFilled(ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y), ImVec2(lineStartScreenPos.x + scrollX + m_TextStart - 5.0f, lineStartScreenPos.y + m_CharAdvance.y), ImGui::GetColorU32(ImGuiCol_WindowBg));
+
+				// Draw breakpoints
+				if (HasBreakpoint(lineNo + 1) != 0)
+				{
+					float radius = ImGui::GetFontSize() * 1.0f / 3.0f;
+					float startX = lineStartScreenPos.x + scrollX + radius + 2.0f;
+					float startY = lineStartScreenPos.y + radius + 4.0f;
+
+					drawList->AddCircle(ImVec2(startX, startY), radius + 1, m_Palette[(int)PaletteIndex::BreakpointOutline]);
+					drawList->AddCircleFilled(ImVec2(startX, startY), radius, m_Palette[(int)PaletteIndex::Breakpoint]);
+
+					Breakpoint bkpt = GetBreakpoint(lineNo + 1);
+
+					if (!bkpt.Enabled)
+					{
+						drawList->AddCircleFilled(ImVec2(startX, startY), radius - 1, m_Palette[(int)PaletteIndex::BreakpointDisabled]);
+					}
+					else
+					{
+						if (bkpt.UseCondition)
+							drawList->AddRectFilled(ImVec2(startX - radius + 3, startY - radius / 4), ImVec2(startX + radius - 3, startY + radius / 4), m_Palette[(int)PaletteIndex::BreakpointOutline]);
+					}
+				}
+
+				// Draw current line indicator
+				if (lineNo + 1 == m_DebugCurrentLine)
+				{
+					float radius = ImGui::GetFontSize() * 1.0f / 3.0f;
+					float startX = lineStartScreenPos.x + scrollX + radius + 2.0f;
+					float startY = lineStartScreenPos.y + 4.0f;
+
+					// outline
+					drawList->AddRect(ImVec2(startX - radius, startY + radius / 2), ImVec2(startX, startY + radius * 3.0f / 2.0f),
+						m_Palette[(int)PaletteIndex::CurrentLineIndicatorOutline]);
+					drawList->AddTriangle(ImVec2(startX - 1, startY - 2), ImVec2(startX - 1, startY + radius * 2 + 1), ImVec2(startX + radius, startY + radius),
+						m_Palette[(int)PaletteIndex::CurrentLineIndicatorOutline]);
+
+					// fill
+					drawList->AddRectFilled(ImVec2(startX - radius + 1, startY + 1 + radius / 2), ImVec2(startX + 1, startY - 1 + radius * 3.0f / 2.0f),
+						m_Palette[(int)PaletteIndex::CurrentLineIndicator]);
+					drawList->AddTriangleFilled(ImVec2(startX, startY + 1), ImVec2(startX, startY - 1 + radius * 2), ImVec2(startX - 1 + radius, startY + radius),
+						m_Palette[(int)PaletteIndex::CurrentLineIndicator]);
+				}
+
+				// Draw line number (right aligned)
+				if (m_ShowLineNumbers)
+				{
+					snprintf(buf, 16, "%3d  ", lineNo + 1);
+
+					auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x;
+					drawList->AddText(ImVec2(lineStartScreenPos.x + scrollX + m_TextStart - lineNoWidth, lineStartScreenPos.y), m_Palette[(int)PaletteIndex::LineNumber], buf);
+				}
+
+				// fold +/- icon
+				if (m_FoldEnabled)
+				{
+					float foldBtnSize = spaceSize;
+					float foldStartX = lineStartScreenPos.x + scrollX + m_TextStart - spaceSize * 2.0f + 4;
+					float foldStartY = lineStartScreenPos.y + (ImGui::GetFontSize() - foldBtnSize) / 2.0f;
+
+					// current weight + whether another "fold" starts or ends here
+					int foldBrace = GetFoldBrace(lineNo);
+					int foldWeight = m_Brackets.GetDepth(lineNo, BracketIndex::Curly);
+					bool hasFold = foldBrace != -1;
+					bool hasFoldEnd = foldWeight > 0 && BracketIndex::Summarize(m_Lines[lineNo]).Close[BracketIndex::Curly] > 0;
+					bool isFolded = hasFold && m_Lines[lineNo].IsFolded(foldBrace);
+
+					bool isHovered = (hoverFoldWeight && foldWeight >= hoverFoldWeight);
+
+					// line
+					if (foldWeight > 0 && !hasFold)
+					{
+						ImVec2 p1(foldStartX + foldBtnSize / 2, lineStartScreenPos.y);
+						ImVec2 p2(p1.x, p1.y + m_CharAdvance.y + 1.0f);
+
+						drawList->AddLine(p1, p2, m_Palette[(int)PaletteIndex::Default]);
+					}
+
+					if (hasFold) // render the +/- box
+					{
+						ImVec2 fmin(foldStartX, foldStartY + 2);
+						ImVec2 fmax(fmin.x + foldBtnSize, fmin.y + foldBtnSize);
+
+						// line up
+						if (foldWeight > 0)
+						{
+							ImVec2 p1(foldStartX + foldBtnSize / 2, lineStartScreenPos.y);
+							ImVec2 p2(p1.x, fmin.y);
+							drawList->AddLine(p1, p2, m_Palette[(int)PaletteIndex::Default]);
+						}
+
+						// fold button
+						foldWeight++;
+						drawList->AddRect(fmin, fmax, m_Palette[(int)PaletteIndex::Default]);
+
+						// check if mouse is over this fold button
+						ImVec2 mpos = ImGui::GetMousePos();
+						if (mpos.x >= fmin.x && mpos.x <= fmax.x && mpos.y >= fmin.y && mpos.y <= fmax.y)
+						{
+							isHovered = true;
+							hoverFoldWeight = foldWeight;
+
+							if (isFolded)
+								hoverFoldWeight = 0;
+
+							ImGui::SetMouseCursor(ImGuiMouseCursor_Arrow);
+
+							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+							{
+								int endLine, endIndex;
+								isFolded = !isFolded;
+								m_Lines[lineNo].SetFolded(foldBrace, isFolded);
+								m_Brackets.Invalidate(lineNo, lineNo + 1);
+								InvalidateRenderCache();
+
+								if (FindMatchingBracket(lineNo, foldBrace, endLine, endIndex))
+									m_FoldIndex.SetFolded({ lineNo, endLine }, isFolded);
+							}
+						}
+
+						// minus
+						drawList->AddLine(ImVec2(fmin.x + 3, (fmin.y + fmax.y) / 2.0f), ImVec2(fmax.x - 4, (fmin.y + fmax.y) / 2.0f), m_Palette[(int)PaletteIndex::Default]);
+
+						// plus
+						if (isFolded)
+							drawList->AddLine(ImVec2((fmin.x + fmax.x) / 2.0f, fmin.y + 3), ImVec2((fmin.x + fmax.x) / 2.0f, fmax.y - 4), m_Palette[(int)PaletteIndex::Default]);
+
+						// line down
+						if (!isFolded || foldWeight > 1)
+						{
+							float lineContinueY = (lineStartScreenPos.y + m_CharAdvance.y) - fmax.y;
+							ImVec2 p1(foldStartX + foldBtnSize / 2, fmax.y);
+							ImVec2 p2(p1.x, fmax.y + lineContinueY);
+							drawList->AddLine(p1, p2, m_Palette[(int)PaletteIndex::Default]);
+						}
+					}
+					else if (hasFoldEnd) // horizontal line
+					{
+						foldWeight--;
+						if (hoverFoldWeight && foldWeight < hoverFoldWeight)
+							hoverFoldWeight = 0;
+
+						ImVec2 p1(foldStartX + foldBtnSize / 2, lineStartScreenPos.y + m_CharAdvance.y - 1.0f);
+						ImVec2 p2(p1.x + m_CharAdvance.x / 2.0f, p1.y);
+						drawList->AddLine(p1, p2, m_Palette[(int)PaletteIndex::Default]);
+					}
+
+					// hover background
+					if (isHovered)
+					{
+						hoverDrawn = true;
+
+						// sidebar bg
+						ImVec2 pmin(foldStartX - 4, lineStartScreenPos.y);
+						ImVec2 pmax(pmin.x + foldBtnSize + 8, pmin.y + m_CharAdvance.y);
+						drawList->AddRectFilled(pmin, pmax, 0x40000000 | (0x00FFFFFF & m_Palette[(int)PaletteIndex::Default]));
+
+						// line bg
+						pmin.x = pmax.x;
+						pmax.x = lineStartScreenPos.x + scrollX + m_TextStart + contentSize.x;
+						drawList->AddRectFilled(pmin, pmax, 0x20000000 | (0x00FFFFFF & m_Palette[(int)PaletteIndex::Default]));
+					}
+				}
+			}
+
+			if (m_FoldEnabled)
+			{
+				// next visible line, skipping whatever a fold hides
+				int row = lineNo - linesFolded + 1;
+				lineNo = m_FoldIndex.RowToLine(row);
+				linesFolded = lineNo - row;
+			}
+			else
+			{
+				++lineNo;
+			}
+		}
+
+		if (!replayed)
+		{
+			m_RenderStats.FramesRendered++;
+
+			// only keep frames that went into the current draw command and whose indices fit in ImDrawIdx
+			bool fits = sizeof(ImDrawIdx) >= 4 || drawList->_VtxCurrentIdx < (1u << (8 * sizeof(ImDrawIdx)));
+
+			if (m_RenderCacheEnabled && !hoverDrawn && fits && drawList->CmdBuffer.Size == cmdCount && drawList->_VtxCurrentIdx - vtxBase == (unsigned int)(drawList->VtxBuffer.Size - vtxStart))
+			{
+				m_RenderCache.Vertices.assign(drawList->VtxBuffer.Data + vtxStart, drawList->VtxBuffer.Data + drawList->VtxBuffer.Size);
+				m_RenderCache.Indices.resize(drawList->IdxBuffer.Size - idxStart);
+
+				for (size_t i = 0; i < m_RenderCache.Indices.size(); i++)
+					m_RenderCache.Indices[i] = (ImDrawIdx)(drawList->IdxBuffer.Data[idxStart + i] - vtxBase);
+
+				m_RenderCache.Hash = renderHash;
+				m_RenderCache.VisibleLineBegin = m_VisibleLineBegin;
+				m_RenderCache.VisibleLineEnd = m_VisibleLineEnd;
+				m_RenderCache.CursorDrawn = cursorDrawn;
+				m_RenderCache.Valid = true;
+			}
+		}
+
+		// Draw a tooltip on known identifiers/preprocessor symbols
+		if (ImGui::IsMousePosValid() && (IsDebugging() || m_FuncTooltips || ImGui::GetIO().KeyCtrl))
+		{
+			Coordinates hoverPosition = MousePosToCoordinates(ImGui::GetMousePos());
+			
+			if (hoverPosition != m_LastHoverPosition)
+			{
+				m_LastHoverPosition = hoverPosition;
+				m_LastHoverTime = std::chrono::steady_clock::now();
+			}
+			
+			td_Char hoverChar = 0;
+
+			if (hoverPosition.Line < m_Lines.size() && hoverPosition.Column < m_Lines[hoverPosition.Line].size())
+				hoverChar = m_Lines[hoverPosition.Line][hoverPosition.Column].Character;
+
+			double hoverTime = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - m_LastHoverTime).count();
+			
+			if (hoverTime > 0.5 && (hoverChar == '(' || hoverChar == ')') && IsDebugging())
+			{
+				std::string expr = "";
+
+				int colStart = 0, rowStart = hoverPosition.Line;
+				int bracketMatch = 0;
+
+				if (hoverChar == ')')
+				{
+					int colIndex = hoverPosition.Column;
+
+					for (; rowStart >= 0; rowStart--)
+					{
+						for (int i = colIndex; i >= 0; i--)
+						{
+							char curChar = m_Lines[rowStart][i].Character;
+
+							if (curChar == '(')
+								bracketMatch++;
+							else if (curChar == ')')
+								bracketMatch--;
+
+							if (!isspace(curChar) || curChar == ' ')
+								expr += curChar;
+
+							if (bracketMatch == 0)
+							{
+								colStart = i - 1;
+								break;
+							}
+						}
+
+						if (bracketMatch == 0)
+							break;
+
+						if (rowStart != 0)
+							colIndex = m_Lines[rowStart - 1].size() - 1;
+					}
+					std::reverse(expr.begin(), expr.end());
+
+					if (rowStart <= 0)
+						colStart = -1;
+
+				}
+				else if (hoverChar == '(')
+				{
+					int colIndex = hoverPosition.Column;
+					colStart = hoverPosition.Column - 1;
+
+					for (int j = rowStart; j < m_Lines.size(); j++)
+					{
+						for (int i = colIndex; i < m_Lines[j].size(); i++)
+						{
+							char curChar = m_Lines[j][i].Character;
+
+							if (curChar == '(')
+								bracketMatch++;
+							else if (curChar == ')')
+								bracketMatch--;
+
+							if (!isspace(curChar) || curChar == ' ')
+								expr += curChar;
+
+							if (bracketMatch == 0)
+								break;
+						}
+
+						if (bracketMatch == 0)
+							break;
+						if (j != 0)
+							colIndex = 0;
+					}
+
+					if (rowStart >= m_Lines.size())
+						colStart = -1;
+				}
+
+				while (colStart >= 0 && isalnum(m_Lines[rowStart][colStart].Character))
+				{
+					expr.insert(expr.begin(), m_Lines[rowStart][colStart].Character);
+					colStart--;
+				}
+
+				if (OnExpressionHover && HasExpressionHover)
+				{
+					if (HasExpressionHover(this, expr))
 					{
-						do
+						ImGui::BeginTooltip();
+						OnExpressionHover(this, expr);
+						ImGui::EndTooltip();
+					}
+				}
+			}
+			else if (hoverTime > 0.2)
+			{
+				Coordinates wordCoords = ScreenPosToCoordinates(ImGui::GetMousePos());
+				auto id = GetWordAt(wordCoords);
+				bool isCtrlDown = ImGui::GetIO().KeyCtrl;
+
+				if (!id.empty())
+				{
+					// function/value tooltips
+					if (!isCtrlDown)
+					{
+						auto it = m_LanguageDefinition.Identifiers.find(id);
+
+						if (it != m_LanguageDefinition.Identifiers.end() && m_FuncTooltips)
 						{
-							m_SnippetTagSelected++;
-							if (m_SnippetTagSelected >= m_SnippetTagStart.size())
-								m_SnippetTagSelected = 0;
+							ImGui::BeginTooltip();
+							ImGui::TextUnformatted(it->second.Declaration.c_str());
+							ImGui::EndTooltip();
 						}
-						while (!m_SnippetTagHighlight[m_SnippetTagSelected]);
+						else
+						{
+							auto pi = m_LanguageDefinition.PreprocIdentifiers.find(id);
+
+							if (pi != m_LanguageDefinition.PreprocIdentifiers.end() && m_FuncTooltips)
+							{
+								ImGui::BeginTooltip();
+								ImGui::TextUnformatted(pi->second.Declaration.c_str());
+								ImGui::EndTooltip();
+							}
+							else if (IsDebugging() && OnIdentifierHover && HasIdentifierHover)
+							{
+								if (HasIdentifierHover(this, id))
+								{
+									ImGui::BeginTooltip();
+									OnIdentifierHover(this, id);
+									ImGui::EndTooltip();
+								}
+							}
+						}
+					}
+					else // CTRL + click functionality
+					{
+						bool hasUnderline = false;
+						bool isHeader = false;
+						bool isFindFirst = false;
+						Coordinates findStart(0, 0);
+						std::string header = "";
+						Coordinates wordStart = FindWordStart(wordCoords);
+						Coordinates wordEnd = FindWordEnd(wordCoords);
+
+						// check if header
+						if (wordStart.Line >= 0 && wordStart.Line < m_Lines.size())
+						{
+							// get the contents of the line in std::string
+							const auto& line = m_Lines[wordStart.Line];
+							std::string text;
+							text.resize(line.size());
+
+							for (size_t i = 0; i < line.size(); ++i)
+								text[i] = line[i].Character;
+
+							// find #include
+							size_t includeLoc = text.find("#include");
+							size_t includeStart = std::string::npos, includeEnd = std::string::npos;
+							
+							if (text.size() > 0 && includeLoc != std::string::npos)
+							{
+								for (size_t f = includeLoc; f < text.size(); f++)
+								{
+									if (text[f] == '<' || text[f] == '\"')
+									{
+										includeStart = f + 1;
+									}
+									else if (text[f] == '>' || text[f] == '\"')
+									{
+										includeEnd = f - 1;
+										break;
+									}
+								}
+							}
+
+							if (includeStart != std::string::npos && includeEnd != std::string::npos)
+							{
+								hasUnderline = true;
+								isHeader = true;
+								
+								header = text.substr(includeStart, includeEnd-includeStart + 1);
+								wordStart.Column = 0;
+								wordEnd.Column = GetCharacterColumn(wordEnd.Line, line.size());
+							}
+						}
+
+						// check if mul, sin, cos, etc...
+						if (!hasUnderline && m_LanguageDefinition.Identifiers.find(id) != m_LanguageDefinition.Identifiers.end())
+							hasUnderline = true;
+
+						// draw the underline
+						if (hasUnderline)
+						{
+							ImVec2 ulinePos = ImVec2(cursorScreenPos.x + m_TextStart, cursorScreenPos.y + wordStart.Line * m_CharAdvance.y);
+							drawList->AddLine(ImVec2(ulinePos.x + wordStart.Column * m_CharAdvance.x, ulinePos.y + m_CharAdvance.y),
+								ImVec2(ulinePos.x + wordEnd.Column * m_CharAdvance.x, ulinePos.y + m_CharAdvance.y),
+								ImGui::GetColorU32(ImGuiCol_HeaderHovered));
+							ImGui::SetMouseCursor(ImGuiMouseCursor_Arrow);
+
+							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+							{
+								if (isHeader)
+								{
+									if (RequestOpen)
+										RequestOpen(this, this->m_Path, header);
+								}
+								else
+								{
+									// go to type definition
+									if (isFindFirst)
+									{
+										if (!ImGui::GetIO().KeyAlt)
+										{
+											Coordinates userTypeLoc = FindFirst(id, findStart);
+										
+											if (userTypeLoc.Line >= 0 && userTypeLoc.Line < m_Lines.size())
+											{
+												m_State.CursorPosition = userTypeLoc;
+												SetSelectionStart(userTypeLoc);
+												SetSelectionEnd(FindWordEnd(userTypeLoc));
+												EnsureCursorVisible();
+											}
+										}
+										else
+										{
+											if (OnCtrlAltClick) 
+												this->OnCtrlAltClick(this, id, wordCoords);
+										}
+									}
+
+									// TODO: identifier documentation
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// function tooltip
+	if (m_FunctionDeclarationTooltip)
+	{
+		const float ttWidth = 350, ttHeight = 50;
+		ImVec2 ttPos = CoordinatesToScreenPos(m_FunctionDeclarationCoord);
+		ttPos.y += m_CharAdvance.y;
+		ttPos.x += ImGui::GetScrollX();
+
+		drawList->AddRectFilled(ttPos, ImVec2(ttPos.x + UICalculateSize(ttWidth), ttPos.y + UICalculateSize(ttHeight)), ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+		ImFont* font = ImGui::GetFont();
+		ImGui::PopFont();
+
+		ImGui::SetNextWindowPos(ttPos, ImGuiCond_Always);
+		ImGui::BeginChild("##texteditor_functooltip", ImVec2(UICalculateSize(ttWidth), UICalculateSize(ttHeight)), true);
+
+		ImGui::TextWrapped("%s", m_FunctionDeclaration.c_str());
+
+		ImGui::EndChild();
+
+		ImGui::PushFont(font);
+
+		ImGui::SetWindowFocus();
+
+		if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape)))
+			m_FunctionDeclarationTooltip = false;
+	}
+
+	// suggestions window
+	if (m_ACOpened)
+	{
+		auto acCoord = FindWordStart(m_ACPosition);
+		ImVec2 acPos = CoordinatesToScreenPos(acCoord);
+		acPos.y += m_CharAdvance.y;
+		acPos.x += ImGui::GetScrollX();
+
+		drawList->AddRectFilled(acPos, ImVec2(acPos.x + UICalculateSize(150), acPos.y + UICalculateSize(100)), ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+		ImFont* font = ImGui::GetFont();
+		ImGui::PopFont();
+
+		ImGui::SetNextWindowPos(acPos, ImGuiCond_Always);
+		ImGui::BeginChild("##texteditor_autocompl", ImVec2(UICalculateSize(150), UICalculateSize(100)), true);
+
+		for (int i = 0; i < m_ACSuggestions.size(); i++)
+		{
+			ImGui::Selectable(m_ACSuggestions[i].first.c_str(), i == m_ACIndex);
+			
+			if (i == m_ACIndex)
+				ImGui::SetScrollHereY();
+		}
+
+		ImGui::EndChild();
+
+		ImGui::PushFont(font);
+
+		ImGui::SetWindowFocus();
+
+		if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape)))
+		{
+			m_ACOpened = false;
+			m_ACObject = "";
+		}
+	}
+
+	// the widest line laid out so far, not just the visible ones
+	float longest = m_TextStart + m_LineWidths.GetMax();
+	ImGui::Dummy(ImVec2(longest + EditorCalculateSize(100), (m_Lines.size() - totalLinesFolded) * m_CharAdvance.y));
+
+	if (m_Follow && m_FollowPinned)
+		ImGui::SetScrollHereY(1.0f);
+
+	if (m_DebugCurrentLineUpdated)
+	{
+		float scrollX = ImGui::GetScrollX();
+		float scrollY = ImGui::GetScrollY();
+
+		auto height = ImGui::GetWindowHeight();
+		auto width = ImGui::GetWindowWidth();
+
+		auto top = 1 + (int)ceil(scrollY / m_CharAdvance.y);
+		auto bottom = (int)ceil((scrollY + height) / m_CharAdvance.y);
+
+		auto left = (int)ceil(scrollX / m_CharAdvance.x);
+		auto right = (int)ceil((scrollX + width) / m_CharAdvance.x);
+
+		ImTextEdit::Coordinates pos(m_DebugCurrentLine, 0);
+
+		if (pos.Line < top)
+			ImGui::SetScrollY(std::max(0.0f, (pos.Line - 1) * m_CharAdvance.y));
+
+		if (pos.Line > bottom - 4)
+			ImGui::SetScrollY(std::max(0.0f, (pos.Line + 4) * m_CharAdvance.y - height));
+
+		m_DebugCurrentLineUpdated = false;
+	}
+
+	if (m_ScrollToCursor)
+	{
+		EnsureCursorVisible();
+		ImGui::SetWindowFocus();
+		m_ScrollToCursor = false;
+	}
+	
+	// hacky way to get the bg working
+	if (m_FindOpened)
+	{
+		ImVec2 findPos = ImVec2(m_UICursorPos.x + scrollX + m_WindowWidth - UICalculateSize(250), m_UICursorPos.y + ImGui::GetScrollY() + UICalculateSize(50) * (IsDebugging() && m_DebugBar));
+		drawList->AddRectFilled(findPos, ImVec2(findPos.x + UICalculateSize(220), findPos.y + UICalculateSize(m_ReplaceOpened ? 90 : 40)), ImGui::GetColorU32(ImGuiCol_WindowBg));
+	}
 
-						m_SnippetTagLength = 0;
-						m_SnippetTagPreviousLength = m_SnippetTagEnd[m_SnippetTagSelected].Column - m_SnippetTagStart[m_SnippetTagSelected].Column;
+	if (IsDebugging() && m_DebugBar)
+	{
+		ImVec2 dbgPos = ImVec2(m_UICursorPos.x + scrollX + m_WindowWidth / 2 - m_DebugBarWidth / 2, m_UICursorPos.y + ImGui::GetScrollY());
+		drawList->AddRectFilled(dbgPos, ImVec2(dbgPos.x + m_DebugBarWidth, dbgPos.y + m_DebugBarHeight), ImGui::GetColorU32(ImGuiCol_FrameBg));
+	}
+}
 
-						SetSelection(m_SnippetTagStart[m_SnippetTagSelected], m_SnippetTagEnd[m_SnippetTagSelected]);
-						SetCursorPosition(m_SnippetTagEnd[m_SnippetTagSelected]);
-					}
-					else
-					{
-						EnterCharacter('\t', false);
-					}
-					break;
-				case ShortcutID::Unindent:
-					EnterCharacter('\t', true);
-					break;
-				case ShortcutID::Find:
-					m_FindOpened = m_HasSearch;
-					m_FindJustOpened = m_HasSearch;
-					m_ReplaceOpened = false;
-					break;
-				case ShortcutID::Replace:
-					m_FindOpened = m_HasSearch;
-					m_FindJustOpened = m_HasSearch;
-					m_ReplaceOpened = m_HasSearch;
-					break;
-				case ShortcutID::DebugStep:
-					if (OnDebuggerAction)
-						OnDebuggerAction(this, ImTextEdit::DebugAction::Step);
-					break;
-				case ShortcutID::DebugStepInto:
-					if (OnDebuggerAction)
-						OnDebuggerAction(this, ImTextEdit::DebugAction::StepInto);
-					break;
-				case ShortcutID::DebugStepOut:
-					if (OnDebuggerAction)
-						OnDebuggerAction(this, ImTextEdit::DebugAction::StepOut);
-					break;
-				case ShortcutID::DebugContinue:
-					if (OnDebuggerAction)
-						OnDebuggerAction(this, ImTextEdit::DebugAction::Continue);
-					break;
-				case ShortcutID::DebugStop:
-					if (OnDebuggerAction)
-						OnDebuggerAction(this, ImTextEdit::DebugAction::Stop);
-					break;
-				case ShortcutID::DebugJumpHere:
-					if (OnDebuggerJump)
-						OnDebuggerJump(this, GetCursorPosition().Line);
-					break;
-				case ShortcutID::DebugBreakpoint:
-					if (OnBreakpointUpdate)
-					{
-						int line = GetCursorPosition().Line + 1;
+void ImTextEdit::OpenFunctionDeclarationTooltip(const std::string& obj, ImTextEdit::Coordinates coord)
+{
+	if (m_ACFunctions.count(obj))
+	{
+		m_FunctionDeclarationTooltip = true;
+		m_FunctionDeclarationCoord = FindWordStart(coord);
+		m_FunctionDeclaration = BuildFunctionDef(obj, m_LanguageDefinition.Name);
+	}
+}
 
-						if (HasBreakpoint(line))
-							RemoveBreakpoint(line);
-						else AddBreakpoint(line);
-					}
-					break;
-				case ShortcutID::DuplicateLine:
-				{
-					/*ImTextEdit::UndoRecord undo;
-					undo.Before = m_State;
+std::string ImTextEdit::BuildFunctionDef(const std::string& func, const std::string& lang)
+{
+	if (m_ACFunctions.count(func) == 0)
+		return "";
 
-					auto oldLine = m_Lines[m_State.CursorPosition.Line];
-					auto& line = InsertLine(m_State.CursorPosition.Line, m_State.CursorPosition.Column);
+	const auto& funcDef = m_ACFunctions[func];
 
-					undo.Added += '\n';
+	std::string ret = BuildVariableType(funcDef.ReturnType, lang) + " " + func + "(";
 
-					for (auto& glyph : oldLine)
-					{
-						line.push_back(glyph);
-						undo.Added += glyph.Character;
-					}
-					
-					m_State.CursorPosition.Line++;
+	for (size_t i = 0; i < funcDef.Arguments.size(); i++)
+	{
+		ret += BuildVariableType(funcDef.Arguments[i], lang) + " " + funcDef.Arguments[i].Name;
 
-					undo.AddedStart = ImTextEdit::Coordinates(m_State.CursorPosition.Line - 1, m_State.CursorPosition.Column);
-					undo.AddedEnd = m_State.CursorPosition;
+		if (i != funcDef.Arguments.size() - 1)
+			ret += ", ";
+	}
 
-					undo.After = m_State;
+	return ret + ")";
+}
+std::string ImTextEdit::BuildVariableType(const ed::SPIRVParser::Variable& var, const std::string& lang)
+{
+	switch (var.Type)
+	{
+	case ed::SPIRVParser::ValueType::Bool:
+		return "bool";
+	case ed::SPIRVParser::ValueType::Float:
+		return "float";
+	case ed::SPIRVParser::ValueType::Int:
+		return "int";
+	case ed::SPIRVParser::ValueType::Void:
+		return "void";
+	case ed::SPIRVParser::ValueType::Struct:
+		return var.TypeName;
+	case ed::SPIRVParser::ValueType::Vector:
+	{
+		std::string count = std::string(1, var.TypeComponentCount + '0');
+		if (lang == "HLSL")
+		{
+			switch (var.BaseType)
+			{
+			case ed::SPIRVParser::ValueType::Bool:
+				return "bool" + count;
 
-					AddUndo(undo);*/
-					break;
-				}
-				case ShortcutID::CommentLines:
-				{
-					for (int l = m_State.SelectionStart.Line; l <= m_State.SelectionEnd.Line && l < m_Lines.size(); l++)
-					{
-						m_Lines[l].insert(m_Lines[l].begin(), ImTextEdit::Glyph('/', ImTextEdit::PaletteIndex::Comment));
-						m_Lines[l].insert(m_Lines[l].begin(), ImTextEdit::Glyph('/', ImTextEdit::PaletteIndex::Comment));
-					}
-				
-					Colorize(m_State.SelectionStart.Line, m_State.SelectionEnd.Line);
-					break;
-				}
-				case ShortcutID::UncommentLines:
-				{
-					for (int l = m_State.SelectionStart.Line; l <= m_State.SelectionEnd.Line && l < m_Lines.size(); l++)
-					{
-						if (m_Lines[l].size() >= 2)
-						{
-							if (m_Lines[l][0].Character == '/' && m_Lines[l][1].Character == '/')
-								m_Lines[l].erase(m_Lines[l].begin(), m_Lines[l].begin() + 2);
-						}
-					}
+			case ed::SPIRVParser::ValueType::Float:
+				return "float" + count;
 
-					Colorize(m_State.SelectionStart.Line, m_State.SelectionEnd.Line);
-					break;
-				}
+			case ed::SPIRVParser::ValueType::Int:
+				return "int" + count;
 			}
 		}
-		else if (!IsReadOnly())
+		else
 		{
-			for (int i = 0; i < io.InputQueueCharacters.Size; i++)
+			switch (var.BaseType)
 			{
-				auto c = (unsigned char)io.InputQueueCharacters[i];
+			case ed::SPIRVParser::ValueType::Bool:
+				return "bvec" + count;
 
-				if (c != 0 && (c == '\n' || c >= 32))
-				{
-					EnterCharacter((char)c, shift);
+			case ed::SPIRVParser::ValueType::Float:
+				return "vec" + count;
 
-					if (c == '.')
-						BuildMemberSuggestions(&keepACOpened);
+			case ed::SPIRVParser::ValueType::Int:
+				return "ivec" + count;
+			}
+		}
+		break;
+	}
 
-					if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
-						hasWrittenALetter = true;
+	case ed::SPIRVParser::ValueType::Matrix:
+	{
+		std::string count = std::string(1, var.TypeComponentCount + '0');
+		if (lang == "HLSL")
+			return "float" + count + "x" + count;
+		else
+			return "mat" + count;
 
-					if (m_IsSnippet)
-					{
-						m_SnippetTagLength++;
-						m_SnippetTagEnd[m_SnippetTagSelected].Column = m_SnippetTagStart[m_SnippetTagSelected].Column + m_SnippetTagLength;
-					
-						Coordinates curCursor = GetCursorPosition();
-						SetSelection(m_SnippetTagStart[m_SnippetTagSelected], m_SnippetTagEnd[m_SnippetTagSelected]);
-						std::string curWord = GetSelectedText();
-						std::unordered_map<int, int> modif;
-						modif[curCursor.Line] = 0;
+		break;
+	}
+	}
 
-						for (int j = 0; j < m_SnippetTagStart.size(); j++)
-						{
-							if (j != m_SnippetTagSelected)
-							{
-								m_SnippetTagStart[j].Column += modif[m_SnippetTagStart[j].Line];
-								m_SnippetTagEnd[j].Column += modif[m_SnippetTagStart[j].Line];
-							}
+	return "";
+}
 
-							if (m_SnippetTagID[j] == m_SnippetTagID[m_SnippetTagSelected])
-							{
-								modif[m_SnippetTagStart[j].Line] += m_SnippetTagLength - m_SnippetTagPreviousLength;
+void ImTextEdit::UpdateBrackets()
+{
+	// a line that opens or closes different braces now can move the end of a fold
+	if (m_Brackets.Update(m_Lines))
+		m_FoldIndexDirty = true;
+}
 
-								if (j != m_SnippetTagSelected)
-								{
-									SetSelection(m_SnippetTagStart[j], m_SnippetTagEnd[j]);
-									Backspace();
-									AppendText(curWord);
-									m_SnippetTagEnd[j].Column = m_SnippetTagStart[j].Column + m_SnippetTagLength;
-								}
-							}
-						}
+bool ImTextEdit::FindMatchingBracket(int aLine, int aIndex, int& aMatchLine, int& aMatchIndex)
+{
+	if (aLine < 0 || aLine >= (int)m_Lines.size())
+		return false;
 
-						SetSelection(curCursor, curCursor);
-						SetCursorPosition(curCursor);
-						EnsureCursorVisible();
-						m_SnippetTagPreviousLength = m_SnippetTagLength;
-					}
+	auto& line = m_Lines[aLine];
+	bool opening, other;
 
-					keyCount++;
-				}
-			}
-			io.InputQueueCharacters.resize(0);
+	if (aIndex < 0 || aIndex >= (int)line.size())
+		return false;
+
+	int kind = BracketIndex::GetBracket(line, aIndex, opening);
+	if (kind == -1)
+		return false;
+
+	UpdateBrackets();
+
+	// on the same line first, then the line that closes whatever is still open at its end (or opens
+	// whatever is still closed at its start) and on that line the right unmatched bracket
+	const int step = opening ? 1 : -1;
+	int pending = 0;
+
+	for (int i = aIndex; i >= 0 && i < (int)line.size(); i += step)
+	{
+		if (BracketIndex::GetBracket(line, i, other) != kind)
+			continue;
+
+		pending += (other == opening) ? 1 : -1;
+
+		if (pending == 0)
+		{
+			aMatchLine = aLine;
+			aMatchIndex = i;
+			return true;
 		}
+	}
+
+	int matchLine = opening ? m_Brackets.FindClose(aLine, kind, pending) : m_Brackets.FindOpen(aLine, kind, pending);
+	if (matchLine == -1)
+		return false;
+
+	auto& match = m_Lines[matchLine];
+	int depth = 0;
+
+	for (int i = opening ? 0 : (int)match.size() - 1; i >= 0 && i < (int)match.size(); i += step)
+	{
+		if (BracketIndex::GetBracket(match, i, other) != kind)
+			continue;
 
-		// active auto-complete
-		if (m_RequestAutocomplete && m_ReadyForAutocomplete && !m_IsSnippet)
+		if (other == opening)
+			depth++;
+		else if (depth > 0)
+			depth--;
+		else if (--pending == 0)
 		{
-			BuildSuggestions(&keepACOpened);
-			m_RequestAutocomplete = false;
-			m_ReadyForAutocomplete = false;
+			aMatchLine = matchLine;
+			aMatchIndex = i;
+			return true;
 		}
+	}
 
-		if ((m_ACOpened && !keepACOpened) || m_FunctionDeclarationTooltip)
-		{
-			for (size_t i = 0; i < ImGuiKey_COUNT; i++)
-				keyCount += ImGui::IsKeyPressed(ImGui::GetKeyIndex(i));
+	return false;
+}
 
-			if (keyCount != 0)
-			{
-				if (functionTooltipState == m_FunctionDeclarationTooltip)
-					m_FunctionDeclarationTooltip = false;
+bool ImTextEdit::FindMatchingBracket(const Coordinates& aFrom, Coordinates& aBracket, Coordinates& aMatch)
+{
+	// the bracket right before aFrom, or else the one right after it
+	if (aFrom.Line < 0 || aFrom.Line >= (int)m_Lines.size())
+		return false;
 
-				m_ACOpened = false;
+	int index = GetCharacterIndex(aFrom);
+	int matchLine, matchIndex;
 
-				if (!hasWrittenALetter)
-					m_ACObject = "";
-			}
+	for (int i : { index - 1, index })
+	{
+		if (FindMatchingBracket(aFrom.Line, i, matchLine, matchIndex))
+		{
+			aBracket = Coordinates(aFrom.Line, GetCharacterColumn(aFrom.Line, i));
+			aMatch = Coordinates(matchLine, GetCharacterColumn(matchLine, matchIndex));
+			return true;
 		}
 	}
+
+	return false;
 }
 
-void ImTextEdit::HandleMouseInputs()
+int ImTextEdit::GetFoldBrace(int aLine) const
 {
-	ImGuiIO& io = ImGui::GetIO();
-	auto shift = io.KeyShift;
-	auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
-	auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+	// the first opening brace still open at the end of the line, it is the last one opened at depth 0
+	auto& line = m_Lines[aLine];
+	int depth = 0;
+	int brace = -1;
 
-	if (ImGui::IsWindowHovered())
+	for (int i = 0; i < (int)line.size(); i++)
 	{
-		auto click = ImGui::IsMouseClicked(0);
-	
-		if ((!shift || (shift && click)) && !alt)
+		bool opening;
+		if (BracketIndex::GetBracket(line, i, opening) != BracketIndex::Curly)
+			continue;
+
+		if (opening)
 		{
-			auto doubleClick = ImGui::IsMouseDoubleClicked(0);
-			auto t = ImGui::GetTime();
-			auto tripleClick = click && !doubleClick && (m_LastClick != -1.0f && (t - m_LastClick) < io.MouseDoubleClickTime);
+			if (depth == 0)
+				brace = i;
+			depth++;
+		}
+		else if (depth > 0)
+			depth--;
+	}
 
-			if (click || doubleClick || tripleClick)
-			{
-				m_IsSnippet = false;
-				m_FunctionDeclarationTooltip = false;
-			}
+	return depth > 0 ? brace : -1;
+}
 
-			if (tripleClick) // Left mouse button triple click
-			{
-				if (!ctrl)
-				{
-					m_State.CursorPosition = m_InteractiveStart = m_InteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
-					m_SelectionMode = SelectionMode::Line;
-					SetSelection(m_InteractiveStart, m_InteractiveEnd, m_SelectionMode);
-				}
+void ImTextEdit::UpdateFoldIndex()
+{
+	UpdateBrackets();
 
-				m_LastClick = -1.0f;
-			}
-			else if (doubleClick) // Left mouse button double click
-			{
-				if (!ctrl)
-				{
-					m_State.CursorPosition = m_InteractiveStart = m_InteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
-					if (m_SelectionMode == SelectionMode::Line)
-						m_SelectionMode = SelectionMode::Normal;
-					else
-						m_SelectionMode = SelectionMode::Word;
-					SetSelection(m_InteractiveStart, m_InteractiveEnd, m_SelectionMode);
-					m_State.CursorPosition = m_State.SelectionEnd;
-				}
+	if (!m_FoldIndexDirty)
+		return;
 
-				m_LastClick = (float)ImGui::GetTime();
-			}
-			else if (click)  // Mouse button click
-			{
-				ImVec2 pos = ImGui::GetMousePos();
+	// only the first brace still open at the end of a line folds anything
+	std::vector<int> lines;
+	m_Brackets.GetFoldedLines(lines);
 
-				if (pos.x - m_UICursorPos.x < ImGui::GetStyle().WindowPadding.x + EditorCalculateSize(s_DebugDataSpace))
-				{
-					Coordinates lineInfo = ScreenPosToCoordinates(ImGui::GetMousePos());
-					lineInfo.Line += 1;
+	std::vector<FoldIndex::Fold> folds;
 
-					if (HasBreakpoint(lineInfo.Line))
-						RemoveBreakpoint(lineInfo.Line);
-					else
-						AddBreakpoint(lineInfo.Line);
-				}
-				else
-				{
-					m_ACOpened = false;
-					m_ACObject = "";
+	for (int line : lines)
+	{
+		int brace = GetFoldBrace(line);
+		int endLine, endIndex;
 
-					auto tcoords = ScreenPosToCoordinates(ImGui::GetMousePos());
-					
-					if (!shift)
-						m_InteractiveStart = tcoords;
-					
-					m_State.CursorPosition = m_InteractiveEnd = tcoords;
+		if (brace != -1 && m_Lines[line].IsFolded(brace) && FindMatchingBracket(line, brace, endLine, endIndex))
+			folds.push_back({ line, endLine });
+	}
 
-					if (ctrl && !shift)
-						m_SelectionMode = SelectionMode::Word;
-					else
-						m_SelectionMode = SelectionMode::Normal;
+	m_FoldIndex.Build((int)m_Lines.size(), folds);
+	m_FoldIndexDirty = false;
+}
 
-					SetSelection(m_InteractiveStart, m_InteractiveEnd, m_SelectionMode);
+void ImTextEdit::FoldIndex::Build(int aLineCount, const std::vector<Fold>& aFolds)
+{
+	m_LineCount = aLineCount;
+	m_HiddenCount = 0;
+	m_Cover.clear();
+	m_Tree.clear();
 
-					m_LastClick = (float)ImGui::GetTime();
-				}
-			}
-			else if (ImGui::IsMouseDragging(0) && ImGui::IsMouseDown(0)) // Mouse left button dragging (=> update selection)
-			{
-				io.WantCaptureMouse = true;
-				m_State.CursorPosition = m_InteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
-				SetSelection(m_InteractiveStart, m_InteractiveEnd, m_SelectionMode);
+	if (aFolds.empty())
+		return;
 
-				float mx = ImGui::GetMousePos().x;
+	// cover counts through a difference array, then the tree in one pass
+	m_Cover.assign(m_LineCount + 1, 0);
 
-				if (mx > m_FindOrigin.x + m_WindowWidth - 50 && mx < m_FindOrigin.x + m_WindowWidth)
-					ImGui::SetScrollX(ImGui::GetScrollX() + 1.0f);
-				else if (mx > m_FindOrigin.x && mx < m_FindOrigin.x + m_TextStart + 50)
-					ImGui::SetScrollX(ImGui::GetScrollX() - 1.0f);
-			}
+	for (auto& fold : aFolds)
+	{
+		if (fold.End <= fold.Begin || fold.Begin < 0 || fold.Begin >= m_LineCount)
+			continue;
+
+		m_Cover[fold.Begin + 1]++;
+		m_Cover[std::min(fold.End + 1, m_LineCount)]--;
+	}
 
+	m_Tree.assign(m_LineCount + 1, 0);
+
+	for (int i = 0, cover = 0; i < m_LineCount; i++)
+	{
+		cover += m_Cover[i];
+		m_Cover[i] = cover;
+
+		if (cover > 0)
+		{
+			m_Tree[i + 1]++;
+			m_HiddenCount++;
 		}
 	}
+
+	m_Cover.pop_back();
+
+	for (int i = 1; i <= m_LineCount; i++)
+	{
+		int parent = i + (i & -i);
+		if (parent <= m_LineCount)
+			m_Tree[parent] += m_Tree[i];
+	}
 }
 
-bool ImTextEdit::HasBreakpoint(int line)
+void ImTextEdit::FoldIndex::Cover(const Fold& aFold, int aDelta)
 {
-	for (const auto& bkpt : m_Breakpoints)
-		if (bkpt.Line == line)
-			return true;
+	if (aFold.End <= aFold.Begin || aFold.Begin < 0)
+		return;
 
-	return false;
+	if (m_Cover.empty())
+	{
+		m_Cover.assign(m_LineCount, 0);
+		m_Tree.assign(m_LineCount + 1, 0);
+	}
+
+	int last = std::min(aFold.End, m_LineCount - 1);
+
+	for (int line = aFold.Begin + 1; line <= last; line++)
+	{
+		bool wasHidden = m_Cover[line] > 0;
+		m_Cover[line] += aDelta;
+
+		if (wasHidden == (m_Cover[line] > 0))
+			continue;
+
+		// only lines that start or stop being hidden touch the tree
+		int delta = wasHidden ? -1 : 1;
+		m_HiddenCount += delta;
+
+		for (int i = line + 1; i <= m_LineCount; i += i & -i)
+			m_Tree[i] += delta;
+	}
 }
 
-void ImTextEdit::AddBreakpoint(int line, bool useCondition, std::string condition, bool enabled)
+int ImTextEdit::FoldIndex::HiddenBefore(int aLine) const
 {
-	RemoveBreakpoint(line);
+	if (m_Tree.empty())
+		return 0;
 
-	Breakpoint bkpt;
-	bkpt.Line = line;
-	bkpt.Condition = condition;
-	bkpt.Enabled = enabled;
-	bkpt.UseCondition = useCondition;
+	int count = 0;
+	for (int i = std::min(aLine, m_LineCount); i > 0; i -= i & -i)
+		count += m_Tree[i];
+	return count;
+}
 
-	if (OnBreakpointUpdate)
-		OnBreakpointUpdate(this, line, useCondition, condition, enabled);
+int ImTextEdit::FoldIndex::LineToRow(int aLine) const
+{
+	if (aLine >= m_LineCount)
+		return aLine - m_HiddenCount;
 
-	m_Breakpoints.push_back(bkpt);
+	// counting the line itself moves a hidden line onto the row of its fold
+	return aLine - HiddenBefore(aLine + 1);
 }
 
-void ImTextEdit::RemoveBreakpoint(int line)
+int ImTextEdit::FoldIndex::RowToLine(int aRow) const
 {
-	for (int i = 0; i < m_Breakpoints.size(); i++)
+	if (aRow < 0 || m_HiddenCount == 0)
+		return aRow;
+
+	if (aRow >= m_LineCount - m_HiddenCount)
+		return aRow + m_HiddenCount;
+
+	// the longest prefix with at most aRow visible lines ends right before the line we want
+	int step = 1;
+	while (step * 2 <= m_LineCount)
+		step *= 2;
+
+	int pos = 0;
+	int rest = aRow;
+
+	for (; step > 0; step /= 2)
 	{
-		if (m_Breakpoints[i].Line == line)
+		int next = pos + step;
+
+		if (next <= m_LineCount && step - m_Tree[next] <= rest)
 		{
-			m_Breakpoints.erase(m_Breakpoints.begin() + i);
-			break;
+			pos = next;
+			rest -= step - m_Tree[next];
 		}
 	}
 
-	if (OnBreakpointRemove)
-		OnBreakpointRemove(this, line);
+	return pos;
 }
 
-void ImTextEdit::SetBreakpointEnabled(int line, bool enable)
+int ImTextEdit::BracketIndex::GetBracket(const Line& aLine, size_t aIndex, bool& aOpening)
 {
-	for (int i = 0; i < m_Breakpoints.size(); i++)
+	int kind;
+
+	switch (aLine.GetChar(aIndex))
 	{
-		if (m_Breakpoints[i].Line == line)
-		{
-			m_Breakpoints[i].Enabled = enable;
-		
-			if (OnBreakpointUpdate)
-				OnBreakpointUpdate(this, line, m_Breakpoints[i].UseCondition, m_Breakpoints[i].Condition, enable);
-			
-			break;
-		}
+	case '(': kind = Paren; aOpening = true; break;
+	case ')': kind = Paren; aOpening = false; break;
+	case '[': kind = Square; aOpening = true; break;
+	case ']': kind = Square; aOpening = false; break;
+	case '{': kind = Curly; aOpening = true; break;
+	case '}': kind = Curly; aOpening = false; break;
+	default: return -1;
 	}
+
+	if (aLine.IsComment(aIndex) || aLine.IsMultiLineComment(aIndex))
+		return -1;
+
+	auto color = aLine.GetColor(aIndex);
+	if (color == PaletteIndex::String || color == PaletteIndex::CharLiteral || color == PaletteIndex::Comment || color == PaletteIndex::MultiLineComment)
+		return -1;
+
+	return kind;
 }
 
-ImTextEdit::Breakpoint& ImTextEdit::GetBreakpoint(int line)
+ImTextEdit::BracketIndex::Summary ImTextEdit::BracketIndex::Summarize(const Line& aLine)
 {
-	for (int i = 0; i < m_Breakpoints.size(); i++)
+	Summary summary;
+
+	for (size_t i = 0; i < aLine.size(); i++)
 	{
-		if (m_Breakpoints[i].Line == line)
-			return m_Breakpoints[i];
+		bool opening;
+		int kind = GetBracket(aLine, i, opening);
+
+		if (kind == -1)
+			continue;
+
+		if (opening)
+			summary.Open[kind]++;
+		else if (summary.Open[kind] > 0)
+			summary.Open[kind]--;
+		else
+			summary.Close[kind]++;
 	}
+
+	return summary;
 }
 
-void ImTextEdit::RenderInternal(const char* aTitle)
+ImTextEdit::BracketIndex::Summary ImTextEdit::BracketIndex::Combine(const Summary& aFirst, const Summary& aSecond)
 {
-	/* Compute m_CharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
-	const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
-	m_CharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * m_LineSpacing);
+	// the brackets left open by the first part close the ones the second part closes first
+	Summary summary;
 
-	/* Update palette with the current alpha from style */
-	for (int i = 0; i < (int)PaletteIndex::Max; ++i)
+	for (int k = 0; k < KindCount; k++)
 	{
-		auto color = ImGui::ColorConvertU32ToFloat4(m_PaletteBase[i]);
-		color.w *= ImGui::GetStyle().Alpha;
-		m_Palette[i] = ImGui::ColorConvertFloat4ToU32(color);
+		int matched = std::min(aFirst.Open[k], aSecond.Close[k]);
+		summary.Close[k] = aFirst.Close[k] + aSecond.Close[k] - matched;
+		summary.Open[k] = aFirst.Open[k] + aSecond.Open[k] - matched;
 	}
 
-	assert(m_LineBuffer.empty());
-	m_Focused = ImGui::IsWindowFocused() || m_FindFocused || m_ReplaceFocused;
+	return summary;
+}
 
-	auto contentSize = ImGui::GetWindowContentRegionMax();
-	auto drawList = ImGui::GetWindowDrawList();
-	float longest(m_TextStart);
+void ImTextEdit::BracketIndex::Reset(int aLineCount)
+{
+	m_Nodes.clear();
+	m_FreeNodes.clear();
+	m_Root = Build(aLineCount);
+}
 
-	if (m_ScrollToTop)
+void ImTextEdit::BracketIndex::ResetEmpty(int aLineCount)
+{
+	m_Nodes.clear();
+	m_FreeNodes.clear();
+	m_Root = Build(aLineCount, s_RunLines);
+}
+
+void ImTextEdit::BracketIndex::Insert(int aLine, int aCount)
+{
+	if (aCount <= 0)
+		return;
+
+	int left, right;
+	Split(m_Root, aLine, left, right);
+	m_Root = Merge(Merge(left, Build(aCount)), right);
+}
+
+void ImTextEdit::BracketIndex::Erase(int aStart, int aEnd)
+{
+	if (aStart >= aEnd)
+		return;
+
+	int left, middle, right;
+	Split(m_Root, aStart, left, right);
+	Split(right, aEnd - aStart, middle, right);
+	Free(middle);
+	m_Root = Merge(left, right);
+}
+
+void ImTextEdit::BracketIndex::Invalidate(int aStart, int aEnd)
+{
+	if (aStart >= aEnd)
+		return;
+
+	if (m_Root == -1 || !m_Nodes[m_Root].RunTotal)
 	{
-		m_ScrollToTop = false;
-		ImGui::SetScrollY(0.f);
+		Mark(m_Root, 0, aStart, aEnd);
+		return;
 	}
 
-	ImVec2 cursorScreenPos = m_UICursorPos = ImGui::GetCursorScreenPos();
-	auto scrollX = ImGui::GetScrollX();
-	auto scrollY = m_LastScroll = ImGui::GetScrollY();
+	// the lines of a run get a node each first, new nodes are summarized anyway
+	int left, middle, right;
+	Split(m_Root, aStart, left, right);
+	Split(right, aEnd - aStart, middle, right);
+
+	if (middle != -1 && m_Nodes[middle].RunTotal)
+	{
+		int count = m_Nodes[middle].Size;
+		Free(middle);
+		middle = Build(count);
+	}
+	else
+	{
+		Mark(middle, 0, 0, aEnd - aStart);
+	}
+
+	m_Root = Merge(Merge(left, middle), right);
+}
+
+void ImTextEdit::BracketIndex::Forget(int aStart, int aEnd)
+{
+	if (aStart >= aEnd)
+		return;
+
+	int left, middle, right;
+	Split(m_Root, aStart, left, right);
+	Split(right, aEnd - aStart, middle, right);
+	Free(middle);
+
+	m_Root = Merge(Merge(left, Build(aEnd - aStart, s_RunLines)), right);
+}
 
-	int pageSize = (int)floor((scrollY + contentSize.y) / m_CharAdvance.y);
-	auto lineNo = (int)floor(scrollY / m_CharAdvance.y);
-	auto globalLineMax = (int)m_Lines.size();
-	auto lineMax = std::max<int>(0, std::min<int>((int)m_Lines.size() - 1, lineNo + pageSize));
-	int totalLinesFolded = 0;
+bool ImTextEdit::BracketIndex::Update(const LineStore& aLines)
+{
+	// the lines were replaced without telling us, start over
+	if (GetLineCount() != (int)aLines.size())
+		Reset((int)aLines.size());
 
-	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
-	char buf[16];
-	snprintf(buf, 16, " %3d ", globalLineMax);
-	m_TextStart = (ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + m_LeftMargin) * m_Sidebar;
+	return Refresh(m_Root, 0, aLines);
+}
 
-	// render
-	GetPageSize();
-	if (!m_Lines.empty())
+int ImTextEdit::BracketIndex::GetDepth(int aLine, int aKind) const
+{
+	Summary before;
+	int node = m_Root;
+
+	while (node != -1)
 	{
-		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
-		
-		// find bracket pairs to highlight
-		bool highlightBrackets = false;
-		Coordinates highlightBracketCoord = m_State.CursorPosition, highlightBracketCursor = m_State.CursorPosition;
-		if (m_HighlightBrackets && m_State.SelectionStart == m_State.SelectionEnd)
+		auto& n = m_Nodes[node];
+		int leftSize = SizeOf(n.Left);
+
+		if (aLine <= leftSize)
 		{
-			if (m_State.CursorPosition.Line <= m_Lines.size())
-			{
-				int lineSize = m_Lines[m_State.CursorPosition.Line].size();
-				Coordinates start = GetCorrectCursorPosition();
-				start.Column = std::min<int>(start.Column, m_Lines[start.Line].size()-1);
-				highlightBracketCursor = start;
+			node = n.Left;
+			continue;
+		}
 
-				if (lineSize != 0 && start.Line >= 0 && start.Line < m_Lines.size() && start.Column >= 0 && start.Column < m_Lines[start.Line].size())
-				{
-					char c1 = m_Lines[start.Line][start.Column].Character;
-					char c2 = m_Lines[start.Line][std::max<int>(0, start.Column - 1)].Character;
-					int b1 = IsBracket(c1);
-					int b2 = IsBracket(c2);
+		if (n.Left != -1)
+			before = Combine(before, m_Nodes[n.Left].Total);
 
-					if (b1 || b2)
-					{
-						char search = c1;
-						int dir = b1;
-						
-						if (b2)
-						{
-							search = c2;
-							dir = b2;
-							start.Column = std::max<int>(0, start.Column - 1);
-							highlightBracketCursor = start;
-						}
+		// the lines of a run are empty
+		if (aLine < leftSize + n.Lines)
+			break;
 
-						int weight = 0;
+		before = Combine(before, n.Own);
+		aLine -= leftSize + n.Lines;
+		node = n.Right;
+	}
 
-						// go forward
-						if (dir == 1)
-						{
-							while (start.Line < m_Lines.size())
-							{
-								for (; start.Column < m_Lines[start.Line].size(); start.Column++)
-								{
-									char curChar = m_Lines[start.Line][start.Column].Character;
-								
-									if (curChar == search)
-									{
-										weight++;
-									}
-									else if (IsClosingBracket(search, curChar))
-									{
-										weight--;
-									
-										if (weight <= 0)
-										{
-											highlightBrackets = true;
-											highlightBracketCoord = start;
-											break;
-										}
-									}
-								}
-								
-								if (highlightBrackets)
-									break;
+	return before.Open[aKind];
+}
 
-								start.Line++;
-								start.Column = 0;
-							}
-						}
-						else // Go backwards
-						{
-							while (start.Line >= 0)
-							{
-								for (; start.Column >= 0; start.Column--)
-								{
-									char curChar = m_Lines[start.Line][start.Column].Character;
+int ImTextEdit::BracketIndex::FindClose(int aLine, int aKind, int& aOpen) const
+{
+	return aOpen > 0 ? FindClose(m_Root, 0, aLine + 1, aKind, aOpen) : -1;
+}
 
-									if (curChar == search)
-									{
-										weight++;
-									}
-									else if (IsOpeningBracket(search, curChar))
-									{
-										weight--;
+int ImTextEdit::BracketIndex::FindOpen(int aLine, int aKind, int& aClose) const
+{
+	return aClose > 0 ? FindOpen(m_Root, 0, aLine, aKind, aClose) : -1;
+}
 
-										if (weight <= 0)
-										{
-											highlightBrackets = true;
-											highlightBracketCoord = start;
-											break;
-										}
-									}
-								}
+void ImTextEdit::BracketIndex::GetFoldedLines(std::vector<int>& aLines) const
+{
+	GetFoldedLines(m_Root, 0, aLines);
+}
 
-								if (highlightBrackets)
-									break;
+int ImTextEdit::BracketIndex::NewNode()
+{
+	int node;
 
-								start.Line--;
+	if (!m_FreeNodes.empty())
+	{
+		node = m_FreeNodes.back();
+		m_FreeNodes.pop_back();
+	}
+	else
+	{
+		node = (int)m_Nodes.size();
+		m_Nodes.emplace_back();
+	}
 
-								if (start.Line >= 0)
-									start.Column = m_Lines[start.Line].size() - 1;
-							}
-						}
-					}
-				}
-			}
-		}
+	// xorshift, the shape only has to be random, not the numbers
+	m_Seed ^= m_Seed << 13;
+	m_Seed ^= m_Seed >> 17;
+	m_Seed ^= m_Seed << 5;
 
-		// fold info
-		int hoverFoldWeight = 0;
-		int linesFolded = 0;
-		uint64_t curTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-		
-		if (m_FoldEnabled)
-		{
-			if (curTime - m_FoldLastIteration > 3000)
-			{
-				// sort if needed
-				if (!m_FoldSorted)
-				{
-					std::sort(m_FoldBegin.begin(), m_FoldBegin.end());
-					std::sort(m_FoldEnd.begin(), m_FoldEnd.end());
-					m_FoldSorted = true;
-				}
+	auto& n = m_Nodes[node];
+	n.Left = n.Right = -1;
+	n.Lines = n.Size = 1;
+	n.Priority = m_Seed;
+	n.Own = n.Total = Summary();
+	n.Folded = n.FoldedTotal = 0;
+	n.Dirty = n.DirtyTotal = true;
+	n.RunTotal = false;
 
-				// resize if needed
-				if (m_Fold.size() != m_FoldBegin.size())
-				{
-					m_Fold.resize(m_FoldBegin.size(), false);
-					m_FoldConnection.resize(m_FoldBegin.size(), -1);
-				}
+	return node;
+}
 
-				// reconnect every fold BEGIN with END (TODO: any better way to do this?)
-				std::vector<bool> foldUsed(m_FoldEnd.size(), false);
-				for (int i = m_FoldBegin.size() - 1; i >= 0; i--)
-				{
-					int j = m_FoldEnd.size() - 1;
-					int lastUnused = j;
+int ImTextEdit::BracketIndex::Build(int aCount, int aRunLines)
+{
+	// a treap over aCount new lines in O(aCount): the right spine on a stack, every node is pushed once.
+	// With aRunLines > 1 every node is a run of that many empty lines instead
+	std::vector<int> spine;
 
-					for (; j >= 0; j--)
-					{
-						if (m_FoldEnd[j] < m_FoldBegin[i])
-							break;
+	for (int i = 0; i < aCount; i += aRunLines)
+	{
+		int node = NewNode();
 
-						if (!foldUsed[j])
-							lastUnused = j;
-					}
+		auto& n = m_Nodes[node];
+		n.Lines = std::min(aRunLines, aCount - i);
+		n.Dirty = n.DirtyTotal = aRunLines == 1;
 
-					if (lastUnused < m_FoldEnd.size())
-					{
-						foldUsed[lastUnused] = true;
-						m_FoldConnection[i] = lastUnused;
-					}
-				}
+		int last = -1;
+		while (!spine.empty() && m_Nodes[spine.back()].Priority < n.Priority)
+		{
+			last = spine.back();
+			spine.pop_back();
+		}
 
-				m_FoldLastIteration = curTime;
-			}
+		n.Left = last;
+		if (!spine.empty())
+			m_Nodes[spine.back()].Right = node;
 
-			auto foldLineStart = 0;
-			auto foldLineEnd = std::min<int>((int)m_Lines.size() - 1, lineNo);
-			
-			while (foldLineStart < m_Lines.size())
-			{
-				// check if line is folded
-				for (int i = 0; i < m_FoldBegin.size(); i++)
-				{
-					if (m_FoldBegin[i].Line == foldLineStart)
-					{
-						if (i < m_Fold.size() && m_Fold[i])
-						{
-							int foldCon = m_FoldConnection[i];
+		spine.push_back(node);
+	}
 
-							if (foldCon != -1 && foldCon < m_FoldEnd.size())
-							{
-								int diff = m_FoldEnd[foldCon].Line - m_FoldBegin[i].Line;
+	if (spine.empty())
+		return -1;
 
-								if (foldLineStart < foldLineEnd)
-								{
-									linesFolded += diff;
-									foldLineEnd = std::min<int>((int)m_Lines.size() - 1, foldLineEnd + diff);
-								}
+	// sizes bottom up, every node comes after its children in this order
+	std::vector<int> order;
+	order.push_back(spine.front());
 
-								totalLinesFolded += diff;
-							}
-							break;
-						}
-					}
-				}
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		auto& n = m_Nodes[order[i]];
+		if (n.Left != -1)
+			order.push_back(n.Left);
+		if (n.Right != -1)
+			order.push_back(n.Right);
+	}
 
-				foldLineStart++;
-			}
+	for (size_t i = order.size(); i-- > 0;)
+		Pull(order[i]);
 
-			lineNo += linesFolded;
-			lineMax = std::max<int>(0, std::min<int>((int)m_Lines.size() - 1, lineNo + pageSize));
-		}
+	return spine.front();
+}
 
-		// render
-		while (lineNo <= lineMax)
-		{
-			ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, cursorScreenPos.y + (lineNo - linesFolded) * m_CharAdvance.y);
-			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + m_TextStart, lineStartScreenPos.y);
+void ImTextEdit::BracketIndex::Free(int aNode)
+{
+	std::vector<int> stack;
+	if (aNode != -1)
+		stack.push_back(aNode);
 
-			auto* line = &m_Lines[lineNo];
-			longest = std::max(m_TextStart + TextDistanceToLineStart(Coordinates(lineNo, GetLineMaxColumn(lineNo))), longest);
-			Coordinates lineStartCoord(lineNo, 0);
-			Coordinates lineEndCoord(lineNo, GetLineMaxColumn(lineNo));
+	while (!stack.empty())
+	{
+		int node = stack.back();
+		stack.pop_back();
 
-			// check if line is folded
-			bool lineFolded = false;
-			int lineNew = 0;
-			Coordinates lineFoldStart, lineFoldEnd;
-			int lineFoldStartCIndex = 0;
+		if (m_Nodes[node].Left != -1)
+			stack.push_back(m_Nodes[node].Left);
+		if (m_Nodes[node].Right != -1)
+			stack.push_back(m_Nodes[node].Right);
 
-			if (m_FoldEnabled)
-			{
-				for (int i = 0; i < m_FoldBegin.size(); i++)
-				{
-					if (m_FoldBegin[i].Line == lineNo)
-					{
-						if (i < m_Fold.size())
-						{
-							lineFolded = m_Fold[i];
-							lineFoldStart = m_FoldBegin[i];
-							lineFoldStartCIndex = GetCharacterIndex(lineFoldStart);
+		m_FreeNodes.push_back(node);
+	}
+}
 
-							int foldCon = m_FoldConnection[i];
+void ImTextEdit::BracketIndex::Pull(int aNode)
+{
+	auto& n = m_Nodes[aNode];
 
-							if (lineFolded && foldCon != -1 && foldCon < m_FoldEnd.size())
-								lineFoldEnd = m_FoldEnd[foldCon];
-						}
+	n.Size = n.Lines;
+	n.Total = n.Own;
+	n.FoldedTotal = n.Folded;
+	n.DirtyTotal = n.Dirty;
+	n.RunTotal = n.Lines > 1;
 
-						break;
-					}
-				}
-			}
+	if (n.Left != -1)
+	{
+		auto& left = m_Nodes[n.Left];
+		n.Size += left.Size;
+		n.Total = Combine(left.Total, n.Total);
+		n.FoldedTotal += left.FoldedTotal;
+		n.DirtyTotal |= left.DirtyTotal;
+		n.RunTotal |= left.RunTotal;
+	}
 
-			// Draw selection for the current line
-			float sstart = -1.0f;
-			float ssend = -1.0f;
-			assert(m_State.SelectionStart <= m_State.SelectionEnd);
-			
-			if (m_State.SelectionStart <= lineEndCoord)
-				sstart = m_State.SelectionStart > lineStartCoord ? TextDistanceToLineStart(m_State.SelectionStart) : 0.0f;
-			
-			if (m_State.SelectionEnd > lineStartCoord)
-				ssend = TextDistanceToLineStart(m_State.SelectionEnd < lineEndCoord ? m_State.SelectionEnd : lineEndCoord);
-			
-			if (m_State.SelectionEnd.Line > lineNo)
-				ssend += m_CharAdvance.x;
-			
-			if (sstart != -1 && ssend != -1 && sstart < ssend)
-			{
-				ImVec2 vstart(lineStartScreenPos.x + m_TextStart + sstart, lineStartScreenPos.y);
-				ImVec2 vend(lineStartScreenPos.x + m_TextStart + ssend, lineStartScreenPos.y + m_CharAdvance.y);
-				drawList->AddRectFilled(vstart, vend, m_Palette[(int)PaletteIndex::Selection]);
-			}
+	if (n.Right != -1)
+	{
+		auto& right = m_Nodes[n.Right];
+		n.Size += right.Size;
+		n.Total = Combine(n.Total, right.Total);
+		n.FoldedTotal += right.FoldedTotal;
+		n.DirtyTotal |= right.DirtyTotal;
+		n.RunTotal |= right.RunTotal;
+	}
+}
 
-			// draw snippet stuff
-			if (m_IsSnippet)
-			{
-				unsigned int oldColor = m_Palette[(int)PaletteIndex::Selection];
-				unsigned int alpha = (oldColor & 0xFF000000) >> 25;
-				unsigned int newColor = (oldColor & 0x00FFFFFF) | (alpha << 24);
+void ImTextEdit::BracketIndex::Split(int aNode, int aCount, int& aLeft, int& aRight)
+{
+	// the first aCount lines go to aLeft, the rest to aRight
+	if (aNode == -1)
+	{
+		aLeft = aRight = -1;
+		return;
+	}
 
-				for (int i = 0; i < m_SnippetTagStart.size(); i++)
-				{
-					if (m_SnippetTagStart[i].Line == lineNo && m_SnippetTagHighlight[i])
-					{
-						float tstart = TextDistanceToLineStart(m_SnippetTagStart[i]);
-						float tend = TextDistanceToLineStart(m_SnippetTagEnd[i]);
+	int leftSize = SizeOf(m_Nodes[aNode].Left);
 
-						ImVec2 vstart(lineStartScreenPos.x + m_TextStart + tstart, lineStartScreenPos.y);
-						ImVec2 vend(lineStartScreenPos.x + m_TextStart + tend, lineStartScreenPos.y + m_CharAdvance.y);
-						drawList->AddRectFilled(vstart, vend, newColor);
-					}
-				}
-			}
+	int lines = m_Nodes[aNode].Lines;
 
-			auto start = ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y);
+	if (aCount <= leftSize)
+	{
+		int left;
+		Split(m_Nodes[aNode].Left, aCount, aLeft, left);
+		m_Nodes[aNode].Left = left;
+		aRight = aNode;
+	}
+	else if (aCount >= leftSize + lines)
+	{
+		int right;
+		Split(m_Nodes[aNode].Right, aCount - leftSize - lines, right, aRight);
+		m_Nodes[aNode].Right = right;
+		aLeft = aNode;
+	}
+	else
+	{
+		// the split falls into a run, its tail becomes a run of its own with the same priority,
+		// which keeps both above their children
+		int tail = NewNode();
+		auto& n = m_Nodes[aNode];
+		auto& t = m_Nodes[tail];
 
-			// Draw error markers
-			auto errorIt = m_ErrorMarkers.find(lineNo + 1);
+		t.Lines = leftSize + lines - aCount;
+		t.Priority = n.Priority;
+		t.Right = n.Right;
+		t.Dirty = false;
+		n.Lines = aCount - leftSize;
+		n.Right = -1;
 
-			if (errorIt != m_ErrorMarkers.end())
-			{
-				auto end = ImVec2(lineStartScreenPos.x + contentSize.x + 2.0f * scrollX, lineStartScreenPos.y + m_CharAdvance.y);
-				drawList->AddRectFilled(start, end, m_Palette[(int)PaletteIndex::ErrorMarker]);
+		Pull(tail);
+		aLeft = aNode;
+		aRight = tail;
+	}
 
-				if (ImGui::IsMouseHoveringRect(lineStartScreenPos, end))
-				{
-					ImGui::BeginTooltip();
-					ImGui::PushStyleColor(ImGuiCol_Text, ImGui::ColorConvertU32ToFloat4(m_Palette[(int)PaletteIndex::ErrorMessage]));
-					ImGui::Text("Error at line %d:", errorIt->first);
-					ImGui::PopStyleColor();
-					ImGui::Separator();
-					ImGui::PushStyleColor(ImGuiCol_Text, ImGui::ColorConvertU32ToFloat4(m_Palette[(int)PaletteIndex::ErrorMessage]));
-					ImGui::Text("%s", errorIt->second.c_str());
-					ImGui::PopStyleColor();
-					ImGui::EndTooltip();
-				}
-			}
+	Pull(aNode);
+}
 
-			// Highlight the current line (where the cursor is)
-			if (m_State.CursorPosition.Line == lineNo)
-			{
-				auto focused = ImGui::IsWindowFocused();
+int ImTextEdit::BracketIndex::Merge(int aLeft, int aRight)
+{
+	if (aLeft == -1)
+		return aRight;
+	if (aRight == -1)
+		return aLeft;
 
-				// Highlight the current line (where the cursor is)
-				if (m_HighlightLine && !HasSelection())
-				{
-					auto end = ImVec2(start.x + contentSize.x + scrollX, start.y + m_CharAdvance.y + 2.0f);
-					drawList->AddRectFilled(start, end, m_Palette[(int)(focused ? PaletteIndex::CurrentLineFill : PaletteIndex::CurrentLineFillInactive)]);
-					drawList->AddRect(start, end, m_Palette[(int)PaletteIndex::CurrentLineEdge], 1.0f);
-				}
+	if (m_Nodes[aLeft].Priority > m_Nodes[aRight].Priority)
+	{
+		int right = Merge(m_Nodes[aLeft].Right, aRight);
+		m_Nodes[aLeft].Right = right;
+		Pull(aLeft);
+		return aLeft;
+	}
 
-				// Render the cursor
-				if (focused)
-				{
-					auto elapsed = curTime - m_StartTime;
-					if (elapsed > 400)
-					{
-						float width = 1.0f;
-						auto cindex = GetCharacterIndex(m_State.CursorPosition);
-						float cx = TextDistanceToLineStart(m_State.CursorPosition);
+	int left = Merge(aLeft, m_Nodes[aRight].Left);
+	m_Nodes[aRight].Left = left;
+	Pull(aRight);
+	return aRight;
+}
 
-						if (m_Overwrite && cindex < (int)line->size())
-						{
-							auto c = (*line)[cindex].Character;
+void ImTextEdit::BracketIndex::Mark(int aNode, int aOffset, int aStart, int aEnd)
+{
+	if (aNode == -1 || aOffset >= aEnd || aOffset + m_Nodes[aNode].Size <= aStart)
+		return;
 
-							if (c == '\t')
-							{
-								auto x = (1.0f + std::floor((1.0f + cx) / (float(m_TabSize) * spaceSize))) * (float(m_TabSize) * spaceSize);
-								width = x - cx;
-							}
-							else
-							{
-								char buf2[2];
-								buf2[0] = (*line)[cindex].Character;
-								buf2[1] = '\0';
-								width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf2).x;
-							}
-						}
+	auto& n = m_Nodes[aNode];
+	int line = aOffset + SizeOf(n.Left);
+
+	Mark(n.Left, aOffset, aStart, aEnd);
+	Mark(n.Right, line + n.Lines, aStart, aEnd);
 
-						ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
-						ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + m_CharAdvance.y);
-						drawList->AddRectFilled(cstart, cend, m_Palette[(int)PaletteIndex::Cursor]);
+	if (line >= aStart && line < aEnd)
+		n.Dirty = true;
+	n.DirtyTotal = true;
+}
 
-						if (elapsed > 800)
-							m_StartTime = curTime;
-					}
-				}
-			}
+bool ImTextEdit::BracketIndex::Refresh(int aNode, int aOffset, const LineStore& aLines)
+{
+	if (aNode == -1 || !m_Nodes[aNode].DirtyTotal)
+		return false;
 
-			// highlight the user defined lines
-			if (m_HighlightLine)
-			{
-				if (std::find(m_HighlightedLines.begin(), m_HighlightedLines.end(), lineNo) != m_HighlightedLines.end())
-				{
-					auto end = ImVec2(start.x + contentSize.x + scrollX, start.y + m_CharAdvance.y);
-					drawList->AddRectFilled(start, end, m_Palette[(int)(PaletteIndex::CurrentLineFill)]);
-				}
-			}
+	int left = m_Nodes[aNode].Left;
+	int line = aOffset + SizeOf(left);
 
-			// text
-			auto prevColor = line->empty() ? m_Palette[(int)PaletteIndex::Default] : GetGlyphColor((*line)[0]);
-			ImVec2 bufferOffset;
-			
-			for (int i = 0; i < line->size();)
-			{
-				auto& glyph = (*line)[i];
-				auto color = GetGlyphColor(glyph);
+	bool changed = Refresh(left, aOffset, aLines);
+	changed |= Refresh(m_Nodes[aNode].Right, line + m_Nodes[aNode].Lines, aLines);
 
-				if ((color != prevColor || glyph.Character == '\t' || glyph.Character == ' ') && !m_LineBuffer.empty())
-				{
-					const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-					drawList->AddText(newOffset, prevColor, m_LineBuffer.c_str());
-					auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, m_LineBuffer.c_str(), nullptr, nullptr);
-					bufferOffset.x += textSize.x;
-					m_LineBuffer.clear();
-				}
+	auto& n = m_Nodes[aNode];
 
-				prevColor = color;
+	if (n.Dirty)
+	{
+		Summary summary = Summarize(aLines[line]);
+		changed |= summary != n.Own;
 
-				// highlight brackets
-				if (highlightBrackets)
-				{
-					if ((lineNo == highlightBracketCoord.Line && i == highlightBracketCoord.Column) || (lineNo == highlightBracketCursor.Line && i == highlightBracketCursor.Column))
-					{
-						const ImVec2 p1(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-						const ImVec2 p2(textScreenPos.x + bufferOffset.x + ImGui::GetFont()->GetCharAdvance(m_Lines[highlightBracketCoord.Line][highlightBracketCoord.Column].Character), textScreenPos.y + bufferOffset.y + ImGui::GetFontSize());
-						drawList->AddRectFilled(p1, p2, m_Palette[(int)PaletteIndex::Selection]);
-					}
-				}
+		n.Own = summary;
+		n.Folded = (int)aLines[line].GetFolds().size();
+		n.Dirty = false;
+	}
 
-				// tab, space, etc...
-				if (glyph.Character == '\t')
-				{
-					auto oldX = bufferOffset.x;
-					bufferOffset.x = (1.0f + std::floor((1.0f + bufferOffset.x) / (float(m_TabSize) * spaceSize))) * (float(m_TabSize) * spaceSize);
-					++i;
+	Pull(aNode);
+	return changed;
+}
 
-					if (m_ShowWhitespaces)
-					{
-						const auto s = ImGui::GetFontSize();
-						const auto x1 = textScreenPos.x + oldX + 1.0f;
-						const auto x2 = textScreenPos.x + bufferOffset.x - 1.0f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
-						const ImVec2 p1(x1, y);
-						const ImVec2 p2(x2, y);
-						const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
-						const ImVec2 p4(x2 - s * 0.2f, y + s * 0.2f);
-						drawList->AddLine(p1, p2, 0x90909090);
-						drawList->AddLine(p2, p3, 0x90909090);
-						drawList->AddLine(p2, p4, 0x90909090);
-					}
-				}
-				else if (glyph.Character == ' ')
-				{
-					if (m_ShowWhitespaces)
-					{
-						const auto s = ImGui::GetFontSize();
-						const auto x = textScreenPos.x + bufferOffset.x + spaceSize * 0.5f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
-						drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
-					}
+int ImTextEdit::BracketIndex::FindClose(int aNode, int aOffset, int aFrom, int aKind, int& aOpen) const
+{
+	// the first line at or after aFrom where the closing brackets run out the open ones
+	if (aNode == -1 || aOffset + m_Nodes[aNode].Size <= aFrom)
+		return -1;
 
-					bufferOffset.x += spaceSize;
-					i++;
-				}
-				else
-				{
-					auto l = UTF8CharLength(glyph.Character);
-					
-					while (l-- > 0)
-						m_LineBuffer.push_back((*line)[i++].Character);
-				}
+	auto& n = m_Nodes[aNode];
 
-				// skip if folded
-				if (lineFolded && lineFoldStartCIndex == i - 1)
-				{
-					i = GetCharacterIndex(lineFoldEnd);
-					lineNew = lineFoldEnd.Line;
-					line = &m_Lines[lineNew];
-					lineFolded = false;
+	if (aOffset >= aFrom && n.Total.Close[aKind] < aOpen)
+	{
+		aOpen += n.Total.Open[aKind] - n.Total.Close[aKind];
+		return -1;
+	}
 
-					if (!m_LineBuffer.empty())
-					{
-						// render the actual text
-						const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-						auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, m_LineBuffer.c_str(), nullptr, nullptr);
-						drawList->AddText(newOffset, prevColor, m_LineBuffer.c_str());
-						m_LineBuffer.clear();
-						bufferOffset.x += textSize.x;
+	int result = FindClose(n.Left, aOffset, aFrom, aKind, aOpen);
+	if (result != -1)
+		return result;
 
-						// render the [...] when folded
-						const ImVec2 offsetFoldBox(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-						drawList->AddText(offsetFoldBox, m_Palette[(int)PaletteIndex::Default], " ... ");
-						textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ... ", nullptr, nullptr);
-						drawList->AddRect(ImVec2(textScreenPos.x + bufferOffset.x + m_CharAdvance.x / 2.0f, textScreenPos.y + bufferOffset.y),
-										  ImVec2(textScreenPos.x + bufferOffset.x + textSize.x - m_CharAdvance.x / 2.0f, textScreenPos.y + bufferOffset.y + m_CharAdvance.y),
-										  m_Palette[(int)PaletteIndex::Default]);
-						bufferOffset.x += textSize.x;
-					}
-				}
+	int line = aOffset + SizeOf(n.Left);
 
-			}
+	if (line >= aFrom)
+	{
+		if (n.Own.Close[aKind] >= aOpen)
+			return line;
 
-			if (!m_LineBuffer.empty())
-			{
-				const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-				drawList->AddText(newOffset, prevColor, m_LineBuffer.c_str());
-				m_LineBuffer.clear();
-			}
+		aOpen += n.Own.Open[aKind] - n.Own.Close[aKind];
+	}
 
-			// side bar
-			if (m_Sidebar)
-			{
-				drawList->AddRectFilled(ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y), ImVec2(lineStartScreenPos.x + scrollX + m_TextStart - 5.0f, lineStartScreenPos.y + m_CharAdvance.y), ImGui::GetColorU32(ImGuiCol_WindowBg));
+	return FindClose(n.Right, line + n.Lines, aFrom, aKind, aOpen);
+}
 
-				// Draw breakpoints
-				if (HasBreakpoint(lineNo + 1) != 0)
-				{
-					float radius = ImGui::GetFontSize() * 1.0f / 3.0f;
-					float startX = lineStartScreenPos.x + scrollX + radius + 2.0f;
-					float startY = lineStartScreenPos.y + radius + 4.0f;
+int ImTextEdit::BracketIndex::FindOpen(int aNode, int aOffset, int aTo, int aKind, int& aClose) const
+{
+	// the same walking backwards from the line before aTo
+	if (aNode == -1 || aOffset >= aTo)
+		return -1;
 
-					drawList->AddCircle(ImVec2(startX, startY), radius + 1, m_Palette[(int)PaletteIndex::BreakpointOutline]);
-					drawList->AddCircleFilled(ImVec2(startX, startY), radius, m_Palette[(int)PaletteIndex::Breakpoint]);
+	auto& n = m_Nodes[aNode];
 
-					Breakpoint bkpt = GetBreakpoint(lineNo + 1);
+	if (aOffset + n.Size <= aTo && n.Total.Open[aKind] < aClose)
+	{
+		aClose += n.Total.Close[aKind] - n.Total.Open[aKind];
+		return -1;
+	}
 
-					if (!bkpt.Enabled)
-					{
-						drawList->AddCircleFilled(ImVec2(startX, startY), radius - 1, m_Palette[(int)PaletteIndex::BreakpointDisabled]);
-					}
-					else
-					{
-						if (bkpt.UseCondition)
-							drawList->AddRectFilled(ImVec2(startX - radius + 3, startY - radius / 4), ImVec2(startX + radius - 3, startY + radius / 4), m_Palette[(int)PaletteIndex::BreakpointOutline]);
-					}
-				}
+	int line = aOffset + SizeOf(n.Left);
 
-				// Draw current line indicator
-				if (lineNo + 1 == m_DebugCurrentLine)
-				{
-					float radius = ImGui::GetFontSize() * 1.0f / 3.0f;
-					float startX = lineStartScreenPos.x + scrollX + radius + 2.0f;
-					float startY = lineStartScreenPos.y + 4.0f;
+	int result = FindOpen(n.Right, line + n.Lines, aTo, aKind, aClose);
+	if (result != -1)
+		return result;
 
-					// outline
-					drawList->AddRect(ImVec2(startX - radius, startY + radius / 2), ImVec2(startX, startY + radius * 3.0f / 2.0f),
-						m_Palette[(int)PaletteIndex::CurrentLineIndicatorOutline]);
-					drawList->AddTriangle(ImVec2(startX - 1, startY - 2), ImVec2(startX - 1, startY + radius * 2 + 1), ImVec2(startX + radius, startY + radius),
-						m_Palette[(int)PaletteIndex::CurrentLineIndicatorOutline]);
+	if (line < aTo)
+	{
+		if (n.Own.Open[aKind] >= aClose)
+			return line;
 
-					// fill
-					drawList->AddRectFilled(ImVec2(startX - radius + 1, startY + 1 + radius / 2), ImVec2(startX + 1, startY - 1 + radius * 3.0f / 2.0f),
-						m_Palette[(int)PaletteIndex::CurrentLineIndicator]);
-					drawList->AddTriangleFilled(ImVec2(startX, startY + 1), ImVec2(startX, startY - 1 + radius * 2), ImVec2(startX - 1 + radius, startY + radius),
-						m_Palette[(int)PaletteIndex::CurrentLineIndicator]);
-				}
+		aClose += n.Own.Close[aKind] - n.Own.Open[aKind];
+	}
 
-				// Draw line number (right aligned)
-				if (m_ShowLineNumbers)
-				{
-					snprintf(buf, 16, "%3d  ", lineNo + 1);
+	return FindOpen(n.Left, aOffset, aTo, aKind, aClose);
+}
 
-					auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x;
-					drawList->AddText(ImVec2(lineStartScreenPos.x + scrollX + m_TextStart - lineNoWidth, lineStartScreenPos.y), m_Palette[(int)PaletteIndex::LineNumber], buf);
-				}
+void ImTextEdit::BracketIndex::GetFoldedLines(int aNode, int aOffset, std::vector<int>& aLines) const
+{
+	if (aNode == -1 || m_Nodes[aNode].FoldedTotal == 0)
+		return;
 
-				// fold +/- icon
-				if (m_FoldEnabled)
-				{
-					int foldID = 0;
-					int foldWeight = 0;
-					bool hasFold = false;
-					bool hasFoldEnd = false;
-					bool isFolded = false;
-					float foldBtnSize = spaceSize;
-					float foldStartX = lineStartScreenPos.x + scrollX + m_TextStart - spaceSize * 2.0f + 4;
-					float foldStartY = lineStartScreenPos.y + (ImGui::GetFontSize() - foldBtnSize) / 2.0f;
+	auto& n = m_Nodes[aNode];
+	int line = aOffset + SizeOf(n.Left);
 
-					// calculate current weight + find if here ends or starts another "fold"
-					for (int i = 0; i < m_FoldBegin.size(); i++)
-					{
-						if (m_FoldBegin[i].Line == lineNo)
-						{
-							hasFold = true;
-							foldID = i;
-							
-							if (i < m_Fold.size())
-								isFolded = m_Fold[i];
-							
-							break;
-						}
-						else if (m_FoldBegin[i].Line < lineNo)
-						{
-							foldWeight++;
-						}
-					}
+	GetFoldedLines(n.Left, aOffset, aLines);
+	if (n.Folded > 0)
+		aLines.push_back(line);
+	GetFoldedLines(n.Right, line + n.Lines, aLines);
+}
 
-					for (int i = 0; i < m_FoldEnd.size(); i++)
-					{
-						if (m_FoldEnd[i].Line == lineNo)
-						{
-							hasFoldEnd = true;
-							break;
-						}
-						else if (m_FoldEnd[i].Line < lineNo)
-						{
-							foldWeight--;
-						}
-					}
+void ImTextEdit::LineWidths::Reset(int aLineCount)
+{
+	m_Widths.assign(aLineCount, 0.0f);
+	m_Counts.clear();
+}
 
-					bool isHovered = (hoverFoldWeight && foldWeight >= hoverFoldWeight);
+void ImTextEdit::LineWidths::Insert(int aIndex, int aCount)
+{
+	m_Widths.insert(m_Widths.begin() + aIndex, aCount, 0.0f);
+}
 
-					// line
-					if (foldWeight > 0 && !hasFold)
-					{
-						ImVec2 p1(foldStartX + foldBtnSize / 2, lineStartScreenPos.y);
-						ImVec2 p2(p1.x, p1.y + m_CharAdvance.y + 1.0f);
+void ImTextEdit::LineWidths::Erase(int aStart, int aEnd)
+{
+	for (int i = aStart; i < aEnd; i++)
+		Count(m_Widths[i], -1);
 
-						drawList->AddLine(p1, p2, m_Palette[(int)PaletteIndex::Default]);
-					}
+	m_Widths.erase(m_Widths.begin() + aStart, m_Widths.begin() + aEnd);
+}
 
-					if (hasFold) // render the +/- box
-					{
-						ImVec2 fmin(foldStartX, foldStartY + 2);
-						ImVec2 fmax(fmin.x + foldBtnSize, fmin.y + foldBtnSize);
+void ImTextEdit::LineWidths::Set(int aLine, float aWidth)
+{
+	Count(m_Widths[aLine], -1);
+	m_Widths[aLine] = aWidth;
+	Count(aWidth, 1);
+}
 
-						// line up
-						if (foldWeight > 0)
-						{
-							ImVec2 p1(foldStartX + foldBtnSize / 2, lineStartScreenPos.y);
-							ImVec2 p2(p1.x, fmin.y);
-							drawList->AddLine(p1, p2, m_Palette[(int)PaletteIndex::Default]);
-						}
+void ImTextEdit::LineWidths::Count(float aWidth, int aDelta)
+{
+	if (aWidth <= 0.0f)
+		return;
 
-						// fold button
-						foldWeight++;
-						drawList->AddRect(fmin, fmax, m_Palette[(int)PaletteIndex::Default]);
+	auto it = m_Counts.emplace(aWidth, 0).first;
+	it->second += aDelta;
+	assert(it->second >= 0);
 
-						// check if mouse is over this fold button
-						ImVec2 mpos = ImGui::GetMousePos();
-						if (mpos.x >= fmin.x && mpos.x <= fmax.x && mpos.y >= fmin.y && mpos.y <= fmax.y)
-						{
-							isHovered = true;
-							hoverFoldWeight = foldWeight;
+	if (it->second == 0)
+		m_Counts.erase(it);
+}
 
-							if (isFolded)
-								hoverFoldWeight = 0;
+void ImTextEdit::TextOffsetIndex::Reset(const LineStore& aLines)
+{
+	m_Blocks.assign(std::max<size_t>(1, (aLines.size() + s_BlockLines - 1) / s_BlockLines), Block());
+	m_LineCount = (int)aLines.size();
 
-							ImGui::SetMouseCursor(ImGuiMouseCursor_Arrow);
+	for (size_t i = 0; i < aLines.size(); i++)
+	{
+		Block& block = m_Blocks[i / s_BlockLines];
+		Length length = Measure(aLines, i);
+		block.Lengths.push_back(length);
+		block.Bytes += length.Bytes;
+		block.Characters += length.Characters;
+	}
 
-							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
-							{
-								if (foldID < m_Fold.size())
-								{
-									isFolded = !isFolded;
-									m_Fold[foldID] = isFolded;
-								}
-							}
-						}
+	m_LineTree.clear();
+	m_ByteTree.clear();
+	m_CharacterTree.clear();
+}
 
-						// minus
-						drawList->AddLine(ImVec2(fmin.x + 3, (fmin.y + fmax.y) / 2.0f), ImVec2(fmax.x - 4, (fmin.y + fmax.y) / 2.0f), m_Palette[(int)PaletteIndex::Default]);
+void ImTextEdit::TextOffsetIndex::Insert(const LineStore& aLines, int aIndex, int aCount)
+{
+	if (m_Blocks.empty() || aCount <= 0)
+		return;
 
-						// plus
-						if (isFolded)
-							drawList->AddLine(ImVec2((fmin.x + fmax.x) / 2.0f, fmin.y + 3), ImVec2((fmin.x + fmax.x) / 2.0f, fmax.y - 4), m_Palette[(int)PaletteIndex::Default]);
+	size_t b, index;
+	Locate(aIndex, b, index);
 
-						// line down
-						if (!isFolded || foldWeight > 1)
-						{
-							float lineContinueY = (lineStartScreenPos.y + m_CharAdvance.y) - fmax.y;
-							ImVec2 p1(foldStartX + foldBtnSize / 2, fmax.y);
-							ImVec2 p2(p1.x, fmax.y + lineContinueY);
-							drawList->AddLine(p1, p2, m_Palette[(int)PaletteIndex::Default]);
-						}
-					}
-					else if (hasFoldEnd) // horizontal line
-					{
-						foldWeight--;
-						if (hoverFoldWeight && foldWeight < hoverFoldWeight)
-							hoverFoldWeight = 0;
+	Block& block = m_Blocks[b];
+	block.Lengths.insert(block.Lengths.begin() + index, aCount, Length());
 
-						ImVec2 p1(foldStartX + foldBtnSize / 2, lineStartScreenPos.y + m_CharAdvance.y - 1.0f);
-						ImVec2 p2(p1.x + m_CharAdvance.x / 2.0f, p1.y);
-						drawList->AddLine(p1, p2, m_Palette[(int)PaletteIndex::Default]);
-					}
+	int64_t bytes = 0, characters = 0;
 
-					// hover background
-					if (isHovered)
-					{
-						// sidebar bg
-						ImVec2 pmin(foldStartX - 4, lineStartScreenPos.y);
-						ImVec2 pmax(pmin.x + foldBtnSize + 8, pmin.y + m_CharAdvance.y);
-						drawList->AddRectFilled(pmin, pmax, 0x40000000 | (0x00FFFFFF & m_Palette[(int)PaletteIndex::Default]));
+	for (int i = 0; i < aCount; i++)
+	{
+		Length length = Measure(aLines, aIndex + i);
+		block.Lengths[index + i] = length;
+		bytes += length.Bytes;
+		characters += length.Characters;
+	}
 
-						// line bg
-						pmin.x = pmax.x;
-						pmax.x = lineStartScreenPos.x + scrollX + m_TextStart + contentSize.x;
-						drawList->AddRectFilled(pmin, pmax, 0x20000000 | (0x00FFFFFF & m_Palette[(int)PaletteIndex::Default]));
-					}
-				}
-			}
+	block.Bytes += bytes;
+	block.Characters += characters;
+	m_LineCount += aCount;
+
+	Add(b, aCount, bytes, characters);
+	Balance(b, b);
+}
+
+void ImTextEdit::TextOffsetIndex::Erase(int aStart, int aEnd)
+{
+	if (m_Blocks.empty() || aStart >= aEnd)
+		return;
 
-			if (lineNew)
-			{
-				linesFolded += lineNew - lineNo;
-				lineMax = std::min<int>((int)m_Lines.size() - 1, lineMax + lineNew - lineNo);
-				lineNo = lineNew;
-			}
+	size_t first, index;
+	Locate(aStart, first, index);
 
-			++lineNo;
-		}
+	// the lines are taken from the blocks one after another, starting at aStart inside the first one
+	size_t b = first;
 
-		// Draw a tooltip on known identifiers/preprocessor symbols
-		if (ImGui::IsMousePosValid() && (IsDebugging() || m_FuncTooltips || ImGui::GetIO().KeyCtrl))
+	for (int rest = aEnd - aStart; rest > 0 && b < m_Blocks.size(); b++, index = 0)
+	{
+		Block& block = m_Blocks[b];
+		size_t count = std::min<size_t>(rest, block.Lengths.size() - index);
+		int64_t bytes = 0, characters = 0;
+
+		for (size_t i = index; i < index + count; i++)
 		{
-			Coordinates hoverPosition = MousePosToCoordinates(ImGui::GetMousePos());
-			
-			if (hoverPosition != m_LastHoverPosition)
-			{
-				m_LastHoverPosition = hoverPosition;
-				m_LastHoverTime = std::chrono::steady_clock::now();
-			}
-			
-			td_Char hoverChar = 0;
+			bytes += block.Lengths[i].Bytes;
+			characters += block.Lengths[i].Characters;
+		}
 
-			if (hoverPosition.Line < m_Lines.size() && hoverPosition.Column < m_Lines[hoverPosition.Line].size())
-				hoverChar = m_Lines[hoverPosition.Line][hoverPosition.Column].Character;
+		block.Lengths.erase(block.Lengths.begin() + index, block.Lengths.begin() + index + count);
+		block.Bytes -= bytes;
+		block.Characters -= characters;
+		rest -= (int)count;
+		m_LineCount -= (int)count;
 
-			double hoverTime = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - m_LastHoverTime).count();
-			
-			if (hoverTime > 0.5 && (hoverChar == '(' || hoverChar == ')') && IsDebugging())
-			{
-				std::string expr = "";
+		Add(b, -(int64_t)count, -bytes, -characters);
+	}
 
-				int colStart = 0, rowStart = hoverPosition.Line;
-				int bracketMatch = 0;
+	Balance(first, b - 1);
+}
 
-				if (hoverChar == ')')
-				{
-					int colIndex = hoverPosition.Column;
+void ImTextEdit::TextOffsetIndex::Clear()
+{
+	m_Blocks.clear();
+	m_LineCount = 0;
+	m_LineTree.clear();
+	m_ByteTree.clear();
+	m_CharacterTree.clear();
+}
 
-					for (; rowStart >= 0; rowStart--)
-					{
-						for (int i = colIndex; i >= 0; i--)
-						{
-							char curChar = m_Lines[rowStart][i].Character;
+void ImTextEdit::TextOffsetIndex::Update(const LineStore& aLines, int aStart, int aEnd)
+{
+	aStart = std::max(0, aStart);
+	aEnd = std::min(aEnd, m_LineCount);
 
-							if (curChar == '(')
-								bracketMatch++;
-							else if (curChar == ')')
-								bracketMatch--;
+	if (m_Blocks.empty() || aStart >= aEnd)
+		return;
 
-							if (!isspace(curChar) || curChar == ' ')
-								expr += curChar;
+	size_t b, index;
+	Locate(aStart, b, index);
 
-							if (bracketMatch == 0)
-							{
-								colStart = i - 1;
-								break;
-							}
-						}
+	for (int line = aStart; line < aEnd && b < m_Blocks.size(); b++, index = 0)
+	{
+		Block& block = m_Blocks[b];
+		int64_t bytes = 0, characters = 0;
 
-						if (bracketMatch == 0)
-							break;
+		for (; index < block.Lengths.size() && line < aEnd; index++, line++)
+		{
+			Length length = Measure(aLines, line);
+			bytes += (int64_t)length.Bytes - block.Lengths[index].Bytes;
+			characters += (int64_t)length.Characters - block.Lengths[index].Characters;
+			block.Lengths[index] = length;
+		}
 
-						if (rowStart != 0)
-							colIndex = m_Lines[rowStart - 1].size() - 1;
-					}
-					std::reverse(expr.begin(), expr.end());
+		block.Bytes += bytes;
+		block.Characters += characters;
+		Add(b, 0, bytes, characters);
+	}
+}
 
-					if (rowStart <= 0)
-						colStart = -1;
+size_t ImTextEdit::TextOffsetIndex::GetLineStart(int aLine, bool aCharacters) const
+{
+	if (m_Blocks.empty())
+		return 0;
 
-				}
-				else if (hoverChar == '(')
-				{
-					int colIndex = hoverPosition.Column;
-					colStart = hoverPosition.Column - 1;
+	size_t b, index;
+	Locate(std::max(0, std::min(aLine, m_LineCount)), b, index);
 
-					for (int j = rowStart; j < m_Lines.size(); j++)
-					{
-						for (int i = colIndex; i < m_Lines[j].size(); i++)
-						{
-							char curChar = m_Lines[j][i].Character;
+	size_t sum = Prefix(aCharacters ? m_CharacterTree : m_ByteTree, b);
 
-							if (curChar == '(')
-								bracketMatch++;
-							else if (curChar == ')')
-								bracketMatch--;
+	for (size_t i = 0; i < index; i++)
+		sum += aCharacters ? m_Blocks[b].Lengths[i].Characters : m_Blocks[b].Lengths[i].Bytes;
 
-							if (!isspace(curChar) || curChar == ' ')
-								expr += curChar;
+	return sum;
+}
 
-							if (bracketMatch == 0)
-								break;
-						}
+int ImTextEdit::TextOffsetIndex::FindLine(size_t aOffset, bool aCharacters) const
+{
+	if (m_LineCount == 0)
+		return 0;
 
-						if (bracketMatch == 0)
-							break;
-						if (j != 0)
-							colIndex = 0;
-					}
+	if (m_LineTree.empty())
+		Build();
 
-					if (rowStart >= m_Lines.size())
-						colStart = -1;
-				}
+	auto& tree = aCharacters ? m_CharacterTree : m_ByteTree;
+	size_t count = m_Blocks.size();
+	size_t b = 0;
 
-				while (colStart >= 0 && isalnum(m_Lines[rowStart][colStart].Character))
-				{
-					expr.insert(expr.begin(), m_Lines[rowStart][colStart].Character);
-					colStart--;
-				}
+	// the blocks that end at or before aOffset are skipped whole
+	size_t step = 1;
+	while (step * 2 <= count)
+		step *= 2;
 
-				if (OnExpressionHover && HasExpressionHover)
-				{
-					if (HasExpressionHover(this, expr))
-					{
-						ImGui::BeginTooltip();
-						OnExpressionHover(this, expr);
-						ImGui::EndTooltip();
-					}
-				}
-			}
-			else if (hoverTime > 0.2)
-			{
-				Coordinates wordCoords = ScreenPosToCoordinates(ImGui::GetMousePos());
-				auto id = GetWordAt(wordCoords);
-				bool isCtrlDown = ImGui::GetIO().KeyCtrl;
+	for (; step > 0; step /= 2)
+	{
+		if (b + step <= count && tree[b + step] <= aOffset)
+		{
+			b += step;
+			aOffset -= tree[b];
+		}
+	}
 
-				if (!id.empty())
-				{
-					// function/value tooltips
-					if (!isCtrlDown)
-					{
-						auto it = m_LanguageDefinition.Identifiers.find(id);
+	// then the lines of the block that end at or before it
+	size_t line = Prefix(m_LineTree, b);
 
-						if (it != m_LanguageDefinition.Identifiers.end() && m_FuncTooltips)
-						{
-							ImGui::BeginTooltip();
-							ImGui::TextUnformatted(it->second.Declaration.c_str());
-							ImGui::EndTooltip();
-						}
-						else
-						{
-							auto pi = m_LanguageDefinition.PreprocIdentifiers.find(id);
+	if (b < count)
+	{
+		for (auto& length : m_Blocks[b].Lengths)
+		{
+			size_t size = aCharacters ? length.Characters : length.Bytes;
 
-							if (pi != m_LanguageDefinition.PreprocIdentifiers.end() && m_FuncTooltips)
-							{
-								ImGui::BeginTooltip();
-								ImGui::TextUnformatted(pi->second.Declaration.c_str());
-								ImGui::EndTooltip();
-							}
-							else if (IsDebugging() && OnIdentifierHover && HasIdentifierHover)
-							{
-								if (HasIdentifierHover(this, id))
-								{
-									ImGui::BeginTooltip();
-									OnIdentifierHover(this, id);
-									ImGui::EndTooltip();
-								}
-							}
-						}
-					}
-					else // CTRL + click functionality
-					{
-						bool hasUnderline = false;
-						bool isHeader = false;
-						bool isFindFirst = false;
-						Coordinates findStart(0, 0);
-						std::string header = "";
-						Coordinates wordStart = FindWordStart(wordCoords);
-						Coordinates wordEnd = FindWordEnd(wordCoords);
+			if (size > aOffset)
+				break;
 
-						// check if header
-						if (wordStart.Line >= 0 && wordStart.Line < m_Lines.size())
-						{
-							// get the contents of the line in std::string
-							const auto& line = m_Lines[wordStart.Line];
-							std::string text;
-							text.resize(line.size());
+			aOffset -= size;
+			line++;
+		}
+	}
 
-							for (size_t i = 0; i < line.size(); ++i)
-								text[i] = line[i].Character;
+	return (int)std::min<size_t>(line, m_LineCount - 1);
+}
 
-							// find #include
-							size_t includeLoc = text.find("#include");
-							size_t includeStart = std::string::npos, includeEnd = std::string::npos;
-							
-							if (text.size() > 0 && includeLoc != std::string::npos)
-							{
-								for (size_t f = includeLoc; f < text.size(); f++)
-								{
-									if (text[f] == '<' || text[f] == '\"')
-									{
-										includeStart = f + 1;
-									}
-									else if (text[f] == '>' || text[f] == '\"')
-									{
-										includeEnd = f - 1;
-										break;
-									}
-								}
-							}
+void ImTextEdit::TextOffsetIndex::Locate(int aLine, size_t& aBlock, size_t& aIndex) const
+{
+	if (m_LineTree.empty())
+		Build();
 
-							if (includeStart != std::string::npos && includeEnd != std::string::npos)
-							{
-								hasUnderline = true;
-								isHeader = true;
-								
-								header = text.substr(includeStart, includeEnd-includeStart + 1);
-								wordStart.Column = 0;
-								wordEnd.Column = GetCharacterColumn(wordEnd.Line, line.size());
-							}
-						}
+	// the longest run of blocks with no more than aLine lines, aLine is in the block after it
+	size_t count = m_Blocks.size();
+	size_t b = 0;
+	size_t rest = (size_t)aLine;
 
-						// check if mul, sin, cos, etc...
-						if (!hasUnderline && m_LanguageDefinition.Identifiers.find(id) != m_LanguageDefinition.Identifiers.end())
-							hasUnderline = true;
+	size_t step = 1;
+	while (step * 2 <= count)
+		step *= 2;
 
-						// draw the underline
-						if (hasUnderline)
-						{
-							ImVec2 ulinePos = ImVec2(cursorScreenPos.x + m_TextStart, cursorScreenPos.y + wordStart.Line * m_CharAdvance.y);
-							drawList->AddLine(ImVec2(ulinePos.x + wordStart.Column * m_CharAdvance.x, ulinePos.y + m_CharAdvance.y),
-								ImVec2(ulinePos.x + wordEnd.Column * m_CharAdvance.x, ulinePos.y + m_CharAdvance.y),
-								ImGui::GetColorU32(ImGuiCol_HeaderHovered));
-							ImGui::SetMouseCursor(ImGuiMouseCursor_Arrow);
+	for (; step > 0; step /= 2)
+	{
+		if (b + step <= count && m_LineTree[b + step] <= rest)
+		{
+			b += step;
+			rest -= m_LineTree[b];
+		}
+	}
 
-							if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
-							{
-								if (isHeader)
-								{
-									if (RequestOpen)
-										RequestOpen(this, this->m_Path, header);
-								}
-								else
-								{
-									// go to type definition
-									if (isFindFirst)
-									{
-										if (!ImGui::GetIO().KeyAlt)
-										{
-											Coordinates userTypeLoc = FindFirst(id, findStart);
-										
-											if (userTypeLoc.Line >= 0 && userTypeLoc.Line < m_Lines.size())
-											{
-												m_State.CursorPosition = userTypeLoc;
-												SetSelectionStart(userTypeLoc);
-												SetSelectionEnd(FindWordEnd(userTypeLoc));
-												EnsureCursorVisible();
-											}
-										}
-										else
-										{
-											if (OnCtrlAltClick) 
-												this->OnCtrlAltClick(this, id, wordCoords);
-										}
-									}
+	// the end of the document, or the end of an empty last block
+	while (b > 0 && (b == count || (rest == 0 && m_Blocks[b].Lengths.empty())))
+	{
+		b--;
+		rest = m_Blocks[b].Lengths.size();
+	}
+
+	aBlock = b;
+	aIndex = rest;
+}
 
-									// TODO: identifier documentation
-								}
-							}
-						}
-					}
-				}
+void ImTextEdit::TextOffsetIndex::Add(size_t aBlock, int64_t aLines, int64_t aBytes, int64_t aCharacters)
+{
+	// the trees are rebuilt from the blocks anyway if they are empty
+	for (size_t k = aBlock + 1; k < m_LineTree.size(); k += k & (~k + 1))
+	{
+		m_LineTree[k] += aLines;
+		m_ByteTree[k] += aBytes;
+		m_CharacterTree[k] += aCharacters;
+	}
+}
+
+size_t ImTextEdit::TextOffsetIndex::Prefix(const std::vector<size_t>& aTree, size_t aBlocks)
+{
+	size_t sum = 0;
+
+	for (size_t k = aBlocks; k > 0; k -= k & (~k + 1))
+		sum += aTree[k];
+
+	return sum;
+}
+
+void ImTextEdit::TextOffsetIndex::Balance(size_t aFirst, size_t aLast)
+{
+	bool changed = false;
+
+	for (size_t b = std::min(aLast, m_Blocks.size() - 1) + 1; b-- > aFirst;)
+	{
+		Block& block = m_Blocks[b];
+
+		if (block.Lengths.size() > 2 * s_BlockLines)
+		{
+			// a large paste, cut into blocks of s_BlockLines lines
+			std::vector<Block> parts((block.Lengths.size() + s_BlockLines - 1) / s_BlockLines);
+
+			for (size_t i = 0; i < block.Lengths.size(); i++)
+			{
+				Block& part = parts[i / s_BlockLines];
+				part.Lengths.push_back(block.Lengths[i]);
+				part.Bytes += block.Lengths[i].Bytes;
+				part.Characters += block.Lengths[i].Characters;
 			}
+
+			m_Blocks.erase(m_Blocks.begin() + b);
+			m_Blocks.insert(m_Blocks.begin() + b, std::make_move_iterator(parts.begin()), std::make_move_iterator(parts.end()));
+			changed = true;
+		}
+		else if (block.Lengths.size() < s_BlockLines / 4 && m_Blocks.size() > 1)
+		{
+			// short blocks go into a neighbour, so the block count stays proportional to the lines
+			size_t other = b + 1 < m_Blocks.size() ? b + 1 : b - 1;
+			Block& into = m_Blocks[other];
+
+			if (into.Lengths.size() + block.Lengths.size() > 2 * s_BlockLines)
+				continue;
+
+			into.Lengths.insert(other > b ? into.Lengths.begin() : into.Lengths.end(), block.Lengths.begin(), block.Lengths.end());
+			into.Bytes += block.Bytes;
+			into.Characters += block.Characters;
+			m_Blocks.erase(m_Blocks.begin() + b);
+			changed = true;
 		}
 	}
 
-	// function tooltip
-	if (m_FunctionDeclarationTooltip)
+	if (changed)
 	{
-		const float ttWidth = 350, ttHeight = 50;
-		ImVec2 ttPos = CoordinatesToScreenPos(m_FunctionDeclarationCoord);
-		ttPos.y += m_CharAdvance.y;
-		ttPos.x += ImGui::GetScrollX();
+		m_LineTree.clear();
+		m_ByteTree.clear();
+		m_CharacterTree.clear();
+	}
+}
 
-		drawList->AddRectFilled(ttPos, ImVec2(ttPos.x + UICalculateSize(ttWidth), ttPos.y + UICalculateSize(ttHeight)), ImGui::GetColorU32(ImGuiCol_FrameBg));
+ImTextEdit::TextOffsetIndex::Length ImTextEdit::TextOffsetIndex::Measure(const td_Char* aChars, size_t aSize)
+{
+	Length length;
+	length.Bytes = (uint32_t)aSize + 1;
+	length.Characters = 1;
 
-		ImFont* font = ImGui::GetFont();
-		ImGui::PopFont();
+	for (size_t i = 0; i < aSize; length.Characters++)
+		i += UTF8CharLength(aChars[i]);
 
-		ImGui::SetNextWindowPos(ttPos, ImGuiCond_Always);
-		ImGui::BeginChild("##texteditor_functooltip", ImVec2(UICalculateSize(ttWidth), UICalculateSize(ttHeight)), true);
+	return length;
+}
 
-		ImGui::TextWrapped("%s", m_FunctionDeclaration.c_str());
+ImTextEdit::TextOffsetIndex::Length ImTextEdit::TextOffsetIndex::Measure(const LineStore& aLines, size_t aIndex)
+{
+	const char* begin;
+	const char* end;
 
-		ImGui::EndChild();
+	// a line that wasn't loaded is measured in the mapped file, without its carriage returns
+	if (!aLines.GetMappedText(aIndex, begin, end))
+		return Measure(aLines[aIndex].GetChars(), aLines[aIndex].size());
 
-		ImGui::PushFont(font);
+	if (memchr(begin, '\r', end - begin) == nullptr)
+		return Measure((const td_Char*)begin, end - begin);
 
-		ImGui::SetWindowFocus();
+	std::string text(begin, end);
+	text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
+	return Measure((const td_Char*)text.data(), text.size());
+}
 
-		if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape)))
-			m_FunctionDeclarationTooltip = false;
+void ImTextEdit::TextOffsetIndex::Build() const
+{
+	// linear time construction: every node passes its sum on to its parent
+	size_t count = m_Blocks.size();
+	m_LineTree.assign(count + 1, 0);
+	m_ByteTree.assign(count + 1, 0);
+	m_CharacterTree.assign(count + 1, 0);
+
+	for (size_t k = 1; k <= count; k++)
+	{
+		m_LineTree[k] += m_Blocks[k - 1].Lengths.size();
+		m_ByteTree[k] += m_Blocks[k - 1].Bytes;
+		m_CharacterTree[k] += m_Blocks[k - 1].Characters;
+
+		size_t parent = k + (k & (~k + 1));
+		if (parent <= count)
+		{
+			m_LineTree[parent] += m_LineTree[k];
+			m_ByteTree[parent] += m_ByteTree[k];
+			m_CharacterTree[parent] += m_CharacterTree[k];
+		}
 	}
+}
 
-	// suggestions window
-	if (m_ACOpened)
+std::string ImTextEdit::AutcompleteParse(const std::string& str, const Coordinates& start)
+{
+	const char* buffer = str.c_str();
+	const char* tagPlaceholderStart = buffer;
+	const char* tagStart = buffer;
+
+	bool parsingTag = false;
+	bool parsingTagPlaceholder = false;
+
+	std::vector<int> tagIds, tagLocations, tagLengths;
+	std::unordered_map<int, std::string> tagPlaceholders;
+
+	m_SnippetTagStart.clear();
+	m_SnippetTagEnd.clear();
+	m_SnippetTagID.clear();
+	m_SnippetTagHighlight.clear();
+
+	Coordinates cursor = start, tagStartCoord, tagEndCoord;
+
+	int tagId = -1;
+	int modif = 0;
+
+	while (*buffer != '\0')
 	{
-		auto acCoord = FindWordStart(m_ACPosition);
-		ImVec2 acPos = CoordinatesToScreenPos(acCoord);
-		acPos.y += m_CharAdvance.y;
-		acPos.x += ImGui::GetScrollX();
+		if (*buffer == '{' && *(buffer + 1) == '$')
+		{
+			parsingTagPlaceholder = false;
+			parsingTag = true;
+			tagId = -1;
+			tagStart = buffer;
 
-		drawList->AddRectFilled(acPos, ImVec2(acPos.x + UICalculateSize(150), acPos.y + UICalculateSize(100)), ImGui::GetColorU32(ImGuiCol_FrameBg));
+			tagStartCoord = cursor;
 
-		ImFont* font = ImGui::GetFont();
-		ImGui::PopFont();
+			const char* skipBuffer = buffer;
+			char** endLoc = const_cast<char**>(&buffer); // oops
+			tagId = strtol(buffer + 2, endLoc, 10);
 
-		ImGui::SetNextWindowPos(acPos, ImGuiCond_Always);
-		ImGui::BeginChild("##texteditor_autocompl", ImVec2(UICalculateSize(150), UICalculateSize(100)), true);
+			cursor.Column += *endLoc - skipBuffer;
 
-		for (int i = 0; i < m_ACSuggestions.size(); i++)
+			if (*buffer == ':')
+			{
+				tagPlaceholderStart = buffer + 1;
+				parsingTagPlaceholder = true;
+			}
+		}
+
+		if (*buffer == '}' && parsingTag)
 		{
-			ImGui::Selectable(m_ACSuggestions[i].first.c_str(), i == m_ACIndex);
+			std::string tagPlaceholder = "";
+
+			if (parsingTagPlaceholder)
+				tagPlaceholder = std::string(tagPlaceholderStart, buffer - tagPlaceholderStart);
+
+			tagIds.push_back(tagId);
+			tagLocations.push_back(tagStart - str.c_str());
+			tagLengths.push_back(buffer - tagStart + 1);
 			
-			if (i == m_ACIndex)
-				ImGui::SetScrollHereY();
-		}
+			if (!tagPlaceholder.empty() || tagPlaceholders.count(tagId) == 0)
+			{
+				if (tagPlaceholder.empty())
+					tagPlaceholder = " ";
 
-		ImGui::EndChild();
+				tagStartCoord.Column = std::max<int>(0, tagStartCoord.Column - modif);
+				tagEndCoord = tagStartCoord;
+				tagEndCoord.Column += tagPlaceholder.size();
 
-		ImGui::PushFont(font);
+				m_SnippetTagStart.push_back(tagStartCoord);
+				m_SnippetTagEnd.push_back(tagEndCoord);
+				m_SnippetTagID.push_back(tagId);
+				m_SnippetTagHighlight.push_back(true);
 
-		ImGui::SetWindowFocus();
+				tagPlaceholders[tagId] = tagPlaceholder;
+			}
+			else
+			{
+				tagStartCoord.Column = std::max<int>(0, tagStartCoord.Column - modif);
+				tagEndCoord = tagStartCoord;
+				tagEndCoord.Column += tagPlaceholders[tagId].size();
 
-		if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape)))
+				m_SnippetTagStart.push_back(tagStartCoord);
+				m_SnippetTagEnd.push_back(tagEndCoord);
+				m_SnippetTagID.push_back(tagId);
+				m_SnippetTagHighlight.push_back(false);
+			}
+
+			modif += (tagLengths.back() - tagPlaceholders[tagId].size());
+
+			parsingTagPlaceholder = false;
+			parsingTag = false;
+			tagId = -1;
+		}
+
+		if (*buffer == '\n')
 		{
-			m_ACOpened = false;
-			m_ACObject = "";
+			cursor.Line++;
+			cursor.Column = 0;
+			modif = 0;
+		}
+		else
+		{
+			cursor.Column++;
 		}
+
+		buffer++;
 	}
 
-	ImGui::Dummy(ImVec2(longest + EditorCalculateSize(100), (m_Lines.size() - totalLinesFolded) * m_CharAdvance.y));
+	m_IsSnippet = !tagIds.empty();
 
-	if (m_DebugCurrentLineUpdated)
+	std::string ret = str;
+	
+	for (int i = tagLocations.size() - 1; i >= 0; i--)
 	{
-		float scrollX = ImGui::GetScrollX();
-		float scrollY = ImGui::GetScrollY();
+		ret.erase(tagLocations[i], tagLengths[i]);
+		ret.insert(tagLocations[i], tagPlaceholders[tagIds[i]]);
+	}
 
-		auto height = ImGui::GetWindowHeight();
-		auto width = ImGui::GetWindowWidth();
+	return ret;
+}
+void ImTextEdit::AutocompleteSelect()
+{
+	UndoRecord undo;
+	undo.Before = m_State;
 
-		auto top = 1 + (int)ceil(scrollY / m_CharAdvance.y);
-		auto bottom = (int)ceil((scrollY + height) / m_CharAdvance.y);
+	auto curCoord = GetCursorPosition();
+	curCoord.Column = std::max<int>(curCoord.Column - 1, 0);
 
-		auto left = (int)ceil(scrollX / m_CharAdvance.x);
-		auto right = (int)ceil((scrollX + width) / m_CharAdvance.x);
+	auto acStart = FindWordStart(curCoord);
+	auto acEnd = FindWordEnd(curCoord);
 
-		ImTextEdit::Coordinates pos(m_DebugCurrentLine, 0);
+	if (!m_ACObject.empty())
+		acStart = m_ACPosition;
 
-		if (pos.Line < top)
-			ImGui::SetScrollY(std::max(0.0f, (pos.Line - 1) * m_CharAdvance.y));
+	undo.AddedStart = acStart;
+	int undoPopCount = std::max(0, acEnd.Column - acStart.Column) + 1;
 
-		if (pos.Line > bottom - 4)
-			ImGui::SetScrollY(std::max(0.0f, (pos.Line + 4) * m_CharAdvance.y - height));
+	if (!m_ACObject.empty() && m_ACWord.empty())
+		undoPopCount = 0;
 
-		m_DebugCurrentLineUpdated = false;
-	}
+	const auto& acEntry = m_ACSuggestions[m_ACIndex];
 
-	if (m_ScrollToCursor)
+	std::string entryText = AutcompleteParse(acEntry.second, acStart);
+
+	if (acStart.Column != acEnd.Column)
 	{
-		EnsureCursorVisible();
-		ImGui::SetWindowFocus();
-		m_ScrollToCursor = false;
+		SetSelection(acStart, acEnd);
+		Backspace();
 	}
 	
-	// hacky way to get the bg working
-	if (m_FindOpened)
-	{
-		ImVec2 findPos = ImVec2(m_UICursorPos.x + scrollX + m_WindowWidth - UICalculateSize(250), m_UICursorPos.y + ImGui::GetScrollY() + UICalculateSize(50) * (IsDebugging() && m_DebugBar));
-		drawList->AddRectFilled(findPos, ImVec2(findPos.x + UICalculateSize(220), findPos.y + UICalculateSize(m_ReplaceOpened ? 90 : 40)), ImGui::GetColorU32(ImGuiCol_WindowBg));
-	}
+	AppendText(entryText, true);
 
-	if (IsDebugging() && m_DebugBar)
+	undo.Added = entryText;
+	undo.AddedEnd = GetActualCursorCoordinates();
+
+	if (m_IsSnippet && m_SnippetTagStart.size() > 0)
 	{
-		ImVec2 dbgPos = ImVec2(m_UICursorPos.x + scrollX + m_WindowWidth / 2 - m_DebugBarWidth / 2, m_UICursorPos.y + ImGui::GetScrollY());
-		drawList->AddRectFilled(dbgPos, ImVec2(dbgPos.x + m_DebugBarWidth, dbgPos.y + m_DebugBarHeight), ImGui::GetColorU32(ImGuiCol_FrameBg));
+		SetSelection(m_SnippetTagStart[0], m_SnippetTagEnd[0]);
+		SetCursorPosition(m_SnippetTagEnd[0]);
+		m_SnippetTagSelected = 0;
+		m_SnippetTagLength = 0;
+		m_SnippetTagPreviousLength = m_SnippetTagEnd[m_SnippetTagSelected].Column - m_SnippetTagStart[m_SnippetTagSelected].Column;
 	}
-}
 
-void ImTextEdit::OpenFunctionDeclarationTooltip(const std::string& obj, ImTextEdit::Coordinates coord)
-{
-	if (m_ACFunctions.count(obj))
-	{
-		m_FunctionDeclarationTooltip = true;
-		m_FunctionDeclarationCoord = FindWordStart(coord);
-		m_FunctionDeclaration = BuildFunctionDef(obj, m_LanguageDefinition.Name);
+	m_RequestAutocomplete = false;
+	m_ACOpened = false;
+	m_ACObject = "";
+
+	undo.After = m_State;
+
+	while (undoPopCount-- != 0)
+	{
+		m_UndoIndex--;
+		m_UndoBuffer.pop_back();
 	}
+	
+	AddUndo(undo);
 }
 
-std::string ImTextEdit::BuildFunctionDef(const std::string& func, const std::string& lang)
+void ImTextEdit::BuildMemberSuggestions(bool* keepACOpened)
 {
-	if (m_ACFunctions.count(func) == 0)
-		return "";
+	m_ACSuggestions.clear();
 
-	const auto& funcDef = m_ACFunctions[func];
+	auto curPos = GetCorrectCursorPosition();
+	std::string obj = GetWordAt(curPos);
 
-	std::string ret = BuildVariableType(funcDef.ReturnType, lang) + " " + func + "(";
+	ed::SPIRVParser::Variable* var = nullptr;
 
-	for (size_t i = 0; i < funcDef.Arguments.size(); i++)
+	for (auto& func : m_ACFunctions)
 	{
-		ret += BuildVariableType(funcDef.Arguments[i], lang) + " " + funcDef.Arguments[i].Name;
+		// suggest arguments and locals
+		if (m_State.CursorPosition.Line >= func.second.LineStart - 2 && m_State.CursorPosition.Line <= func.second.LineEnd + 1)
+		{
+			// locals
+			for (auto& loc : func.second.Locals)
+			{
+				if (strcmp(loc.Name.c_str(), obj.c_str()) == 0)
+				{
+					var = &loc;
+					break;
+				}
+			}
 
-		if (i != funcDef.Arguments.size() - 1)
-			ret += ", ";
+			// arguments
+			if (var == nullptr)
+			{
+				for (auto& arg : func.second.Arguments)
+				{
+					if (strcmp(arg.Name.c_str(), obj.c_str()) == 0)
+					{
+						var = &arg;
+						break;
+					}
+				}
+			}
+		}
 	}
 
-	return ret + ")";
-}
-std::string ImTextEdit::BuildVariableType(const ed::SPIRVParser::Variable& var, const std::string& lang)
-{
-	switch (var.Type)
-	{
-	case ed::SPIRVParser::ValueType::Bool:
-		return "bool";
-	case ed::SPIRVParser::ValueType::Float:
-		return "float";
-	case ed::SPIRVParser::ValueType::Int:
-		return "int";
-	case ed::SPIRVParser::ValueType::Void:
-		return "void";
-	case ed::SPIRVParser::ValueType::Struct:
-		return var.TypeName;
-	case ed::SPIRVParser::ValueType::Vector:
+	if (var == nullptr)
 	{
-		std::string count = std::string(1, var.TypeComponentCount + '0');
-		if (lang == "HLSL")
+		for (auto& uni : m_ACUniforms)
 		{
-			switch (var.BaseType)
+			if (strcmp(uni.Name.c_str(), obj.c_str()) == 0)
 			{
-			case ed::SPIRVParser::ValueType::Bool:
-				return "bool" + count;
-
-			case ed::SPIRVParser::ValueType::Float:
-				return "float" + count;
-
-			case ed::SPIRVParser::ValueType::Int:
-				return "int" + count;
+				var = &uni;
+				break;
 			}
 		}
-		else
+	}
+
+	if (var == nullptr)
+	{
+		for (auto& glob : m_ACGlobals)
 		{
-			switch (var.BaseType)
+			if (strcmp(glob.Name.c_str(), obj.c_str()) == 0)
 			{
-			case ed::SPIRVParser::ValueType::Bool:
-				return "bvec" + count;
+				var = &glob;
+				break;
+			}
+		}
+	}
 
-			case ed::SPIRVParser::ValueType::Float:
-				return "vec" + count;
+	if (var != nullptr)
+	{
+		m_ACIndex = 0;
+		m_ACSwitched = false;
 
-			case ed::SPIRVParser::ValueType::Int:
-				return "ivec" + count;
+		if (var->TypeName.size() > 0 && var->TypeName[0] != 0)
+		{
+			for (const auto& uType : m_ACUserTypes)
+			{
+				if (uType.first == var->TypeName)
+				{
+					for (const auto& uMember : uType.second)
+						m_ACSuggestions.push_back(std::make_pair(uMember.Name, uMember.Name));
+				}
 			}
+
+			if (m_ACSuggestions.size() > 0)
+				m_ACObject = var->TypeName;
 		}
-		break;
 	}
 
-	case ed::SPIRVParser::ValueType::Matrix:
+	if (m_ACSuggestions.size() > 0)
 	{
-		std::string count = std::string(1, var.TypeComponentCount + '0');
-		if (lang == "HLSL")
-			return "float" + count + "x" + count;
-		else
-			return "mat" + count;
+		m_ACOpened = true;
+		m_ACWord = "";
 
-		break;
-	}
-	}
+		if (keepACOpened != nullptr)
+			*keepACOpened = true;
 
-	return "";
-}
+		Coordinates curCursor = GetCursorPosition();
 
-void ImTextEdit::RemoveFolds(const Coordinates& aStart, const Coordinates& aEnd)
-{
-	RemoveFolds(m_FoldBegin, aStart, aEnd);
-	RemoveFolds(m_FoldEnd, aStart, aEnd);
+		m_ACPosition = FindWordStart(curCursor);
+	}
 }
-void ImTextEdit::RemoveFolds(std::vector<Coordinates>& folds, const Coordinates& aStart, const Coordinates& aEnd)
+void ImTextEdit::BuildSuggestions(bool* keepACOpened)
 {
-	bool deleteFullyLastLine = false;
+	m_ACWord = GetWordUnderCursor();
 
-	if (aEnd.Line >= m_Lines.size() || aEnd.Column >= 100000)
-		deleteFullyLastLine = true;
+	bool isValid = false;
+	
+	for (int i = 0; i < m_ACWord.size(); i++)
+	{
+		if ((m_ACWord[i] >= 'a' && m_ACWord[i] <= 'z') || (m_ACWord[i] >= 'A' && m_ACWord[i] <= 'Z'))
+		{
+			isValid = true;
+			break;
+		}
+	}
 
-	for (int i = 0; i < folds.size(); i++)
+	if (isValid)
 	{
-		if (folds[i].Line >= aStart.Line && folds[i].Line <= aEnd.Line)
+		m_ACSuggestions.clear();
+		m_ACIndex = 0;
+		m_ACSwitched = false;
+
+		std::string acWord = m_ACWord;
+		std::transform(acWord.begin(), acWord.end(), acWord.begin(), tolower);
+
+		struct ACEntry
 		{
-			if (folds[i].Line == aStart.Line && aStart.Line != aEnd.Line)
+			ACEntry(const std::string& str, const std::string& val, int loc)
 			{
-				if (folds[i].Column >= aStart.Column)
-				{
-					folds.erase(folds.begin() + i);
-					m_FoldSorted = false;
-					i--;
-				}
+				DisplayString = str;
+				Value = val;
+				Location = loc;
 			}
-			else if (folds[i].Line == aEnd.Line)
-			{
-				if (folds[i].Column < aEnd.Column)
-				{
-					if (aEnd.Line != aStart.Line || folds[i].Column >= aStart.Column)
-					{
-						folds.erase(folds.begin() + i);
-						m_FoldSorted = false;
-						i--;
-					}
-				}
-				else
-				{
-					if (aEnd.Line == aStart.Line)
-					{
-						folds[i].Column = std::max<int>(0, folds[i].Column - (aEnd.Column - aStart.Column));
-					}
-					else
-					{
-						// calculate new
-						if (aStart.Line < m_Lines.size())
-						{
-							auto* line = &m_Lines[aStart.Line];
-							int colOffset = 0;
-							int chi = 0;
-							bool skipped = false;
-							int bracketEndChIndex = GetCharacterIndex(m_FoldEnd[i]);
-
-							while (chi < (int)line->size() && (!skipped || (skipped && chi < bracketEndChIndex)))
-							{
-								auto c = (*line)[chi].Character;
-								chi += UTF8CharLength(c);
 
-								if (c == '\t')
-									colOffset = (colOffset / m_TabSize) * m_TabSize + m_TabSize;
-								else
-									colOffset++;
-
-								// go to the last line
-								if (chi == line->size() && aEnd.Line < m_Lines.size() && !skipped)
-								{
-									chi = GetCharacterIndex(aEnd);
-									line = &m_Lines[aEnd.Line];
-									skipped = true;
-								}
-							}
+			std::string DisplayString;
+			std::string Value;
+			int Location;
+		};
 
-							folds[i].Column = colOffset;
-						}
+		std::vector<ACEntry> weights;
 
-						folds[i].Line -= (aEnd.Line - aStart.Line);
-					}
-				}
-			}
-			else
-			{
-				folds.erase(folds.begin() + i);
-				m_FoldSorted = false;
-				i--;
-			}
-		}
-		else if (folds[i].Line > aEnd.Line)
+		if (m_ACObject.empty())
 		{
-			folds[i].Line -= (aEnd.Line - aStart.Line) + deleteFullyLastLine;
-		}
-	}
-}
-
-std::string ImTextEdit::AutcompleteParse(const std::string& str, const Coordinates& start)
-{
-	const char* buffer = str.c_str();
-	const char* tagPlaceholderStart = buffer;
-	const char* tagStart = buffer;
+			// get the words
+			for (int i = 0; i < m_ACEntrySearch.size(); i++)
+			{
+				std::string lwrStr = m_ACEntrySearch[i];
+				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
 
-	bool parsingTag = false;
-	bool parsingTagPlaceholder = false;
+				size_t loc = lwrStr.find(acWord);
 
-	std::vector<int> tagIds, tagLocations, tagLengths;
-	std::unordered_map<int, std::string> tagPlaceholders;
+				if (loc != std::string::npos)
+					weights.push_back(ACEntry(m_ACEntries[i].first, m_ACEntries[i].second, loc));
+			}
 
-	m_SnippetTagStart.clear();
-	m_SnippetTagEnd.clear();
-	m_SnippetTagID.clear();
-	m_SnippetTagHighlight.clear();
+			for (auto& func : m_ACFunctions)
+			{
+				std::string lwrStr = func.first;
+				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
 
-	Coordinates cursor = start, tagStartCoord, tagEndCoord;
+				// suggest arguments and locals
+				if (m_State.CursorPosition.Line >= func.second.LineStart - 2 && m_State.CursorPosition.Line <= func.second.LineEnd + 1)
+				{
+					// locals
+					for (auto& loc : func.second.Locals)
+					{
+						std::string lwrLoc = loc.Name;
+						std::transform(lwrLoc.begin(), lwrLoc.end(), lwrLoc.begin(), tolower);
 
-	int tagId = -1;
-	int modif = 0;
+						size_t location = lwrLoc.find(acWord);
+						if (location != std::string::npos)
+							weights.push_back(ACEntry(loc.Name, loc.Name, location));
+					}
 
-	while (*buffer != '\0')
-	{
-		if (*buffer == '{' && *(buffer + 1) == '$')
-		{
-			parsingTagPlaceholder = false;
-			parsingTag = true;
-			tagId = -1;
-			tagStart = buffer;
+					// arguments
+					for (auto& arg : func.second.Arguments)
+					{
+						std::string lwrLoc = arg.Name;
+						std::transform(lwrLoc.begin(), lwrLoc.end(), lwrLoc.begin(), tolower);
 
-			tagStartCoord = cursor;
+						size_t loc = lwrLoc.find(acWord);
+						if (loc != std::string::npos)
+							weights.push_back(ACEntry(arg.Name, arg.Name, loc));
+					}
+				}
 
-			const char* skipBuffer = buffer;
-			char** endLoc = const_cast<char**>(&buffer); // oops
-			tagId = strtol(buffer + 2, endLoc, 10);
+				size_t loc = lwrStr.find(acWord);
 
-			cursor.Column += *endLoc - skipBuffer;
+				if (loc != std::string::npos)
+				{
+					std::string val = func.first;
+					if (m_CompleteBraces) val += "()";
+					weights.push_back(ACEntry(func.first, val, loc));
+				}
+			}
 
-			if (*buffer == ':')
+			for (auto& uni : m_ACUniforms)
 			{
-				tagPlaceholderStart = buffer + 1;
-				parsingTagPlaceholder = true;
-			}
-		}
+				std::string lwrStr = uni.Name;
+				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
 
-		if (*buffer == '}' && parsingTag)
-		{
-			std::string tagPlaceholder = "";
+				size_t loc = lwrStr.find(acWord);
+				
+				if (loc != std::string::npos)
+					weights.push_back(ACEntry(uni.Name, uni.Name, loc));
+			}
+			for (auto& glob : m_ACGlobals)
+			{
+				std::string lwrStr = glob.Name;
+				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
 
-			if (parsingTagPlaceholder)
-				tagPlaceholder = std::string(tagPlaceholderStart, buffer - tagPlaceholderStart);
+				size_t loc = lwrStr.find(acWord);
 
-			tagIds.push_back(tagId);
-			tagLocations.push_back(tagStart - str.c_str());
-			tagLengths.push_back(buffer - tagStart + 1);
+				if (loc != std::string::npos)
+					weights.push_back(ACEntry(glob.Name, glob.Name, loc));
+			}
 			
-			if (!tagPlaceholder.empty() || tagPlaceholders.count(tagId) == 0)
+			for (auto& utype : m_ACUserTypes)
 			{
-				if (tagPlaceholder.empty())
-					tagPlaceholder = " ";
+				std::string lwrStr = utype.first;
+				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
 
-				tagStartCoord.Column = std::max<int>(0, tagStartCoord.Column - modif);
-				tagEndCoord = tagStartCoord;
-				tagEndCoord.Column += tagPlaceholder.size();
+				size_t loc = lwrStr.find(acWord);
+			
+				if (loc != std::string::npos)
+					weights.push_back(ACEntry(utype.first, utype.first, loc));
+			}
 
-				m_SnippetTagStart.push_back(tagStartCoord);
-				m_SnippetTagEnd.push_back(tagEndCoord);
-				m_SnippetTagID.push_back(tagId);
-				m_SnippetTagHighlight.push_back(true);
+			for (auto& str : m_LanguageDefinition.Keywords)
+			{
+				std::string lwrStr = str;
+				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
 
-				tagPlaceholders[tagId] = tagPlaceholder;
+				size_t loc = lwrStr.find(acWord);
+				
+				if (loc != std::string::npos)
+					weights.push_back(ACEntry(str, str, loc));
 			}
-			else
+
+			for (auto& str : m_LanguageDefinition.Identifiers)
 			{
-				tagStartCoord.Column = std::max<int>(0, tagStartCoord.Column - modif);
-				tagEndCoord = tagStartCoord;
-				tagEndCoord.Column += tagPlaceholders[tagId].size();
+				std::string lwrStr = str.first;
+				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
 
-				m_SnippetTagStart.push_back(tagStartCoord);
-				m_SnippetTagEnd.push_back(tagEndCoord);
-				m_SnippetTagID.push_back(tagId);
-				m_SnippetTagHighlight.push_back(false);
+				size_t loc = lwrStr.find(acWord);
+				
+				if (loc != std::string::npos)
+				{
+					std::string val = str.first;
+					
+					if (m_CompleteBraces) val += "()";
+					weights.push_back(ACEntry(str.first, val, loc));
+				}
 			}
+		}
+		else
+		{
+			for (const auto& uType : m_ACUserTypes)
+			{
+				if (uType.first == m_ACObject)
+				{
+					for (const auto& uMember : uType.second)
+					{
 
-			modif += (tagLengths.back() - tagPlaceholders[tagId].size());
+						std::string lwrStr = uMember.Name;
+						std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
 
-			parsingTagPlaceholder = false;
-			parsingTag = false;
-			tagId = -1;
+						size_t loc = lwrStr.find(acWord);
+						
+						if (loc != std::string::npos)
+							weights.push_back(ACEntry(uMember.Name, uMember.Name, loc));
+					}
+				}
+			}
 		}
 
-		if (*buffer == '\n')
+		// build the actual list
+		for (const auto& entry : weights)
 		{
-			cursor.Line++;
-			cursor.Column = 0;
-			modif = 0;
+			if (entry.Location == 0)
+				m_ACSuggestions.push_back(std::make_pair(entry.DisplayString, entry.Value));
 		}
-		else
+
+		for (const auto& entry : weights)
 		{
-			cursor.Column++;
+			if (entry.Location != 0)
+				m_ACSuggestions.push_back(std::make_pair(entry.DisplayString, entry.Value));
 		}
 
-		buffer++;
-	}
+		if (m_ACSuggestions.size() > 0)
+		{
+			m_ACOpened = true;
 
-	m_IsSnippet = !tagIds.empty();
+			if (keepACOpened != nullptr)
+				*keepACOpened = true;
 
-	std::string ret = str;
-	
-	for (int i = tagLocations.size() - 1; i >= 0; i--)
-	{
-		ret.erase(tagLocations[i], tagLengths[i]);
-		ret.insert(tagLocations[i], tagPlaceholders[tagIds[i]]);
-	}
+			Coordinates curCursor = GetCursorPosition();
+			curCursor.Column--;
 
-	return ret;
+			m_ACPosition = FindWordStart(curCursor);
+		}
+	}
 }
-void ImTextEdit::AutocompleteSelect()
-{
-	UndoRecord undo;
-	undo.Before = m_State;
-
-	auto curCoord = GetCursorPosition();
-	curCoord.Column = std::max<int>(curCoord.Column - 1, 0);
-
-	auto acStart = FindWordStart(curCoord);
-	auto acEnd = FindWordEnd(curCoord);
 
-	if (!m_ACObject.empty())
-		acStart = m_ACPosition;
-
-	undo.AddedStart = acStart;
-	int undoPopCount = std::max(0, acEnd.Column - acStart.Column) + 1;
+ImVec2 ImTextEdit::CoordinatesToScreenPos(const ImTextEdit::Coordinates& aPosition) const
+{
+	ImVec2 origin = m_UICursorPos;
+	int dist = aPosition.Column;
 
-	if (!m_ACObject.empty() && m_ACWord.empty())
-		undoPopCount = 0;
+	int retY = origin.y + aPosition.Line * m_CharAdvance.y;
+	int retX = origin.x + GetTextStart() * m_CharAdvance.x + dist * m_CharAdvance.x - ImGui::GetScrollX();
 
-	const auto& acEntry = m_ACSuggestions[m_ACIndex];
+	return ImVec2(retX, retY);
+}
 
-	std::string entryText = AutcompleteParse(acEntry.second, acStart);
+void ImTextEdit::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
+{
+	m_WithinRender = true;
+	m_CursorPositionChanged = false;
 
-	if (acStart.Column != acEnd.Column)
-	{
-		SetSelection(acStart, acEnd);
-		Backspace();
-	}
+	m_FindOrigin = ImGui::GetCursorScreenPos();
+	float windowWidth = m_WindowWidth = ImGui::GetWindowWidth();
 	
-	AppendText(entryText, true);
-
-	undo.Added = entryText;
-	undo.AddedEnd = GetActualCursorCoordinates();
-
-	if (m_IsSnippet && m_SnippetTagStart.size() > 0)
-	{
-		SetSelection(m_SnippetTagStart[0], m_SnippetTagEnd[0]);
-		SetCursorPosition(m_SnippetTagEnd[0]);
-		m_SnippetTagSelected = 0;
-		m_SnippetTagLength = 0;
-		m_SnippetTagPreviousLength = m_SnippetTagEnd[m_SnippetTagSelected].Column - m_SnippetTagStart[m_SnippetTagSelected].Column;
-	}
-
-	m_RequestAutocomplete = false;
-	m_ACOpened = false;
-	m_ACObject = "";
-
-	undo.After = m_State;
-
-	while (undoPopCount-- != 0)
+	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::ColorConvertU32ToFloat4(m_Palette[(int)PaletteIndex::Background]));
+	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
+	
+	if (!m_IgnoreImGuiChild)
+		ImGui::BeginChild(aTitle, aSize, aBorder, (ImGuiWindowFlags_AlwaysHorizontalScrollbar * m_HorizontalScroll) | ImGuiWindowFlags_NoMove |
+			ImGuiWindowFlags_NoNav);
+	
+	if (m_HandleKeyboardInputs)
 	{
-		m_UndoIndex--;
-		m_UndoBuffer.pop_back();
+		HandleKeyboardInputs();
+		ImGui::PushAllowKeyboardFocus(true);
 	}
-	
-	AddUndo(undo);
-}
 
-void ImTextEdit::BuildMemberSuggestions(bool* keepACOpened)
-{
-	m_ACSuggestions.clear();
+	if (m_HandleMouseInputs)
+		HandleMouseInputs();
 
-	auto curPos = GetCorrectCursorPosition();
-	std::string obj = GetWordAt(curPos);
+	EvictLines();
+	OnLinesLoaded();
+	ColorizeInternal();
+	RenderInternal(aTitle);
 
-	ed::SPIRVParser::Variable* var = nullptr;
+	// a viewer keeps the blocks around the shown lines
+	m_Lines.Touch(m_VisibleLineBegin, m_VisibleLineEnd);
 
-	for (auto& func : m_ACFunctions)
+	// markers
+	if (m_ScrollbarMarkers)
 	{
-		// suggest arguments and locals
-		if (m_State.CursorPosition.Line >= func.second.LineStart - 2 && m_State.CursorPosition.Line <= func.second.LineEnd + 1)
+		ImGuiWindow* window = ImGui::GetCurrentWindowRead();
+	
+		if (window->ScrollbarY)
 		{
-			// locals
-			for (auto& loc : func.second.Locals)
-			{
-				if (strcmp(loc.Name.c_str(), obj.c_str()) == 0)
-				{
-					var = &loc;
-					break;
-				}
+			ImDrawList* drawList = ImGui::GetWindowDrawList();
+			ImRect scrollBarRect = ImGui::GetWindowScrollbarRect(window, ImGuiAxis_Y);
+			ImGui::PushClipRect(scrollBarRect.Min, scrollBarRect.Max, false);
+			int mSelectedLine = m_State.CursorPosition.Line;
+
+			// current line marker
+			if (mSelectedLine != 0)
+			{
+				float lineStartY = std::round(scrollBarRect.Min.y + (mSelectedLine - 0.5f) / m_Lines.size() * scrollBarRect.GetHeight());
+				drawList->AddLine(ImVec2(scrollBarRect.Min.x, lineStartY), ImVec2(scrollBarRect.Max.x, lineStartY), (m_Palette[(int)PaletteIndex::Default] & 0x00FFFFFFu) | 0x83000000u, 3);
 			}
 
-			// arguments
-			if (var == nullptr)
+			// changed lines marker
+			for (int line : m_ChangedLines)
 			{
-				for (auto& arg : func.second.Arguments)
-				{
-					if (strcmp(arg.Name.c_str(), obj.c_str()) == 0)
-					{
-						var = &arg;
-						break;
-					}
-				}
+				float lineStartY = std::round(scrollBarRect.Min.y + (float(line) - 0.5f) / m_Lines.size() * scrollBarRect.GetHeight());
+				float lineEndY = std::round(scrollBarRect.Min.y + (float(line+1) - 0.5f) / m_Lines.size() * scrollBarRect.GetHeight());
+				drawList->AddRectFilled(ImVec2(scrollBarRect.Min.x + scrollBarRect.GetWidth() * 0.6f, lineStartY), ImVec2(scrollBarRect.Min.x + scrollBarRect.GetWidth(), lineEndY), 0xFF8CE6F0);
 			}
-		}
-	}
 
-	if (var == nullptr)
-	{
-		for (auto& uni : m_ACUniforms)
-		{
-			if (strcmp(uni.Name.c_str(), obj.c_str()) == 0)
+			// error markers
+			for (auto& error : m_ErrorMarkers)
 			{
-				var = &uni;
-				break;
+				float lineStartY = std::round(scrollBarRect.Min.y + (float(error.first) - 0.5f) / m_Lines.size() * scrollBarRect.GetHeight());
+				drawList->AddRectFilled(ImVec2(scrollBarRect.Min.x, lineStartY), ImVec2(scrollBarRect.Min.x + scrollBarRect.GetWidth() * 0.4f, lineStartY + 6.0f), m_Palette[(int)PaletteIndex::ErrorMarker]);
 			}
+
+			ImGui::PopClipRect();
 		}
 	}
 
-	if (var == nullptr)
+	if (ImGui::IsMouseClicked(1))
 	{
-		for (auto& glob : m_ACGlobals)
-		{
-			if (strcmp(glob.Name.c_str(), obj.c_str()) == 0)
-			{
-				var = &glob;
-				break;
-			}
-		}
+		m_RightClickPos = ImGui::GetMousePos();
+		
+		if (ImGui::IsWindowHovered())
+			SetCursorPosition(ScreenPosToCoordinates(m_RightClickPos));
 	}
 
-	if (var != nullptr)
+	bool openBkptConditionWindow = false;
+
+	if (ImGui::BeginPopupContextItem(("##edcontext" + std::string(aTitle)).c_str()))
 	{
-		m_ACIndex = 0;
-		m_ACSwitched = false;
+		if (m_RightClickPos.x - m_UICursorPos.x > ImGui::GetStyle().WindowPadding.x + s_DebugDataSpace)
+		{
+			if (ImGui::Selectable("Cut"))
+				Cut();
 
-		if (var->TypeName.size() > 0 && var->TypeName[0] != 0)
+			if (ImGui::Selectable("Copy"))
+				Copy();
+
+			if (ImGui::Selectable("Paste"))
+				Paste();
+		}
+		else
 		{
-			for (const auto& uType : m_ACUserTypes)
+			int line = ScreenPosToCoordinates(m_RightClickPos).Line + 1;
+
+			if (IsDebugging() && ImGui::Selectable("Jump") && OnDebuggerJump)
+				OnDebuggerJump(this, line);
+
+			if (ImGui::Selectable("Breakpoint"))
+				AddBreakpoint(line);
+
+			if (HasBreakpoint(line))
 			{
-				if (uType.first == var->TypeName)
+				const auto& bkpt = GetBreakpoint(line);
+				bool isEnabled = bkpt.Enabled;
+
+				if (ImGui::Selectable("Condition"))
 				{
-					for (const auto& uMember : uType.second)
-						m_ACSuggestions.push_back(std::make_pair(uMember.Name, uMember.Name));
+					m_PopupCondition_Line = line;
+					m_PopupCondition_Use = bkpt.UseCondition;
+					memcpy(m_PopupCondition_Condition, bkpt.Condition.c_str(), bkpt.Condition.size());
+					m_PopupCondition_Condition[std::min<size_t>(511, bkpt.Condition.size())] = 0;
+					openBkptConditionWindow = true;
 				}
-			}
 
-			if (m_ACSuggestions.size() > 0)
-				m_ACObject = var->TypeName;
+				if (ImGui::Selectable(isEnabled ? "Disable" : "Enable"))
+					SetBreakpointEnabled(line, !isEnabled);
+
+				if (ImGui::Selectable("Delete"))
+					RemoveBreakpoint(line);
+			}
 		}
+
+		ImGui::EndPopup();
 	}
 
-	if (m_ACSuggestions.size() > 0)
+	/* FIND TEXT WINDOW */
+	if (m_FindOpened)
 	{
-		m_ACOpened = true;
-		m_ACWord = "";
-
-		if (keepACOpened != nullptr)
-			*keepACOpened = true;
-
-		Coordinates curCursor = GetCursorPosition();
+		ImFont* font = ImGui::GetFont();
+		ImGui::PushFont(font);
 
-		m_ACPosition = FindWordStart(curCursor);
-	}
-}
-void ImTextEdit::BuildSuggestions(bool* keepACOpened)
-{
-	m_ACWord = GetWordUnderCursor();
+		ImGui::SetNextWindowPos(ImVec2(m_FindOrigin.x + windowWidth - UICalculateSize(250), m_FindOrigin.y + UICalculateSize(50) * (IsDebugging() && m_DebugBar)), ImGuiCond_Always);
+		ImGui::BeginChild(("##ted_findwnd" + std::string(aTitle)).c_str(), ImVec2(UICalculateSize(220), UICalculateSize(m_ReplaceOpened ? 90 : 40)), true, ImGuiWindowFlags_NoScrollbar);
 
-	bool isValid = false;
-	
-	for (int i = 0; i < m_ACWord.size(); i++)
-	{
-		if ((m_ACWord[i] >= 'a' && m_ACWord[i] <= 'z') || (m_ACWord[i] >= 'A' && m_ACWord[i] <= 'Z'))
+		// check for findnext shortcut here...
+		ShortcutID curActionID = ShortcutID::Count;
+		ImGuiIO& io = ImGui::GetIO();
+		auto shift = io.KeyShift;
+		auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
+		auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+		
+		for (int i = 0; i < m_Shortcuts.size(); i++)
 		{
-			isValid = true;
-			break;
-		}
-	}
+			auto sct = m_Shortcuts[i];
 
-	if (isValid)
-	{
-		m_ACSuggestions.clear();
-		m_ACIndex = 0;
-		m_ACSwitched = false;
+			if (sct.Key1 == -1)
+				continue;
 
-		std::string acWord = m_ACWord;
-		std::transform(acWord.begin(), acWord.end(), acWord.begin(), tolower);
+			int sc1 = ::GetAsyncKeyState(sct.Key1) & 0x8000 ? sct.Key1 : -1;
 
-		struct ACEntry
-		{
-			ACEntry(const std::string& str, const std::string& val, int loc)
+			if (ImGui::IsKeyPressed(sc1) && ((sct.Key2 != -1 && ImGui::IsKeyPressed(sct.Key2))) || sct.Key2 == -1)
 			{
-				DisplayString = str;
-				Value = val;
-				Location = loc;
+				if (((sct.Ctrl == 0 && !ctrl) || (sct.Ctrl == 1 && ctrl) || (sct.Ctrl == 2)) &&		// ctrl check
+					((sct.Alt == 0 && !alt) || (sct.Alt == 1 && alt) || (sct.Alt == 2)) &&			// alt check
+					((sct.Shift == 0 && !shift) || (sct.Shift == 1 && shift) || (sct.Shift == 2)))  // shift check
+				{
+				
+					curActionID = (ImTextEdit::ShortcutID)i;
+				}
 			}
+		}
 
-			std::string DisplayString;
-			std::string Value;
-			int Location;
-		};
-
-		std::vector<ACEntry> weights;
+		m_FindNext = curActionID == ImTextEdit::ShortcutID::FindNext;
 
-		if (m_ACObject.empty())
+		if (m_FindJustOpened)
 		{
-			// get the words
-			for (int i = 0; i < m_ACEntrySearch.size(); i++)
-			{
-				std::string lwrStr = m_ACEntrySearch[i];
-				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+			std::string txt = GetSelectedText();
+			if (txt.size() > 0)
+				strcpy(m_FindWord, txt.c_str());
+		}
 
-				size_t loc = lwrStr.find(acWord);
+		ImGui::PushItemWidth(UICalculateSize(-45));
 
-				if (loc != std::string::npos)
-					weights.push_back(ACEntry(m_ACEntries[i].first, m_ACEntries[i].second, loc));
-			}
+		if (ImGui::InputText(("##ted_findtextbox" + std::string(aTitle)).c_str(), m_FindWord, 256, ImGuiInputTextFlags_EnterReturnsTrue) || m_FindNext)
+		{
+			auto curPos = m_State.CursorPosition;
+			size_t cindex = CoordinatesToOffset(curPos);
 
-			for (auto& func : m_ACFunctions)
-			{
-				std::string lwrStr = func.first;
-				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+			std::string wordLower = m_FindWord;
+			std::transform(wordLower.begin(), wordLower.end(), wordLower.begin(), ::tolower);
 
-				// suggest arguments and locals
-				if (m_State.CursorPosition.Line >= func.second.LineStart - 2 && m_State.CursorPosition.Line <= func.second.LineEnd + 1)
-				{
-					// locals
-					for (auto& loc : func.second.Locals)
-					{
-						std::string lwrLoc = loc.Name;
-						std::transform(lwrLoc.begin(), lwrLoc.end(), lwrLoc.begin(), tolower);
+			std::string textSrc = GetText();
+			std::transform(textSrc.begin(), textSrc.end(), textSrc.begin(), ::tolower);
 
-						size_t location = lwrLoc.find(acWord);
-						if (location != std::string::npos)
-							weights.push_back(ACEntry(loc.Name, loc.Name, location));
-					}
+			size_t textLoc = textSrc.find(wordLower, cindex);
 
-					// arguments
-					for (auto& arg : func.second.Arguments)
-					{
-						std::string lwrLoc = arg.Name;
-						std::transform(lwrLoc.begin(), lwrLoc.end(), lwrLoc.begin(), tolower);
+			if (textLoc == std::string::npos)
+				textLoc = textSrc.find(wordLower, 0);
 
-						size_t loc = lwrLoc.find(acWord);
-						if (loc != std::string::npos)
-							weights.push_back(ACEntry(arg.Name, arg.Name, loc));
-					}
-				}
 
-				size_t loc = lwrStr.find(acWord);
+			if (textLoc != std::string::npos)
+			{
+				curPos = OffsetToCoordinates(textLoc);
+				auto selEnd = OffsetToCoordinates(textLoc + wordLower.size());
+				SetSelection(curPos, selEnd);
+				SetCursorPosition(selEnd);
+				m_ScrollToCursor = true;
 
-				if (loc != std::string::npos)
-				{
-					std::string val = func.first;
-					if (m_CompleteBraces) val += "()";
-					weights.push_back(ACEntry(func.first, val, loc));
-				}
+				if (!m_FindNext)
+					ImGui::SetKeyboardFocusHere(0);
 			}
 
-			for (auto& uni : m_ACUniforms)
-			{
-				std::string lwrStr = uni.Name;
-				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+			m_FindNext = false;
+		}
+		
+		if (ImGui::IsItemActive())
+			m_FindFocused = true;
+		else
+			m_FindFocused = false;
+
+		if (m_FindJustOpened)
+		{
+			ImGui::SetKeyboardFocusHere(0);
+			m_FindJustOpened = false;
+		}
+
+		ImGui::PopItemWidth();
+
+		if (!m_ReadOnly)
+		{
+			ImGui::SameLine();
+			
+			if (ImGui::ArrowButton(("##expandFind" + std::string(aTitle)).c_str(), m_ReplaceOpened ? ImGuiDir_Up : ImGuiDir_Down))
+				m_ReplaceOpened = !m_ReplaceOpened;
+		}
+
+		ImGui::SameLine();
 
-				size_t loc = lwrStr.find(acWord);
-				
-				if (loc != std::string::npos)
-					weights.push_back(ACEntry(uni.Name, uni.Name, loc));
-			}
-			for (auto& glob : m_ACGlobals)
-			{
-				std::string lwrStr = glob.Name;
-				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+		if (ImGui::Button(("X##" + std::string(aTitle)).c_str()))
+			m_FindOpened = false;
 
-				size_t loc = lwrStr.find(acWord);
+		if (m_ReplaceOpened && !m_ReadOnly)
+		{
+			ImGui::PushItemWidth(UICalculateSize(-45));
+			ImGui::NewLine();
+			bool shouldReplace = false;
 
-				if (loc != std::string::npos)
-					weights.push_back(ACEntry(glob.Name, glob.Name, loc));
-			}
+			if (ImGui::InputText(("##ted_replacetb" + std::string(aTitle)).c_str(), m_ReplaceWord, 256, ImGuiInputTextFlags_EnterReturnsTrue))
+				shouldReplace = true;
 			
-			for (auto& utype : m_ACUserTypes)
-			{
-				std::string lwrStr = utype.first;
-				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+			if (ImGui::IsItemActive())
+				m_ReplaceFocused = true;
+			else
+				m_ReplaceFocused = false;
+			ImGui::PopItemWidth();
 
-				size_t loc = lwrStr.find(acWord);
-			
-				if (loc != std::string::npos)
-					weights.push_back(ACEntry(utype.first, utype.first, loc));
-			}
+			ImGui::SameLine();
 
-			for (auto& str : m_LanguageDefinition.Keywords)
+			if (ImGui::Button((">##replaceOne" + std::string(aTitle)).c_str()) || shouldReplace)
 			{
-				std::string lwrStr = str;
-				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
-
-				size_t loc = lwrStr.find(acWord);
+				if (strlen(m_FindWord) > 0)
+				{
+					auto curPos = m_State.CursorPosition;
+					
+					std::string textSrc = GetText();
 				
-				if (loc != std::string::npos)
-					weights.push_back(ACEntry(str, str, loc));
-			}
-
-			for (auto& str : m_LanguageDefinition.Identifiers)
-			{
-				std::string lwrStr = str.first;
-				std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+					if (m_ReplaceIndex >= textSrc.size())
+						m_ReplaceIndex = 0;
 
-				size_t loc = lwrStr.find(acWord);
-				
-				if (loc != std::string::npos)
-				{
-					std::string val = str.first;
+					size_t textLoc = textSrc.find(m_FindWord, m_ReplaceIndex);
 					
-					if (m_CompleteBraces) val += "()";
-					weights.push_back(ACEntry(str.first, val, loc));
+					if (textLoc == std::string::npos)
+					{
+						m_ReplaceIndex = 0;
+						textLoc = textSrc.find(m_FindWord, 0);
+					}
+
+					if (textLoc != std::string::npos)
+					{
+						curPos = OffsetToCoordinates(textLoc);
+						auto selEnd = OffsetToCoordinates(textLoc + strlen(m_FindWord));
+						SetSelection(curPos, selEnd);
+						DeleteSelection();
+						AppendText(m_ReplaceWord);
+						SetCursorPosition(selEnd);
+						m_ScrollToCursor = true;
+
+						ImGui::SetKeyboardFocusHere(0);
+
+						m_ReplaceIndex = textLoc + strlen(m_ReplaceWord);
+					}
 				}
 			}
-		}
-		else
-		{
-			for (const auto& uType : m_ACUserTypes)
+
+			ImGui::SameLine();
+
+			if (ImGui::Button((">>##replaceAll" + std::string(aTitle)).c_str()))
 			{
-				if (uType.first == m_ACObject)
+				if (strlen(m_FindWord) > 0)
 				{
-					for (const auto& uMember : uType.second)
+					auto curPos = m_State.CursorPosition;
+
+					std::string textSrc = GetText();
+					size_t textLoc = textSrc.find(m_FindWord, 0);
+
+					do
 					{
+						if (textLoc != std::string::npos)
+						{
+							curPos = OffsetToCoordinates(textLoc);
+							auto selEnd = OffsetToCoordinates(textLoc + strlen(m_FindWord));
+							SetSelection(curPos, selEnd);
+							DeleteSelection();
+							AppendText(m_ReplaceWord);
+							SetCursorPosition(selEnd);
+							m_ScrollToCursor = true;
 
-						std::string lwrStr = uMember.Name;
-						std::transform(lwrStr.begin(), lwrStr.end(), lwrStr.begin(), tolower);
+							ImGui::SetKeyboardFocusHere(0);
 
-						size_t loc = lwrStr.find(acWord);
-						
-						if (loc != std::string::npos)
-							weights.push_back(ACEntry(uMember.Name, uMember.Name, loc));
+							// find next occurance
+							textSrc = GetText();
+							textLoc += strlen(m_ReplaceWord);
+							textLoc = textSrc.find(m_FindWord, textLoc);
+						}
 					}
+					while (textLoc != std::string::npos);
 				}
 			}
 		}
 
-		// build the actual list
-		for (const auto& entry : weights)
-		{
-			if (entry.Location == 0)
-				m_ACSuggestions.push_back(std::make_pair(entry.DisplayString, entry.Value));
-		}
+		ImGui::EndChild();
 
-		for (const auto& entry : weights)
-		{
-			if (entry.Location != 0)
-				m_ACSuggestions.push_back(std::make_pair(entry.DisplayString, entry.Value));
-		}
+		ImGui::PopFont();
 
-		if (m_ACSuggestions.size() > 0)
-		{
-			m_ACOpened = true;
+		if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape)))
+			m_FindOpened = false;
+	}
 
-			if (keepACOpened != nullptr)
-				*keepACOpened = true;
+	/* DEBUGGER CONTROLS */
+	if (IsDebugging() && m_DebugBar)
+	{
+		ImFont* font = ImGui::GetFont();
+		ImGui::PushFont(font);
 
-			Coordinates curCursor = GetCursorPosition();
-			curCursor.Column--;
 
-			m_ACPosition = FindWordStart(curCursor);
-		}
-	}
-}
+		ImGui::SetNextWindowPos(ImVec2(m_FindOrigin.x + windowWidth / 2 - m_DebugBarWidth / 2, m_FindOrigin.y), ImGuiCond_Always);
+		ImGui::BeginChild(("##ted_dbgcontrols" + std::string(aTitle)).c_str(), ImVec2(m_DebugBarWidth, m_DebugBarHeight), true, ImGuiWindowFlags_NoScrollbar);
 
-ImVec2 ImTextEdit::CoordinatesToScreenPos(const ImTextEdit::Coordinates& aPosition) const
-{
-	ImVec2 origin = m_UICursorPos;
-	int dist = aPosition.Column;
+		ImVec2 dbBarStart = ImGui::GetCursorPos();
 
-	int retY = origin.y + aPosition.Line * m_CharAdvance.y;
-	int retX = origin.x + GetTextStart() * m_CharAdvance.x + dist * m_CharAdvance.x - ImGui::GetScrollX();
+		if (ImGui::Button(("Step##ted_dbgstep" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+			OnDebuggerAction(this, ImTextEdit::DebugAction::Step);
 
-	return ImVec2(retX, retY);
-}
+		ImGui::SameLine(0, 6);
 
-void ImTextEdit::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
-{
-	m_WithinRender = true;
-	m_CursorPositionChanged = false;
+		if (ImGui::Button(("Step In##ted_dbgstepin" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+			OnDebuggerAction(this, ImTextEdit::DebugAction::StepInto);
+		
+		ImGui::SameLine(0, 6);
 
-	m_FindOrigin = ImGui::GetCursorScreenPos();
-	float windowWidth = m_WindowWidth = ImGui::GetWindowWidth();
-	
-	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::ColorConvertU32ToFloat4(m_Palette[(int)PaletteIndex::Background]));
-	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
-	
-	if (!m_IgnoreImGuiChild)
-		ImGui::BeginChild(aTitle, aSize, aBorder, (ImGuiWindowFlags_AlwaysHorizontalScrollbar * m_HorizontalScroll) | ImGuiWindowFlags_NoMove |
-			ImGuiWindowFlags_NoNav);
-	
-	if (m_HandleKeyboardInputs)
-	{
-		HandleKeyboardInputs();
-		ImGui::PushAllowKeyboardFocus(true);
-	}
+		if (ImGui::Button(("Step Out##ted_dbgstepout" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+			OnDebuggerAction(this, ImTextEdit::DebugAction::StepOut);
+		
+		ImGui::SameLine(0, 6);
 
-	if (m_HandleMouseInputs)
-		HandleMouseInputs();
+		if (ImGui::Button(("Continue##ted_dbgcontinue" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+			OnDebuggerAction(this, ImTextEdit::DebugAction::Continue);
+		
+		ImGui::SameLine(0, 6);
 
-	ColorizeInternal();
-	RenderInternal(aTitle);
+		if (ImGui::Button(("Stop##ted_dbgstop" + std::string(aTitle)).c_str()) && OnDebuggerAction)
+			OnDebuggerAction(this, ImTextEdit::DebugAction::Stop);
 
-	// markers
-	if (m_ScrollbarMarkers)
-	{
-		ImGuiWindow* window = ImGui::GetCurrentWindowRead();
-	
-		if (window->ScrollbarY)
-		{
-			ImDrawList* drawList = ImGui::GetWindowDrawList();
-			ImRect scrollBarRect = ImGui::GetWindowScrollbarRect(window, ImGuiAxis_Y);
-			ImGui::PushClipRect(scrollBarRect.Min, scrollBarRect.Max, false);
-			int mSelectedLine = m_State.CursorPosition.Line;
+		ImVec2 dbBarEnd = ImGui::GetCursorPos();
+		m_DebugBarHeight = dbBarEnd.y - dbBarStart.y + ImGui::GetStyle().WindowPadding.y * 2.0f;
 
-			// current line marker
-			if (mSelectedLine != 0)
-			{
-				float lineStartY = std::round(scrollBarRect.Min.y + (mSelectedLine - 0.5f) / m_Lines.size() * scrollBarRect.GetHeight());
-				drawList->AddLine(ImVec2(scrollBarRect.Min.x, lineStartY), ImVec2(scrollBarRect.Max.x, lineStartY), (m_Palette[(int)PaletteIndex::Default] & 0x00FFFFFFu) | 0x83000000u, 3);
-			}
+		ImGui::SameLine(0, 6);
 
-			// changed lines marker
-			for (int line : m_ChangedLines)
-			{
-				float lineStartY = std::round(scrollBarRect.Min.y + (float(line) - 0.5f) / m_Lines.size() * scrollBarRect.GetHeight());
-				float lineEndY = std::round(scrollBarRect.Min.y + (float(line+1) - 0.5f) / m_Lines.size() * scrollBarRect.GetHeight());
-				drawList->AddRectFilled(ImVec2(scrollBarRect.Min.x + scrollBarRect.GetWidth() * 0.6f, lineStartY), ImVec2(scrollBarRect.Min.x + scrollBarRect.GetWidth(), lineEndY), 0xFF8CE6F0);
-			}
+		dbBarEnd = ImGui::GetCursorPos();
+		m_DebugBarWidth = dbBarEnd.x - dbBarStart.x + ImGui::GetStyle().WindowPadding.x * 2.0f;
 
-			// error markers
-			for (auto& error : m_ErrorMarkers)
-			{
-				float lineStartY = std::round(scrollBarRect.Min.y + (float(error.first) - 0.5f) / m_Lines.size() * scrollBarRect.GetHeight());
-				drawList->AddRectFilled(ImVec2(scrollBarRect.Min.x, lineStartY), ImVec2(scrollBarRect.Min.x + scrollBarRect.GetWidth() * 0.4f, lineStartY + 6.0f), m_Palette[(int)PaletteIndex::ErrorMarker]);
-			}
+		ImGui::EndChild();
+
+		ImGui::PopFont();
+	}
+
+	if (m_HandleKeyboardInputs)
+		ImGui::PopAllowKeyboardFocus();
+
+	if (!m_IgnoreImGuiChild)
+		ImGui::EndChild();
+	
+	ImGui::PopStyleColor();
+	ImGui::PopStyleVar();
 
-			ImGui::PopClipRect();
-		}
-	}
+	// breakpoint condition popup
+	if (openBkptConditionWindow)
+		ImGui::OpenPopup("Condition##condition");
 
-	if (ImGui::IsMouseClicked(1))
-	{
-		m_RightClickPos = ImGui::GetMousePos();
-		
-		if (ImGui::IsWindowHovered())
-			SetCursorPosition(ScreenPosToCoordinates(m_RightClickPos));
-	}
+	ImFont* font = ImGui::GetFont();
+	////TODO! 
+	ImGui::PushFont(font);
 
-	bool openBkptConditionWindow = false;
+	ImGui::SetNextWindowSize(ImVec2(430, 175), ImGuiCond_Once);
 
-	if (ImGui::BeginPopupContextItem(("##edcontext" + std::string(aTitle)).c_str()))
+	if (ImGui::BeginPopupModal("Condition##condition"))
 	{
-		if (m_RightClickPos.x - m_UICursorPos.x > ImGui::GetStyle().WindowPadding.x + s_DebugDataSpace)
-		{
-			if (ImGui::Selectable("Cut"))
-				Cut();
-
-			if (ImGui::Selectable("Copy"))
-				Copy();
+		ImGui::Checkbox("Use condition", &m_PopupCondition_Use);
 
-			if (ImGui::Selectable("Paste"))
-				Paste();
+		if (!m_PopupCondition_Use)
+		{
+			ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true);
+			ImGui::PushStyleVar(ImGuiStyleVar_Alpha, ImGui::GetStyle().Alpha * 0.5f);
 		}
-		else
+		
+		ImGui::InputText("Condition", m_PopupCondition_Condition, 512);
+		
+		if (!m_PopupCondition_Use)
 		{
-			int line = ScreenPosToCoordinates(m_RightClickPos).Line + 1;
-
-			if (IsDebugging() && ImGui::Selectable("Jump") && OnDebuggerJump)
-				OnDebuggerJump(this, line);
+			ImGui::PopStyleVar();
+			ImGui::PopItemFlag();
+		}
 
-			if (ImGui::Selectable("Breakpoint"))
-				AddBreakpoint(line);
+		if (ImGui::Button("Cancel"))
+			ImGui::CloseCurrentPopup();
 
-			if (HasBreakpoint(line))
+		ImGui::SameLine();
+		
+		if (ImGui::Button("OK"))
+		{
+			size_t clen = strlen(m_PopupCondition_Condition);
+			bool isEmpty = true;
+			
+			for (size_t i = 0; i < clen; i++)
 			{
-				const auto& bkpt = GetBreakpoint(line);
-				bool isEnabled = bkpt.Enabled;
-
-				if (ImGui::Selectable("Condition"))
+				if (!isspace(m_PopupCondition_Condition[i]))
 				{
-					m_PopupCondition_Line = line;
-					m_PopupCondition_Use = bkpt.UseCondition;
-					memcpy(m_PopupCondition_Condition, bkpt.Condition.c_str(), bkpt.Condition.size());
-					m_PopupCondition_Condition[std::min<size_t>(511, bkpt.Condition.size())] = 0;
-					openBkptConditionWindow = true;
+					isEmpty = false;
+					break;
 				}
+			}
+			Breakpoint& bkpt = GetBreakpoint(m_PopupCondition_Line);
+			bkpt.Condition = m_PopupCondition_Condition;
+			bkpt.UseCondition = (m_PopupCondition_Use && !isEmpty);
 
-				if (ImGui::Selectable(isEnabled ? "Disable" : "Enable"))
-					SetBreakpointEnabled(line, !isEnabled);
+			if (OnBreakpointUpdate)
+				OnBreakpointUpdate(this, bkpt.Line, bkpt.UseCondition, bkpt.Condition, bkpt.Enabled);
 
-				if (ImGui::Selectable("Delete"))
-					RemoveBreakpoint(line);
-			}
+			ImGui::CloseCurrentPopup();
 		}
-
 		ImGui::EndPopup();
 	}
+	////TODO! 
+	ImGui::PopFont();
 
-	/* FIND TEXT WINDOW */
-	if (m_FindOpened)
-	{
-		ImFont* font = ImGui::GetFont();
-		ImGui::PushFont(font);
+	m_WithinRender = false;
+}
 
-		ImGui::SetNextWindowPos(ImVec2(m_FindOrigin.x + windowWidth - UICalculateSize(250), m_FindOrigin.y + UICalculateSize(50) * (IsDebugging() && m_DebugBar)), ImGuiCond_Always);
-		ImGui::BeginChild(("##ted_findwnd" + std::string(aTitle)).c_str(), ImVec2(UICalculateSize(220), UICalculateSize(m_ReplaceOpened ? 90 : 40)), true, ImGuiWindowFlags_NoScrollbar);
+void ImTextEdit::SetText(const std::string & aText)
+{
+	const char* text = aText.data();
 
-		// check for findnext shortcut here...
-		ShortcutID curActionID = ShortcutID::Count;
-		ImGuiIO& io = ImGui::GetIO();
-		auto shift = io.KeyShift;
-		auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
-		auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
-		
-		for (int i = 0; i < m_Shortcuts.size(); i++)
-		{
-			auto sct = m_Shortcuts[i];
+	// every line is sized exactly once its end is known, the last one runs to the end of the text
+	std::vector<size_t> ends;
+	FindLineEnds(text, aText.size(), ends);
+	ends.push_back(aText.size());
 
-			if (sct.Key1 == -1)
-				continue;
+	m_Lines.Reset(ends.size());
+	CloseViewer();
+	m_ColorDirty.clear();
+	m_ColorizeResumeLine = -1;
+	m_FoldIndexDirty = true;
 
-			int sc1 = ::GetAsyncKeyState(sct.Key1) & 0x8000 ? sct.Key1 : -1;
+	ParallelFor(m_Lines.GetBlockCount(), s_MinBlocksPerThread, [&](size_t aFirst, size_t aLast)
+	{
+		for (size_t b = aFirst; b < aLast; b++)
+		{
+			size_t start, count;
+			Line* lines = m_Lines.GetBlockLines(b, start, count);
 
-			if (ImGui::IsKeyPressed(sc1) && ((sct.Key2 != -1 && ImGui::IsKeyPressed(sct.Key2))) || sct.Key2 == -1)
+			for (size_t i = 0; i < count; i++)
 			{
-				if (((sct.Ctrl == 0 && !ctrl) || (sct.Ctrl == 1 && ctrl) || (sct.Ctrl == 2)) &&		// ctrl check
-					((sct.Alt == 0 && !alt) || (sct.Alt == 1 && alt) || (sct.Alt == 2)) &&			// alt check
-					((sct.Shift == 0 && !shift) || (sct.Shift == 1 && shift) || (sct.Shift == 2)))  // shift check
-				{
-				
-					curActionID = (ImTextEdit::ShortcutID)i;
-				}
+				size_t line = start + i;
+				lines[i].assign(text + (line == 0 ? 0 : ends[line - 1] + 1), text + ends[line]);
 			}
 		}
+	});
 
-		m_FindNext = curActionID == ImTextEdit::ShortcutID::FindNext;
+	m_Brackets.Reset((int)m_Lines.size());
+	m_LineWidths.Reset((int)m_Lines.size());
+	m_TextOffsets.Clear();
+	
+	m_TextChanged = true;
+	m_ScrollToTop = true;
 
-		if (m_FindJustOpened)
-		{
-			std::string txt = GetSelectedText();
-			if (txt.size() > 0)
-				strcpy(m_FindWord, txt.c_str());
-		}
+	m_UndoBuffer.clear();
+	m_UndoIndex = 0;
 
-		ImGui::PushItemWidth(UICalculateSize(-45));
+	Colorize();
+}
 
-		if (ImGui::InputText(("##ted_findtextbox" + std::string(aTitle)).c_str(), m_FindWord, 256, ImGuiInputTextFlags_EnterReturnsTrue) || m_FindNext)
-		{
-			auto curPos = m_State.CursorPosition;
-			size_t cindex = 0;
+bool ImTextEdit::LoadFromFile(const std::string& aPath)
+{
+	auto file = std::make_shared<MappedFile>();
+	if (!file->Open(aPath))
+		return false;
 
-			for (size_t ln = 0; ln < curPos.Line; ln++)
-				cindex += GetLineCharacterCount(ln) + 1;
-			
-			cindex += curPos.Column;
+	m_Lines.Map(file);
+	CloseViewer();
+	m_ColorDirty.clear();
+	m_ColorizeResumeLine = -1;
+	m_FoldIndexDirty = true;
 
-			std::string wordLower = m_FindWord;
-			std::transform(wordLower.begin(), wordLower.end(), wordLower.begin(), ::tolower);
+	// nothing is measured or summarized up front, that happens as the lines are loaded
+	m_Brackets.ResetEmpty((int)m_Lines.size());
+	m_LineWidths.Reset((int)m_Lines.size());
+	m_TextOffsets.Clear();
 
-			std::string textSrc = GetText();
-			std::transform(textSrc.begin(), textSrc.end(), textSrc.begin(), ::tolower);
+	m_TextChanged = true;
+	m_ScrollToTop = true;
 
-			size_t textLoc = textSrc.find(wordLower, cindex);
+	m_UndoBuffer.clear();
+	m_UndoIndex = 0;
 
-			if (textLoc == std::string::npos)
-				textLoc = textSrc.find(wordLower, 0);
+	m_DocumentVersion++;
+	InvalidateRenderCache();
 
+	return true;
+}
 
-			if (textLoc != std::string::npos)
-			{
-				curPos.Line = curPos.Column = 0;
-				cindex = 0;
+bool ImTextEdit::OpenViewer(const std::string& aPath)
+{
+	if (!LoadFromFile(aPath))
+		return false;
 
-				for (size_t ln = 0; ln < m_Lines.size(); ln++)
-				{
-					int charCount = GetLineCharacterCount(ln) + 1;
-				
-					if (cindex + charCount > textLoc)
-					{
-						curPos.Line = ln;
-						curPos.Column = textLoc - cindex;
+	m_Lines.SetResidentLimit(s_ViewerResidentBlocks);
+	m_Viewer = true;
+	m_ViewerReadOnly = m_ReadOnly;
+	m_ReadOnly = true;
 
-						auto& line = m_Lines[curPos.Line];
+	return true;
+}
 
-						for (int i = 0; i < line.size(); i++)
-						{
-							if (line[i].Character == '\t')
-								curPos.Column += (m_TabSize - 1);
-						}
+void ImTextEdit::CloseViewer()
+{
+	if (!m_Viewer)
+		return;
 
-						break;
-					}
-					else // just keep adding
-					{
-						cindex += charCount;
-					}
-				}
+	m_Viewer = false;
+	m_ReadOnly = m_ViewerReadOnly;
+}
 
-				auto selStart = curPos, selEnd = curPos;
-				selEnd.Column += strlen(m_FindWord);
-				SetSelection(curPos, selEnd);
-				SetCursorPosition(selEnd);
-				m_ScrollToCursor = true;
+void ImTextEdit::SetTextLines(const std::vector<std::string> & aLines)
+{
+	m_Lines.Reset(std::max<size_t>(aLines.size(), 1));
+	CloseViewer();
+	m_ColorDirty.clear();
+	m_ColorizeResumeLine = -1;
+	m_FoldIndexDirty = true;
 
-				if (!m_FindNext)
-					ImGui::SetKeyboardFocusHere(0);
-			}
+	ParallelFor(aLines.empty() ? 0 : m_Lines.GetBlockCount(), s_MinBlocksPerThread, [&](size_t aFirst, size_t aLast)
+	{
+		for (size_t b = aFirst; b < aLast; b++)
+		{
+			size_t start, count;
+			Line* lines = m_Lines.GetBlockLines(b, start, count);
 
-			m_FindNext = false;
+			for (size_t i = 0; i < count; i++)
+			{
+				const std::string & aLine = aLines[start + i];
+				lines[i].assign(aLine.data(), aLine.data() + aLine.size());
+			}
 		}
-		
-		if (ImGui::IsItemActive())
-			m_FindFocused = true;
-		else
-			m_FindFocused = false;
+	});
 
-		if (m_FindJustOpened)
-		{
-			ImGui::SetKeyboardFocusHere(0);
-			m_FindJustOpened = false;
-		}
+	m_Brackets.Reset((int)m_Lines.size());
+	m_LineWidths.Reset((int)m_Lines.size());
+	m_TextOffsets.Clear();
 
-		ImGui::PopItemWidth();
+	m_TextChanged = true;
+	m_ScrollToTop = true;
 
-		if (!m_ReadOnly)
-		{
-			ImGui::SameLine();
-			
-			if (ImGui::ArrowButton(("##expandFind" + std::string(aTitle)).c_str(), m_ReplaceOpened ? ImGuiDir_Up : ImGuiDir_Down))
-				m_ReplaceOpened = !m_ReplaceOpened;
-		}
+	m_UndoBuffer.clear();
+	m_UndoIndex = 0;
 
-		ImGui::SameLine();
+	Colorize();
+}
 
-		if (ImGui::Button(("X##" + std::string(aTitle)).c_str()))
-			m_FindOpened = false;
+void ImTextEdit::EnterCharacter(ImWchar aChar, bool aShift)
+{
+	assert(!m_ReadOnly);
 
-		if (m_ReplaceOpened && !m_ReadOnly)
+	UndoRecord u;
+
+	u.Before = m_State;
+
+	if (HasSelection())
+	{
+		if (aChar == '\t' && m_State.SelectionStart.Line != m_State.SelectionEnd.Line)
 		{
-			ImGui::PushItemWidth(UICalculateSize(-45));
-			ImGui::NewLine();
-			bool shouldReplace = false;
+			auto start = m_State.SelectionStart;
+			auto end = m_State.SelectionEnd;
+			auto originalEnd = end;
 
-			if (ImGui::InputText(("##ted_replacetb" + std::string(aTitle)).c_str(), m_ReplaceWord, 256, ImGuiInputTextFlags_EnterReturnsTrue))
-				shouldReplace = true;
+			if (start > end)
+				std::swap(start, end);
+
+			start.Column = 0;
+			//			end.mColumn = end.mLine < mLines.size() ? mLines[end.mLine].size() : 0;
+			if (end.Column == 0 && end.Line > 0)
+				--end.Line;
+
+			if (end.Line >= (int)m_Lines.size())
+				end.Line = m_Lines.empty() ? 0 : (int)m_Lines.size() - 1;
 			
-			if (ImGui::IsItemActive())
-				m_ReplaceFocused = true;
-			else
-				m_ReplaceFocused = false;
-			ImGui::PopItemWidth();
+			end.Column = GetLineMaxColumn(end.Line);
+
+			//if (end.mColumn >= GetLineMaxColumn(end.mLine))
+			//	end.mColumn = GetLineMaxColumn(end.mLine) - 1;
+
+			u.RemovedStart = start;
+			u.RemovedEnd = end;
+			u.Removed = GetText(start, end);
 
-			ImGui::SameLine();
+			bool modified = false;
 
-			if (ImGui::Button((">##replaceOne" + std::string(aTitle)).c_str()) || shouldReplace)
+			for (int i = start.Line; i <= end.Line; i++)
 			{
-				if (strlen(m_FindWord) > 0)
-				{
-					auto curPos = m_State.CursorPosition;
-					
-					std::string textSrc = GetText();
-				
-					if (m_ReplaceIndex >= textSrc.size())
-						m_ReplaceIndex = 0;
-
-					size_t textLoc = textSrc.find(m_FindWord, m_ReplaceIndex);
-					
-					if (textLoc == std::string::npos)
-					{
-						m_ReplaceIndex = 0;
-						textLoc = textSrc.find(m_FindWord, 0);
-					}
+				auto& line = m_Lines[i];
 
-					if (textLoc != std::string::npos)
+				if (aShift)
+				{
+					if (!line.empty())
 					{
-						curPos.Line = curPos.Column = 0;
-						int totalCount = 0;
-
-						for (size_t ln = 0; ln < m_Lines.size(); ln++)
+						if (line.front().Character == '\t')
 						{
-							int lineCharCount = GetLineCharacterCount(ln) + 1;
-
-							if (textLoc >= totalCount && textLoc < totalCount + lineCharCount)
+							line.erase(line.begin());
+							modified = true;
+						}
+						else
+						{
+							for (int j = 0; j < m_TabSize && !line.empty() && line.front().Character == ' '; j++)
 							{
-								curPos.Line = ln;
-								curPos.Column = textLoc - totalCount;
-
-								auto& line = m_Lines[curPos.Line];
-
-								for (int i = 0; i < line.size(); i++)
-								{
-									if (line[i].Character == '\t')
-										curPos.Column += (m_TabSize - 1);
-								}
-
-								break;
+								line.erase(line.begin());
+								modified = true;
 							}
-
-							totalCount += lineCharCount;
 						}
-
-						auto selStart = curPos, selEnd = curPos;
-						selEnd.Column += strlen(m_FindWord);
-						SetSelection(curPos, selEnd);
-						DeleteSelection();
-						AppendText(m_ReplaceWord);
-						SetCursorPosition(selEnd);
-						m_ScrollToCursor = true;
-
-						ImGui::SetKeyboardFocusHere(0);
-
-						m_ReplaceIndex = textLoc + strlen(m_ReplaceWord);
 					}
 				}
+				else
+				{
+					if (m_InsertSpaces)
+					{
+						for (int i = 0; i < m_TabSize; i++)
+							line.insert(line.begin(), Glyph(' ', ImTextEdit::PaletteIndex::Background));
+					}
+					else
+					{
+						line.insert(line.begin(), Glyph('\t', ImTextEdit::PaletteIndex::Background));
+					}
+
+					modified = true;
+				}
 			}
 
-			ImGui::SameLine();
+			OnLinesChanged(start.Line, end.Line + 1);
 
-			if (ImGui::Button((">>##replaceAll" + std::string(aTitle)).c_str()))
+			if (modified)
 			{
-				if (strlen(m_FindWord) > 0)
+				start = Coordinates(start.Line, GetCharacterColumn(start.Line, 0));
+				Coordinates rangeEnd;
+				if (originalEnd.Column != 0)
 				{
-					auto curPos = m_State.CursorPosition;
+					end = Coordinates(end.Line, GetLineMaxColumn(end.Line));
+					rangeEnd = end;
+					u.Added = GetText(start, end);
+				}
+				else
+				{
+					end = Coordinates(originalEnd.Line, 0);
+					rangeEnd = Coordinates(end.Line - 1, GetLineMaxColumn(end.Line - 1));
+					u.Added = GetText(start, rangeEnd);
+				}
 
-					std::string textSrc = GetText();
-					size_t textLoc = textSrc.find(m_FindWord, 0);
+				u.AddedStart = start;
+				u.AddedEnd = rangeEnd;
+				u.After = m_State;
 
-					do
-					{
-						if (textLoc != std::string::npos)
-						{
-							curPos.Line = curPos.Column = 0;
-							int totalCount = 0;
+				m_State.SelectionStart = start;
+				m_State.SelectionEnd = end;
+				AddUndo(u);
 
-							for (size_t ln = 0; ln < m_Lines.size(); ln++)
-							{
-								int lineCharCount = GetLineCharacterCount(ln) + 1;
+				m_TextChanged = true;
 
-								if (textLoc >= totalCount && textLoc < totalCount + lineCharCount)
-								{
-									curPos.Line = ln;
-									curPos.Column = textLoc - totalCount;
+				if (OnContentUpdate != nullptr)
+					OnContentUpdate(this);
 
-									auto& line = m_Lines[curPos.Line];
+				Colorize(start.Line, end.Line - start.Line + 1);
+				EnsureCursorVisible();
+			}
 
-									for (int i = 0; i < line.size(); i++)
-									{
-										if (line[i].Character == '\t')
-											curPos.Column += (m_TabSize - 1);
-									}
+			return;
+		}
+		else
+		{
+			u.Removed = GetSelectedText();
+			u.RemovedStart = m_State.SelectionStart;
+			u.RemovedEnd = m_State.SelectionEnd;
+			DeleteSelection();
+		}
+	}
 
-									break;
-								}
-								totalCount += lineCharCount;
-							}
+	auto coord = GetActualCursorCoordinates();
+	u.AddedStart = coord;
 
-							auto selStart = curPos, selEnd = curPos;
-							selEnd.Column += strlen(m_FindWord);
-							SetSelection(curPos, selEnd);
-							DeleteSelection();
-							AppendText(m_ReplaceWord);
-							SetCursorPosition(selEnd);
-							m_ScrollToCursor = true;
+	if (m_Lines.empty())
+		m_Lines.push_back(Line());
 
-							ImGui::SetKeyboardFocusHere(0);
+	if (aChar == '\n')
+	{
+		InsertLine(coord.Line + 1);
+		auto& line = m_Lines[coord.Line];
+		auto& newLine = m_Lines[coord.Line + 1];
+		auto cindex = GetCharacterIndex(coord);
 
-							// find next occurance
-							textSrc = GetText();
-							textLoc += strlen(m_ReplaceWord);
-							textLoc = textSrc.find(m_FindWord, textLoc);
-						}
-					}
-					while (textLoc != std::string::npos);
-				}
-			}
+		if (m_LanguageDefinition.AutoIndentation && m_SmartIndent)
+		{
+			for (size_t it = 0; it < line.size() && isascii(line[it].Character) && isblank(line[it].Character); ++it)
+				newLine.push_back(line[it]);
 		}
 
-		ImGui::EndChild();
-
-		ImGui::PopFont();
-
-		if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape)))
-			m_FindOpened = false;
+		const size_t whitespaceSize = newLine.size();
+		newLine.insert(newLine.end(), line.begin() + cindex, line.end());
+		line.erase(line.begin() + cindex, line.begin() + line.size());
+		OnLinesChanged(coord.Line, coord.Line + 2);
+		SetCursorPosition(Coordinates(coord.Line + 1, GetCharacterColumn(coord.Line + 1, (int)whitespaceSize)));
+		u.Added = (char)aChar;
 	}
-
-	/* DEBUGGER CONTROLS */
-	if (IsDebugging() && m_DebugBar)
+	else
 	{
-		ImFont* font = ImGui::GetFont();
-		ImGui::PushFont(font);
+		char buf[7];
+		int e = ImTextCharToUtf8(buf, 7, aChar);
 
+		if (e > 0)
+		{
+			if (m_InsertSpaces && e == 1 && buf[0] == '\t')
+			{
+				for (int i = 0; i < m_TabSize; i++)
+					buf[i] = ' ';
+				e = m_TabSize;
+			}
 
-		ImGui::SetNextWindowPos(ImVec2(m_FindOrigin.x + windowWidth / 2 - m_DebugBarWidth / 2, m_FindOrigin.y), ImGuiCond_Always);
-		ImGui::BeginChild(("##ted_dbgcontrols" + std::string(aTitle)).c_str(), ImVec2(m_DebugBarWidth, m_DebugBarHeight), true, ImGuiWindowFlags_NoScrollbar);
+			buf[e] = '\0';
 
-		ImVec2 dbBarStart = ImGui::GetCursorPos();
+			auto& line = m_Lines[coord.Line];
+			auto cindex = GetCharacterIndex(coord);
 
-		if (ImGui::Button(("Step##ted_dbgstep" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-			OnDebuggerAction(this, ImTextEdit::DebugAction::Step);
+			if (m_Overwrite && cindex < (int)line.size())
+			{
+				auto d = UTF8CharLength(line[cindex].Character);
 
-		ImGui::SameLine(0, 6);
+				u.RemovedStart = m_State.CursorPosition;
+				u.RemovedEnd = Coordinates(coord.Line, GetCharacterColumn(coord.Line, cindex + d));
 
-		if (ImGui::Button(("Step In##ted_dbgstepin" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-			OnDebuggerAction(this, ImTextEdit::DebugAction::StepInto);
-		
-		ImGui::SameLine(0, 6);
+				while (d-- > 0 && cindex < (int)line.size())
+				{
+					u.Removed += line[cindex].Character;
+					line.erase(line.begin() + cindex);
+				}
+			}
 
-		if (ImGui::Button(("Step Out##ted_dbgstepout" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-			OnDebuggerAction(this, ImTextEdit::DebugAction::StepOut);
-		
-		ImGui::SameLine(0, 6);
+			// insert text
+			for (auto p = buf; *p != '\0'; p++, ++cindex)
+				line.insert(line.begin() + cindex, Glyph(*p, PaletteIndex::Default));
 
-		if (ImGui::Button(("Continue##ted_dbgcontinue" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-			OnDebuggerAction(this, ImTextEdit::DebugAction::Continue);
-		
-		ImGui::SameLine(0, 6);
+			OnLinesChanged(coord.Line, coord.Line + 1);
 
-		if (ImGui::Button(("Stop##ted_dbgstop" + std::string(aTitle)).c_str()) && OnDebuggerAction)
-			OnDebuggerAction(this, ImTextEdit::DebugAction::Stop);
+			u.Added = buf;
 
-		ImVec2 dbBarEnd = ImGui::GetCursorPos();
-		m_DebugBarHeight = dbBarEnd.y - dbBarStart.y + ImGui::GetStyle().WindowPadding.y * 2.0f;
+			SetCursorPosition(Coordinates(coord.Line, GetCharacterColumn(coord.Line, cindex)));
+		}
+		else
+		{
+			return;
+		}
+	}
 
-		ImGui::SameLine(0, 6);
+	// active suggestions
+	if (m_ActiveAutocomplete && aChar <= 127 && (isalpha(aChar) || aChar == '_'))
+	{
+		m_RequestAutocomplete = true;
+		m_ReadyForAutocomplete = false;
+	}
 
-		dbBarEnd = ImGui::GetCursorPos();
-		m_DebugBarWidth = dbBarEnd.x - dbBarStart.x + ImGui::GetStyle().WindowPadding.x * 2.0f;
+	if (m_ScrollbarMarkers)
+	{
+		bool changeExists = false;
 
-		ImGui::EndChild();
+		for (int i = 0; i < m_ChangedLines.size(); i++)
+		{
+			if (m_ChangedLines[i] == m_State.CursorPosition.Line)
+			{
+				changeExists = true;
+				break;
+			}
+		}
 
-		ImGui::PopFont();
+		if (!changeExists)
+			m_ChangedLines.push_back(m_State.CursorPosition.Line);
 	}
 
-	if (m_HandleKeyboardInputs)
-		ImGui::PopAllowKeyboardFocus();
-
-	if (!m_IgnoreImGuiChild)
-		ImGui::EndChild();
-	
-	ImGui::PopStyleColor();
-	ImGui::PopStyleVar();
-
-	// breakpoint condition popup
-	if (openBkptConditionWindow)
-		ImGui::OpenPopup("Condition##condition");
+	m_TextChanged = true;
+	if (OnContentUpdate != nullptr)
+		OnContentUpdate(this);
 
-	ImFont* font = ImGui::GetFont();
-	////TODO! 
-	ImGui::PushFont(font);
+	u.AddedEnd = GetActualCursorCoordinates();
+	u.After = m_State;
 
-	ImGui::SetNextWindowSize(ImVec2(430, 175), ImGuiCond_Once);
+	AddUndo(u);
 
-	if (ImGui::BeginPopupModal("Condition##condition"))
-	{
-		ImGui::Checkbox("Use condition", &m_PopupCondition_Use);
+	Colorize(coord.Line - 1, 3);
+	EnsureCursorVisible();
 
-		if (!m_PopupCondition_Use)
+	// function tooltip
+	if (m_FunctionDeclarationTooltipEnabled)
+	{
+		if (aChar == '(')
 		{
-			ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true);
-			ImGui::PushStyleVar(ImGuiStyleVar_Alpha, ImGui::GetStyle().Alpha * 0.5f);
+			auto curPos = GetCorrectCursorPosition();
+			std::string obj = GetWordAt(curPos);
 		}
-		
-		ImGui::InputText("Condition", m_PopupCondition_Condition, 512);
-		
-		if (!m_PopupCondition_Use)
+		else if (aChar == ',')
 		{
-			ImGui::PopStyleVar();
-			ImGui::PopItemFlag();
-		}
+			auto curPos = GetCorrectCursorPosition();
+			curPos.Column--;
 
-		if (ImGui::Button("Cancel"))
-			ImGui::CloseCurrentPopup();
+			const auto& line = m_Lines[curPos.Line];
+			std::string obj = "";
+			int weight = 0;
 
-		ImGui::SameLine();
-		
-		if (ImGui::Button("OK"))
-		{
-			size_t clen = strlen(m_PopupCondition_Condition);
-			bool isEmpty = true;
-			
-			for (size_t i = 0; i < clen; i++)
+			for (; curPos.Column > 0; curPos.Column--)
 			{
-				if (!isspace(m_PopupCondition_Condition[i]))
+				if (line[curPos.Column].Character == '(')
 				{
-					isEmpty = false;
-					break;
-				}
-			}
-			Breakpoint& bkpt = GetBreakpoint(m_PopupCondition_Line);
-			bkpt.Condition = m_PopupCondition_Condition;
-			bkpt.UseCondition = (m_PopupCondition_Use && !isEmpty);
+					if (weight == 0)
+					{
+						obj = GetWordAt(curPos);
+						break;
+					}
 
-			if (OnBreakpointUpdate)
-				OnBreakpointUpdate(this, bkpt.Line, bkpt.UseCondition, bkpt.Condition, bkpt.Enabled);
+					weight--;
+				}
 
-			ImGui::CloseCurrentPopup();
+				if (line[curPos.Column].Character == ')')
+					weight++;
+			}
 		}
-		ImGui::EndPopup();
 	}
-	////TODO! 
-	ImGui::PopFont();
-
-	m_WithinRender = false;
-}
-
-void ImTextEdit::SetText(const std::string & aText)
-{
-	m_Lines.clear();
-	m_FoldBegin.clear();
-	m_FoldEnd.clear();
-	m_FoldSorted = false;
 
-	m_Lines.emplace_back(Line());
-
-	for (auto chr : aText)
+	// auto brace completion
+	if (m_CompleteBraces)
 	{
-		if (chr == '\r')
+		if (aChar == '{')
 		{
-			// ignore the carriage return character
+			EnterCharacter('\n', false);
+			EnterCharacter('}', false);
 		}
-		else if (chr == '\n')
+		else if (aChar == '(')
 		{
-			m_Lines.emplace_back(Line());
+			EnterCharacter(')', false);
 		}
-		else
+		else if (aChar == '[')
 		{
-			if (chr == '{')
-				m_FoldBegin.push_back(Coordinates(m_Lines.size() - 1, m_Lines.back().size()));
-			else if (chr == '}')
-				m_FoldEnd.push_back(Coordinates(m_Lines.size() - 1, m_Lines.back().size()));
-
-			m_Lines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
+			EnterCharacter(']', false);
 		}
+
+		if (aChar == '{' || aChar == '(' || aChar == '[')
+			m_State.CursorPosition.Column--;
 	}
-	
-	m_TextChanged = true;
-	m_ScrollToTop = true;
+}
 
-	m_UndoBuffer.clear();
-	m_UndoIndex = 0;
+void ImTextEdit::SetReadOnly(bool aValue)
+{
+	// the lines of a viewer are read from the file again, they can't be edited. The setting applies once it closes
+	if (m_Viewer)
+		m_ViewerReadOnly = aValue;
+	else
+		m_ReadOnly = aValue;
+}
 
-	Colorize();
+void ImTextEdit::SetColorizerEnable(bool aValue)
+{
+	// the lines edited in the meantime weren't lexed
+	if (aValue && !m_ColorizerEnabled)
+		Colorize();
+
+	m_ColorizerEnabled = aValue;
 }
 
-void ImTextEdit::SetTextLines(const std::vector<std::string> & aLines)
+void ImTextEdit::SetColorizerThreaded(bool aValue)
 {
-	m_Lines.clear();
-	m_FoldBegin.clear();
-	m_FoldEnd.clear();
-	m_FoldSorted = false;
+	if (aValue == IsColorizerThreaded())
+		return;
 
-	if (aLines.empty())
+	if (!aValue)
 	{
-		m_Lines.emplace_back(Line());
+		StopColorizerThread();
+		return;
 	}
-	else
-	{
-		m_Lines.resize(aLines.size());
-
-		for (size_t i = 0; i < aLines.size(); ++i)
-		{
-			const std::string & aLine = aLines[i];
 
-			m_Lines[i].reserve(aLine.size());
+	m_ColorizerWorker.reset(new ColorizerWorker());
+	m_ColorizerWorker->Thread = std::thread(ColorizerThread, m_ColorizerWorker.get());
+}
 
-			for (size_t j = 0; j < aLine.size(); ++j)
-			{
-				if (aLine[j] == '{')
-					m_FoldBegin.push_back(Coordinates(i, j));
-				else if (aLine[j] == '}')
-					m_FoldEnd.push_back(Coordinates(i, j));
+void ImTextEdit::StopColorizerThread()
+{
+	if (m_ColorizerWorker == nullptr)
+		return;
 
-				m_Lines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
-			}
-		}
+	{
+		std::lock_guard<std::mutex> lock(m_ColorizerWorker->Mutex);
+		m_ColorizerWorker->Stop = true;
 	}
 
-	m_TextChanged = true;
-	m_ScrollToTop = true;
+	m_ColorizerWorker->Wakeup.notify_one();
+	m_ColorizerWorker->Thread.join();
 
-	m_UndoBuffer.clear();
-	m_UndoIndex = 0;
+	// whatever the worker had in hand is lost, colorize it again on this thread
+	if (m_ColorizerWorker->Busy)
+		MarkColorDirty(m_ColorizerWorker->BusyFrom, m_ColorizerWorker->BusyTo);
 
-	Colorize();
+	delete m_ColorizerWorker->Result.exchange(nullptr);
+	m_ColorizerWorker.reset();
 }
 
-void ImTextEdit::EnterCharacter(ImWchar aChar, bool aShift)
+ImTextEdit::Coordinates ImTextEdit::GetCorrectCursorPosition()
 {
-	assert(!m_ReadOnly);
-
-	UndoRecord u;
-
-	u.Before = m_State;
+	auto curPos = GetCursorPosition();
 
-	if (HasSelection())
+	if (curPos.Line >= 0 && curPos.Line <= GetCursorPosition().Line)
 	{
-		if (aChar == '\t' && m_State.SelectionStart.Line != m_State.SelectionEnd.Line)
+		for (int c = 0; c < std::min<int>(curPos.Line, m_Lines[curPos.Line].size()); c++)
 		{
-			auto start = m_State.SelectionStart;
-			auto end = m_State.SelectionEnd;
-			auto originalEnd = end;
+			if (m_Lines[curPos.Line][c].Character == '\t')
+				curPos.Column -= (GetTabSize() - 1);
+		}
+	}
 
-			if (start > end)
-				std::swap(start, end);
+	return curPos;
+}
 
-			start.Column = 0;
-			//			end.mColumn = end.mLine < mLines.size() ? mLines[end.mLine].size() : 0;
-			if (end.Column == 0 && end.Line > 0)
-				--end.Line;
+void ImTextEdit::SetCursorPosition(const Coordinates & aPosition)
+{
+	if (m_State.CursorPosition != aPosition)
+	{
+		m_State.CursorPosition = aPosition;
+		m_CursorPositionChanged = true;
+		EnsureCursorVisible();
+	}
+}
 
-			if (end.Line >= (int)m_Lines.size())
-				end.Line = m_Lines.empty() ? 0 : (int)m_Lines.size() - 1;
-			
-			end.Column = GetLineMaxColumn(end.Line);
+void ImTextEdit::SetSelectionStart(const Coordinates & aPosition)
+{
+	m_State.SelectionStart = SanitizeCoordinates(aPosition);
 
-			//if (end.mColumn >= GetLineMaxColumn(end.mLine))
-			//	end.mColumn = GetLineMaxColumn(end.mLine) - 1;
+	if (m_State.SelectionStart > m_State.SelectionEnd)
+		std::swap(m_State.SelectionStart, m_State.SelectionEnd);
+}
 
-			u.RemovedStart = start;
-			u.RemovedEnd = end;
-			u.Removed = GetText(start, end);
+void ImTextEdit::SetSelectionEnd(const Coordinates & aPosition)
+{
+	m_State.SelectionEnd = SanitizeCoordinates(aPosition);
+	
+	if (m_State.SelectionStart > m_State.SelectionEnd)
+		std::swap(m_State.SelectionStart, m_State.SelectionEnd);
+}
 
-			bool modified = false;
+void ImTextEdit::SetSelection(const Coordinates & aStart, const Coordinates & aEnd, SelectionMode aMode)
+{
+	auto oldSelStart = m_State.SelectionStart;
+	auto oldSelEnd = m_State.SelectionEnd;
 
-			for (int i = start.Line; i <= end.Line; i++)
-			{
-				auto& line = m_Lines[i];
+	m_State.SelectionStart = SanitizeCoordinates(aStart);
+	m_State.SelectionEnd = SanitizeCoordinates(aEnd);
+	
+	if (m_State.SelectionStart > m_State.SelectionEnd)
+		std::swap(m_State.SelectionStart, m_State.SelectionEnd);
 
-				if (aShift)
-				{
-					if (!line.empty())
-					{
-						if (line.front().Character == '\t')
-						{
-							line.erase(line.begin());
-							modified = true;
-						}
-						else
-						{
-							for (int j = 0; j < m_TabSize && !line.empty() && line.front().Character == ' '; j++)
-							{
-								line.erase(line.begin());
-								modified = true;
-							}
-						}
-					}
-				}
-				else
-				{
-					if (m_InsertSpaces)
-					{
-						for (int i = 0; i < m_TabSize; i++)
-							line.insert(line.begin(), Glyph(' ', ImTextEdit::PaletteIndex::Background));
-					}
-					else
-					{
-						line.insert(line.begin(), Glyph('\t', ImTextEdit::PaletteIndex::Background));
-					}
+	switch (aMode)
+	{
+	case ImTextEdit::SelectionMode::Normal:
+		break;
+	case ImTextEdit::SelectionMode::Word:
+	{
+		m_State.SelectionStart = FindWordStart(m_State.SelectionStart);
+		
+		if (!IsOnWordBoundary(m_State.SelectionEnd))
+			m_State.SelectionEnd = FindWordEnd(FindWordStart(m_State.SelectionEnd));
+
+		break;
+	}
+	case ImTextEdit::SelectionMode::Line:
+	{
+		const auto lineNo = m_State.SelectionEnd.Line;
+		const auto lineSize = (size_t)lineNo < m_Lines.size() ? m_Lines[lineNo].size() : 0;
+		m_State.SelectionStart = Coordinates(m_State.SelectionStart.Line, 0);
+		m_State.SelectionEnd = Coordinates(lineNo, GetLineMaxColumn(lineNo));
+		break;
+	}
+	default:
+		break;
+	}
 
-					modified = true;
-				}
-			}
+	if (m_State.SelectionStart != oldSelStart || m_State.SelectionEnd != oldSelEnd)
+		m_CursorPositionChanged = true;
 
-			if (modified)
-			{
-				start = Coordinates(start.Line, GetCharacterColumn(start.Line, 0));
-				Coordinates rangeEnd;
-				if (originalEnd.Column != 0)
-				{
-					end = Coordinates(end.Line, GetLineMaxColumn(end.Line));
-					rangeEnd = end;
-					u.Added = GetText(start, end);
-				}
-				else
-				{
-					end = Coordinates(originalEnd.Line, 0);
-					rangeEnd = Coordinates(end.Line - 1, GetLineMaxColumn(end.Line - 1));
-					u.Added = GetText(start, rangeEnd);
-				}
+	// update mReplaceIndex
+	m_ReplaceIndex = (int)CoordinatesToOffset(m_State.CursorPosition);
+}
 
-				u.AddedStart = start;
-				u.AddedEnd = rangeEnd;
-				u.After = m_State;
+void ImTextEdit::AppendText(const std::string& aValue, bool indent)
+{
+	AppendText(aValue.c_str(), indent);
+}
 
-				m_State.SelectionStart = start;
-				m_State.SelectionEnd = end;
-				AddUndo(u);
+void ImTextEdit::AppendText(const char* aValue, bool indent)
+{
+	if (aValue == nullptr)
+		return;
 
-				m_TextChanged = true;
+	auto pos = GetActualCursorCoordinates();
+	auto start = std::min<Coordinates>(pos, m_State.SelectionStart);
+	int totalLines = pos.Line - start.Line;
 
-				if (OnContentUpdate != nullptr)
-					OnContentUpdate(this);
+	totalLines += InsertTextAt(pos, aValue, indent);
 
-				EnsureCursorVisible();
-			}
+	SetSelection(pos, pos);
+	SetCursorPosition(pos);
+	Colorize(start.Line - 1, totalLines + 2);
+}
 
-			return;
+void ImTextEdit::SetFollowMode(bool aValue, int aMaxLines)
+{
+	m_Follow = aValue;
+	m_FollowMaxLines = std::max(0, aMaxLines);
+	m_FollowPinned = true;
+}
+
+void ImTextEdit::AppendToEnd(const std::string& aValue)
+{
+	AppendToEnd(aValue.c_str());
+}
+
+void ImTextEdit::AppendToEnd(const char* aValue)
+{
+	// the lines of a viewer are read from its file again whenever they are evicted, there is nothing to append to
+	if (aValue == nullptr || m_Viewer)
+		return;
+
+	const char* end = aValue + strlen(aValue);
+	const char* lineStart = aValue;
+	int lastLine = (int)m_Lines.size() - 1;
+	bool first = true;
+
+	// the text up to the first newline goes to the last line, every line after it is added as a whole
+	auto addLine = [&](const char* aLineEnd)
+	{
+		if (first)
+		{
+			m_Lines.back().append(lineStart, aLineEnd);
+			first = false;
 		}
 		else
 		{
-			u.Removed = GetSelectedText();
-			u.RemovedStart = m_State.SelectionStart;
-			u.RemovedEnd = m_State.SelectionEnd;
-			DeleteSelection();
+			Line line;
+			line.assign(lineStart, aLineEnd);
+			m_Lines.push_back(std::move(line));
 		}
-	}
 
-	auto coord = GetActualCursorCoordinates();
-	u.AddedStart = coord;
+		lineStart = aLineEnd + 1;
+	};
 
-	if (m_Lines.empty())
-		m_Lines.push_back(Line());
+	ForEachNewline(aValue, end, addLine);
+	addLine(end);
 
-	if (aChar == '\n')
-	{
-		InsertLine(coord.Line + 1, coord.Column);
-		auto& line = m_Lines[coord.Line];
-		auto& newLine = m_Lines[coord.Line + 1];
-		auto cindex = GetCharacterIndex(coord);
+	int added = (int)m_Lines.size() - 1 - lastLine;
+	OnLinesChanged(lastLine, lastLine + 1);
+	if (added > 0)
+		OnLinesInserted(lastLine + 1, added);
 
-		int foldOffset = 0;
+	Colorize(lastLine, added + 1);
 
-		for (int i = 0; i < cindex; i++)
-			foldOffset -= 1 + (line[i].Character == '\t') * 3;
+	if (m_Follow && m_FollowMaxLines > 0)
+	{
+		// whole blocks go, the lines of the others don't move
+		int count = 0;
 
-		if (m_LanguageDefinition.AutoIndentation && m_SmartIndent)
+		for (size_t block = 0; block + 1 < m_Lines.GetBlockCount(); block++)
 		{
-			for (size_t it = 0; it < line.size() && isascii(line[it].Character) && isblank(line[it].Character); ++it)
-			{
-				newLine.push_back(line[it]);
-				foldOffset += 1 + (line[it].Character == '\t') * 3;
-			}
+			int lines = (int)m_Lines.GetBlockLineCount(block);
+			if ((int)m_Lines.size() - count - lines < m_FollowMaxLines)
+				break;
+
+			count += lines;
 		}
 
-		const size_t whitespaceSize = newLine.size();
-		newLine.insert(newLine.end(), line.begin() + cindex, line.end());
-		line.erase(line.begin() + cindex, line.begin() + line.size());
-		SetCursorPosition(Coordinates(coord.Line + 1, GetCharacterColumn(coord.Line + 1, (int)whitespaceSize)));
-		u.Added = (char)aChar;
+		if (count > 0)
+			DropFirstLines(count);
+	}
+
+	// the undo records don't know about the appended text
+	m_UndoBuffer.clear();
+	m_UndoIndex = 0;
 
-		// shift folds
-		for (int b = 0; b < m_FoldBegin.size(); b++)
-			if (m_FoldBegin[b].Line == coord.Line + 1)
-				m_FoldBegin[b].Column = std::max<int>(0, (m_FoldBegin[b].Column + foldOffset) + (m_FoldBegin[b].Column != coord.Column));
-		for (int b = 0; b < m_FoldEnd.size(); b++)
-			if (m_FoldEnd[b].Line == coord.Line + 1)
-				m_FoldEnd[b].Column = std::max<int>(0, (m_FoldEnd[b].Column + foldOffset) + (m_FoldEnd[b].Column != coord.Column));
+	m_TextChanged = true;
+
+	if (OnContentUpdate != nullptr)
+		OnContentUpdate(this);
+}
+
+void ImTextEdit::DropFirstLines(int aCount)
+{
+	m_Lines.erase(0, aCount);
+	OnLinesRemoved(0, aCount);
+
+	m_FollowDropped += aCount;
+
+	// error markers and breakpoints count lines from 1
+	td_ErrorMarkers etmp;
+
+	for (auto& i : m_ErrorMarkers)
+	{
+		if (i.first > aCount)
+			etmp.insert(td_ErrorMarkers::value_type(i.first - aCount, i.second));
 	}
-	else
+
+	m_ErrorMarkers = std::move(etmp);
+
+	auto btmp = m_Breakpoints;
+	m_Breakpoints.clear();
+
+	for (auto i : btmp)
 	{
-		char buf[7];
-		int e = ImTextCharToUtf8(buf, 7, aChar);
+		if (i.Line <= aCount)
+			RemoveBreakpoint(i.Line);
+		else
+			AddBreakpoint(i.Line - aCount, i.UseCondition, i.Condition, i.Enabled);
+	}
 
-		if (e > 0)
+	if (m_ScrollbarMarkers)
+	{
+		for (int i = 0; i < (int)m_ChangedLines.size(); i++)
 		{
-			if (m_InsertSpaces && e == 1 && buf[0] == '\t')
+			if (m_ChangedLines[i] >= aCount)
 			{
-				for (int i = 0; i < m_TabSize; i++)
-					buf[i] = ' ';
-				e = m_TabSize;
+				m_ChangedLines[i] -= aCount;
 			}
-
-			buf[e] = '\0';
-
-			auto& line = m_Lines[coord.Line];
-			auto cindex = GetCharacterIndex(coord);
-
-			if (m_Overwrite && cindex < (int)line.size())
+			else
 			{
-				auto d = UTF8CharLength(line[cindex].Character);
+				m_ChangedLines.erase(m_ChangedLines.begin() + i);
+				i--;
+			}
+		}
+	}
 
-				u.RemovedStart = m_State.CursorPosition;
-				u.RemovedEnd = Coordinates(coord.Line, GetCharacterColumn(coord.Line, cindex + d));
+	auto shift = [aCount](const Coordinates& aPosition) { return aPosition.Line < aCount ? Coordinates(0, 0) : Coordinates(aPosition.Line - aCount, aPosition.Column); };
 
-				while (d-- > 0 && cindex < (int)line.size())
-				{
-					u.Removed += line[cindex].Character;
+	m_State.CursorPosition = shift(m_State.CursorPosition);
+	m_State.SelectionStart = shift(m_State.SelectionStart);
+	m_State.SelectionEnd = shift(m_State.SelectionEnd);
+	m_InteractiveStart = shift(m_InteractiveStart);
+	m_InteractiveEnd = shift(m_InteractiveEnd);
 
+	// so do the snippet tags, a snippet that loses one of them ends
+	for (size_t i = 0; i < m_SnippetTagStart.size(); i++)
+	{
+		if (m_SnippetTagStart[i].Line < aCount)
+		{
+			m_IsSnippet = false;
+			m_SnippetTagStart.clear();
+			m_SnippetTagEnd.clear();
+			m_SnippetTagID.clear();
+			m_SnippetTagHighlight.clear();
+			break;
+		}
 
-					// remove fold information if needed
-					if (line[cindex].Character == '{')
-					{
-						for (int fl = 0; fl < m_FoldBegin.size(); fl++)
-						{
-							if (m_FoldBegin[fl].Line == coord.Line && m_FoldBegin[fl].Column == coord.Column)
-							{
-								m_FoldBegin.erase(m_FoldBegin.begin() + fl);
-								m_FoldSorted = false;
-								break;
-							}
-						}
-					}
+		m_SnippetTagStart[i].Line -= aCount;
+		m_SnippetTagEnd[i].Line -= aCount;
+	}
+}
 
-					if (line[cindex].Character == '}')
-					{
-						for (int fl = 0; fl < m_FoldEnd.size(); fl++)
-						{
-							if (m_FoldEnd[fl].Line == coord.Line && m_FoldEnd[fl].Column == coord.Column)
-							{
-								m_FoldEnd.erase(m_FoldEnd.begin() + fl);
-								m_FoldSorted = false;
-								break;
-							}
-						}
-					}
+void ImTextEdit::DeleteSelection()
+{
+	assert(m_State.SelectionEnd >= m_State.SelectionStart);
 
-					line.erase(line.begin() + cindex);
-				}
-			}
+	if (m_State.SelectionEnd == m_State.SelectionStart)
+		return;
 
-			// move the folds if necessary
-			int foldOffset = 0;
+	DeleteRange(m_State.SelectionStart, m_State.SelectionEnd);
 
-			if (buf[0] == '\t')
-				foldOffset = m_TabSize - (coord.Column - (coord.Column / m_TabSize) * m_TabSize);
-			else
-				foldOffset = strlen(buf);
+	SetSelection(m_State.SelectionStart, m_State.SelectionStart);
+	SetCursorPosition(m_State.SelectionStart);
+	Colorize(m_State.SelectionStart.Line, 1);
+}
 
-			int foldColumn = GetCharacterColumn(coord.Line, cindex);
+void ImTextEdit::MoveUp(int aAmount, bool aSelect)
+{
+	auto oldPos = m_State.CursorPosition;
+	m_State.CursorPosition.Line = std::max<int>(0, m_State.CursorPosition.Line - aAmount);
 
-			for (int b = 0; b < m_FoldBegin.size(); b++)
+	if (oldPos != m_State.CursorPosition)
+	{
+		if (aSelect)
+		{
+			if (oldPos == m_InteractiveStart)
 			{
-				if (m_FoldBegin[b].Line == coord.Line && m_FoldBegin[b].Column >= foldColumn)
-					m_FoldBegin[b].Column += foldOffset;
+				m_InteractiveStart = m_State.CursorPosition;
 			}
-
-			for (int b = 0; b < m_FoldEnd.size(); b++)
+			else if (oldPos == m_InteractiveEnd)
 			{
-				if (m_FoldEnd[b].Line == coord.Line && m_FoldEnd[b].Column >= foldColumn)
-					m_FoldEnd[b].Column += foldOffset;
+				m_InteractiveEnd = m_State.CursorPosition;
 			}
-
-			// insert text
-			for (auto p = buf; *p != '\0'; p++, ++cindex)
+			else
 			{
-				if (*p == '{')
-				{
-					m_FoldBegin.push_back(Coordinates(coord.Line, foldColumn));
-					m_FoldSorted = false;
-				}
-				else if (*p == '}')
-				{
-					m_FoldEnd.push_back(Coordinates(coord.Line, foldColumn));
-					m_FoldSorted = false;
-				}
-
-				line.insert(line.begin() + cindex, Glyph(*p, PaletteIndex::Default));
+				m_InteractiveStart = m_State.CursorPosition;
+				m_InteractiveEnd = oldPos;
 			}
-
-			u.Added = buf;
-
-			SetCursorPosition(Coordinates(coord.Line, GetCharacterColumn(coord.Line, cindex)));
 		}
 		else
 		{
-			return;
+			m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
 		}
-	}
 
-	// active suggestions
-	if (m_ActiveAutocomplete && aChar <= 127 && (isalpha(aChar) || aChar == '_'))
-	{
-		m_RequestAutocomplete = true;
-		m_ReadyForAutocomplete = false;
+		SetSelection(m_InteractiveStart, m_InteractiveEnd);
+		EnsureCursorVisible();
 	}
+}
 
-	if (m_ScrollbarMarkers)
-	{
-		bool changeExists = false;
+void ImTextEdit::MoveDown(int aAmount, bool aSelect)
+{
+	assert(m_State.CursorPosition.Column >= 0);
+	auto oldPos = m_State.CursorPosition;
+	m_State.CursorPosition.Line = std::max<int>(0, std::min<int>((int)m_Lines.size() - 1, m_State.CursorPosition.Line + aAmount));
 
-		for (int i = 0; i < m_ChangedLines.size(); i++)
+	if (m_State.CursorPosition != oldPos)
+	{
+		if (aSelect)
 		{
-			if (m_ChangedLines[i] == m_State.CursorPosition.Line)
+			if (oldPos == m_InteractiveEnd)
 			{
-				changeExists = true;
-				break;
+				m_InteractiveEnd = m_State.CursorPosition;
+			}
+			else if (oldPos == m_InteractiveStart)
+			{
+				m_InteractiveStart = m_State.CursorPosition;
+			}
+			else
+			{
+				m_InteractiveStart = oldPos;
+				m_InteractiveEnd = m_State.CursorPosition;
 			}
 		}
+		else
+		{
+			m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
+		}
 
-		if (!changeExists)
-			m_ChangedLines.push_back(m_State.CursorPosition.Line);
+		SetSelection(m_InteractiveStart, m_InteractiveEnd);
+		EnsureCursorVisible();
 	}
+}
 
-	m_TextChanged = true;
-	if (OnContentUpdate != nullptr)
-		OnContentUpdate(this);
-
-	u.AddedEnd = GetActualCursorCoordinates();
-	u.After = m_State;
+static bool IsUTFSequence(char c)
+{
+	return (c & 0xC0) == 0x80;
+}
 
-	AddUndo(u);
+void ImTextEdit::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
+{
+	if (m_Lines.empty())
+		return;
 
-	Colorize(coord.Line - 1, 3);
-	EnsureCursorVisible();
+	auto oldPos = m_State.CursorPosition;
+	m_State.CursorPosition = GetActualCursorCoordinates();
+	auto line = m_State.CursorPosition.Line;
+	auto cindex = GetCharacterIndex(m_State.CursorPosition);
 
-	// function tooltip
-	if (m_FunctionDeclarationTooltipEnabled)
+	while (aAmount-- > 0)
 	{
-		if (aChar == '(')
+		if (cindex == 0)
 		{
-			auto curPos = GetCorrectCursorPosition();
-			std::string obj = GetWordAt(curPos);
+			if (line > 0)
+			{
+				--line;
+
+				if ((int)m_Lines.size() > line)
+					cindex = (int)m_Lines[line].size();
+				else
+					cindex = 0;
+			}
 		}
-		else if (aChar == ',')
+		else
 		{
-			auto curPos = GetCorrectCursorPosition();
-			curPos.Column--;
-
-			const auto& line = m_Lines[curPos.Line];
-			std::string obj = "";
-			int weight = 0;
+			--cindex;
 
-			for (; curPos.Column > 0; curPos.Column--)
+			if (cindex > 0)
 			{
-				if (line[curPos.Column].Character == '(')
+				if ((int)m_Lines.size() > line)
 				{
-					if (weight == 0)
-					{
-						obj = GetWordAt(curPos);
-						break;
-					}
-
-					weight--;
+					while (cindex > 0 && IsUTFSequence(m_Lines[line][cindex].Character))
+						--cindex;
 				}
-
-				if (line[curPos.Column].Character == ')')
-					weight++;
 			}
 		}
+
+		m_State.CursorPosition = Coordinates(line, GetCharacterColumn(line, cindex));
+
+		if (aWordMode)
+		{
+			m_State.CursorPosition = FindWordStart(m_State.CursorPosition);
+			cindex = GetCharacterIndex(m_State.CursorPosition);
+		}
 	}
 
-	// auto brace completion
-	if (m_CompleteBraces)
+	m_State.CursorPosition = Coordinates(line, GetCharacterColumn(line, cindex));
+
+	assert(m_State.CursorPosition.Column >= 0);
+
+	if (aSelect)
 	{
-		if (aChar == '{')
+		m_InteractiveStart = m_State.SelectionStart;
+		m_InteractiveEnd = m_State.SelectionEnd;
+
+		if (oldPos == m_InteractiveStart)
 		{
-			EnterCharacter('\n', false);
-			EnterCharacter('}', false);
+			m_InteractiveStart = m_State.CursorPosition;
 		}
-		else if (aChar == '(')
+		else if (oldPos == m_InteractiveEnd)
 		{
-			EnterCharacter(')', false);
+			m_InteractiveEnd = m_State.CursorPosition;
 		}
-		else if (aChar == '[')
+		else
 		{
-			EnterCharacter(']', false);
+			m_InteractiveStart = m_State.CursorPosition;
+			m_InteractiveEnd = oldPos;
 		}
-
-		if (aChar == '{' || aChar == '(' || aChar == '[')
-			m_State.CursorPosition.Column--;
 	}
-}
+	else
+	{
+		m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
+	}
 
-void ImTextEdit::SetReadOnly(bool aValue)
-{
-	m_ReadOnly = aValue;
+	SetSelection(m_InteractiveStart, m_InteractiveEnd, SelectionMode::Normal);
+	EnsureCursorVisible();
 }
 
-void ImTextEdit::SetColorizerEnable(bool aValue)
+void ImTextEdit::MoveRight(int aAmount, bool aSelect, bool aWordMode)
 {
-	m_ColorizerEnabled = aValue;
-}
+	auto oldPos = m_State.CursorPosition;
 
-ImTextEdit::Coordinates ImTextEdit::GetCorrectCursorPosition()
-{
-	auto curPos = GetCursorPosition();
+	if (m_Lines.empty() || oldPos.Line >= m_Lines.size())
+		return;
+		
+	m_State.CursorPosition = GetActualCursorCoordinates();
+	auto line = m_State.CursorPosition.Line;
+	auto cindex = GetCharacterIndex(m_State.CursorPosition);
 
-	if (curPos.Line >= 0 && curPos.Line <= GetCursorPosition().Line)
+	while (aAmount-- > 0)
 	{
-		for (int c = 0; c < std::min<int>(curPos.Line, m_Lines[curPos.Line].size()); c++)
+		auto lindex = m_State.CursorPosition.Line;
+		auto& line = m_Lines[lindex];
+
+		if (cindex >= line.size())
 		{
-			if (m_Lines[curPos.Line][c].Character == '\t')
-				curPos.Column -= (GetTabSize() - 1);
+			if (m_State.CursorPosition.Line < m_Lines.size() - 1)
+			{
+				m_State.CursorPosition.Line = std::max(0, std::min((int)m_Lines.size() - 1, m_State.CursorPosition.Line + 1));
+				m_State.CursorPosition.Column = 0;
+			}
+			else
+			{
+				return;
+			}
+		}
+		else
+		{
+			cindex += UTF8CharLength(line[cindex].Character);
+			m_State.CursorPosition = Coordinates(lindex, GetCharacterColumn(lindex, cindex));
+
+			if (aWordMode)
+				m_State.CursorPosition = FindWordEnd(m_State.CursorPosition);
 		}
 	}
 
-	return curPos;
-}
+	if (aSelect)
+	{
+		m_InteractiveStart = m_State.SelectionStart;
+		m_InteractiveEnd = m_State.SelectionEnd;
 
-void ImTextEdit::SetCursorPosition(const Coordinates & aPosition)
-{
-	if (m_State.CursorPosition != aPosition)
+		if (oldPos == m_InteractiveEnd)
+		{
+			m_InteractiveEnd = m_State.CursorPosition;
+		}
+		else if (oldPos == m_InteractiveStart)
+		{
+			m_InteractiveStart = m_State.CursorPosition;
+		}
+		else
+		{
+			m_InteractiveStart = oldPos;
+			m_InteractiveEnd = m_State.CursorPosition;
+		}
+	}
+	else
 	{
-		m_State.CursorPosition = aPosition;
-		m_CursorPositionChanged = true;
-		EnsureCursorVisible();
+		m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
 	}
-}
 
-void ImTextEdit::SetSelectionStart(const Coordinates & aPosition)
-{
-	m_State.SelectionStart = SanitizeCoordinates(aPosition);
-
-	if (m_State.SelectionStart > m_State.SelectionEnd)
-		std::swap(m_State.SelectionStart, m_State.SelectionEnd);
-}
-
-void ImTextEdit::SetSelectionEnd(const Coordinates & aPosition)
-{
-	m_State.SelectionEnd = SanitizeCoordinates(aPosition);
-	
-	if (m_State.SelectionStart > m_State.SelectionEnd)
-		std::swap(m_State.SelectionStart, m_State.SelectionEnd);
+	SetSelection(m_InteractiveStart, m_InteractiveEnd, SelectionMode::Normal);
+	EnsureCursorVisible();
 }
 
-void ImTextEdit::SetSelection(const Coordinates & aStart, const Coordinates & aEnd, SelectionMode aMode)
+void ImTextEdit::MoveTop(bool aSelect)
 {
-	auto oldSelStart = m_State.SelectionStart;
-	auto oldSelEnd = m_State.SelectionEnd;
-
-	m_State.SelectionStart = SanitizeCoordinates(aStart);
-	m_State.SelectionEnd = SanitizeCoordinates(aEnd);
-	
-	if (m_State.SelectionStart > m_State.SelectionEnd)
-		std::swap(m_State.SelectionStart, m_State.SelectionEnd);
+	auto oldPos = m_State.CursorPosition;
+	SetCursorPosition(Coordinates(0, 0));
 
-	switch (aMode)
-	{
-	case ImTextEdit::SelectionMode::Normal:
-		break;
-	case ImTextEdit::SelectionMode::Word:
+	if (m_State.CursorPosition != oldPos)
 	{
-		m_State.SelectionStart = FindWordStart(m_State.SelectionStart);
-		
-		if (!IsOnWordBoundary(m_State.SelectionEnd))
-			m_State.SelectionEnd = FindWordEnd(FindWordStart(m_State.SelectionEnd));
+		if (aSelect)
+		{
+			m_InteractiveEnd = oldPos;
+			m_InteractiveStart = m_State.CursorPosition;
+		}
+		else
+		{
+			m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
+		}
 
-		break;
-	}
-	case ImTextEdit::SelectionMode::Line:
-	{
-		const auto lineNo = m_State.SelectionEnd.Line;
-		const auto lineSize = (size_t)lineNo < m_Lines.size() ? m_Lines[lineNo].size() : 0;
-		m_State.SelectionStart = Coordinates(m_State.SelectionStart.Line, 0);
-		m_State.SelectionEnd = Coordinates(lineNo, GetLineMaxColumn(lineNo));
-		break;
-	}
-	default:
-		break;
+		SetSelection(m_InteractiveStart, m_InteractiveEnd);
 	}
-
-	if (m_State.SelectionStart != oldSelStart || m_State.SelectionEnd != oldSelEnd)
-		m_CursorPositionChanged = true;
-
-	// update mReplaceIndex
-	m_ReplaceIndex = 0;
-
-	for (size_t ln = 0; ln < m_State.CursorPosition.Line; ln++)
-		m_ReplaceIndex += GetLineCharacterCount(ln) + 1;
-
-	m_ReplaceIndex += m_State.CursorPosition.Column;
 }
 
-void ImTextEdit::AppendText(const std::string& aValue, bool indent)
+void ImTextEdit::MoveToMatchingBracket(bool aSelect)
 {
-	AppendText(aValue.c_str(), indent);
-}
+	auto oldPos = m_State.CursorPosition;
+	Coordinates bracket, match;
 
-void ImTextEdit::AppendText(const char* aValue, bool indent)
-{
-	if (aValue == nullptr)
+	if (!FindMatchingBracket(GetActualCursorCoordinates(), bracket, match))
 		return;
 
-	auto pos = GetActualCursorCoordinates();
-	auto start = std::min<Coordinates>(pos, m_State.SelectionStart);
-	int totalLines = pos.Line - start.Line;
+	// stay on the same side of the bracket, so jumping again comes back
+	if (bracket < GetActualCursorCoordinates())
+		match.Column = GetCharacterColumn(match.Line, GetCharacterIndex(match) + 1);
+
+	SetCursorPosition(match);
+
+	if (aSelect)
+	{
+		m_InteractiveEnd = m_State.CursorPosition;
+		m_InteractiveStart = oldPos;
 
-	totalLines += InsertTextAt(pos, aValue, indent);
+		if (m_InteractiveEnd < m_InteractiveStart)
+			std::swap(m_InteractiveStart, m_InteractiveEnd);
+	}
+	else
+	{
+		m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
+	}
 
-	SetSelection(pos, pos);
-	SetCursorPosition(pos);
-	Colorize(start.Line - 1, totalLines + 2);
+	SetSelection(m_InteractiveStart, m_InteractiveEnd);
 }
 
-void ImTextEdit::DeleteSelection()
+void ImTextEdit::MoveBottom(bool aSelect)
 {
-	assert(m_State.SelectionEnd >= m_State.SelectionStart);
-
-	if (m_State.SelectionEnd == m_State.SelectionStart)
-		return;
+	auto oldPos = GetCursorPosition();
+	auto newPos = Coordinates((int)m_Lines.size() - 1, 0);
+	SetCursorPosition(newPos);
 
-	DeleteRange(m_State.SelectionStart, m_State.SelectionEnd);
+	if (aSelect)
+	{
+		m_InteractiveStart = oldPos;
+		m_InteractiveEnd = newPos;
+	}
+	else
+	{
+		m_InteractiveStart = m_InteractiveEnd = newPos;
+	}
 
-	SetSelection(m_State.SelectionStart, m_State.SelectionStart);
-	SetCursorPosition(m_State.SelectionStart);
-	Colorize(m_State.SelectionStart.Line, 1);
+	SetSelection(m_InteractiveStart, m_InteractiveEnd);
 }
 
-void ImTextEdit::MoveUp(int aAmount, bool aSelect)
+void ImTextEdit::MoveHome(bool aSelect)
 {
 	auto oldPos = m_State.CursorPosition;
-	m_State.CursorPosition.Line = std::max<int>(0, m_State.CursorPosition.Line - aAmount);
+	SetCursorPosition(Coordinates(m_State.CursorPosition.Line, 0));
 
-	if (oldPos != m_State.CursorPosition)
+	if (m_State.CursorPosition != oldPos)
 	{
 		if (aSelect)
 		{
@@ -4777,15 +7614,13 @@ void ImTextEdit::MoveUp(int aAmount, bool aSelect)
 		}
 
 		SetSelection(m_InteractiveStart, m_InteractiveEnd);
-		EnsureCursorVisible();
 	}
 }
 
-void ImTextEdit::MoveDown(int aAmount, bool aSelect)
+void ImTextEdit::MoveEnd(bool aSelect)
 {
-	assert(m_State.CursorPosition.Column >= 0);
 	auto oldPos = m_State.CursorPosition;
-	m_State.CursorPosition.Line = std::max<int>(0, std::min<int>((int)m_Lines.size() - 1, m_State.CursorPosition.Line + aAmount));
+	SetCursorPosition(Coordinates(m_State.CursorPosition.Line, GetLineMaxColumn(oldPos.Line)));
 
 	if (m_State.CursorPosition != oldPos)
 	{
@@ -4811,1289 +7646,1629 @@ void ImTextEdit::MoveDown(int aAmount, bool aSelect)
 		}
 
 		SetSelection(m_InteractiveStart, m_InteractiveEnd);
-		EnsureCursorVisible();
 	}
 }
 
-static bool IsUTFSequence(char c)
+void ImTextEdit::Delete()
 {
-	return (c & 0xC0) == 0x80;
+	assert(!m_ReadOnly);
+
+	if (m_Lines.empty())
+		return;
+
+	UndoRecord u;
+	u.Before = m_State;
+
+	if (HasSelection())
+	{
+		u.Removed = GetSelectedText();
+		u.RemovedStart = m_State.SelectionStart;
+		u.RemovedEnd = m_State.SelectionEnd;
+
+		DeleteSelection();
+	}
+	else
+	{
+		auto pos = GetActualCursorCoordinates();
+		SetCursorPosition(pos);
+		auto& line = m_Lines[pos.Line];
+
+		if (pos.Column == GetLineMaxColumn(pos.Line))
+		{
+			if (pos.Line == (int)m_Lines.size() - 1)
+				return;
+
+			u.Removed = '\n';
+			u.RemovedStart = u.RemovedEnd = GetActualCursorCoordinates();
+			Advance(u.RemovedEnd);
+
+			auto& nextLine = m_Lines[pos.Line + 1];
+			line.insert(line.end(), nextLine.begin(), nextLine.end());
+
+			RemoveLine(pos.Line + 1);
+		}
+		else
+		{
+			auto cindex = GetCharacterIndex(pos);
+			u.RemovedStart = u.RemovedEnd = GetActualCursorCoordinates();
+			u.RemovedEnd.Column++;
+			u.Removed = GetText(u.RemovedStart, u.RemovedEnd);
+
+			auto d = UTF8CharLength(line[cindex].Character);
+
+			while (d-- > 0 && cindex < (int)line.size())
+				line.erase(line.begin() + cindex);
+		}
+
+		OnLinesChanged(pos.Line, pos.Line + 1);
+
+		if (m_ScrollbarMarkers)
+		{
+			bool changeExists = false;
+
+			for (int i = 0; i < m_ChangedLines.size(); i++)
+			{
+				if (m_ChangedLines[i] == m_State.CursorPosition.Line)
+				{
+					changeExists = true;
+					break;
+				}
+			}
+
+			if (!changeExists)
+				m_ChangedLines.push_back(m_State.CursorPosition.Line);
+		}
+
+		m_TextChanged = true;
+
+		if (OnContentUpdate != nullptr)
+			OnContentUpdate(this);
+
+		Colorize(pos.Line, 1);
+	}
+
+	u.After = m_State;
+	AddUndo(u);
 }
 
-void ImTextEdit::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
+void ImTextEdit::DuplicateLine()
+{
+	ImTextEdit::UndoRecord undo;
+	undo.Before = m_State;
+
+	auto oldLine = m_Lines[m_State.CursorPosition.Line];
+	auto& line = InsertLine(m_State.CursorPosition.Line);
+
+	undo.Added += '\n';
+
+	for (auto glyph : oldLine)
+	{
+		line.push_back(glyph);
+		undo.Added += glyph.Character;
+	}
+
+	OnLinesChanged(m_State.CursorPosition.Line, m_State.CursorPosition.Line + 1);
+	m_State.CursorPosition.Line++;
+
+	undo.AddedStart = ImTextEdit::Coordinates(m_State.CursorPosition.Line - 1, m_State.CursorPosition.Column);
+	undo.AddedEnd = m_State.CursorPosition;
+
+	undo.After = m_State;
+
+	AddUndo(undo);
+
+	Colorize(m_State.CursorPosition.Line - 1, 2);
+}
+
+void ImTextEdit::Backspace()
 {
+	assert(!m_ReadOnly);
+
 	if (m_Lines.empty())
 		return;
 
-	auto oldPos = m_State.CursorPosition;
-	m_State.CursorPosition = GetActualCursorCoordinates();
-	auto line = m_State.CursorPosition.Line;
-	auto cindex = GetCharacterIndex(m_State.CursorPosition);
+	UndoRecord u;
+	u.Before = m_State;
 
-	while (aAmount-- > 0)
+	if (HasSelection())
 	{
-		if (cindex == 0)
+		u.Removed = GetSelectedText();
+		u.RemovedStart = m_State.SelectionStart;
+		u.RemovedEnd = m_State.SelectionEnd;
+
+		DeleteSelection();
+	}
+	else
+	{
+		auto pos = GetActualCursorCoordinates();
+		SetCursorPosition(pos);
+
+		if (m_State.CursorPosition.Column == 0)
 		{
-			if (line > 0)
+			if (m_State.CursorPosition.Line == 0)
+				return;
+
+			u.Removed = '\n';
+			u.RemovedStart = u.RemovedEnd = Coordinates(pos.Line - 1, GetLineMaxColumn(pos.Line - 1));
+			Advance(u.RemovedEnd);
+
+			auto& line = m_Lines[m_State.CursorPosition.Line];
+			auto& prevLine = m_Lines[m_State.CursorPosition.Line - 1];
+			auto prevSize = GetLineMaxColumn(m_State.CursorPosition.Line - 1);
+			prevLine.insert(prevLine.end(), line.begin(), line.end());
+
+			// error markers
+			td_ErrorMarkers etmp;
+			for (auto& i : m_ErrorMarkers)
+				etmp.insert(td_ErrorMarkers::value_type(i.first - 1 == m_State.CursorPosition.Line ? i.first - 1 : i.first, i.second));
+			m_ErrorMarkers = std::move(etmp);
+
+			RemoveLine(m_State.CursorPosition.Line);
+			--m_State.CursorPosition.Line;
+			m_State.CursorPosition.Column = prevSize;
+		}
+		else
+		{
+			auto& line = m_Lines[m_State.CursorPosition.Line];
+			auto cindex = GetCharacterIndex(pos) - 1;
+			auto cend = cindex + 1;
+
+			while (cindex > 0 && IsUTFSequence(line[cindex].Character))
+				--cindex;
+
+			//if (cindex > 0 && UTF8CharLength(line[cindex].Character) > 1)
+			//	--cindex;
+
+			int actualLoc = pos.Column;
+
+			for (int i = 0; i < line.size(); i++)
 			{
-				--line;
+				if (line[i].Character == '\t')
+					actualLoc -= GetTabSize() - 1;
+			}
 
-				if ((int)m_Lines.size() > line)
-					cindex = (int)m_Lines[line].size();
-				else
-					cindex = 0;
+			if (m_CompleteBraces && actualLoc > 0 && actualLoc < line.size())
+			{
+				if ((line[actualLoc - 1].Character == '(' && line[actualLoc].Character == ')') || (line[actualLoc - 1].Character == '{' && line[actualLoc].Character == '}') || (line[actualLoc - 1].Character == '[' && line[actualLoc].Character == ']'))
+					Delete();
+			}
+
+			u.RemovedStart = u.RemovedEnd = GetActualCursorCoordinates();
+
+			while (cindex < line.size() && cend-- > cindex)
+			{
+				uint8_t chVal = line[cindex].Character;
+
+				int remColumn = 0;
+
+				for (int i = 0; i < cindex && i < line.size(); i++)
+				{
+					if (line[i].Character == '\t')
+					{
+						int tabSize = remColumn - (remColumn / m_TabSize) * m_TabSize;
+						remColumn += m_TabSize - tabSize;
+					}
+					else
+					{
+						remColumn++;
+					}
+				}
+
+				int remSize = m_State.CursorPosition.Column - remColumn;
+
+				u.Removed += line[cindex].Character;
+				u.RemovedStart.Column -= remSize;
+
+				line.erase(line.begin() + cindex);
+
+				m_State.CursorPosition.Column -= remSize;
 			}
 		}
-		else
+
+		OnLinesChanged(m_State.CursorPosition.Line, m_State.CursorPosition.Line + 1);
+
+		if (m_ScrollbarMarkers)
 		{
-			--cindex;
+			bool changeExists = false;
 
-			if (cindex > 0)
+			for (int i = 0; i < m_ChangedLines.size(); i++)
 			{
-				if ((int)m_Lines.size() > line)
+				if (m_ChangedLines[i] == m_State.CursorPosition.Line)
 				{
-					while (cindex > 0 && IsUTFSequence(m_Lines[line][cindex].Character))
-						--cindex;
+					changeExists = true;
+					break;
 				}
 			}
-		}
-
-		m_State.CursorPosition = Coordinates(line, GetCharacterColumn(line, cindex));
 
-		if (aWordMode)
-		{
-			m_State.CursorPosition = FindWordStart(m_State.CursorPosition);
-			cindex = GetCharacterIndex(m_State.CursorPosition);
+			if (!changeExists)
+				m_ChangedLines.push_back(m_State.CursorPosition.Line);
 		}
-	}
-
-	m_State.CursorPosition = Coordinates(line, GetCharacterColumn(line, cindex));
 
-	assert(m_State.CursorPosition.Column >= 0);
+		m_TextChanged = true;
 
-	if (aSelect)
-	{
-		m_InteractiveStart = m_State.SelectionStart;
-		m_InteractiveEnd = m_State.SelectionEnd;
+		if (OnContentUpdate != nullptr)
+			OnContentUpdate(this);
 
-		if (oldPos == m_InteractiveStart)
-		{
-			m_InteractiveStart = m_State.CursorPosition;
-		}
-		else if (oldPos == m_InteractiveEnd)
-		{
-			m_InteractiveEnd = m_State.CursorPosition;
-		}
-		else
-		{
-			m_InteractiveStart = m_State.CursorPosition;
-			m_InteractiveEnd = oldPos;
-		}
+		EnsureCursorVisible();
+		Colorize(m_State.CursorPosition.Line, 1);
 	}
-	else
+
+	u.After = m_State;
+	AddUndo(u);
+
+	// auto-complete
+	if (m_ActiveAutocomplete && m_ACOpened)
 	{
-		m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
+		m_RequestAutocomplete = true;
+		m_ReadyForAutocomplete = false;
 	}
+}
 
-	SetSelection(m_InteractiveStart, m_InteractiveEnd, SelectionMode::Normal);
-	EnsureCursorVisible();
+void ImTextEdit::SelectWordUnderCursor()
+{
+	auto c = GetCursorPosition();
+	SetSelection(FindWordStart(c), FindWordEnd(c));
 }
 
-void ImTextEdit::MoveRight(int aAmount, bool aSelect, bool aWordMode)
+void ImTextEdit::SelectAll()
 {
-	auto oldPos = m_State.CursorPosition;
+	SetSelection(Coordinates(0, 0), Coordinates((int)m_Lines.size(), 0));
+}
 
-	if (m_Lines.empty() || oldPos.Line >= m_Lines.size())
-		return;
-		
-	m_State.CursorPosition = GetActualCursorCoordinates();
-	auto line = m_State.CursorPosition.Line;
-	auto cindex = GetCharacterIndex(m_State.CursorPosition);
+bool ImTextEdit::HasSelection() const
+{
+	return m_State.SelectionEnd > m_State.SelectionStart;
+}
 
-	while (aAmount-- > 0)
-	{
-		auto lindex = m_State.CursorPosition.Line;
-		auto& line = m_Lines[lindex];
+void ImTextEdit::SetShortcut(ImTextEdit::ShortcutID id, Shortcut s)
+{
+	m_Shortcuts[(int)id].Key1 = s.Key1;
+	m_Shortcuts[(int)id].Key2 = s.Key2;
 
-		if (cindex >= line.size())
-		{
-			if (m_State.CursorPosition.Line < m_Lines.size() - 1)
-			{
-				m_State.CursorPosition.Line = std::max(0, std::min((int)m_Lines.size() - 1, m_State.CursorPosition.Line + 1));
-				m_State.CursorPosition.Column = 0;
-			}
-			else
-			{
-				return;
-			}
-		}
-		else
-		{
-			cindex += UTF8CharLength(line[cindex].Character);
-			m_State.CursorPosition = Coordinates(lindex, GetCharacterColumn(lindex, cindex));
+	if (m_Shortcuts[(int)id].Ctrl != 2)
+		m_Shortcuts[(int)id].Ctrl = s.Ctrl;
 
-			if (aWordMode)
-				m_State.CursorPosition = FindWordEnd(m_State.CursorPosition);
-		}
-	}
+	if (m_Shortcuts[(int)id].Shift != 2)
+		m_Shortcuts[(int)id].Shift = s.Shift;
 
-	if (aSelect)
-	{
-		m_InteractiveStart = m_State.SelectionStart;
-		m_InteractiveEnd = m_State.SelectionEnd;
+	if (m_Shortcuts[(int)id].Alt != 2)
+		m_Shortcuts[(int)id].Alt = s.Alt;
+}
 
-		if (oldPos == m_InteractiveEnd)
-		{
-			m_InteractiveEnd = m_State.CursorPosition;
-		}
-		else if (oldPos == m_InteractiveStart)
-		{
-			m_InteractiveStart = m_State.CursorPosition;
-		}
-		else
-		{
-			m_InteractiveStart = oldPos;
-			m_InteractiveEnd = m_State.CursorPosition;
-		}
+void ImTextEdit::Copy()
+{
+	if (HasSelection())
+	{
+		ImGui::SetClipboardText(GetSelectedText().c_str());
 	}
 	else
 	{
-		m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
-	}
-
-	SetSelection(m_InteractiveStart, m_InteractiveEnd, SelectionMode::Normal);
-	EnsureCursorVisible();
-}
+		if (!m_Lines.empty())
+		{
+			std::string str;
+			auto& line = m_Lines[GetActualCursorCoordinates().Line];
 
-void ImTextEdit::MoveTop(bool aSelect)
-{
-	auto oldPos = m_State.CursorPosition;
-	SetCursorPosition(Coordinates(0, 0));
+			str.assign((const char*)line.GetChars(), line.size());
 
-	if (m_State.CursorPosition != oldPos)
-	{
-		if (aSelect)
-		{
-			m_InteractiveEnd = oldPos;
-			m_InteractiveStart = m_State.CursorPosition;
-		}
-		else
-		{
-			m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
+			ImGui::SetClipboardText(str.c_str());
 		}
-
-		SetSelection(m_InteractiveStart, m_InteractiveEnd);
 	}
 }
 
-void ImTextEdit::MoveBottom(bool aSelect)
+void ImTextEdit::Cut()
 {
-	auto oldPos = GetCursorPosition();
-	auto newPos = Coordinates((int)m_Lines.size() - 1, 0);
-	SetCursorPosition(newPos);
-
-	if (aSelect)
+	if (IsReadOnly())
 	{
-		m_InteractiveStart = oldPos;
-		m_InteractiveEnd = newPos;
+		Copy();
 	}
-	else
+	else if (HasSelection())
 	{
-		m_InteractiveStart = m_InteractiveEnd = newPos;
-	}
+		UndoRecord u;
+		u.Before = m_State;
+		u.Removed = GetSelectedText();
+		u.RemovedStart = m_State.SelectionStart;
+		u.RemovedEnd = m_State.SelectionEnd;
 
-	SetSelection(m_InteractiveStart, m_InteractiveEnd);
+		Copy();
+		DeleteSelection();
+
+		u.After = m_State;
+		AddUndo(u);
+	}
 }
 
-void ImTextEdit::MoveHome(bool aSelect)
+void ImTextEdit::Paste()
 {
-	auto oldPos = m_State.CursorPosition;
-	SetCursorPosition(Coordinates(m_State.CursorPosition.Line, 0));
+	if (IsReadOnly())
+		return;
 
-	if (m_State.CursorPosition != oldPos)
+	auto clipText = ImGui::GetClipboardText();
+
+	if (clipText != nullptr && strlen(clipText) > 0)
 	{
-		if (aSelect)
-		{
-			if (oldPos == m_InteractiveStart)
-			{
-				m_InteractiveStart = m_State.CursorPosition;
-			}
-			else if (oldPos == m_InteractiveEnd)
-			{
-				m_InteractiveEnd = m_State.CursorPosition;
-			}
-			else
-			{
-				m_InteractiveStart = m_State.CursorPosition;
-				m_InteractiveEnd = oldPos;
-			}
-		}
-		else
+		UndoRecord u;
+		u.Before = m_State;
+
+		if (HasSelection())
 		{
-			m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
+			u.Removed = GetSelectedText();
+			u.RemovedStart = m_State.SelectionStart;
+			u.RemovedEnd = m_State.SelectionEnd;
+			DeleteSelection();
 		}
 
-		SetSelection(m_InteractiveStart, m_InteractiveEnd);
+		u.Added = clipText;
+		u.AddedStart = GetActualCursorCoordinates();
+
+		AppendText(clipText, m_AutoindentOnPaste);
+
+		u.AddedEnd = GetActualCursorCoordinates();
+		u.After = m_State;
+		AddUndo(u);
 	}
 }
 
-void ImTextEdit::MoveEnd(bool aSelect)
+bool ImTextEdit::CanUndo()
+{
+	return !IsReadOnly() && m_UndoIndex > 0;
+}
+
+bool ImTextEdit::CanRedo()
+{
+	return !IsReadOnly() && m_UndoIndex < (int)m_UndoBuffer.size();
+}
+
+void ImTextEdit::Undo(int aSteps)
+{
+	while (CanUndo() && aSteps-- > 0)
+		m_UndoBuffer[--m_UndoIndex].Undo(this);
+}
+
+void ImTextEdit::Redo(int aSteps)
 {
-	auto oldPos = m_State.CursorPosition;
-	SetCursorPosition(Coordinates(m_State.CursorPosition.Line, GetLineMaxColumn(oldPos.Line)));
-
-	if (m_State.CursorPosition != oldPos)
-	{
-		if (aSelect)
-		{
-			if (oldPos == m_InteractiveEnd)
-			{
-				m_InteractiveEnd = m_State.CursorPosition;
-			}
-			else if (oldPos == m_InteractiveStart)
-			{
-				m_InteractiveStart = m_State.CursorPosition;
-			}
-			else
-			{
-				m_InteractiveStart = oldPos;
-				m_InteractiveEnd = m_State.CursorPosition;
-			}
-		}
-		else
-		{
-			m_InteractiveStart = m_InteractiveEnd = m_State.CursorPosition;
-		}
+	while (CanRedo() && aSteps-- > 0)
+		m_UndoBuffer[m_UndoIndex++].Redo(this);
+}
 
-		SetSelection(m_InteractiveStart, m_InteractiveEnd);
-	}
+void ImTextEdit::ResetUndos()
+{
+	m_UndoIndex = 0;
+	m_UndoBuffer.clear();
+	m_UndoBuffer.shrink_to_fit();
 }
 
-void ImTextEdit::Delete()
+std::vector<std::string> ImTextEdit::GetRelevantExpressions(int line)
 {
-	assert(!m_ReadOnly);
+	std::vector<std::string> ret;
+	line--;
 
-	if (m_Lines.empty())
-		return;
+	if (line < 0 || line >= m_Lines.size() || (m_LanguageDefinition.Name != "HLSL" && m_LanguageDefinition.Name != "GLSL"))
+		return ret;
 
-	UndoRecord u;
-	u.Before = m_State;
+	std::string expr = "";
 
-	if (HasSelection())
-	{
-		u.Removed = GetSelectedText();
-		u.RemovedStart = m_State.SelectionStart;
-		u.RemovedEnd = m_State.SelectionEnd;
+	for (int i = 0; i < m_Lines[line].size(); i++)
+		expr += m_Lines[line][i].Character;
 
-		DeleteSelection();
-	}
-	else
+	enum class TokenType
 	{
-		auto pos = GetActualCursorCoordinates();
-		SetCursorPosition(pos);
-		auto& line = m_Lines[pos.Line];
+		Identifier,
+		Operator,
+		Number,
+		Parenthesis,
+		Comma,
+		Semicolon
+	};
+	
+	struct Token
+	{
+		TokenType Type;
+		std::string Content;
+	};
 
-		if (pos.Column == GetLineMaxColumn(pos.Line))
+	char buffer[512] = { 0 };
+	int bufferLoc = 0;
+	std::vector<Token> tokens;
+
+	// convert expression into list of tokens
+	const char* e = expr.c_str();
+
+	while (*e != 0)
+	{
+		if (*e == '*' || *e == '/' || *e == '+' || *e == '-' || *e == '%' || *e == '&' || *e == '|' || *e == '=' || *e == '(' || *e == ')' || *e == ',' || *e == ';' || *e == '<' || *e == '>')
 		{
-			if (pos.Line == (int)m_Lines.size() - 1)
-				return;
+			if (bufferLoc != 0)
+				tokens.push_back({ TokenType::Identifier, std::string(buffer) });
 
-			u.Removed = '\n';
-			u.RemovedStart = u.RemovedEnd = GetActualCursorCoordinates();
-			Advance(u.RemovedEnd);
+			memset(buffer, 0, 512);
+			bufferLoc = 0;
 
-			// move folds
-			for (int i = 0; i < m_FoldBegin.size(); i++)
+			if (*e == '(' || *e == ')')
+				tokens.push_back({ TokenType::Parenthesis, std::string(e, 1) });
+			else if (*e == ',')
+				tokens.push_back({ TokenType::Comma, "," });
+			else if (*e == ';')
+				tokens.push_back({ TokenType::Semicolon, ";" });
+			else
+				tokens.push_back({ TokenType::Operator, std::string(e, 1) });
+		}
+		else if (*e == '{' || *e == '}')
+		{
+			break;
+		}
+		else if (*e == '\n' || *e == '\r' || *e == ' ' || *e == '\t')
+		{
+			// empty the buffer if needed
+			if (bufferLoc != 0)
 			{
-				if (m_FoldBegin[i].Line == pos.Line + 1)
-				{
-					m_FoldBegin[i].Line = std::max<int>(0, m_FoldBegin[i].Line - 1);
-					m_FoldBegin[i].Column += GetCharacterColumn(pos.Line, line.size());
-				}
-			}
+				tokens.push_back({ TokenType::Identifier, std::string(buffer) });
 
-			for (int i = 0; i < m_FoldEnd.size(); i++)
-			{
-				if (m_FoldEnd[i].Line == pos.Line + 1)
-				{
-					m_FoldEnd[i].Line = std::max<int>(0, m_FoldEnd[i].Line - 1);
-					m_FoldEnd[i].Column += GetCharacterColumn(pos.Line, line.size());
-				}
+				memset(buffer, 0, 512);
+				bufferLoc = 0;
 			}
-
-			auto& nextLine = m_Lines[pos.Line + 1];
-			line.insert(line.end(), nextLine.begin(), nextLine.end());
-
-			RemoveLine(pos.Line + 1);
 		}
 		else
 		{
-			auto cindex = GetCharacterIndex(pos);
-			u.RemovedStart = u.RemovedEnd = GetActualCursorCoordinates();
-			u.RemovedEnd.Column++;
-			u.Removed = GetText(u.RemovedStart, u.RemovedEnd);
+			buffer[bufferLoc] = *e;
+			bufferLoc++;
+		}
 
-			RemoveFolds(u.RemovedStart, u.RemovedEnd);
+		e++;
+	}
 
-			auto d = UTF8CharLength(line[cindex].Character);
+	// empty the buffer
+	if (bufferLoc != 0)
+		tokens.push_back({ TokenType::Identifier, std::string(buffer) });
 
-			while (d-- > 0 && cindex < (int)line.size())
-				line.erase(line.begin() + cindex);
+	// some "post processing"
+	int multilineComment = 0;
+	for (int i = 0; i < tokens.size(); i++)
+	{
+		if (tokens[i].Type == TokenType::Identifier)
+		{
+			if (tokens[i].Content.size() > 0)
+			{
+				if (tokens[i].Content[0] == '.' || isdigit(tokens[i].Content[0]))
+					tokens[i].Type = TokenType::Number;
+				else if (tokens[i].Content == "true" || tokens[i].Content == "false")
+					tokens[i].Type = TokenType::Number;
+			}
 		}
-
-		if (m_ScrollbarMarkers)
+		else if (i != 0 && tokens[i].Type == TokenType::Operator)
 		{
-			bool changeExists = false;
-
-			for (int i = 0; i < m_ChangedLines.size(); i++)
+			if (tokens[i - 1].Type == TokenType::Operator)
 			{
-				if (m_ChangedLines[i] == m_State.CursorPosition.Line)
+				// comment
+				if (tokens[i].Content == "/" && tokens[i - 1].Content == "/")
 				{
-					changeExists = true;
+					tokens.erase(tokens.begin() + i - 1, tokens.end());
 					break;
 				}
+				else if (tokens[i - 1].Content == "/" && tokens[i].Content == "*")
+				{
+					multilineComment = i - 1;
+				}
+				else if (tokens[i - 1].Content == "*" && tokens[i].Content == "/")
+				{
+					tokens.erase(tokens.begin() + multilineComment, tokens.begin() + i + 1);
+					i -= (i - multilineComment) - 1;
+					multilineComment = 0;
+					continue;
+				}
+				else
+				{
+					// &&, <=, ...
+					tokens[i - 1].Content += tokens[i].Content;
+					tokens.erase(tokens.begin() + i);
+					i--;
+					continue;
+				}
 			}
-
-			if (!changeExists)
-				m_ChangedLines.push_back(m_State.CursorPosition.Line);
 		}
-
-		m_TextChanged = true;
-
-		if (OnContentUpdate != nullptr)
-			OnContentUpdate(this);
-
-		Colorize(pos.Line, 1);
 	}
 
-	u.After = m_State;
-	AddUndo(u);
-}
-
-void ImTextEdit::DuplicateLine()
-{
-	ImTextEdit::UndoRecord undo;
-	undo.Before = m_State;
-
-	auto oldLine = m_Lines[m_State.CursorPosition.Line];
-	auto& line = InsertLine(m_State.CursorPosition.Line, m_State.CursorPosition.Column);
-
-	undo.Added += '\n';
-
-	for (auto& glyph : oldLine)
+	// 1. get all the identifiers (highest priority)
+	for (int i = 0; i < tokens.size(); i++)
 	{
-		line.push_back(glyph);
-		undo.Added += glyph.Character;
+		if (tokens[i].Type == TokenType::Identifier)
+		{
+			if (i == tokens.size() - 1 || tokens[i + 1].Content != "(")
+			{
+				if (std::count(ret.begin(), ret.end(), tokens[i].Content) == 0)
+					ret.push_back(tokens[i].Content);
+			}
+		}
 	}
 
-	m_State.CursorPosition.Line++;
-
-	undo.AddedStart = ImTextEdit::Coordinates(m_State.CursorPosition.Line - 1, m_State.CursorPosition.Column);
-	undo.AddedEnd = m_State.CursorPosition;
-
-	undo.After = m_State;
-
-	AddUndo(undo);
-}
-
-void ImTextEdit::Backspace()
-{
-	assert(!m_ReadOnly);
-
-	if (m_Lines.empty())
-		return;
-
-	UndoRecord u;
-	u.Before = m_State;
+	// 2. get all the function calls, their arguments and expressions
+	std::stack<std::string> funcStack;
+	std::stack<std::string> argStack;
+	std::string exprBuffer = "";
+	int exprParenthesis = 0;
+	int forSection = -1;
+	for (int i = 0; i < tokens.size(); i++)
+	{
+		if ((forSection == -1 || forSection == 1) && tokens[i].Type == TokenType::Identifier && i + 1 < tokens.size() && tokens[i + 1].Content == "(")
+		{
+			if (tokens[i].Content == "if" || tokens[i].Content == "for" || tokens[i].Content == "while")
+			{
+				if (tokens[i].Content == "for")
+					forSection = 0;
+				else
+					i++; // skip '('
 
-	if (HasSelection())
-	{
-		u.Removed = GetSelectedText();
-		u.RemovedStart = m_State.SelectionStart;
-		u.RemovedEnd = m_State.SelectionEnd;
+				continue;
+			}
 
-		DeleteSelection();
-	}
-	else
-	{
-		auto pos = GetActualCursorCoordinates();
-		SetCursorPosition(pos);
+			funcStack.push(tokens[i].Content + "(");
+			argStack.push("");
+			i++;
 
-		if (m_State.CursorPosition.Column == 0)
+			continue;
+		}
+		else if ((forSection == -1 || forSection == 1) && (tokens[i].Type == TokenType::Comma || tokens[i].Content == ")") && !argStack.empty() && !funcStack.empty())
 		{
-			if (m_State.CursorPosition.Line == 0)
-				return;
+			funcStack.top() += argStack.top().substr(0, argStack.top().size() - 1) + tokens[i].Content;
 
-			u.Removed = '\n';
-			u.RemovedStart = u.RemovedEnd = Coordinates(pos.Line - 1, GetLineMaxColumn(pos.Line - 1));
-			Advance(u.RemovedEnd);
+			if (tokens[i].Content == ")")
+			{
+				std::string topFunc = funcStack.top();
+				funcStack.pop();
 
-			auto& line = m_Lines[m_State.CursorPosition.Line];
-			auto& prevLine = m_Lines[m_State.CursorPosition.Line - 1];
-			auto prevSize = GetLineMaxColumn(m_State.CursorPosition.Line - 1);
-			prevLine.insert(prevLine.end(), line.begin(), line.end());
+				if (!argStack.top().empty())
+					ret.push_back(argStack.top().substr(0, argStack.top().size() - 1));
 
-			// error markers
-			td_ErrorMarkers etmp;
-			for (auto& i : m_ErrorMarkers)
-				etmp.insert(td_ErrorMarkers::value_type(i.first - 1 == m_State.CursorPosition.Line ? i.first - 1 : i.first, i.second));
-			m_ErrorMarkers = std::move(etmp);
+				argStack.pop();
+				
+				if (!argStack.empty())
+					argStack.top() += topFunc + " ";
+
+				ret.push_back(topFunc);
 
-			// shift folds
-			for (int b = 0; b < m_FoldBegin.size(); b++)
+				if (funcStack.empty())
+					exprBuffer += topFunc + " ";
+			}
+			else if (tokens[i].Type == TokenType::Comma)
 			{
-				if (m_FoldBegin[b].Line == m_State.CursorPosition.Line)
-				{
-					m_FoldBegin[b].Line = std::max<int>(0, m_FoldBegin[b].Line - 1);
-					m_FoldBegin[b].Column = m_FoldBegin[b].Column + prevSize;
-				}
+				funcStack.top() += " ";
+				ret.push_back(argStack.top().substr(0, argStack.top().size() - 1));
+				argStack.top() = "";
 			}
-
-			for (int b = 0; b < m_FoldEnd.size(); b++)
+		}
+		else if (tokens[i].Type == TokenType::Semicolon)
+		{
+			if (forSection != -1)
 			{
-				if (m_FoldEnd[b].Line == m_State.CursorPosition.Line)
+				if (forSection == 1 && !exprBuffer.empty())
 				{
-					m_FoldEnd[b].Line = std::max<int>(0, m_FoldEnd[b].Line - 1);
-					m_FoldEnd[b].Column = m_FoldEnd[b].Column + prevSize;
+					ret.push_back(exprBuffer);
+					exprBuffer.clear();
+					exprParenthesis = 0;
 				}
-			}
 
-			RemoveLine(m_State.CursorPosition.Line);
-			--m_State.CursorPosition.Line;
-			m_State.CursorPosition.Column = prevSize;
+				forSection++;
+			}
 		}
-		else
+		else if (forSection == -1 || forSection == 1)
 		{
-			auto& line = m_Lines[m_State.CursorPosition.Line];
-			auto cindex = GetCharacterIndex(pos) - 1;
-			auto cend = cindex + 1;
-
-			while (cindex > 0 && IsUTFSequence(line[cindex].Character))
-				--cindex;
-
-			//if (cindex > 0 && UTF8CharLength(line[cindex].Character) > 1)
-			//	--cindex;
-
-			int actualLoc = pos.Column;
+			if (tokens[i].Content == "(")
+				exprParenthesis++;
+			else if (tokens[i].Content == ")")
+				exprParenthesis--;
 
-			for (int i = 0; i < line.size(); i++)
+			if (!argStack.empty())
 			{
-				if (line[i].Character == '\t')
-					actualLoc -= GetTabSize() - 1;
+				argStack.top() += tokens[i].Content + " ";
 			}
-
-			if (m_CompleteBraces && actualLoc > 0 && actualLoc < line.size())
+			else if (exprParenthesis < 0)
 			{
-				if ((line[actualLoc - 1].Character == '(' && line[actualLoc].Character == ')') || (line[actualLoc - 1].Character == '{' && line[actualLoc].Character == '}') || (line[actualLoc - 1].Character == '[' && line[actualLoc].Character == ']'))
-					Delete();
+				if (!exprBuffer.empty())
+					ret.push_back(exprBuffer.substr(0, exprBuffer.size() - 1));
+				exprBuffer.clear();
+				exprParenthesis = 0;
 			}
-
-			u.RemovedStart = u.RemovedEnd = GetActualCursorCoordinates();
-
-			while (cindex < line.size() && cend-- > cindex)
+			else if (tokens[i].Type == TokenType::Operator && (tokens[i].Content.size() >= 2 || tokens[i].Content == "="))
 			{
-				uint8_t chVal = line[cindex].Character;
+				if (!exprBuffer.empty())
+					ret.push_back(exprBuffer.substr(0, exprBuffer.size() - 1));
 
-				int remColumn = 0;
+				exprBuffer.clear();
+				exprParenthesis = 0;
+			}
+			else
+			{
+				bool isKeyword = false;
 
-				for (int i = 0; i < cindex && i < line.size(); i++)
+				for (const auto& kwd : m_LanguageDefinition.Keywords)
 				{
-					if (line[i].Character == '\t')
-					{
-						int tabSize = remColumn - (remColumn / m_TabSize) * m_TabSize;
-						remColumn += m_TabSize - tabSize;
-					}
-					else
+					if (kwd == tokens[i].Content)
 					{
-						remColumn++;
+						isKeyword = true;
+						break;
 					}
 				}
+				
+				if (!isKeyword)
+					exprBuffer += tokens[i].Content + " ";
+			}
+		}
+	}
 
-				int remSize = m_State.CursorPosition.Column - remColumn;
+	if (!exprBuffer.empty())
+		ret.push_back(exprBuffer.substr(0, exprBuffer.size() - 1));
 
-				u.Removed += line[cindex].Character;
-				u.RemovedStart.Column -= remSize;
+	// remove duplicates, numbers & keywords
+	for (int i = 0; i < ret.size(); i++)
+	{
+		std::string r = ret[i];
+		bool eraseR = false;
 
-				line.erase(line.begin() + cindex);
+		// empty or duplicate
+		if (ret.empty() || std::count(ret.begin(), ret.begin() + i, r) > 0)
+			eraseR = true;
 
-				m_State.CursorPosition.Column -= remSize;
-			}
+		// boolean
+		if (r == "true" || r == "false")
+			eraseR = true;
 
-			RemoveFolds(u.RemovedStart, u.RemovedEnd);
-		}
+		// number
+		bool isNumber = true;
 
-		if (m_ScrollbarMarkers)
+		for (int i = 0; i < r.size(); i++)
 		{
-			bool changeExists = false;
+			if (!isdigit(r[i]) && r[i] != '.' && r[i] != 'f')
+			{
+				isNumber = false;
+				break;
+			}
+		}
 
-			for (int i = 0; i < m_ChangedLines.size(); i++)
+		if (isNumber)
+			eraseR = true;
+
+		// keyword
+		if (!eraseR)
+		{
+			for (const auto& ident : m_LanguageDefinition.Identifiers)
 			{
-				if (m_ChangedLines[i] == m_State.CursorPosition.Line)
+				if (ident.first == r)
 				{
-					changeExists = true;
+					eraseR = true;
 					break;
 				}
 			}
 
-			if (!changeExists)
-				m_ChangedLines.push_back(m_State.CursorPosition.Line);
+			for (const auto& kwd : m_LanguageDefinition.Keywords)
+			{
+				if (kwd == r)
+				{
+					eraseR = true;
+					break;
+				}
+			}
 		}
 
-		m_TextChanged = true;
-
-		if (OnContentUpdate != nullptr)
-			OnContentUpdate(this);
-
-		EnsureCursorVisible();
-		Colorize(m_State.CursorPosition.Line, 1);
-	}
-
-	u.After = m_State;
-	AddUndo(u);
+		// delete it from the array
+		if (eraseR)
+		{
+			ret.erase(ret.begin() + i);
+			i--;
 
-	// auto-complete
-	if (m_ActiveAutocomplete && m_ACOpened)
-	{
-		m_RequestAutocomplete = true;
-		m_ReadyForAutocomplete = false;
+			continue;
+		}
 	}
-}
 
-void ImTextEdit::SelectWordUnderCursor()
-{
-	auto c = GetCursorPosition();
-	SetSelection(FindWordStart(c), FindWordEnd(c));
+	return ret;
 }
 
-void ImTextEdit::SelectAll()
+const ImTextEdit::td_Palette & ImTextEdit::GetDarkPalette()
 {
-	SetSelection(Coordinates(0, 0), Coordinates((int)m_Lines.size(), 0));
-}
+	const static td_Palette p =
+	{
+		{
+			0xff7f7f7f,	// Default
+			0xffd69c56,	// Keyword	
+			0xff00ff00,	// Number
+			0xff7070e0,	// String
+			0xff70a0e0, // Char literal
+			0xffffffff, // Punctuation
+			0xff408080,	// Preprocessor
+			0xffaaaaaa, // Identifier
+			0xff9bc64d, // Known identifier
+			0xffc040a0, // Preproc identifier
+			0xff206020, // Comment (single line)
+			0xff406020, // Comment (multi line)
+			0xff101010, // Background
+			0xffe0e0e0, // Cursor
+			0x80a06020, // Selection
+			0x800020ff, // ErrorMarker
+			0xff0000ff, // Breakpoint
+			0xffffffff, // Breakpoint outline
+			0xFF1DD8FF, // Current line indicator
+			0xFF696969, // Current line indicator outline
+			0xff707000, // Line number
+			0x40000000, // Current line fill
+			0x40808080, // Current line fill (inactive)
+			0x40a0a0a0, // Current line edge
+			0xff33ffff, // Error message
+			0xffffffff, // BreakpointDisabled
+			0xffaaaaaa, // UserFunction
+			0xffb0c94e, // UserType
+			0xffaaaaaa, // UniformType
+			0xffaaaaaa, // GlobalVariable
+			0xffaaaaaa, // LocalVariable
+			0xff888888	// FunctionArgument
+		}
+	};
 
-bool ImTextEdit::HasSelection() const
-{
-	return m_State.SelectionEnd > m_State.SelectionStart;
+	return p;
 }
 
-void ImTextEdit::SetShortcut(ImTextEdit::ShortcutID id, Shortcut s)
+const ImTextEdit::td_Palette & ImTextEdit::GetLightPalette()
 {
-	m_Shortcuts[(int)id].Key1 = s.Key1;
-	m_Shortcuts[(int)id].Key2 = s.Key2;
-
-	if (m_Shortcuts[(int)id].Ctrl != 2)
-		m_Shortcuts[(int)id].Ctrl = s.Ctrl;
-
-	if (m_Shortcuts[(int)id].Shift != 2)
-		m_Shortcuts[(int)id].Shift = s.Shift;
+	const static td_Palette p =
+	{
+		{
+			0xff7f7f7f,	// None
+			0xffff0c06,	// Keyword	
+			0xff008000,	// Number
+			0xff2020a0,	// String
+			0xff304070, // Char literal
+			0xff000000, // Punctuation
+			0xff406060,	// Preprocessor
+			0xff404040, // Identifier
+			0xff606010, // Known identifier
+			0xffc040a0, // Preproc identifier
+			0xff205020, // Comment (single line)
+			0xff405020, // Comment (multi line)
+			0xffffffff, // Background
+			0xff000000, // Cursor
+			0x80DFBF80, // Selection
+			0xa00010ff, // ErrorMarker
+			0xff0000ff, // Breakpoint
+			0xff000000, // Breakpoint outline
+			0xFF1DD8FF, // Current line indicator
+			0xFF696969, // Current line indicator outline
+			0xff505000, // Line number
+			0x20000000, // Current line fill
+			0x20808080, // Current line fill (inactive)
+			0x30000000, // Current line edge
+			0xff3333ff, // Error message
+			0xffffffff, // BreakpointDisabled
+			0xff404040, // UserFunction
+			0xffb0912b, // UserType
+			0xff404040, // UniformType
+			0xff404040, // GlobalVariable
+			0xff404040, // LocalVariable
+			0xff606060	// FunctionArgument
+		}
+	};
 
-	if (m_Shortcuts[(int)id].Alt != 2)
-		m_Shortcuts[(int)id].Alt = s.Alt;
+	return p;
 }
 
-void ImTextEdit::Copy()
+const ImTextEdit::td_Palette & ImTextEdit::GetRetroBluePalette()
 {
-	if (HasSelection())
-	{
-		ImGui::SetClipboardText(GetSelectedText().c_str());
-	}
-	else
+	const static td_Palette p =
 	{
-		if (!m_Lines.empty())
 		{
-			std::string str;
-			auto& line = m_Lines[GetActualCursorCoordinates().Line];
-
-			for (auto& g : line)
-				str.push_back(g.Character);
-
-			ImGui::SetClipboardText(str.c_str());
+			0xff00ffff,	// None
+			0xffffff00,	// Keyword	
+			0xff00ff00,	// Number
+			0xff808000,	// String
+			0xff808000, // Char literal
+			0xffffffff, // Punctuation
+			0xff008000,	// Preprocessor
+			0xff00ffff, // Identifier
+			0xffffffff, // Known identifier
+			0xffff00ff, // Preproc identifier
+			0xff808080, // Comment (single line)
+			0xff404040, // Comment (multi line)
+			0xff800000, // Background
+			0xff0080ff, // Cursor
+			0x80ffff00, // Selection
+			0xa00000ff, // ErrorMarker
+			0xff0000ff, // Breakpoint
+			0xffffffff, // Breakpoint outline
+			0xFF1DD8FF, // Current line indicator
+			0xff808000, // Line number
+			0x40000000, // Current line fill
+			0x40808080, // Current line fill (inactive)
+			0x40000000, // Current line edge
+			0xffffff00, // Error message
+			0xffffffff, // BreakpointDisabled
+			0xff00ffff, // UserFunction
+			0xff00ffff, // UserType
+			0xff00ffff, // UniformType
+			0xff00ffff, // GlobalVariable
+			0xff00ffff, // LocalVariable
+			0xff00ffff	// FunctionArgument
 		}
-	}
+	};
+
+	return p;
 }
 
-void ImTextEdit::Cut()
+
+std::string ImTextEdit::GetText() const
 {
-	if (IsReadOnly())
-	{
-		Copy();
-	}
-	else if (HasSelection())
-	{
-		UndoRecord u;
-		u.Before = m_State;
-		u.Removed = GetSelectedText();
-		u.RemovedStart = m_State.SelectionStart;
-		u.RemovedEnd = m_State.SelectionEnd;
+	return GetText(Coordinates(), Coordinates((int)m_Lines.size(), 0));
+}
 
-		Copy();
-		DeleteSelection();
+void ImTextEdit::GetTextLines(std::vector<std::string>& result) const
+{
+	result.reserve(m_Lines.size());
 
-		u.After = m_State;
-		AddUndo(u);
-	}
+	for (auto & line : m_Lines)
+		result.emplace_back((const char*)line.GetChars(), line.size());
 }
 
-void ImTextEdit::Paste()
+ImTextEdit::MemoryUsage ImTextEdit::GetMemoryUsage() const
 {
-	if (IsReadOnly())
-		return;
-
-	auto clipText = ImGui::GetClipboardText();
+	MemoryUsage usage;
+	usage.LineCount = m_Lines.size();
 
-	if (clipText != nullptr && strlen(clipText) > 0)
+	for (size_t i = 0; i < m_Lines.size(); i++)
 	{
-		UndoRecord u;
-		u.Before = m_State;
+		const char* begin;
+		const char* end;
 
-		if (HasSelection())
+		// a line that wasn't loaded is only in the mapped file
+		if (m_Lines.GetMappedText(i, begin, end))
 		{
-			u.Removed = GetSelectedText();
-			u.RemovedStart = m_State.SelectionStart;
-			u.RemovedEnd = m_State.SelectionEnd;
-			DeleteSelection();
+			size_t bytes = (end - begin) - std::count(begin, end, '\r');
+			usage.TextBytes += bytes;
+			usage.GlyphStorageLegacy += sizeof(std::vector<Glyph>) + bytes * sizeof(Glyph);
+			continue;
 		}
 
-		u.Added = clipText;
-		u.AddedStart = GetActualCursorCoordinates();
-
-		AppendText(clipText, m_AutoindentOnPaste);
-
-		u.AddedEnd = GetActualCursorCoordinates();
-		u.After = m_State;
-		AddUndo(u);
+		auto& line = m_Lines[i];
+		usage.TextBytes += line.size();
+		usage.GlyphStorage += line.GetMemoryUsage();
+		usage.GlyphStorageLegacy += sizeof(std::vector<Glyph>) + line.size() * sizeof(Glyph);
 	}
-}
-
-bool ImTextEdit::CanUndo()
-{
-	return !IsReadOnly() && m_UndoIndex > 0;
-}
 
-bool ImTextEdit::CanRedo()
-{
-	return !IsReadOnly() && m_UndoIndex < (int)m_UndoBuffer.size();
+	return usage;
 }
 
-void ImTextEdit::Undo(int aSteps)
+std::string ImTextEdit::GetSelectedText() const
 {
-	while (CanUndo() && aSteps-- > 0)
-		m_UndoBuffer[--m_UndoIndex].Undo(this);
+	return GetText(m_State.SelectionStart, m_State.SelectionEnd);
 }
 
-void ImTextEdit::Redo(int aSteps)
+std::string ImTextEdit::GetCurrentLineText()const
 {
-	while (CanRedo() && aSteps-- > 0)
-		m_UndoBuffer[m_UndoIndex++].Redo(this);
+	auto lineLength = GetLineMaxColumn(m_State.CursorPosition.Line);
+	
+	return GetText(Coordinates(m_State.CursorPosition.Line, 0), Coordinates(m_State.CursorPosition.Line, lineLength));
 }
 
-void ImTextEdit::ResetUndos()
+void ImTextEdit::Colorize(int aFromLine, int aLines)
 {
-	m_UndoIndex = 0;
-	m_UndoBuffer.clear();
-	m_UndoBuffer.shrink_to_fit();
+	int toLine = aLines == -1 ? (int)m_Lines.size() : std::min<int>((int)m_Lines.size(), aFromLine + aLines);
+	MarkColorDirty(aFromLine, toLine);
+	m_LexDirtyLine = std::max<int>(0, std::min<int>(m_LexDirtyLine, aFromLine));
+	m_LexDirtyEnd = std::max(m_LexDirtyEnd, toLine);
+	m_DocumentVersion++;
 }
 
-std::vector<std::string> ImTextEdit::GetRelevantExpressions(int line)
+void ImTextEdit::ColorizeRange(int aFromLine, int aToLine)
 {
-	std::vector<std::string> ret;
-	line--;
-
-	if (line < 0 || line >= m_Lines.size() || (m_LanguageDefinition.Name != "HLSL" && m_LanguageDefinition.Name != "GLSL"))
-		return ret;
-
-	std::string expr = "";
+	if (m_Lines.empty() || !m_ColorizerEnabled)
+		return;
 
-	for (int i = 0; i < m_Lines[line].size(); i++)
-		expr += m_Lines[line][i].Character;
+	int endLine = std::max(0, std::min((int)m_Lines.size(), aToLine));
 
-	enum class TokenType
-	{
-		Identifier,
-		Operator,
-		Number,
-		Parenthesis,
-		Comma,
-		Semicolon
-	};
-	
-	struct Token
+	for (int i = aFromLine; i < endLine; ++i)
 	{
-		TokenType Type;
-		std::string Content;
-	};
+		auto& line = m_Lines[i];
 
-	char buffer[512] = { 0 };
-	int bufferLoc = 0;
-	std::vector<Token> tokens;
+		if (line.empty())
+			continue;
 
-	// convert expression into list of tokens
-	const char* e = expr.c_str();
+		int tokens = std::numeric_limits<int>::max();
+		const char* bufferBegin = (const char*)line.GetChars();
+		ColorizeLine(*m_ColorizerContext, bufferBegin, bufferBegin + line.size(), 0, line.GetPreprocessorStart(), line.GetColors(), tokens);
+	}
 
-	while (*e != 0)
-	{
-		if (*e == '*' || *e == '/' || *e == '+' || *e == '-' || *e == '%' || *e == '&' || *e == '|' || *e == '=' || *e == '(' || *e == ')' || *e == ',' || *e == ';' || *e == '<' || *e == '>')
-		{
-			if (bufferLoc != 0)
-				tokens.push_back({ TokenType::Identifier, std::string(buffer) });
+	m_Brackets.Invalidate(aFromLine, endLine);
+	InvalidateRenderCache();
 
-			memset(buffer, 0, 512);
-			bufferLoc = 0;
+	if (aFromLine <= m_ColorizeResumeLine && m_ColorizeResumeLine < endLine)
+		m_ColorizeResumeLine = -1;
+}
 
-			if (*e == '(' || *e == ')')
-				tokens.push_back({ TokenType::Parenthesis, std::string(e, 1) });
-			else if (*e == ',')
-				tokens.push_back({ TokenType::Comma, "," });
-			else if (*e == ';')
-				tokens.push_back({ TokenType::Semicolon, ";" });
-			else
-				tokens.push_back({ TokenType::Operator, std::string(e, 1) });
-		}
-		else if (*e == '{' || *e == '}')
-		{
-			break;
-		}
-		else if (*e == '\n' || *e == '\r' || *e == ' ' || *e == '\t')
-		{
-			// empty the buffer if needed
-			if (bufferLoc != 0)
-			{
-				tokens.push_back({ TokenType::Identifier, std::string(buffer) });
+size_t ImTextEdit::ColorizeLine(const ColorizerContext& aContext, const char* aBegin, const char* aEnd, size_t aStart, size_t aPreprocStart, uint8_t* aColors, int& aTokens)
+{
+	// runs on the colorizer thread too, so only touch aContext and the buffers passed in
+	auto& language = aContext.Language;
 
-				memset(buffer, 0, 512);
-				bufferLoc = 0;
-			}
-		}
-		else
-		{
-			buffer[bufferLoc] = *e;
-			bufferLoc++;
-		}
+	std::cmatch results;
 
-		e++;
-	}
+	std::fill(aColors + aStart, aColors + (aEnd - aBegin), (uint8_t)PaletteIndex::Default);
 
-	// empty the buffer
-	if (bufferLoc != 0)
-		tokens.push_back({ TokenType::Identifier, std::string(buffer) });
+	auto last = aEnd;
 
-	// some "post processing"
-	int multilineComment = 0;
-	for (int i = 0; i < tokens.size(); i++)
+	// tokens don't look at what came before them on the line, so stopping between two is safe
+	for (auto first = aBegin + aStart; first != last;)
 	{
-		if (tokens[i].Type == TokenType::Identifier)
+		if (aTokens-- <= 0)
+			return first - aBegin;
+
+		const char* token_begin = nullptr;
+		const char* token_end = nullptr;
+		PaletteIndex token_color = PaletteIndex::Default;
+
+		bool hasTokenizeResult = false;
+
+		if (language.Tokenize != nullptr)
 		{
-			if (tokens[i].Content.size() > 0)
+			if (language.Tokenize(first, last, token_begin, token_end, token_color))
+				hasTokenizeResult = true;
+		}
+
+		if (hasTokenizeResult == false && !aContext.TokenDFA.IsEmpty())
+		{
+			int pattern;
+
+			if (aContext.TokenDFA.Match(first, last, token_end, pattern))
 			{
-				if (tokens[i].Content[0] == '.' || isdigit(tokens[i].Content[0]))
-					tokens[i].Type = TokenType::Number;
-				else if (tokens[i].Content == "true" || tokens[i].Content == "false")
-					tokens[i].Type = TokenType::Number;
+				hasTokenizeResult = true;
+				token_begin = first;
+				token_color = language.TokenRegexStrings[pattern].second;
 			}
 		}
-		else if (i != 0 && tokens[i].Type == TokenType::Operator)
+		else if (hasTokenizeResult == false)
 		{
-			if (tokens[i - 1].Type == TokenType::Operator)
+			for (auto& p : aContext.RegexList)
 			{
-				// comment
-				if (tokens[i].Content == "/" && tokens[i - 1].Content == "/")
+				if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
 				{
-					tokens.erase(tokens.begin() + i - 1, tokens.end());
+					hasTokenizeResult = true;
+
+					auto& v = *results.begin();
+					token_begin = v.first;
+					token_end = v.second;
+					token_color = p.second;
 					break;
 				}
-				else if (tokens[i - 1].Content == "/" && tokens[i].Content == "*")
-				{
-					multilineComment = i - 1;
-				}
-				else if (tokens[i - 1].Content == "*" && tokens[i].Content == "/")
+			}
+		}
+
+		if (hasTokenizeResult == false)
+		{
+			first++;
+		}
+		else
+		{
+			if (token_color == PaletteIndex::Identifier)
+			{
+				int mask = aContext.Identifiers.Find(token_begin, token_end);
+
+				if ((size_t)(first - aBegin) < aPreprocStart)
 				{
-					tokens.erase(tokens.begin() + multilineComment, tokens.begin() + i + 1);
-					i -= (i - multilineComment) - 1;
-					multilineComment = 0;
-					continue;
+					if (mask & IdentifierTable::ClassKeyword)
+						token_color = PaletteIndex::Keyword;
+					else if (mask & IdentifierTable::ClassKnownIdentifier)
+						token_color = PaletteIndex::KnownIdentifier;
+					else if (mask & IdentifierTable::ClassPreprocIdentifier)
+						token_color = PaletteIndex::PreprocIdentifier;
 				}
 				else
 				{
-					// &&, <=, ...
-					tokens[i - 1].Content += tokens[i].Content;
-					tokens.erase(tokens.begin() + i);
-					i--;
-					continue;
+					if (mask & IdentifierTable::ClassPreprocIdentifier)
+						token_color = PaletteIndex::PreprocIdentifier;
 				}
 			}
+
+			std::fill(aColors + (token_begin - aBegin), aColors + (token_end - aBegin), (uint8_t)token_color);
+
+			first = token_end;
 		}
 	}
 
-	// 1. get all the identifiers (highest priority)
-	for (int i = 0; i < tokens.size(); i++)
+	return aEnd - aBegin;
+}
+
+static inline unsigned char FoldCase(char aChar)
+{
+	// case insensitive languages have always looked their keywords up in upper case
+	unsigned char c = (unsigned char)aChar;
+	return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+uint64_t ImTextEdit::IdentifierTable::Hash(const char* aBegin, const char* aEnd) const
+{
+	// fnv-1a
+	uint64_t hash = 14695981039346656037ull;
+
+	if (m_CaseSensitive)
 	{
-		if (tokens[i].Type == TokenType::Identifier)
-		{
-			if (i == tokens.size() - 1 || tokens[i + 1].Content != "(")
-			{
-				if (std::count(ret.begin(), ret.end(), tokens[i].Content) == 0)
-					ret.push_back(tokens[i].Content);
-			}
-		}
+		for (const char* p = aBegin; p != aEnd; p++)
+			hash = (hash ^ (unsigned char)*p) * 1099511628211ull;
+	}
+	else
+	{
+		for (const char* p = aBegin; p != aEnd; p++)
+			hash = (hash ^ FoldCase(*p)) * 1099511628211ull;
 	}
 
-	// 2. get all the function calls, their arguments and expressions
-	std::stack<std::string> funcStack;
-	std::stack<std::string> argStack;
-	std::string exprBuffer = "";
-	int exprParenthesis = 0;
-	int forSection = -1;
-	for (int i = 0; i < tokens.size(); i++)
+	return hash;
+}
+
+uint32_t ImTextEdit::IdentifierTable::Mix(uint64_t aHash, uint32_t aSeed)
+{
+	uint64_t h = aHash ^ (aSeed * 0x9E3779B97F4A7C15ull);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return (uint32_t)h;
+}
+
+void ImTextEdit::IdentifierTable::Build(const LanguageDefinition& aLanguage)
+{
+	m_CaseSensitive = aLanguage.CaseSensitive;
+	m_Seeds.clear();
+	m_Slots.clear();
+	m_Keys.clear();
+
+	std::unordered_map<std::string, int> masks;
+
+	for (auto& k : aLanguage.Keywords)
+		masks[k] |= ClassKeyword;
+	for (auto& k : aLanguage.Identifiers)
+		masks[k.first] |= ClassKnownIdentifier;
+	for (auto& k : aLanguage.PreprocIdentifiers)
+		masks[k.first] |= ClassPreprocIdentifier;
+
+	std::vector<std::pair<std::string, int>> keys;
+	std::vector<uint64_t> hashes;
+
+	for (auto& k : masks)
 	{
-		if ((forSection == -1 || forSection == 1) && tokens[i].Type == TokenType::Identifier && i + 1 < tokens.size() && tokens[i + 1].Content == "(")
+		// an upper cased token can never equal a key with lower case letters
+		bool reachable = !k.first.empty() && k.first.size() <= 0xffff;
+
+		for (size_t i = 0; reachable && !m_CaseSensitive && i < k.first.size(); i++)
+			reachable = FoldCase(k.first[i]) == (unsigned char)k.first[i];
+
+		if (reachable)
 		{
-			if (tokens[i].Content == "if" || tokens[i].Content == "for" || tokens[i].Content == "while")
-			{
-				if (tokens[i].Content == "for")
-					forSection = 0;
-				else
-					i++; // skip '('
+			keys.push_back(k);
+			hashes.push_back(Hash(k.first.data(), k.first.data() + k.first.size()));
+		}
+	}
 
-				continue;
-			}
+	if (keys.empty())
+		return;
 
-			funcStack.push(tokens[i].Content + "(");
-			argStack.push("");
-			i++;
+	size_t slotCount = 1;
+	while (slotCount < keys.size() * 2)
+		slotCount <<= 1;
 
-			continue;
-		}
-		else if ((forSection == -1 || forSection == 1) && (tokens[i].Type == TokenType::Comma || tokens[i].Content == ")") && !argStack.empty() && !funcStack.empty())
-		{
-			funcStack.top() += argStack.top().substr(0, argStack.top().size() - 1) + tokens[i].Content;
+	const size_t bucketCount = keys.size() / 4 + 1;
 
-			if (tokens[i].Content == ")")
-			{
-				std::string topFunc = funcStack.top();
-				funcStack.pop();
+	std::vector<std::vector<int>> buckets(bucketCount);
+	for (size_t i = 0; i < keys.size(); i++)
+		buckets[(hashes[i] >> 32) % bucketCount].push_back((int)i);
 
-				if (!argStack.top().empty())
-					ret.push_back(argStack.top().substr(0, argStack.top().size() - 1));
+	// place the crowded buckets first while the table is still empty
+	std::vector<int> order(bucketCount);
+	for (size_t i = 0; i < bucketCount; i++)
+		order[i] = (int)i;
+	std::sort(order.begin(), order.end(), [&buckets](int a, int b) { return buckets[a].size() > buckets[b].size(); });
 
-				argStack.pop();
-				
-				if (!argStack.empty())
-					argStack.top() += topFunc + " ";
+	std::vector<int> slotKey;
+	std::vector<size_t> used;
 
-				ret.push_back(topFunc);
+	for (bool placed = false; !placed; slotCount <<= 1)
+	{
+		slotKey.assign(slotCount, -1);
+		m_Seeds.assign(bucketCount, 0);
+		placed = true;
 
-				if (funcStack.empty())
-					exprBuffer += topFunc + " ";
-			}
-			else if (tokens[i].Type == TokenType::Comma)
-			{
-				funcStack.top() += " ";
-				ret.push_back(argStack.top().substr(0, argStack.top().size() - 1));
-				argStack.top() = "";
-			}
-		}
-		else if (tokens[i].Type == TokenType::Semicolon)
+		for (int b : order)
 		{
-			if (forSection != -1)
+			auto& bucket = buckets[b];
+
+			if (bucket.empty())
+				break;
+
+			uint32_t seed = 1;
+
+			for (; seed < 0x10000; seed++)
 			{
-				if (forSection == 1 && !exprBuffer.empty())
+				used.clear();
+
+				for (int k : bucket)
 				{
-					ret.push_back(exprBuffer);
-					exprBuffer.clear();
-					exprParenthesis = 0;
+					size_t slot = Mix(hashes[k], seed) & (slotCount - 1);
+
+					if (slotKey[slot] != -1 || std::find(used.begin(), used.end(), slot) != used.end())
+						break;
+
+					used.push_back(slot);
 				}
 
-				forSection++;
+				if (used.size() == bucket.size())
+					break;
 			}
-		}
-		else if (forSection == -1 || forSection == 1)
-		{
-			if (tokens[i].Content == "(")
-				exprParenthesis++;
-			else if (tokens[i].Content == ")")
-				exprParenthesis--;
 
-			if (!argStack.empty())
-			{
-				argStack.top() += tokens[i].Content + " ";
-			}
-			else if (exprParenthesis < 0)
+			// no seed works, retry with a bigger table
+			if (seed == 0x10000)
 			{
-				if (!exprBuffer.empty())
-					ret.push_back(exprBuffer.substr(0, exprBuffer.size() - 1));
-				exprBuffer.clear();
-				exprParenthesis = 0;
+				placed = false;
+				break;
 			}
-			else if (tokens[i].Type == TokenType::Operator && (tokens[i].Content.size() >= 2 || tokens[i].Content == "="))
-			{
-				if (!exprBuffer.empty())
-					ret.push_back(exprBuffer.substr(0, exprBuffer.size() - 1));
 
-				exprBuffer.clear();
-				exprParenthesis = 0;
-			}
-			else
-			{
-				bool isKeyword = false;
+			m_Seeds[b] = seed;
+			for (size_t i = 0; i < bucket.size(); i++)
+				slotKey[used[i]] = bucket[i];
+		}
 
-				for (const auto& kwd : m_LanguageDefinition.Keywords)
-				{
-					if (kwd == tokens[i].Content)
-					{
-						isKeyword = true;
-						break;
-					}
-				}
-				
-				if (!isKeyword)
-					exprBuffer += tokens[i].Content + " ";
-			}
+		if (placed)
+			break;
+	}
+
+	m_Slots.resize(slotCount);
+
+	for (size_t i = 0; i < slotCount; i++)
+	{
+		Slot& slot = m_Slots[i];
+		slot.Offset = (uint32_t)m_Keys.size();
+		slot.Length = 0;
+		slot.Mask = 0;
+
+		if (slotKey[i] != -1)
+		{
+			auto& key = keys[slotKey[i]];
+			slot.Length = (uint16_t)key.first.size();
+			slot.Mask = (uint8_t)key.second;
+			m_Keys += key.first;
 		}
 	}
+}
 
-	if (!exprBuffer.empty())
-		ret.push_back(exprBuffer.substr(0, exprBuffer.size() - 1));
+int ImTextEdit::IdentifierTable::Find(const char* aBegin, const char* aEnd) const
+{
+	if (m_Seeds.empty())
+		return 0;
 
-	// remove duplicates, numbers & keywords
-	for (int i = 0; i < ret.size(); i++)
+	const size_t length = aEnd - aBegin;
+	const uint64_t hash = Hash(aBegin, aEnd);
+	const uint32_t seed = m_Seeds[(hash >> 32) % m_Seeds.size()];
+	const Slot& slot = m_Slots[Mix(hash, seed) & (m_Slots.size() - 1)];
+
+	if (slot.Mask == 0 || slot.Length != length)
+		return 0;
+
+	const char* key = m_Keys.data() + slot.Offset;
+
+	if (m_CaseSensitive)
+		return memcmp(key, aBegin, length) == 0 ? slot.Mask : 0;
+
+	for (size_t i = 0; i < length; i++)
+		if (FoldCase(aBegin[i]) != (unsigned char)key[i])
+			return 0;
+
+	return slot.Mask;
+}
+
+void ImTextEdit::ColorizerThread(ColorizerWorker* aWorker)
+{
+	for (;;)
 	{
-		std::string r = ret[i];
-		bool eraseR = false;
+		std::unique_ptr<ColorizerJob> job;
 
-		// empty or duplicate
-		if (ret.empty() || std::count(ret.begin(), ret.begin() + i, r) > 0)
-			eraseR = true;
+		{
+			std::unique_lock<std::mutex> lock(aWorker->Mutex);
+			aWorker->Wakeup.wait(lock, [aWorker] { return aWorker->Stop || aWorker->Job != nullptr; });
 
-		// boolean
-		if (r == "true" || r == "false")
-			eraseR = true;
+			if (aWorker->Stop)
+				return;
 
-		// number
-		bool isNumber = true;
+			job = std::move(aWorker->Job);
+		}
 
-		for (int i = 0; i < r.size(); i++)
+		auto startTime = std::chrono::steady_clock::now();
+
+		const char* text = job->Text.data();
+		job->Colors.resize(job->Text.size());
+
+		for (size_t i = 0; i + 1 < job->LineStart.size() && !aWorker->Stop; i++)
 		{
-			if (!isdigit(r[i]) && r[i] != '.' && r[i] != 'f')
-			{
-				isNumber = false;
-				break;
-			}
+			int tokens = std::numeric_limits<int>::max();
+			size_t start = job->LineStart[i];
+			ColorizeLine(*job->Context, text + start, text + job->LineStart[i + 1], 0, job->PreprocStart[i], job->Colors.data() + start, tokens);
 		}
 
-		if (isNumber)
-			eraseR = true;
+		job->Microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+		delete aWorker->Result.exchange(job.release());
+	}
+}
+
+void ImTextEdit::SubmitColorizerJob(int aFromLine, int aToLine)
+{
+	aToLine = std::min<int>(aToLine, (int)m_Lines.size());
+
+	std::unique_ptr<ColorizerJob> job(new ColorizerJob());
+	job->Version = m_DocumentVersion;
+	job->FirstLine = aFromLine;
+	job->Context = m_ColorizerContext;
+
+	size_t bytes = 0;
+	for (int i = aFromLine; i < aToLine; i++)
+		bytes += m_Lines[i].size();
+
+	job->Text.reserve(bytes);
+	job->LineStart.reserve(aToLine - aFromLine + 1);
+	job->PreprocStart.reserve(aToLine - aFromLine);
+
+	for (int i = aFromLine; i < aToLine; i++)
+	{
+		auto& line = m_Lines[i];
+		job->LineStart.push_back(job->Text.size());
+		job->PreprocStart.push_back(line.GetPreprocessorStart());
+		job->Text.append((const char*)line.GetChars(), line.size());
+	}
+	job->LineStart.push_back(job->Text.size());
+
+	m_ColorizerWorker->Busy = true;
+	m_ColorizerWorker->BusyFrom = aFromLine;
+	m_ColorizerWorker->BusyTo = aToLine;
+
+	{
+		std::lock_guard<std::mutex> lock(m_ColorizerWorker->Mutex);
+		m_ColorizerWorker->Job = std::move(job);
+	}
+
+	m_ColorizerWorker->Wakeup.notify_one();
+}
+
+void ImTextEdit::ApplyColorizerResult()
+{
+	std::unique_ptr<ColorizerJob> result(m_ColorizerWorker->Result.exchange(nullptr));
+
+	if (result == nullptr)
+		return;
 
-		// keyword
-		if (!eraseR)
+	m_ColorizerWorker->Busy = false;
+
+	int count = (int)result->LineStart.size() - 1;
+
+	if (result->Version == m_DocumentVersion)
+	{
+		for (int i = 0; i < count; i++)
 		{
-			for (const auto& ident : m_LanguageDefinition.Identifiers)
-			{
-				if (ident.first == r)
-				{
-					eraseR = true;
-					break;
-				}
-			}
+			// a viewer may have dropped the lines meanwhile, they are colored again when they load
+			if (!m_Lines.IsLoaded(result->FirstLine + i))
+				continue;
 
-			for (const auto& kwd : m_LanguageDefinition.Keywords)
+			auto& line = m_Lines[result->FirstLine + i];
+
+			// an edit that didn't change the version would make the colors run past the line, color it again
+			if (line.size() != result->LineStart[i + 1] - result->LineStart[i])
 			{
-				if (kwd == r)
-				{
-					eraseR = true;
-					break;
-				}
+				MarkColorDirty(result->FirstLine + i, result->FirstLine + i + 1);
+				continue;
 			}
+
+			auto colors = result->Colors.data() + result->LineStart[i];
+			std::copy(colors, colors + line.size(), line.GetColors());
 		}
 
-		// delete it from the array
-		if (eraseR)
-		{
-			ret.erase(ret.begin() + i);
-			i--;
+		m_Brackets.Invalidate(result->FirstLine, result->FirstLine + count);
+		InvalidateRenderCache();
 
-			continue;
-		}
-	}
+		AddColorizerStats(count, result->Microseconds);
 
-	return ret;
+		if (result->FirstLine <= m_ColorizeResumeLine && m_ColorizeResumeLine < result->FirstLine + count)
+			m_ColorizeResumeLine = -1;
+	}
+	else
+	{
+		// the text changed while the worker was busy, queue the batch again where its lines are now
+		MarkColorDirty(m_ColorizerWorker->BusyFrom, m_ColorizerWorker->BusyTo);
+	}
 }
 
-const ImTextEdit::td_Palette & ImTextEdit::GetDarkPalette()
+void ImTextEdit::MarkColorDirty(int aFromLine, int aToLine)
 {
-	const static td_Palette p =
+	aFromLine = std::max(0, aFromLine);
+
+	if (aFromLine >= aToLine)
+		return;
+
+	// lines of a mapped file that weren't loaded yet have no colors, they are marked once they load
+	bool loaded;
+	int runEnd = (int)m_Lines.GetRunEnd(aFromLine, loaded);
+	int toLine = std::min<int>(aToLine, (int)m_Lines.size());
+
+	if (!loaded || runEnd < toLine)
 	{
+		for (int line = aFromLine; line < toLine; line = runEnd)
 		{
-			0xff7f7f7f,	// Default
-			0xffd69c56,	// Keyword	
-			0xff00ff00,	// Number
-			0xff7070e0,	// String
-			0xff70a0e0, // Char literal
-			0xffffffff, // Punctuation
-			0xff408080,	// Preprocessor
-			0xffaaaaaa, // Identifier
-			0xff9bc64d, // Known identifier
-			0xffc040a0, // Preproc identifier
-			0xff206020, // Comment (single line)
-			0xff406020, // Comment (multi line)
-			0xff101010, // Background
-			0xffe0e0e0, // Cursor
-			0x80a06020, // Selection
-			0x800020ff, // ErrorMarker
-			0xff0000ff, // Breakpoint
-			0xffffffff, // Breakpoint outline
-			0xFF1DD8FF, // Current line indicator
-			0xFF696969, // Current line indicator outline
-			0xff707000, // Line number
-			0x40000000, // Current line fill
-			0x40808080, // Current line fill (inactive)
-			0x40a0a0a0, // Current line edge
-			0xff33ffff, // Error message
-			0xffffffff, // BreakpointDisabled
-			0xffaaaaaa, // UserFunction
-			0xffb0c94e, // UserType
-			0xffaaaaaa, // UniformType
-			0xffaaaaaa, // GlobalVariable
-			0xffaaaaaa, // LocalVariable
-			0xff888888	// FunctionArgument
+			runEnd = std::min(toLine, (int)m_Lines.GetRunEnd(line, loaded));
+
+			if (loaded)
+				MarkColorDirty(line, runEnd);
 		}
-	};
 
-	return p;
-}
+		return;
+	}
 
-const ImTextEdit::td_Palette & ImTextEdit::GetLightPalette()
-{
-	const static td_Palette p =
+	// brackets in strings and comments don't count, they are summarized again once the new colors are in
+	m_Brackets.Invalidate(aFromLine, aToLine);
+	InvalidateRenderCache();
+
+	// whatever made the line dirty again also invalidates the half of it that was done
+	if (aFromLine <= m_ColorizeResumeLine && m_ColorizeResumeLine < aToLine)
+		m_ColorizeResumeLine = -1;
+
+	// merge with every range it overlaps or touches
+	auto it = m_ColorDirty.upper_bound(aFromLine);
+
+	if (it != m_ColorDirty.begin())
 	{
+		auto prev = std::prev(it);
+
+		if (prev->second >= aFromLine)
 		{
-			0xff7f7f7f,	// None
-			0xffff0c06,	// Keyword	
-			0xff008000,	// Number
-			0xff2020a0,	// String
-			0xff304070, // Char literal
-			0xff000000, // Punctuation
-			0xff406060,	// Preprocessor
-			0xff404040, // Identifier
-			0xff606010, // Known identifier
-			0xffc040a0, // Preproc identifier
-			0xff205020, // Comment (single line)
-			0xff405020, // Comment (multi line)
-			0xffffffff, // Background
-			0xff000000, // Cursor
-			0x80DFBF80, // Selection
-			0xa00010ff, // ErrorMarker
-			0xff0000ff, // Breakpoint
-			0xff000000, // Breakpoint outline
-			0xFF1DD8FF, // Current line indicator
-			0xFF696969, // Current line indicator outline
-			0xff505000, // Line number
-			0x20000000, // Current line fill
-			0x20808080, // Current line fill (inactive)
-			0x30000000, // Current line edge
-			0xff3333ff, // Error message
-			0xffffffff, // BreakpointDisabled
-			0xff404040, // UserFunction
-			0xffb0912b, // UserType
-			0xff404040, // UniformType
-			0xff404040, // GlobalVariable
-			0xff404040, // LocalVariable
-			0xff606060	// FunctionArgument
+			aFromLine = prev->first;
+			aToLine = std::max(aToLine, prev->second);
+			it = prev;
 		}
-	};
+	}
 
-	return p;
+	while (it != m_ColorDirty.end() && it->first <= aToLine)
+	{
+		aToLine = std::max(aToLine, it->second);
+		it = m_ColorDirty.erase(it);
+	}
+
+	m_ColorDirty[aFromLine] = aToLine;
 }
 
-const ImTextEdit::td_Palette & ImTextEdit::GetRetroBluePalette()
+bool ImTextEdit::TakeColorDirty(int aBegin, int aEnd, int aMaxLines, int& aFromLine, int& aToLine)
 {
-	const static td_Palette p =
-	{
-		{
-			0xff00ffff,	// None
-			0xffffff00,	// Keyword	
-			0xff00ff00,	// Number
-			0xff808000,	// String
-			0xff808000, // Char literal
-			0xffffffff, // Punctuation
-			0xff008000,	// Preprocessor
-			0xff00ffff, // Identifier
-			0xffffffff, // Known identifier
-			0xffff00ff, // Preproc identifier
-			0xff808080, // Comment (single line)
-			0xff404040, // Comment (multi line)
-			0xff800000, // Background
-			0xff0080ff, // Cursor
-			0x80ffff00, // Selection
-			0xa00000ff, // ErrorMarker
-			0xff0000ff, // Breakpoint
-			0xffffffff, // Breakpoint outline
-			0xFF1DD8FF, // Current line indicator
-			0xff808000, // Line number
-			0x40000000, // Current line fill
-			0x40808080, // Current line fill (inactive)
-			0x40000000, // Current line edge
-			0xffffff00, // Error message
-			0xffffffff, // BreakpointDisabled
-			0xff00ffff, // UserFunction
-			0xff00ffff, // UserType
-			0xff00ffff, // UniformType
-			0xff00ffff, // GlobalVariable
-			0xff00ffff, // LocalVariable
-			0xff00ffff	// FunctionArgument
-		}
-	};
+	// removes and returns up to aMaxLines of the first dirty range inside [aBegin, aEnd)
+	aBegin = std::max(0, aBegin);
+	aEnd = std::min<int>(aEnd, (int)m_Lines.size());
 
-	return p;
-}
+	if (aBegin >= aEnd || m_ColorDirty.empty())
+		return false;
 
+	auto it = m_ColorDirty.upper_bound(aBegin);
 
-std::string ImTextEdit::GetText() const
+	if (it != m_ColorDirty.begin() && std::prev(it)->second > aBegin)
+		it = std::prev(it);
+	else if (it == m_ColorDirty.end() || it->first >= aEnd)
+		return false;
+
+	const int first = it->first;
+	const int second = it->second;
+
+	aFromLine = std::max(first, aBegin);
+	aToLine = std::min(std::min(second, aEnd), aFromLine + aMaxLines);
+
+	m_ColorDirty.erase(it);
+
+	if (first < aFromLine)
+		m_ColorDirty[first] = aFromLine;
+	if (aToLine < second)
+		m_ColorDirty[aToLine] = second;
+
+	return true;
+}
+
+void ImTextEdit::OnLinesChanged(int aStart, int aEnd)
 {
-	return GetText(Coordinates(), Coordinates((int)m_Lines.size(), 0));
+	m_DocumentVersion++;
+	m_Brackets.Invalidate(aStart, aEnd);
+	m_TextOffsets.Update(m_Lines, aStart, aEnd);
 }
 
-void ImTextEdit::GetTextLines(std::vector<std::string>& result) const
+void ImTextEdit::OnLinesInserted(int aIndex, int aCount)
 {
-	result.reserve(m_Lines.size());
+	m_DocumentVersion++;
+	m_Brackets.Insert(aIndex, aCount);
+	m_LineWidths.Insert(aIndex, aCount);
+	m_TextOffsets.Insert(m_Lines, aIndex, aCount);
+	InvalidateRenderCache();
 
-	for (auto & line : m_Lines)
-	{
-		std::string text;
-		text.resize(line.size());
+	auto shift = [aIndex, aCount](int aLine, bool aEnd) { return (aLine > aIndex || (aLine == aIndex && !aEnd)) ? aLine + aCount : aLine; };
 
-		for (size_t i = 0; i < line.size(); ++i)
-			text[i] = line[i].Character;
+	// a dirty range around aIndex grows to include the new lines
+	std::map<int, int> dirty;
+	for (auto& range : m_ColorDirty)
+		dirty[shift(range.first, false)] = shift(range.second, true);
+	m_ColorDirty.swap(dirty);
 
-		result.emplace_back(std::move(text));
+	if (m_ColorizeResumeLine >= 0)
+		m_ColorizeResumeLine = shift(m_ColorizeResumeLine, false);
+
+	if (m_LexDirtyEnd > aIndex)
+		m_LexDirtyEnd += aCount;
+
+	m_FoldIndexDirty = true;
+
+	if (m_ColorizerWorker != nullptr)
+	{
+		m_ColorizerWorker->BusyFrom = shift(m_ColorizerWorker->BusyFrom, false);
+		m_ColorizerWorker->BusyTo = shift(m_ColorizerWorker->BusyTo, true);
 	}
 }
 
-std::string ImTextEdit::GetSelectedText() const
+void ImTextEdit::OnLinesLoaded()
 {
-	return GetText(m_State.SelectionStart, m_State.SelectionEnd);
-}
+	size_t start, end;
 
-std::string ImTextEdit::GetCurrentLineText()const
-{
-	auto lineLength = GetLineMaxColumn(m_State.CursorPosition.Line);
-	
-	return GetText(Coordinates(m_State.CursorPosition.Line, 0), Coordinates(m_State.CursorPosition.Line, lineLength));
+	while (m_Lines.TakeLoaded(start, end))
+	{
+		MarkColorDirty((int)start, (int)end);
+
+		// lexed one block at a time, lexing from the first one stops where the lines after it are already
+		// consistent and wouldn't reach the blocks loaded further down
+		if (m_ColorizerEnabled)
+			LexLines((int)start, (int)start);
+	}
 }
 
-void ImTextEdit::Colorize(int aFromLine, int aLines)
+void ImTextEdit::EvictLines()
 {
-	int toLine = aLines == -1 ? (int)m_Lines.size() : std::min<int>((int)m_Lines.size(), aFromLine + aLines);
-	m_ColorRangeMin = std::min<int>(m_ColorRangeMin, aFromLine);
-	m_ColorRangeMax = std::max<int>(m_ColorRangeMax, toLine);
-	m_ColorRangeMin = std::max<int>(0, m_ColorRangeMin);
-	m_ColorRangeMax = std::max<int>(m_ColorRangeMin, m_ColorRangeMax);
-	m_CheckComments = true;
+	std::vector<std::pair<size_t, size_t>> evicted;
+	m_Lines.Evict(evicted);
+
+	// dropped lines are marked dirty again once they load, until then there is nothing to color and
+	// their brackets aren't known, like the lines that were never loaded
+	for (auto& range : evicted)
+	{
+		m_Brackets.Forget((int)range.first, (int)range.second);
+
+		int fromLine, toLine;
+		while (TakeColorDirty((int)range.first, (int)range.second, (int)(range.second - range.first), fromLine, toLine));
+
+		if ((int)range.first <= m_ColorizeResumeLine && m_ColorizeResumeLine < (int)range.second)
+			m_ColorizeResumeLine = -1;
+	}
+
+	if (!evicted.empty())
+		InvalidateRenderCache();
 }
 
-void ImTextEdit::ColorizeRange(int aFromLine, int aToLine)
+void ImTextEdit::OnLinesRemoved(int aStart, int aEnd)
 {
-	if (m_Lines.empty() || !m_ColorizerEnabled)
-		return;
+	m_DocumentVersion++;
+	m_Brackets.Erase(aStart, aEnd);
+	m_LineWidths.Erase(aStart, aEnd);
+	m_TextOffsets.Erase(aStart, aEnd);
+	InvalidateRenderCache();
 
-	std::string buffer;
-	std::cmatch results;
-	std::string id;
+	auto shift = [aStart, aEnd](int aLine) { return aLine < aStart ? aLine : std::max(aStart, aLine - (aEnd - aStart)); };
 
-	int endLine = std::max(0, std::min((int)m_Lines.size(), aToLine));
+	int resumeLine = (m_ColorizeResumeLine < aStart || m_ColorizeResumeLine >= aEnd) ? shift(m_ColorizeResumeLine) : -1;
 
-	for (int i = aFromLine; i < endLine; ++i)
+	// the ranges only move, their lines were measured and invalidated when they were marked.
+	// Ranges that now touch are merged
+	std::map<int, int> dirty;
+	dirty.swap(m_ColorDirty);
+
+	for (auto& range : dirty)
 	{
-		auto& line = m_Lines[i];
+		int from = shift(range.first);
+		int to = shift(range.second);
 
-		if (line.empty())
+		if (from >= to)
 			continue;
 
-		buffer.resize(line.size());
+		if (!m_ColorDirty.empty() && std::prev(m_ColorDirty.end())->second >= from)
+			std::prev(m_ColorDirty.end())->second = std::max(std::prev(m_ColorDirty.end())->second, to);
+		else
+			m_ColorDirty.emplace_hint(m_ColorDirty.end(), from, to);
+	}
 
-		for (size_t j = 0; j < line.size(); ++j)
-		{
-			auto& col = line[j];
-			buffer[j] = col.Character;
-			col.ColorIndex = PaletteIndex::Default;
-		}
+	m_ColorizeResumeLine = resumeLine;
+	m_FoldIndexDirty = true;
+
+	m_LexDirtyLine = shift(m_LexDirtyLine);
+	m_LexDirtyEnd = shift(m_LexDirtyEnd);
+
+	if (m_ColorizerWorker != nullptr)
+	{
+		m_ColorizerWorker->BusyFrom = shift(m_ColorizerWorker->BusyFrom);
+		m_ColorizerWorker->BusyTo = shift(m_ColorizerWorker->BusyTo);
+	}
+}
 
-		const char* bufferBegin = &buffer.front();
-		const char* bufferEnd = bufferBegin + buffer.size();
+int ImTextEdit::ColorizeUntil(int aFromLine, int aToLine, std::chrono::steady_clock::time_point aDeadline, bool aTimed)
+{
+	// returns the first line that isn't done, everything from there on is marked dirty again
+	int tokens = s_ColorizerClockTokens;
 
-		auto last = bufferEnd;
+	for (int i = aFromLine; i < aToLine; i++)
+	{
+		auto& line = m_Lines[i];
+		const char* bufferBegin = (const char*)line.GetChars();
+		size_t offset = (i == m_ColorizeResumeLine) ? m_ColorizeResumeOffset : 0;
 
-		for (auto first = bufferBegin; first != last;)
+		while (offset < line.size())
 		{
-			const char* token_begin = nullptr;
-			const char* token_end = nullptr;
-			PaletteIndex token_color = PaletteIndex::Default;
+			offset = ColorizeLine(*m_ColorizerContext, bufferBegin, bufferBegin + line.size(), offset, line.GetPreprocessorStart(), line.GetColors(), tokens);
 
-			bool hasTokenizeResult = false;
+			if (offset == line.size())
+				break;
+
+			tokens = s_ColorizerClockTokens;
 
-			if (m_LanguageDefinition.Tokenize != nullptr)
+			if (aTimed && std::chrono::steady_clock::now() >= aDeadline)
 			{
-				if (m_LanguageDefinition.Tokenize(first, last, token_begin, token_end, token_color))
-					hasTokenizeResult = true;
+				MarkColorDirty(i, aToLine);
+				m_ColorizeResumeLine = i;
+				m_ColorizeResumeOffset = offset;
+				return i;
 			}
+		}
 
-			if (hasTokenizeResult == false)
-			{
-				// todo : remove
-					//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
+		if (i == m_ColorizeResumeLine)
+			m_ColorizeResumeLine = -1;
+	}
 
-				for (auto& p : m_RegexList)
-				{
-					if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
-					{
-						hasTokenizeResult = true;
+	return aToLine;
+}
 
-						auto& v = *results.begin();
-						token_begin = v.first;
-						token_end = v.second;
-						token_color = p.second;
-						break;
-					}
-				}
-			}
+void ImTextEdit::AddColorizerStats(int aLines, int64_t aMicroseconds)
+{
+	m_ColorizerStats.Lines += aLines;
+	m_ColorizerStats.Microseconds += aMicroseconds;
 
-			if (hasTokenizeResult == false)
-			{
-				first++;
-			}
-			else
-			{
-				const size_t token_length = token_end - token_begin;
+	if (m_ColorizerStats.Microseconds > 0)
+		m_ColorizerStats.LinesPerSecond = m_ColorizerStats.Lines * 1000000.0 / m_ColorizerStats.Microseconds;
+}
 
-				if (token_color == PaletteIndex::Identifier)
-				{
-					id.assign(token_begin, token_end);
+void ImTextEdit::LexLines(int aFromLine, int aToLine)
+{
+	// start from the closest line whose saved state is still valid
+	int currentLine = std::max(0, aFromLine);
 
-					// todo : almost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
-					if (!m_LanguageDefinition.CaseSensitive)
-						std::transform(id.begin(), id.end(), id.begin(), ::toupper);
+	while (currentLine > 0 && m_Lines.IsLoaded(currentLine) && !m_Lines[currentLine].GetLexState().Valid)
+		--currentLine;
 
-					if (!line[first - bufferBegin].Preprocessor)
-					{
-						if (m_LanguageDefinition.Keywords.count(id) != 0)
-							token_color = PaletteIndex::Keyword;
-						else if (m_LanguageDefinition.Identifiers.count(id) != 0)
-							token_color = PaletteIndex::KnownIdentifier;
-						else if (m_LanguageDefinition.PreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-					else
-					{
-						if (m_LanguageDefinition.PreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-				}
+	LexState state;
+
+	if (currentLine > 0 && m_Lines.IsLoaded(currentLine))
+		state = m_Lines[currentLine].GetLexState();
 
-				for (size_t j = 0; j < token_length; ++j)
-					line[(token_begin - bufferBegin) + j].ColorIndex = token_color;
+	state.Valid = true;
 
-				first = token_end;
-			}
+	for (; currentLine < (int)m_Lines.size(); ++currentLine)
+	{
+		// nothing is known about lines of a mapped file that weren't loaded, start over after them
+		if (!m_Lines.IsLoaded(currentLine))
+		{
+			bool loaded;
+			currentLine = (int)m_Lines.GetRunEnd(currentLine, loaded) - 1;
+			state = LexState();
+			state.Valid = true;
+			continue;
 		}
+
+		auto& line = m_Lines[currentLine];
+
+		// the rest of the document was lexed from the same state and hasn't changed since. Edits further
+		// down than aFromLine don't show in the state coming into them, so that holds only past aToLine
+		if (currentLine > aFromLine && currentLine >= aToLine && line.GetLexState() == state)
+			break;
+
+		state = LexLine(line, state);
 	}
+
+	// lines past the edit were only lexed again because the state carried into them changed,
+	// which can move their preprocessor region and with it the keyword colors
+	if (currentLine > aFromLine + 1)
+		MarkColorDirty(aFromLine, currentLine);
 }
 
 void ImTextEdit::ColorizeInternal()
@@ -6101,173 +9276,211 @@ void ImTextEdit::ColorizeInternal()
 	if (m_Lines.empty() || !m_ColorizerEnabled)
 		return;
 
-	if (m_CheckComments)
+	const auto startTime = std::chrono::steady_clock::now();
+	const auto deadline = startTime + std::chrono::microseconds(m_ColorizerFrameBudget);
+	const bool timed = m_ColorizerFrameBudget > 0;
+
+	if (m_LexDirtyLine < (int)m_Lines.size())
 	{
-		auto endLine = m_Lines.size();
-		auto endIndex = 0;
-		auto commentStartLine = endLine;
-		auto commentStartIndex = endIndex;
-		auto withinString = false;
-		auto withinSingleLineComment = false;
-		auto withinPreproc = false;
-		auto firstChar = true;			// there is no other non-whitespace characters in the line before
-		auto concatenate = false;		// '\' on the very end of the line
-		auto currentLine = 0;
-		auto currentIndex = 0;
+		LexLines(m_LexDirtyLine, m_LexDirtyEnd);
+		m_LexDirtyLine = std::numeric_limits<int>::max();
+		m_LexDirtyEnd = 0;
+	}
 
-		while (currentLine < endLine || currentIndex < endIndex)
-		{
-			auto& line = m_Lines[currentLine];
+	if (m_ColorizerWorker != nullptr)
+		ApplyColorizerResult();
 
-			if (currentIndex == 0 && !concatenate)
-			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
-			}
+	// what's on screen first, then a few pages around it, then the rest from the top
+	const int visibleBegin = m_VisibleLineBegin;
+	const int visibleEnd = m_VisibleLineEnd;
+	const int nearLines = std::max(1, visibleEnd - visibleBegin) * s_ColorizerNearPages;
 
-			concatenate = false;
+	int from, to;
+	int lines = 0;
+	bool worked = false;
+	bool outOfTime = false;
 
-			if (!line.empty())
-			{
-				auto& g = line[currentIndex];
-				auto c = g.Character;
+	auto colorize = [&]()
+	{
+		int stop = ColorizeUntil(from, to, deadline, timed);
+		m_Brackets.Invalidate(from, stop);
+		InvalidateRenderCache();
+		lines += stop - from;
+		worked = true;
+		outOfTime = stop < to;
+	};
 
-				if (c != m_LanguageDefinition.PreprocChar && !isspace(c))
-					firstChar = false;
+	while (!outOfTime && TakeColorDirty(visibleBegin, visibleEnd, visibleEnd - visibleBegin, from, to))
+		colorize();
 
-				if (currentIndex == (int)line.size() - 1 && line[line.size() - 1].Character == '\\')
-					concatenate = true;
+	auto takeOffscreen = [&](int aMaxLines)
+	{
+		return TakeColorDirty(visibleEnd, visibleEnd + nearLines, aMaxLines, from, to) ||
+			TakeColorDirty(visibleBegin - nearLines, visibleBegin, aMaxLines, from, to) ||
+			TakeColorDirty(0, std::numeric_limits<int>::max(), aMaxLines, from, to);
+	};
 
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+	// off screen lines go to the worker one batch at a time
+	if (m_ColorizerWorker != nullptr)
+	{
+		if (!m_ColorizerWorker->Busy && takeOffscreen(s_ColorizerJobLines))
+			SubmitColorizerJob(from, to);
+	}
+	else
+	{
+		while (!outOfTime && takeOffscreen(s_ColorizerJobLines))
+			colorize();
+	}
 
-				if (withinString)
-				{
-					line[currentIndex].MultiLineComment = inComment;
+	if (worked)
+	{
+		int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
 
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].Character == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].MultiLineComment = inComment;
-						}
-						else
-						{
-							withinString = false;
-						}
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
+		m_ColorizerStats.LastFrameLines = lines;
+		m_ColorizerStats.LastFrameMicroseconds = (int)elapsed;
+		AddColorizerStats(lines, elapsed);
+	}
+}
 
-						if (currentIndex < (int)line.size())
-							line[currentIndex].MultiLineComment = inComment;
-					}
-				}
-				else
-				{
-					if (firstChar && c == m_LanguageDefinition.PreprocChar)
-						withinPreproc = true;
+static bool MatchesAt(const ImTextEdit::Line& aLine, size_t aIndex, const std::string& aStr)
+{
+	return aIndex + aStr.size() <= aLine.size() && memcmp(aLine.GetChars() + aIndex, aStr.data(), aStr.size()) == 0;
+}
 
-					if (c == '\"')
-					{
-						withinString = true;
-						line[currentIndex].MultiLineComment = inComment;
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.Character; };
-						auto from = line.begin() + currentIndex;
-						auto& startStr = m_LanguageDefinition.CommentStart;
-						auto& singleStartStr = m_LanguageDefinition.SingleLineComment;
+ImTextEdit::LexState ImTextEdit::LexLine(Line& aLine, const LexState& aState)
+{
+	aLine.SetLexState(aState);
+	aLine.ClearFlags();
 
-						if (singleStartStr.size() > 0 && currentIndex + singleStartStr.size() <= line.size() && Equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							withinSingleLineComment = true;
-						}
-						else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() && Equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
+	auto withinString = aState.String;
+	auto withinSingleLineComment = aState.Continuation && aState.SingleLineComment;
+	auto withinPreproc = aState.Continuation && aState.Preprocessor;
+	auto firstChar = !aState.Continuation;	// there is no other non-whitespace characters in the line before
+	auto concatenate = false;				// '\' on the very end of the line
+	int commentStartIndex = aState.MultiLineComment ? 0 : -1;
+	int currentIndex = 0;
+	const int size = (int)aLine.size();
 
-						inComment = inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+	auto& startStr = m_LanguageDefinition.CommentStart;
+	auto& singleStartStr = m_LanguageDefinition.SingleLineComment;
+	auto& endStr = m_LanguageDefinition.CommentEnd;
 
-						line[currentIndex].MultiLineComment = inComment;
-						line[currentIndex].Comment = withinSingleLineComment;
+	while (currentIndex < size)
+	{
+		auto c = aLine.GetChar(currentIndex);
 
-						auto& endStr = m_LanguageDefinition.CommentEnd;
+		if (c != m_LanguageDefinition.PreprocChar && !isspace(c))
+			firstChar = false;
 
-						if (currentIndex + 1 >= (int)endStr.size() && Equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
-					}
-				}
-				line[currentIndex].Preprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
+		if (currentIndex == size - 1 && c == '\\')
+			concatenate = true;
 
-				if (currentIndex >= (int)line.size())
+		bool inComment = (commentStartIndex != -1 && commentStartIndex <= currentIndex);
+
+		if (withinString)
+		{
+			aLine.SetMultiLineComment(currentIndex, inComment);
+
+			if (c == '\"')
+			{
+				if (currentIndex + 1 < size && aLine.GetChar(currentIndex + 1) == '\"')
 				{
-					currentIndex = 0;
-					++currentLine;
+					currentIndex += 1;
+					if (currentIndex < size)
+						aLine.SetMultiLineComment(currentIndex, inComment);
+				}
+				else
+				{
+					withinString = false;
 				}
 			}
-			else
+			else if (c == '\\')
 			{
-				currentIndex = 0;
-				++currentLine;
+				currentIndex += 1;
+
+				if (currentIndex < size)
+					aLine.SetMultiLineComment(currentIndex, inComment);
 			}
 		}
+		else
+		{
+			if (firstChar && c == m_LanguageDefinition.PreprocChar)
+				withinPreproc = true;
 
-		m_CheckComments = false;
-	}
+			if (c == '\"')
+			{
+				withinString = true;
+				aLine.SetMultiLineComment(currentIndex, inComment);
+			}
+			else
+			{
+				// the block opener goes first since it can start with the single line one, like lua's --[[ and --
+				if (!withinSingleLineComment && startStr.size() > 0 && MatchesAt(aLine, currentIndex, startStr))
+					commentStartIndex = currentIndex;
+				else if (singleStartStr.size() > 0 && MatchesAt(aLine, currentIndex, singleStartStr))
+					withinSingleLineComment = true;
 
-	if (m_ColorRangeMin < m_ColorRangeMax)
-	{
-		const int increment = (m_LanguageDefinition.Tokenize == nullptr) ? 10 : 10000;
-		const int to = std::min<int>(m_ColorRangeMin + increment, m_ColorRangeMax);
-		ColorizeRange(m_ColorRangeMin, to);
-		m_ColorRangeMin = to;
+				inComment = (commentStartIndex != -1 && commentStartIndex <= currentIndex);
 
-		if (m_ColorRangeMax == m_ColorRangeMin)
-		{
-			m_ColorRangeMin = std::numeric_limits<int>::max();
-			m_ColorRangeMax = 0;
+				aLine.SetMultiLineComment(currentIndex, inComment);
+				aLine.SetComment(currentIndex, withinSingleLineComment);
+
+				if (currentIndex + 1 >= (int)endStr.size() && MatchesAt(aLine, currentIndex + 1 - endStr.size(), endStr))
+					commentStartIndex = -1;
+			}
 		}
 
-		return;
+		if (currentIndex < size)
+			aLine.SetPreprocessor(currentIndex, withinPreproc);
+
+		currentIndex += UTF8CharLength(c);
 	}
+
+	LexState next;
+	next.Valid = true;
+	next.MultiLineComment = commentStartIndex != -1;
+	next.String = withinString;
+	next.Continuation = concatenate;
+	next.SingleLineComment = withinSingleLineComment;
+	next.Preprocessor = withinPreproc;
+
+	return next;
 }
 
 float ImTextEdit::TextDistanceToLineStart(const Coordinates& aFrom) const
 {
+	if (auto offsets = GetLineOffsets(aFrom.Line))
+	{
+		// the first character at or past the column, like GetCharacterIndex
+		size_t index = std::lower_bound(offsets->Column.begin(), offsets->Column.end(), aFrom.Column) - offsets->Column.begin();
+		return offsets->X[std::min(index, offsets->X.size() - 1)];
+	}
+
 	auto& line = m_Lines[aFrom.Line];
+	auto& advances = GetAdvances();
+	const td_Char* chars = line.GetChars();
 	float distance = 0.0f;
-	float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
-	int colIndex = GetCharacterIndex(aFrom);
+	size_t colIndex = std::min<size_t>(std::max(0, GetCharacterIndex(aFrom)), line.size());
 
-	for (size_t it = 0u; it < line.size() && it < colIndex;)
+	for (size_t it = 0u; it < colIndex;)
 	{
-		if (line[it].Character == '\t')
+		if (chars[it] == '\t')
 		{
-			distance = (1.0f + std::floor((1.0f + distance) / (float(m_TabSize) * spaceSize))) * (float(m_TabSize) * spaceSize);
+			distance = advances.GetTabStop(distance);
 			++it;
 		}
+		else if (advances.GetPitch() > 0.0f && chars[it] >= 32 && chars[it] < 127)
+		{
+			// fixed pitch: everything up to the next tab or non ASCII character in one go
+			size_t count = AdvanceTable::CountPrintable(chars + it, chars + colIndex);
+			distance += count * advances.GetPitch();
+			it += count;
+		}
 		else
 		{
-			auto d = UTF8CharLength(line[it].Character);
-			char tempCString[7];
-			int i = 0;
-
-			for (; i < 6 && d-- > 0 && it < (int)line.size(); i++, it++)
-				tempCString[i] = line[it].Character;
-
-			tempCString[i] = '\0';
-			distance += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, tempCString, nullptr, nullptr).x;
+			int length = std::min<int>(UTF8CharLength(chars[it]), (int)(line.size() - it));
+			distance += advances.Get(chars + it, length);
+			it += length;
 		}
 	}
 
@@ -6314,6 +9527,7 @@ void ImTextEdit::SetCurrentLineIndicator(int line, bool displayBar)
 	m_DebugCurrentLine = line;
 	m_DebugCurrentLineUpdated = line > 0;
 	m_DebugBar = displayBar;
+	InvalidateRenderCache();
 }
 
 int ImTextEdit::GetPageSize() const
@@ -6354,14 +9568,14 @@ void ImTextEdit::UndoRecord::Redo(ImTextEdit * aEditor)
 	if (!Removed.empty())
 	{
 		aEditor->DeleteRange(RemovedStart, RemovedEnd);
-		aEditor->Colorize(RemovedStart.Line - 1, RemovedEnd.Line - RemovedStart.Line + 1);
+		aEditor->Colorize(RemovedStart.Line - 1, RemovedEnd.Line - RemovedStart.Line + 2);
 	}
 
 	if (!Added.empty())
 	{
 		auto start = AddedStart;
 		aEditor->InsertTextAt(start, Added.c_str());
-		aEditor->Colorize(AddedStart.Line - 1, AddedEnd.Line - AddedStart.Line + 1);
+		aEditor->Colorize(AddedStart.Line - 1, AddedEnd.Line - AddedStart.Line + 2);
 	}
 
 	aEditor->m_State = After;
@@ -6545,45 +9759,263 @@ static bool TokenizeCStyleNumber(const char* in_begin, const char* in_end, const
 			p++;
 	}
 
-	out_begin = in_begin;
-	out_end = p;
-
+	out_begin = in_begin;
+	out_end = p;
+
+	return true;
+}
+
+static bool TokenizeCStylePunctuation(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
+{
+	(void)in_end;
+
+	switch (*in_begin)
+	{
+	case '[':
+	case ']':
+	case '{':
+	case '}':
+	case '!':
+	case '%':
+	case '^':
+	case '&':
+	case '*':
+	case '(':
+	case ')':
+	case '-':
+	case '+':
+	case '=':
+	case '~':
+	case '|':
+	case '<':
+	case '>':
+	case '?':
+	case ':':
+	case '/':
+	case ';':
+	case ',':
+	case '.':
+		out_begin = in_begin;
+		out_end = in_begin + 1;
+		return true;
+	}
+
+	return false;
+}
+
+static bool TokenizeEscapedString(const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, char quote)
+{
+	const char* p = in_begin;
+
+	if (*p != quote)
+		return false;
+
+	p++;
+
+	while (p < in_end)
+	{
+		if (*p == quote)
+		{
+			out_begin = in_begin;
+			out_end = p + 1;
+
+			return true;
+		}
+
+		// any escaped character, including the quote and the backslash itself
+		if (*p == '\\' && p + 1 < in_end)
+			p++;
+
+		p++;
+	}
+
+	return false;
+}
+
+static bool TokenizePreprocessorDirective(const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end)
+{
+	const char* p = in_begin;
+
+	if (*p != '#')
+		return false;
+
+	p++;
+
+	while (p < in_end && (*p == ' ' || *p == '\t'))
+		p++;
+
+	const char* name = p;
+
+	while (p < in_end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '_'))
+		p++;
+
+	if (p == name)
+		return false;
+
+	out_begin = in_begin;
+	out_end = p;
+
+	return true;
+}
+
+// decimal, octal and hex integers, floats like 1.0, .5 and 1e-3, with an optional sign and the type suffixes the language allows
+static bool TokenizeShaderNumber(const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, const char* floatSuffixes, const char* intSuffixes)
+{
+	const char* p = in_begin;
+
+	if (*p == '+' || *p == '-')
+		p++;
+
+	const char* digits = p;
+	bool isFloat = false;
+
+	if (p + 1 < in_end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+	{
+		p += 2;
+
+		const char* hex = p;
+
+		while (p < in_end && isxdigit((unsigned char)*p))
+			p++;
+
+		if (p == hex)
+			return false;
+	}
+	else
+	{
+		while (p < in_end && *p >= '0' && *p <= '9')
+			p++;
+
+		if (p < in_end && *p == '.')
+		{
+			const char* fraction = p + 1;
+
+			while (fraction < in_end && *fraction >= '0' && *fraction <= '9')
+				fraction++;
+
+			// a lone '.' is punctuation
+			if (fraction - p > 1 || p > digits)
+			{
+				isFloat = true;
+				p = fraction;
+			}
+		}
+
+		if (p == digits)
+			return false;
+
+		// exponent, only taken if digits follow
+		if (p < in_end && (*p == 'e' || *p == 'E'))
+		{
+			const char* exponent = p + 1;
+
+			if (exponent < in_end && (*exponent == '+' || *exponent == '-'))
+				exponent++;
+
+			if (exponent < in_end && *exponent >= '0' && *exponent <= '9')
+			{
+				while (exponent < in_end && *exponent >= '0' && *exponent <= '9')
+					exponent++;
+
+				isFloat = true;
+				p = exponent;
+			}
+		}
+	}
+
+	const char* suffix = p;
+
+	if (!isFloat)
+	{
+		while (p < in_end && p - suffix < 3 && strchr(intSuffixes, *p) != nullptr && *p != 0)
+			p++;
+	}
+
+	// 1f is accepted as well as 1.0f
+	if (p == suffix)
+	{
+		while (p < in_end && p - suffix < 2 && strchr(floatSuffixes, *p) != nullptr && *p != 0)
+			p++;
+	}
+
+	out_begin = in_begin;
+	out_end = p;
+
+	return true;
+}
+
+// lua long brackets: [[...]], [==[...]==]. Only the part on the current line is matched
+static bool TokenizeLuaLongBracket(const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end)
+{
+	const char* p = in_begin;
+
+	if (p >= in_end || *p != '[')
+		return false;
+
+	p++;
+
+	int level = 0;
+
+	while (p < in_end && *p == '=')
+	{
+		level++;
+		p++;
+	}
+
+	if (p >= in_end || *p != '[')
+		return false;
+
+	p++;
+
+	out_begin = in_begin;
+	out_end = in_end;
+
+	for (; p < in_end; p++)
+	{
+		if (*p != ']')
+			continue;
+
+		const char* close = p + 1;
+		int closeLevel = 0;
+
+		while (close < in_end && *close == '=')
+		{
+			closeLevel++;
+			close++;
+		}
+
+		if (closeLevel == level && close < in_end && *close == ']')
+		{
+			out_end = close + 1;
+			break;
+		}
+	}
+
 	return true;
 }
 
-static bool TokenizeCStylePunctuation(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
+// sql identifiers quoted as "name", [name] or `name`
+static bool TokenizeSQLQuotedIdentifier(const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end)
 {
-	(void)in_end;
+	char close;
 
 	switch (*in_begin)
 	{
-	case '[':
-	case ']':
-	case '{':
-	case '}':
-	case '!':
-	case '%':
-	case '^':
-	case '&':
-	case '*':
-	case '(':
-	case ')':
-	case '-':
-	case '+':
-	case '=':
-	case '~':
-	case '|':
-	case '<':
-	case '>':
-	case '?':
-	case ':':
-	case '/':
-	case ';':
-	case ',':
-	case '.':
-		out_begin = in_begin;
-		out_end = in_begin + 1;
-		return true;
+	case '"': close = '"'; break;
+	case '[': close = ']'; break;
+	case '`': close = '`'; break;
+	default: return false;
+	}
+
+	for (const char* p = in_begin + 1; p < in_end; p++)
+	{
+		if (*p == close)
+		{
+			out_begin = in_begin;
+			out_end = p + 1;
+
+			return true;
+		}
 	}
 
 	return false;
@@ -6703,15 +10135,46 @@ const ImTextEdit::LanguageDefinition& ImTextEdit::LanguageDefinition::HLSL()
 
 		HLSLDocumentation(langDef.Identifiers);
 
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[ \\t]*#[ \\t]*[a-zA-Z_]+", PaletteIndex::Preprocessor));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\'\\\\?[^\\']\\'", PaletteIndex::CharLiteral));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
+		langDef.Tokenize = [](const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, PaletteIndex & paletteIndex) -> bool
+		{
+			paletteIndex = PaletteIndex::Max;
+
+			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
+				in_begin++;
+
+			if (in_begin == in_end)
+			{
+				out_begin = in_end;
+				out_end = in_end;
+				paletteIndex = PaletteIndex::Default;
+			}
+			else if (TokenizePreprocessorDirective(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Preprocessor;
+			}
+			else if (TokenizeEscapedString(in_begin, in_end, out_begin, out_end, '"'))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (TokenizeCStyleCharacterLiteral(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::CharLiteral;
+			}
+			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Identifier;
+			}
+			else if (TokenizeShaderNumber(in_begin, in_end, out_begin, out_end, "fFhHlL", "uUlL"))
+			{
+				paletteIndex = PaletteIndex::Number;
+			}
+			else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Punctuation;
+			}
+
+			return paletteIndex != PaletteIndex::Max;
+		};
 
 		langDef.CommentStart = "/*";
 		langDef.CommentEnd = "*/";
@@ -6893,15 +10356,46 @@ const ImTextEdit::LanguageDefinition& ImTextEdit::LanguageDefinition::GLSL()
 
 		GLSLDocumentation(langDef.Identifiers);
 
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[ \\t]*#[ \\t]*[a-zA-Z_]+", PaletteIndex::Preprocessor));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\'\\\\?[^\\']\\'", PaletteIndex::CharLiteral));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
+		langDef.Tokenize = [](const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, PaletteIndex & paletteIndex) -> bool
+		{
+			paletteIndex = PaletteIndex::Max;
+
+			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
+				in_begin++;
+
+			if (in_begin == in_end)
+			{
+				out_begin = in_end;
+				out_end = in_end;
+				paletteIndex = PaletteIndex::Default;
+			}
+			else if (TokenizePreprocessorDirective(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Preprocessor;
+			}
+			else if (TokenizeEscapedString(in_begin, in_end, out_begin, out_end, '"'))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (TokenizeCStyleCharacterLiteral(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::CharLiteral;
+			}
+			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Identifier;
+			}
+			else if (TokenizeShaderNumber(in_begin, in_end, out_begin, out_end, "fFlL", "uU"))
+			{
+				paletteIndex = PaletteIndex::Number;
+			}
+			else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Punctuation;
+			}
+
+			return paletteIndex != PaletteIndex::Max;
+		};
 
 		langDef.CommentStart = "/*";
 		langDef.CommentEnd = "*/";
@@ -7097,13 +10591,47 @@ const ImTextEdit::LanguageDefinition& ImTextEdit::LanguageDefinition::SPIRV()
 		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
 		*/
 
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[ =\\t]Op[a-zA-Z]*", PaletteIndex::Keyword));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("%[_a-zA-Z0-9]*", PaletteIndex::Identifier));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
+		langDef.Tokenize = [](const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, PaletteIndex & paletteIndex) -> bool
+		{
+			paletteIndex = PaletteIndex::Max;
+
+			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
+				in_begin++;
+
+			if (in_begin == in_end)
+			{
+				out_begin = in_end;
+				out_end = in_end;
+				paletteIndex = PaletteIndex::Default;
+			}
+			else if (TokenizeEscapedString(in_begin, in_end, out_begin, out_end, '"'))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (*in_begin == '%')
+			{
+				// result ids: %1, %main, ...
+				out_begin = in_begin;
+				out_end = in_begin + 1;
+
+				while (out_end < in_end && (isalnum((unsigned char)*out_end) || *out_end == '_'))
+					out_end++;
+
+				paletteIndex = PaletteIndex::Identifier;
+			}
+			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
+			{
+				// only the opcodes are highlighted, operands like Shader or Function keep the default color
+				bool isOpcode = out_end - out_begin > 2 && out_begin[0] == 'O' && out_begin[1] == 'p';
+				paletteIndex = isOpcode ? PaletteIndex::Keyword : PaletteIndex::Default;
+			}
+			else if (TokenizeShaderNumber(in_begin, in_end, out_begin, out_end, "fF", "uUlL"))
+			{
+				paletteIndex = PaletteIndex::Number;
+			}
+
+			return paletteIndex != PaletteIndex::Max;
+		};
 		
 		langDef.CommentStart = "/*";
 		langDef.CommentEnd = "*/";
@@ -7243,18 +10771,46 @@ const ImTextEdit::LanguageDefinition& ImTextEdit::LanguageDefinition::SQL()
 			langDef.Identifiers.insert(std::make_pair(std::string(k), id));
 		}
 
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\\'[^\\\']*\\\'", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
+		langDef.Tokenize = [](const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, PaletteIndex & paletteIndex) -> bool
+		{
+			paletteIndex = PaletteIndex::Max;
+
+			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
+				in_begin++;
+
+			if (in_begin == in_end)
+			{
+				out_begin = in_end;
+				out_end = in_end;
+				paletteIndex = PaletteIndex::Default;
+			}
+			else if (TokenizeEscapedString(in_begin, in_end, out_begin, out_end, '\''))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (TokenizeSQLQuotedIdentifier(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Identifier;
+			}
+			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Identifier;
+			}
+			else if (TokenizeShaderNumber(in_begin, in_end, out_begin, out_end, "", ""))
+			{
+				paletteIndex = PaletteIndex::Number;
+			}
+			else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Punctuation;
+			}
+
+			return paletteIndex != PaletteIndex::Max;
+		};
 
 		langDef.CommentStart = "/*";
 		langDef.CommentEnd = "*/";
-		langDef.SingleLineComment = "//";
+		langDef.SingleLineComment = "--";
 
 		langDef.CaseSensitive = false;
 		langDef.AutoIndentation = false;
@@ -7296,14 +10852,42 @@ const ImTextEdit::LanguageDefinition& ImTextEdit::LanguageDefinition::AngelScrip
 			langDef.Identifiers.insert(std::make_pair(std::string(k), id));
 		}
 
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\'\\\\?[^\\']\\'", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
+		langDef.Tokenize = [](const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, PaletteIndex & paletteIndex) -> bool
+		{
+			paletteIndex = PaletteIndex::Max;
+
+			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
+				in_begin++;
+
+			if (in_begin == in_end)
+			{
+				out_begin = in_end;
+				out_end = in_end;
+				paletteIndex = PaletteIndex::Default;
+			}
+			else if (TokenizeEscapedString(in_begin, in_end, out_begin, out_end, '"'))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (TokenizeEscapedString(in_begin, in_end, out_begin, out_end, '\''))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Identifier;
+			}
+			else if (TokenizeShaderNumber(in_begin, in_end, out_begin, out_end, "fFdD", "uUlL"))
+			{
+				paletteIndex = PaletteIndex::Number;
+			}
+			else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Punctuation;
+			}
+
+			return paletteIndex != PaletteIndex::Max;
+		};
 
 		langDef.CommentStart = "/*";
 		langDef.CommentEnd = "*/";
@@ -7353,13 +10937,59 @@ const ImTextEdit::LanguageDefinition& ImTextEdit::LanguageDefinition::Lua()
 			langDef.Identifiers.insert(std::make_pair(std::string(k), id));
 		}
 
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\\'[^\\\']*\\\'", PaletteIndex::String));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.TokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
+		langDef.Tokenize = [](const char* in_begin, const char* in_end, const char*& out_begin, const char*& out_end, PaletteIndex & paletteIndex) -> bool
+		{
+			paletteIndex = PaletteIndex::Max;
+
+			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
+				in_begin++;
+
+			if (in_begin == in_end)
+			{
+				out_begin = in_end;
+				out_end = in_end;
+				paletteIndex = PaletteIndex::Default;
+			}
+			else if (in_end - in_begin >= 2 && in_begin[0] == '-' && in_begin[1] == '-')
+			{
+				// --[[ ]] and --[==[ ]==] up to the closing bracket, anything else up to the end of the line
+				if (in_end - in_begin > 2 && TokenizeLuaLongBracket(in_begin + 2, in_end, out_begin, out_end))
+					out_begin = in_begin;
+				else
+				{
+					out_begin = in_begin;
+					out_end = in_end;
+				}
+
+				paletteIndex = PaletteIndex::Comment;
+			}
+			else if (TokenizeEscapedString(in_begin, in_end, out_begin, out_end, '"'))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (TokenizeEscapedString(in_begin, in_end, out_begin, out_end, '\''))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (TokenizeLuaLongBracket(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::String;
+			}
+			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Identifier;
+			}
+			else if (TokenizeShaderNumber(in_begin, in_end, out_begin, out_end, "", ""))
+			{
+				paletteIndex = PaletteIndex::Number;
+			}
+			else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
+			{
+				paletteIndex = PaletteIndex::Punctuation;
+			}
+
+			return paletteIndex != PaletteIndex::Max;
+		};
 
 		langDef.CommentStart = "--[[";
 		langDef.CommentEnd = "]]";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "SPIRVParser.h"
+#include "RegexDFA.h"
 
 #include "imgui.h"
 
@@ -8,11 +9,17 @@
 #include <vector>
 #include <array>
 #include <memory>
+#include <algorithm>
 #include <unordered_set>
 #include <unordered_map>
 #include <functional>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <cmath>
 #include <regex>
 
 class ImTextEdit
@@ -115,6 +122,7 @@ public:
 		DuplicateLine,
 		CommentLines,
 		UncommentLines,
+		JumpToMatchingBracket,
 		Count
 	};
 
@@ -231,6 +239,7 @@ public:
 	typedef std::map<int, std::string> td_ErrorMarkers;
 	typedef std::array<ImU32, (unsigned)PaletteIndex::Max> td_Palette;
 	typedef uint8_t td_Char;
+	typedef std::function<void(const char* aData, size_t aSize)> td_TextSink;
 
 	struct Glyph
 	{
@@ -281,8 +290,428 @@ public:
 		static void GLSLDocumentation(td_Identifiers& idents);
 	};
 
-	typedef std::vector<Glyph> Line;
-	typedef std::vector<Line> Lines;
+	// State of the comment/string/preprocessor pass at the start of a line. ColorizeInternal saves it
+	// for each line it lexes and stops as soon as the state it reaches matches the saved one.
+	struct LexState
+	{
+		bool Valid : 1;
+		bool MultiLineComment : 1;
+		bool String : 1;
+		bool Continuation : 1;      // previous line ended with '\'
+		bool SingleLineComment : 1; // carried over by a continuation
+		bool Preprocessor : 1;      // carried over by a continuation
+
+		LexState()
+			: Valid(false), MultiLineComment(false), String(false), Continuation(false), SingleLineComment(false), Preprocessor(false) {}
+
+		bool operator==(const LexState& o) const
+		{
+			return Valid == o.Valid && MultiLineComment == o.MultiLineComment && String == o.String &&
+				Continuation == o.Continuation && SingleLineComment == o.SingleLineComment && Preprocessor == o.Preprocessor;
+		}
+	};
+
+	// A line laid out the way RenderInternal draws it: runs of same colored text between whitespace and
+	// where the tabs and spaces go. Built by GetLineLayout, x offsets are relative to the start of the text.
+	struct LineLayout
+	{
+		struct Run
+		{
+			uint32_t Begin, End; // byte range
+			ImU32 Color;
+			float X, Width;
+		};
+
+		std::vector<Run> Runs;
+		std::vector<ImVec2> Tabs;  // x range covered by each tab
+		std::vector<float> Spaces; // x of each space, only filled while whitespaces are shown
+		float Width = 0.0f;
+		uint32_t Generation = 0;   // m_LayoutGeneration it was built for, 0 once the line changed
+	};
+
+	// x offset and column of every byte of a long line, so hit testing and measuring it is a binary search.
+	// The bytes of a UTF-8 character all get the values of its start, one more entry at the end holds the
+	// width and column count of the whole line. Built by GetLineOffsets
+	struct LineOffsets
+	{
+		std::vector<float> X;
+		std::vector<int> Column;
+		uint32_t Generation = 0; // AdvanceTable generation it was built for, 0 once the text changed
+	};
+
+	// code point count and tab positions of a line, so the column functions don't have to walk it. On ASCII lines
+	// bytes and columns only drift apart at the tabs, GetColumn and GetIndex are a binary search over them there.
+	// Built by Line::GetMetrics, thrown away by every text change
+	struct LineMetrics
+	{
+		std::vector<uint32_t> Tabs;    // byte index of every tab
+		std::vector<uint32_t> TabEnds; // column right after each tab, ASCII lines only
+		uint32_t Characters = 0;
+		int TabSize = 0;               // TabEnds were computed for it
+		bool Ascii = true;
+		bool Valid = false;
+
+		int GetColumn(size_t aIndex, size_t aSize) const;
+		size_t GetIndex(int aColumn, size_t aSize) const;
+	};
+
+	// A line stores its glyphs as separate arrays: the raw UTF-8 bytes, one palette index byte per
+	// byte and packed bitplanes for the Comment/MultiLineComment/Preprocessor flags (the bitplanes
+	// are only allocated once a flag gets set). Indexing assembles a Glyph from these arrays, so
+	// colors and flags have to be changed through the setters.
+	class Line
+	{
+	public:
+		class Iterator
+		{
+		public:
+			Iterator(const Line* aLine, size_t aIndex)
+				: m_Line(aLine), m_Index(aIndex) {}
+
+			Glyph operator*() const { return (*m_Line)[m_Index]; }
+			Iterator operator+(ptrdiff_t aOffset) const { return Iterator(m_Line, m_Index + aOffset); }
+			Iterator operator-(ptrdiff_t aOffset) const { return Iterator(m_Line, m_Index - aOffset); }
+			ptrdiff_t operator-(const Iterator& o) const { return (ptrdiff_t)m_Index - (ptrdiff_t)o.m_Index; }
+			Iterator& operator++() { ++m_Index; return *this; }
+			bool operator==(const Iterator& o) const { return m_Index == o.m_Index; }
+			bool operator!=(const Iterator& o) const { return m_Index != o.m_Index; }
+
+		private:
+			friend class Line;
+
+			const Line* m_Line;
+			size_t m_Index;
+		};
+
+		typedef Iterator iterator;
+		typedef Iterator const_iterator;
+
+		size_t size() const { return m_Chars.size(); }
+		bool empty() const { return m_Chars.empty(); }
+
+		Glyph operator[](size_t aIndex) const
+		{
+			Glyph glyph(m_Chars[aIndex], (PaletteIndex)m_Colors[aIndex]);
+			glyph.Comment = GetFlag(FlagComment, aIndex);
+			glyph.MultiLineComment = GetFlag(FlagMultiLineComment, aIndex);
+			glyph.Preprocessor = GetFlag(FlagPreprocessor, aIndex);
+			return glyph;
+		}
+
+		Glyph front() const { return (*this)[0]; }
+		Glyph back() const { return (*this)[m_Chars.size() - 1]; }
+		Iterator begin() const { return Iterator(this, 0); }
+		Iterator end() const { return Iterator(this, m_Chars.size()); }
+
+		const td_Char* GetChars() const { return m_Chars.data(); }
+		const uint8_t* GetColors() const { return m_Colors.data(); }
+		uint8_t* GetColors() { m_Layout.Generation = 0; return m_Colors.data(); }
+
+		td_Char GetChar(size_t aIndex) const { return m_Chars[aIndex]; }
+		PaletteIndex GetColor(size_t aIndex) const { return (PaletteIndex)m_Colors[aIndex]; }
+		bool IsComment(size_t aIndex) const { return GetFlag(FlagComment, aIndex); }
+		bool IsMultiLineComment(size_t aIndex) const { return GetFlag(FlagMultiLineComment, aIndex); }
+		bool IsPreprocessor(size_t aIndex) const { return GetFlag(FlagPreprocessor, aIndex); }
+		size_t GetPreprocessorStart() const;
+
+		void SetColor(size_t aIndex, PaletteIndex aColor) { m_Colors[aIndex] = (uint8_t)aColor; m_Layout.Generation = 0; }
+		void SetColor(size_t aStart, size_t aEnd, PaletteIndex aColor) { std::fill(m_Colors.begin() + aStart, m_Colors.begin() + aEnd, (uint8_t)aColor); m_Layout.Generation = 0; }
+		void SetComment(size_t aIndex, bool aValue) { SetFlag(FlagComment, aIndex, aValue); }
+		void SetMultiLineComment(size_t aIndex, bool aValue) { SetFlag(FlagMultiLineComment, aIndex, aValue); }
+		void SetPreprocessor(size_t aIndex, bool aValue) { SetFlag(FlagPreprocessor, aIndex, aValue); }
+		void ClearFlags() { m_Flags.clear(); m_Layout.Generation = 0; }
+
+		// any text change invalidates the saved lexer state
+		const LexState& GetLexState() const { return m_LexState; }
+		void SetLexState(const LexState& aState) { m_LexState = aState; }
+
+		// every change to the glyphs, colors or flags throws the layout away
+		const LineLayout& GetLayout() const { return m_Layout; }
+		LineLayout& GetLayout() { return m_Layout; }
+
+		// only text changes throw the offsets and metrics away
+		LineOffsets& GetOffsets() const { return m_Offsets; }
+		const LineMetrics& GetMetrics(int aTabSize) const;
+
+		// glyph indices of the folded braces, they move with the text inserted or erased before them
+		const std::vector<uint32_t>& GetFolds() const { return m_Folds; }
+		bool IsFolded(size_t aIndex) const { return std::binary_search(m_Folds.begin(), m_Folds.end(), (uint32_t)aIndex); }
+		void SetFolded(size_t aIndex, bool aValue);
+
+		void push_back(const Glyph& aGlyph) { insert(end(), aGlyph); }
+		void insert(Iterator aWhere, const Glyph& aGlyph);
+		void insert(Iterator aWhere, Iterator aFirst, Iterator aLast);
+		// inserts the text [aBegin, aEnd) in the default color, without its carriage returns
+		void insert(Iterator aWhere, const char* aBegin, const char* aEnd);
+		void erase(Iterator aWhere) { erase(aWhere, aWhere + 1); }
+		void erase(Iterator aFirst, Iterator aLast);
+		void reserve(size_t aCount);
+		void clear();
+
+		// replaces the text with [aBegin, aEnd) in the default color, without its carriage returns
+		void assign(const char* aBegin, const char* aEnd);
+		void append(const char* aBegin, const char* aEnd) { insert(end(), aBegin, aEnd); }
+
+		size_t GetMemoryUsage() const;
+
+	private:
+		enum
+		{
+			FlagComment,
+			FlagMultiLineComment,
+			FlagPreprocessor,
+			FlagCount
+		};
+
+		// the bitplanes are interleaved per 64 glyphs: word (i / 64) * FlagCount + flag holds bit (i % 64)
+		static size_t FlagWordCount(size_t aGlyphs) { return ((aGlyphs + 63) / 64) * FlagCount; }
+
+		bool GetFlag(int aFlag, size_t aIndex) const
+		{
+			if (m_Flags.empty())
+				return false;
+			return (m_Flags[(aIndex >> 6) * FlagCount + aFlag] >> (aIndex & 63)) & 1;
+		}
+
+		void SetFlag(int aFlag, size_t aIndex, bool aValue)
+		{
+			m_Layout.Generation = 0;
+
+			if (m_Flags.empty())
+			{
+				if (!aValue)
+					return;
+				m_Flags.resize(FlagWordCount(m_Chars.size()), 0);
+			}
+
+			uint64_t& word = m_Flags[(aIndex >> 6) * FlagCount + aFlag];
+			uint64_t bit = (uint64_t)1 << (aIndex & 63);
+			word = aValue ? (word | bit) : (word & ~bit);
+		}
+
+		void InsertFlags(size_t aIndex, size_t aCount);
+		void EraseFlags(size_t aStart, size_t aEnd);
+
+		std::vector<td_Char> m_Chars;
+		std::vector<uint8_t> m_Colors;
+		std::vector<uint64_t> m_Flags;
+		LexState m_LexState;
+		LineLayout m_Layout;
+		mutable LineOffsets m_Offsets;
+		mutable LineMetrics m_Metrics;
+		std::vector<uint32_t> m_Folds;
+	};
+
+	// read only view of a whole file, its pages are only read in once something touches them
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool Open(const std::string& aPath);
+		void Close();
+
+		const char* GetData() const { return m_Data; }
+		size_t GetSize() const { return m_Size; }
+
+		// lets the system drop the pages of [aBegin, aEnd) from memory, they are read again when accessed
+		void Release(const char* aBegin, const char* aEnd) const;
+
+	private:
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* m_Data;
+		size_t m_Size;
+#ifdef _WIN32
+		void* m_Mapping;
+#endif
+	};
+
+	// Document storage: consecutive lines are grouped into blocks of roughly s_BlockSize lines.
+	// Looking up a line is a binary search over the block start indices, inserting or removing
+	// a line only shifts the lines of a single block instead of the whole document.
+	// After Map() the blocks only know where their lines are in the mapped file, a block builds its
+	// lines the first time one of them is accessed. With a resident limit the blocks used least
+	// recently are dropped back to that state again.
+	class LineStore
+	{
+	public:
+		template<typename TStore, typename TLine>
+		class Iterator
+		{
+		public:
+			Iterator(TStore* aStore, size_t aIndex)
+				: m_Store(aStore), m_Index(aIndex) {}
+
+			TLine& operator*() const { return (*m_Store)[m_Index]; }
+			TLine* operator->() const { return &(*m_Store)[m_Index]; }
+			Iterator& operator++() { ++m_Index; return *this; }
+			bool operator==(const Iterator& o) const { return m_Index == o.m_Index; }
+			bool operator!=(const Iterator& o) const { return m_Index != o.m_Index; }
+
+		private:
+			TStore* m_Store;
+			size_t m_Index;
+		};
+
+		typedef Iterator<LineStore, Line> iterator;
+		typedef Iterator<const LineStore, const Line> const_iterator;
+
+		static constexpr size_t s_BlockSize = 512;
+
+		LineStore()
+			: m_Size(0), m_LastBlock(0), m_UnloadedBlocks(0), m_FreshBlocks(0), m_ResidentLimit(0), m_UseClock(0) {}
+
+		size_t size() const { return m_Size; }
+		bool empty() const { return m_Size == 0; }
+
+		Line& operator[](size_t aIndex)
+		{
+			size_t block = FindBlock(aIndex);
+			Load(block);
+			return m_Blocks[block].Lines[aIndex - m_Blocks[block].Start];
+		}
+
+		const Line& operator[](size_t aIndex) const
+		{
+			size_t block = FindBlock(aIndex);
+			Load(block);
+			return m_Blocks[block].Lines[aIndex - m_Blocks[block].Start];
+		}
+
+		Line& at(size_t aIndex) { assert(aIndex < m_Size); return (*this)[aIndex]; }
+		const Line& at(size_t aIndex) const { assert(aIndex < m_Size); return (*this)[aIndex]; }
+		Line& front() { return (*this)[0]; }
+		const Line& front() const { return (*this)[0]; }
+		Line& back() { return (*this)[m_Size - 1]; }
+		const Line& back() const { return (*this)[m_Size - 1]; }
+
+		iterator begin() { return iterator(this, 0); }
+		iterator end() { return iterator(this, m_Size); }
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, m_Size); }
+
+		Line& insert(size_t aIndex, Line&& aLine);
+		void insert(size_t aIndex, std::vector<Line>&& aLines);
+		void erase(size_t aStart, size_t aEnd);
+		void erase(size_t aIndex) { erase(aIndex, aIndex + 1); }
+		void push_back(Line&& aLine) { insert(m_Size, std::move(aLine)); }
+		void push_back(const Line& aLine) { insert(m_Size, Line(aLine)); }
+		void resize(size_t aCount);
+		void clear();
+
+		// replaces the lines with aCount empty ones in full blocks, which can then be filled block by block
+		// from several threads through GetBlockLines
+		void Reset(size_t aCount);
+		size_t GetBlockCount() const { return m_Blocks.size(); }
+		size_t GetBlockLineCount(size_t aBlock) const { return m_Blocks[aBlock].GetCount(); }
+
+		Line* GetBlockLines(size_t aBlock, size_t& aStart, size_t& aCount)
+		{
+			assert(m_Blocks[aBlock].Text == nullptr);
+
+			aStart = m_Blocks[aBlock].Start;
+			aCount = m_Blocks[aBlock].Lines.size();
+			return m_Blocks[aBlock].Lines.data();
+		}
+
+		// replaces the lines with the ones in aFile without loading any of them
+		void Map(const std::shared_ptr<MappedFile>& aFile);
+
+		bool IsLoaded(size_t aIndex) const { return m_UnloadedBlocks == 0 || m_Blocks[FindBlock(aIndex)].Text == nullptr; }
+
+		// end of the lines from aIndex on that are all loaded, or all not loaded, like aIndex
+		size_t GetRunEnd(size_t aIndex, bool& aLoaded) const;
+
+		// the bytes of a line that wasn't loaded yet, carriage returns included. False once it is loaded
+		bool GetMappedText(size_t aIndex, const char*& aBegin, const char*& aEnd) const;
+
+		// lines of a block that was loaded since the last call
+		bool TakeLoaded(size_t& aStart, size_t& aEnd);
+
+		// keeps at most aBlocks blocks of the mapped file loaded once Evict() is called, 0 keeps all of them.
+		// The lines can't be edited while there is a limit, clear() removes it
+		void SetResidentLimit(size_t aBlocks) { m_ResidentLimit = aBlocks; }
+		size_t GetResidentCount() const { return m_Resident.size(); }
+
+		// marks the blocks of [aStart, aEnd) as used now
+		void Touch(size_t aStart, size_t aEnd);
+
+		// drops the blocks used least recently down to the limit, a block with folded lines is kept.
+		// Adds the lines of every dropped block to aEvicted
+		void Evict(std::vector<std::pair<size_t, size_t>>& aEvicted);
+
+	private:
+		struct Block
+		{
+			size_t Start; // index of the first line in this block
+			std::vector<Line> Lines;
+
+			// a block that wasn't loaded yet: its line i ends at Text + Ends[i], the next line starts
+			// after the newline there. Text is nullptr once the block is loaded
+			const char* Text;
+			std::vector<uint32_t> Ends;
+			bool Fresh; // loaded since the last TakeLoaded
+
+			// with a resident limit a loaded block keeps its Ends and the text they start at, to be dropped again
+			const char* Source;
+			uint64_t LastUse;
+
+			Block()
+				: Start(0), Text(nullptr), Fresh(false), Source(nullptr), LastUse(0) {}
+
+			size_t GetCount() const { return Text != nullptr ? Ends.size() : Lines.size(); }
+		};
+
+		size_t FindBlock(size_t aIndex) const
+		{
+			assert(aIndex < m_Size);
+
+			// consecutive lookups usually land in the same block
+			if (m_LastBlock < m_Blocks.size() && aIndex >= m_Blocks[m_LastBlock].Start && aIndex - m_Blocks[m_LastBlock].Start < m_Blocks[m_LastBlock].GetCount())
+				return m_LastBlock;
+
+			auto it = std::upper_bound(m_Blocks.begin(), m_Blocks.end(), aIndex, [](size_t index, const Block& block) { return index < block.Start; });
+			m_LastBlock = (size_t)(it - m_Blocks.begin()) - 1;
+			return m_LastBlock;
+		}
+
+		void Load(size_t aBlock) const
+		{
+			if (m_Blocks[aBlock].Text != nullptr)
+				LoadBlock(aBlock);
+		}
+
+		void LoadBlock(size_t aBlock) const;
+		void RemoveBlock(size_t aBlock);
+		void UpdateBlockStarts(size_t aFromBlock);
+		void MergeBlock(size_t aBlock);
+
+		mutable std::vector<Block> m_Blocks; // loading a block doesn't change the document
+		size_t m_Size;
+		mutable size_t m_LastBlock;
+		mutable size_t m_UnloadedBlocks, m_FreshBlocks;
+		mutable std::shared_ptr<MappedFile> m_File; // closed once no block points into it anymore
+
+		size_t m_ResidentLimit;
+		mutable std::vector<size_t> m_Resident; // loaded blocks that can be dropped again
+		mutable uint64_t m_UseClock;
+	};
+
+	typedef LineStore Lines;
+
+	struct MemoryUsage
+	{
+		size_t LineCount;
+		size_t TextBytes;          // UTF-8 bytes stored in the document
+		size_t GlyphStorage;       // bytes used by the per-line glyph arrays
+		size_t GlyphStorageLegacy; // bytes the same text needs as one std::vector<Glyph> per line
+
+		MemoryUsage()
+			: LineCount(0), TextBytes(0), GlyphStorage(0), GlyphStorageLegacy(0) {}
+	};
 
 public:
 	ImTextEdit();
@@ -294,7 +723,7 @@ public:
 	const td_Palette& GetPalette() const { return m_PaletteBase; }
 	void SetPalette(const td_Palette& aValue);
 
-	void SetErrorMarkers(const td_ErrorMarkers& aMarkers) { m_ErrorMarkers = aMarkers; }
+	void SetErrorMarkers(const td_ErrorMarkers& aMarkers) { m_ErrorMarkers = aMarkers; InvalidateRenderCache(); }
 
 	bool HasBreakpoint(int line);
 	void AddBreakpoint(int line, bool useCondition = false, std::string condition = "", bool enabled = true);
@@ -314,10 +743,26 @@ public:
 	void SetTextLines(const std::vector<std::string>& aLines);
 	void GetTextLines(std::vector<std::string>& out) const;
 
+	// the same bytes as GetText() without building a string, passed to aSink as contiguous spans. Lines that
+	// weren't loaded yet are passed straight from the mapped file
+	void WriteText(const td_TextSink& aSink) const;
+	void ForEachChunk(const Coordinates& aStart, const Coordinates& aEnd, const td_TextSink& aCallback) const;
+
+	// maps the file instead of reading it, a line is only decoded and colored once it is shown or
+	// edited. The file must not change on disk while it is open. Returns false if it can't be opened
+	bool LoadFromFile(const std::string& aPath);
+
+	// opens the file like LoadFromFile for viewing only, e.g. logs too large to keep decoded. Only the lines of
+	// the s_ViewerResidentBlocks blocks that were shown last stay in memory, the others are decoded again from
+	// the file when they come back into view. The editor is read-only until other text is set, then SetReadOnly applies again
+	bool OpenViewer(const std::string& aPath);
+	bool IsViewer() const { return m_Viewer; }
+
 	std::string GetSelectedText() const;
 	std::string GetCurrentLineText() const;
 
 	int GetTotalLines() const { return (int)m_Lines.size(); }
+	MemoryUsage GetMemoryUsage() const;
 	bool IsOverwrite() const { return m_Overwrite; }
 
 	bool IsFocused() const { return m_Focused; }
@@ -334,6 +779,38 @@ public:
 	bool IsColorizerEnabled() const { return m_ColorizerEnabled; }
 	void SetColorizerEnable(bool aValue);
 
+	// tokenize large ranges on a worker thread instead of spreading them over frames
+	bool IsColorizerThreaded() const { return m_ColorizerWorker != nullptr; }
+	void SetColorizerThreaded(bool aValue);
+
+	// time the ui thread may spend tokenizing per frame, a line that doesn't fit is finished on the next one.
+	// 0 or less means no limit
+	int GetColorizerFrameBudget() const { return m_ColorizerFrameBudget; }
+	inline void SetColorizerFrameBudget(int aMicroseconds) { m_ColorizerFrameBudget = aMicroseconds; }
+
+	struct ColorizerStats
+	{
+		uint64_t Lines = 0;             // lines tokenized since the editor was created, worker included
+		uint64_t Microseconds = 0;      // time spent on them
+		double LinesPerSecond = 0.0;
+		int LastFrameLines = 0;         // ui thread only
+		int LastFrameMicroseconds = 0;
+	};
+
+	const ColorizerStats& GetColorizerStats() const { return m_ColorizerStats; }
+
+	// while nothing the text area draws changed, Render replays the vertices of the last frame instead of laying out the lines
+	struct RenderStats
+	{
+		uint64_t FramesRendered = 0;
+		uint64_t FramesCached = 0;      // frames served from the replayed vertices
+	};
+
+	const RenderStats& GetRenderStats() const { return m_RenderStats; }
+	inline bool IsRenderCacheEnabled() const { return m_RenderCacheEnabled; }
+	inline void SetRenderCacheEnabled(bool aValue) { m_RenderCacheEnabled = aValue; m_RenderCache.Valid = false; }
+	inline void InvalidateRenderCache() { m_RenderCache.Valid = false; }
+
 	Coordinates GetCorrectCursorPosition(); // The GetCursorPosition() returns the cursor pos where \t == 4 spaces
 	Coordinates GetCursorPosition() const { return GetActualCursorCoordinates(); }
 	void SetCursorPosition(const Coordinates& aPosition);
@@ -353,6 +830,17 @@ public:
 	void AppendText(const std::string& aValue, bool indent = false);
 	void AppendText(const char* aValue, bool indent = false);
 
+	// for streamed output like logs: adds to the end of the document wherever the cursor is and only colors
+	// the new lines. It leaves no undo records and clears the ones there were. Does nothing while a viewer is
+	// open, SetText or LoadFromFile first
+	void AppendToEnd(const std::string& aValue);
+	void AppendToEnd(const char* aValue);
+
+	// in follow mode AppendToEnd drops the oldest lines a block at a time past aMaxLines lines (0 keeps all),
+	// and the view stays at the end while it is scrolled there
+	void SetFollowMode(bool aValue, int aMaxLines = 0);
+	bool IsFollowMode() const { return m_Follow; }
+
 	void MoveUp(int aAmount = 1, bool aSelect = false);
 	void MoveDown(int aAmount = 1, bool aSelect = false);
 	void MoveLeft(int aAmount = 1, bool aSelect = false, bool aWordMode = false);
@@ -361,10 +849,18 @@ public:
 	void MoveBottom(bool aSelect = false);
 	void MoveHome(bool aSelect = false);
 	void MoveEnd(bool aSelect = false);
+	void MoveToMatchingBracket(bool aSelect = false);
 
 	void SetSelectionStart(const Coordinates& aPosition);
 	void SetSelectionEnd(const Coordinates& aPosition);
 	void SetSelection(const Coordinates& aStart, const Coordinates& aEnd, SelectionMode aMode = SelectionMode::Normal);
+
+	// offset in GetText() and back, O(log lines) plus a walk over the one line. The newline at the end of a line
+	// counts as one byte and one character
+	size_t CoordinatesToOffset(const Coordinates& aPosition) const;
+	Coordinates OffsetToCoordinates(size_t aOffset) const;
+	size_t CoordinatesToCharacterOffset(const Coordinates& aPosition) const; // in code points
+	Coordinates CharacterOffsetToCoordinates(size_t aOffset) const;
 	void SelectWordUnderCursor();
 	void SelectAll();
 	bool HasSelection() const;
@@ -383,8 +879,8 @@ public:
 
 	std::vector<std::string> GetRelevantExpressions(int line);
 
-	inline void SetHighlightedLines(const std::vector<int>& lines) { m_HighlightedLines = lines; }
-	inline void ClearHighlightedLines() { m_HighlightedLines.clear(); }
+	inline void SetHighlightedLines(const std::vector<int>& lines) { m_HighlightedLines = lines; InvalidateRenderCache(); }
+	inline void ClearHighlightedLines() { m_HighlightedLines.clear(); InvalidateRenderCache(); }
 
 	inline void SetTabSize(int s) { m_TabSize = std::max<int>(0, std::min<int>(32, s)); }
 	inline int GetTabSize() { return m_TabSize; }
@@ -425,6 +921,8 @@ public:
 	void Colorize(int aFromLine = 0, int aCount = -1);
 	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
 	void ColorizeInternal();
+	void LexLines(int aFromLine, int aToLine);
+	LexState LexLine(Line& aLine, const LexState& aState);
 	
 	inline void ClearAutocompleteData()
 	{
@@ -511,6 +1009,375 @@ private:
 	std::string m_Path;
 
 	typedef std::vector<std::pair<std::regex, PaletteIndex>> td_RegexList;
+
+	// read-only perfect hash from identifier bytes to the lists they appear in (a mask of the Class* bits).
+	// Keys are spread over buckets and every bucket gets a seed that sends its keys to free slots, so a
+	// lookup hashes the token once and compares against a single slot without copying it
+	class IdentifierTable
+	{
+	public:
+		enum
+		{
+			ClassKeyword = 1,
+			ClassKnownIdentifier = 2,
+			ClassPreprocIdentifier = 4
+		};
+
+		IdentifierTable() : m_CaseSensitive(true) {}
+
+		void Build(const LanguageDefinition& aLanguage);
+		int Find(const char* aBegin, const char* aEnd) const;
+
+	private:
+		struct Slot
+		{
+			uint32_t Offset;
+			uint16_t Length;
+			uint8_t Mask;
+		};
+
+		uint64_t Hash(const char* aBegin, const char* aEnd) const;
+		static uint32_t Mix(uint64_t aHash, uint32_t aSeed);
+
+		std::vector<uint32_t> m_Seeds;
+		std::vector<Slot> m_Slots;
+		std::string m_Keys;
+		bool m_CaseSensitive;
+	};
+
+	// Which lines the folded folds hide, so rendering and hit testing don't scan every fold for every
+	// line. A folded fold hides the lines after its begin line up to and including its end line. Only a
+	// count of covering folds per line is kept, plus a Fenwick tree over the hidden lines that maps
+	// document lines to visible rows and back. Build is O(lines) and runs again whenever lines are
+	// inserted or removed or a brace summary changes. SetFolded walks the lines of that fold.
+	class FoldIndex
+	{
+	public:
+		struct Fold
+		{
+			int Begin, End; // lines
+		};
+
+		FoldIndex()
+			: m_LineCount(0), m_HiddenCount(0) {}
+
+		// aFolds holds only the folded folds
+		void Build(int aLineCount, const std::vector<Fold>& aFolds);
+		void SetFolded(const Fold& aFold, bool aFolded) { Cover(aFold, aFolded ? 1 : -1); }
+
+		bool IsHidden(int aLine) const { return aLine >= 0 && aLine < (int)m_Cover.size() && m_Cover[aLine] > 0; }
+		int GetHiddenCount() const { return m_HiddenCount; }
+
+		// a hidden line gets the row of the line its fold begins on. Rows past the end map one to one
+		int LineToRow(int aLine) const;
+		int RowToLine(int aRow) const;
+
+	private:
+		void Cover(const Fold& aFold, int aDelta);
+		int HiddenBefore(int aLine) const;
+
+		int m_LineCount;
+		int m_HiddenCount;
+		std::vector<int> m_Cover; // number of folded folds hiding each line, empty while nothing is folded
+		std::vector<int> m_Tree;  // Fenwick tree over m_Cover[i] > 0
+	};
+
+	// Unmatched brackets of every line, kept in an implicit treap ordered by line so inserting or removing
+	// lines, summarizing a line again and finding the line that closes or opens a bracket are all O(log n).
+	// Each kind of bracket only pairs with its own kind. Brackets in strings, character literals and
+	// comments don't count. Edits and the colorizer mark the lines they touch with Invalidate, Update
+	// summarizes only those lines again.
+	class BracketIndex
+	{
+	public:
+		enum Kind
+		{
+			Paren,
+			Square,
+			Curly,
+			KindCount
+		};
+
+		struct Summary
+		{
+			int Close[KindCount]; // closing brackets with no opening bracket before them on the line
+			int Open[KindCount];  // opening brackets still open at the end of the line
+
+			Summary()
+			{
+				for (int k = 0; k < KindCount; k++)
+					Close[k] = Open[k] = 0;
+			}
+
+			bool operator==(const Summary& o) const { return std::equal(Close, Close + KindCount, o.Close) && std::equal(Open, Open + KindCount, o.Open); }
+			bool operator!=(const Summary& o) const { return !(*this == o); }
+		};
+
+		// kind of the bracket at aIndex or -1 if there is none, or it is in a string or comment
+		static int GetBracket(const Line& aLine, size_t aIndex, bool& aOpening);
+		static Summary Summarize(const Line& aLine);
+		static Summary Combine(const Summary& aFirst, const Summary& aSecond);
+
+		BracketIndex()
+			: m_Root(-1), m_Seed(0x9E3779B9u) {}
+
+		void Reset(int aLineCount);
+		void Insert(int aLine, int aCount);
+
+		// like Reset, but the lines count as empty until they are invalidated. For a mapped file whose
+		// lines aren't loaded yet, they are kept as a few runs of lines instead of a node per line
+		void ResetEmpty(int aLineCount);
+		void Erase(int aStart, int aEnd);
+		void Invalidate(int aStart, int aEnd);
+
+		// turns the lines back into a run like ResetEmpty, for lines that were unloaded again
+		void Forget(int aStart, int aEnd);
+
+		// summarizes the invalidated lines again, returns true if any of their summaries changed
+		bool Update(const LineStore& aLines);
+
+		int GetLineCount() const { return SizeOf(m_Root); }
+
+		// opening brackets of aKind still open where aLine starts
+		int GetDepth(int aLine, int aKind) const;
+
+		// the first line after aLine that closes aOpen brackets left open by the lines before it, aOpen is
+		// then the number of that line's unmatched closing brackets it takes. -1 if they never close
+		int FindClose(int aLine, int aKind, int& aOpen) const;
+
+		// the last line before aLine that opens aClose brackets the lines after it close, aClose is then
+		// the number of that line's unmatched opening brackets it takes, counting from the end
+		int FindOpen(int aLine, int aKind, int& aClose) const;
+
+		// lines with at least one folded brace
+		void GetFoldedLines(std::vector<int>& aLines) const;
+
+	private:
+		struct Node
+		{
+			int Left, Right;
+			int Lines; // more than one for a run of empty lines that were never summarized
+			int Size;  // lines in the subtree
+			uint32_t Priority;
+			Summary Own, Total;
+			int Folded, FoldedTotal; // folded braces on the line and in the subtree
+			bool Dirty, DirtyTotal;  // the line, or any line in the subtree, needs to be summarized again
+			bool RunTotal;           // the subtree has a run
+		};
+
+		static const int s_RunLines = 4096;
+
+		int SizeOf(int aNode) const { return aNode == -1 ? 0 : m_Nodes[aNode].Size; }
+		int NewNode();
+		int Build(int aCount, int aRunLines = 1);
+		void Free(int aNode);
+		void Pull(int aNode);
+		void Split(int aNode, int aCount, int& aLeft, int& aRight);
+		int Merge(int aLeft, int aRight);
+		void Mark(int aNode, int aOffset, int aStart, int aEnd);
+		bool Refresh(int aNode, int aOffset, const LineStore& aLines);
+		int FindClose(int aNode, int aOffset, int aFrom, int aKind, int& aOpen) const;
+		int FindOpen(int aNode, int aOffset, int aTo, int aKind, int& aClose) const;
+		void GetFoldedLines(int aNode, int aOffset, std::vector<int>& aLines) const;
+
+		std::vector<Node> m_Nodes;
+		std::vector<int> m_FreeNodes;
+		int m_Root;
+		uint32_t m_Seed;
+	};
+
+	// width of every line that was laid out and how many lines have each width, so the horizontal scroll range
+	// is the widest line without measuring the lines every frame. Lines that were never laid out count as 0
+	class LineWidths
+	{
+	public:
+		void Reset(int aLineCount);
+		void Insert(int aIndex, int aCount);
+		void Erase(int aStart, int aEnd);
+		void Set(int aLine, float aWidth);
+
+		int GetLineCount() const { return (int)m_Widths.size(); }
+		float GetMax() const { return m_Counts.empty() ? 0.0f : m_Counts.rbegin()->first; }
+
+	private:
+		void Count(float aWidth, int aDelta);
+
+		std::vector<float> m_Widths;
+		std::map<float, int> m_Counts; // zero widths aren't counted
+	};
+
+	// where every line starts in GetText(), in bytes and in characters (code points), the newline at the end of a line
+	// counted as one of each. The line lengths are kept in blocks of about s_BlockLines lines, with Fenwick trees over
+	// the lines, bytes and characters of every block. Inserting, removing or measuring lines again only touches their
+	// blocks and the trees, so all of it and both lookups are O(log n + s_BlockLines). The trees are rebuilt, in
+	// O(blocks), on the first query after a block was split, merged or removed. Edited lines are measured again through Update
+	class TextOffsetIndex
+	{
+	public:
+		TextOffsetIndex()
+			: m_LineCount(0) {}
+
+		void Reset(const LineStore& aLines);
+		void Insert(const LineStore& aLines, int aIndex, int aCount);
+		void Erase(int aStart, int aEnd);
+		void Update(const LineStore& aLines, int aStart, int aEnd);
+
+		// drops every line, edits are ignored until the next Reset
+		void Clear();
+
+		int GetLineCount() const { return m_LineCount; }
+		size_t GetLineStart(int aLine, bool aCharacters) const;
+		int FindLine(size_t aOffset, bool aCharacters) const; // last line that starts at or before aOffset
+
+	private:
+		struct Length
+		{
+			uint32_t Bytes, Characters;
+		};
+
+		struct Block
+		{
+			std::vector<Length> Lengths;
+			size_t Bytes = 0, Characters = 0;
+		};
+
+		static const size_t s_BlockLines = 512;
+
+		static Length Measure(const td_Char* aChars, size_t aSize);
+		static Length Measure(const LineStore& aLines, size_t aIndex);
+		void Build() const;
+
+		// block of aLine and its index in there. aLine may be the line count, that is the end of the last block
+		void Locate(int aLine, size_t& aBlock, size_t& aIndex) const;
+		void Add(size_t aBlock, int64_t aLines, int64_t aBytes, int64_t aCharacters);
+		static size_t Prefix(const std::vector<size_t>& aTree, size_t aBlocks);
+
+		// splits blocks longer than 2 * s_BlockLines and merges short ones into the next, from aFirst to aLast
+		void Balance(size_t aFirst, size_t aLast);
+
+		std::vector<Block> m_Blocks;
+		int m_LineCount;
+		mutable std::vector<size_t> m_LineTree, m_ByteTree, m_CharacterTree; // empty while they have to be rebuilt
+	};
+
+	// advance width of every character for one font, size and tab size, so measuring text doesn't go
+	// through CalcTextSizeA one character at a time. ASCII is a plain array, other characters are measured
+	// on first use. If all printable ASCII characters are equally wide GetPitch() returns that width
+	class AdvanceTable
+	{
+	public:
+		AdvanceTable();
+
+		// measures again if the font, its size or the tab size changed, returns true if it did
+		bool Update(const ImFont* aFont, float aFontSize, int aTabSize);
+
+		// changes whenever Update measures again
+		uint32_t GetGeneration() const { return m_Generation; }
+
+		float GetPitch() const { return m_Pitch; }
+		float GetSpace() const { return m_Ascii[' ']; }
+
+		// x of the first tab stop after aX
+		float GetTabStop(float aX) const
+		{
+			const float tab = float(m_TabSize) * m_Ascii[' '];
+			return (1.0f + std::floor((1.0f + aX) / tab)) * tab;
+		}
+
+		// width of the UTF-8 character aChar[0, aLength)
+		float Get(const td_Char* aChar, int aLength) const
+		{
+			if (*aChar < 128)
+				return m_Ascii[*aChar];
+			return GetOther(aChar, aLength);
+		}
+
+		// width of a run of text without tabs
+		float Measure(const td_Char* aBegin, const td_Char* aEnd) const;
+
+		// number of bytes from aBegin on that are printable ASCII, those are all GetPitch() wide
+		static size_t CountPrintable(const td_Char* aBegin, const td_Char* aEnd)
+		{
+			const td_Char* it = aBegin;
+			while (it < aEnd && *it >= 32 && *it < 127)
+				++it;
+			return it - aBegin;
+		}
+
+	private:
+		float GetOther(const td_Char* aChar, int aLength) const;
+
+		const ImFont* m_Font;
+		float m_FontSize;
+		int m_TabSize;
+		uint32_t m_Generation;
+		float m_Ascii[128];
+		float m_Pitch;
+		mutable std::unordered_map<uint64_t, float> m_Other; // keyed on the character's bytes
+	};
+
+	// everything the tokenizer reads. Built by SetLanguageDefinition and never modified afterwards,
+	// so the colorizer thread can keep using an old one while a new language is set
+	struct ColorizerContext
+	{
+		LanguageDefinition Language;
+		IdentifierTable Identifiers;
+		ed::RegexDFA TokenDFA;   // all TokenRegexStrings combined
+		td_RegexList RegexList;  // only compiled if TokenDFA couldn't handle them
+	};
+
+	// a batch of lines for the colorizer thread. Text and PreprocStart are copied on the UI thread,
+	// Colors is written by the worker and only copied back if Version still matches the document
+	struct ColorizerJob
+	{
+		uint64_t Version;
+		int FirstLine;
+		std::shared_ptr<const ColorizerContext> Context;
+		std::string Text;
+		std::vector<size_t> LineStart;
+		std::vector<size_t> PreprocStart;
+		std::vector<uint8_t> Colors;
+		int64_t Microseconds = 0;
+	};
+
+	struct ColorizerWorker
+	{
+		std::thread Thread;
+		std::mutex Mutex;
+		std::condition_variable Wakeup;
+		std::unique_ptr<ColorizerJob> Job;
+		std::atomic<ColorizerJob*> Result { nullptr };
+		std::atomic<bool> Stop { false };
+
+		// ui thread only. BusyFrom/BusyTo follow inserted and removed lines
+		bool Busy = false;
+		int BusyFrom = 0, BusyTo = 0;
+	};
+
+	static const int s_ColorizerJobLines = 2000;
+	static const int s_ColorizerNearPages = 4;
+	static const int s_ColorizerClockTokens = 256; // tokens between two looks at the clock
+
+	// tokenizes from aBegin + aStart and stops early once aTokens runs out, returns where it stopped
+	static size_t ColorizeLine(const ColorizerContext& aContext, const char* aBegin, const char* aEnd, size_t aStart, size_t aPreprocStart, uint8_t* aColors, int& aTokens);
+	int ColorizeUntil(int aFromLine, int aToLine, std::chrono::steady_clock::time_point aDeadline, bool aTimed);
+	void AddColorizerStats(int aLines, int64_t aMicroseconds);
+	static void ColorizerThread(ColorizerWorker* aWorker);
+	void SubmitColorizerJob(int aFromLine, int aToLine);
+	void ApplyColorizerResult();
+	void StopColorizerThread();
+
+	void MarkColorDirty(int aFromLine, int aToLine);
+	bool TakeColorDirty(int aBegin, int aEnd, int aMaxLines, int& aFromLine, int& aToLine);
+
+	// keep line indexed state in sync with m_Lines. Every edit calls OnLinesChanged for the lines whose text it
+	// changed, whatever range it colorizes afterwards
+	void OnLinesChanged(int aStart, int aEnd);
+	void OnLinesInserted(int aIndex, int aCount);
+	void OnLinesRemoved(int aStart, int aEnd);
+	void OnLinesLoaded();
+	void EvictLines();
+	void CloseViewer(); // puts back the read-only setting from before OpenViewer
 	
 	struct EditorState
 	{
@@ -568,18 +1435,30 @@ private:
 	bool IsOnWordBoundary(const Coordinates& aAt) const;
 	void RemoveLine(int aStart, int aEnd);
 	void RemoveLine(int aIndex);
-	Line& InsertLine(int aIndex, int column);
+	Line& InsertLine(int aIndex);
+	void InsertLines(int aIndex, std::vector<Line>&& aLines);
+	void DropFirstLines(int aCount);
 	void EnterCharacter(ImWchar aChar, bool aShift);
 	void DeleteSelection();
 	std::string GetWordUnderCursor() const;
 	std::string GetWordAt(const Coordinates& aCoords) const;
 	ImU32 GetGlyphColor(const Glyph& aGlyph) const;
+	LineLayout& GetLineLayout(int aLine);
+	const AdvanceTable& GetAdvances() const;
+	const LineOffsets* GetLineOffsets(int aLine) const;
+	const TextOffsetIndex& GetTextOffsets() const;
+	static size_t HitTestOffsets(const Line& aLine, const LineOffsets& aOffsets, float aX);
+
+	static const size_t s_LineOffsetsMinLength = 256; // shorter lines are simply walked
+	static const size_t s_MinBlocksPerThread = 64; // SetText fills smaller documents on the calling thread
+	static const size_t s_ViewerResidentBlocks = 64;
 
 	Coordinates FindFirst(const std::string& what, const Coordinates& fromWhere);
 
 	void HandleKeyboardInputs();
 	void HandleMouseInputs();
 	void RenderInternal(const char* aTitle);
+	void ReplayRenderCache(ImDrawList* aDrawList);
 
 	bool m_FuncTooltips;
 
@@ -605,8 +1484,11 @@ private:
 	std::string BuildFunctionDef(const std::string& func, const std::string& lang);
 	std::string BuildVariableType(const ed::SPIRVParser::Variable& var, const std::string& lang);
 
-	void RemoveFolds(const Coordinates& start, const Coordinates& end);
-	void RemoveFolds(std::vector<Coordinates>& folds, const Coordinates& start, const Coordinates& end);
+	void UpdateBrackets();
+	bool FindMatchingBracket(int aLine, int aIndex, int& aMatchLine, int& aMatchIndex);
+	bool FindMatchingBracket(const Coordinates& aFrom, Coordinates& aBracket, Coordinates& aMatch);
+	int GetFoldBrace(int aLine) const;
+	void UpdateFoldIndex();
 
 	std::string AutcompleteParse(const std::string& str, const Coordinates& start);
 	void AutocompleteSelect();
@@ -633,12 +1515,11 @@ private:
 	char m_ReplaceWord[256];
 
 	bool m_FoldEnabled;
-	std::vector<Coordinates> m_FoldBegin, m_FoldEnd;
-	std::vector<int> m_FoldConnection;
-	std::vector<bool> m_Fold;
-	bool m_FoldSorted;
-	
-	uint64_t m_FoldLastIteration;
+	BracketIndex m_Brackets;
+	FoldIndex m_FoldIndex;
+	bool m_FoldIndexDirty; // set when braces move or lines are inserted or removed, see UpdateFoldIndex
+	LineWidths m_LineWidths;
+	mutable TextOffsetIndex m_TextOffsets;
 
 	float m_LastScroll;
 
@@ -685,6 +1566,12 @@ private:
 	int m_TabSize;
 	bool m_Overwrite;
 	bool m_ReadOnly;
+	bool m_Viewer;
+	bool m_ViewerReadOnly; // what SetReadOnly asked for while the viewer is open
+	bool m_Follow;
+	bool m_FollowPinned;  // the view was at the end, it follows the new lines
+	int m_FollowMaxLines;
+	int m_FollowDropped;  // lines dropped since the last frame, the view moves up with the others
 	bool m_WithinRender;
 	bool m_ScrollToCursor;
 	bool m_ScrollToTop;
@@ -693,7 +1580,12 @@ private:
 	float m_TextStart;                   // position (in pixels) where a code line starts relative to the left of the ImTextEdit.
 	int  m_LeftMargin;
 	bool m_CursorPositionChanged;
-	int m_ColorRangeMin, m_ColorRangeMax;
+	std::map<int, int> m_ColorDirty;        // lines still to be tokenized, disjoint [first, second) ranges
+	int m_VisibleLineBegin, m_VisibleLineEnd; // lines drawn by the last RenderInternal
+	int m_ColorizerFrameBudget;             // microseconds
+	int m_ColorizeResumeLine;               // line left half tokenized by the last frame or -1
+	size_t m_ColorizeResumeOffset;
+	ColorizerStats m_ColorizerStats;
 	SelectionMode m_SelectionMode;
 	bool m_HandleKeyboardInputs;
 	bool m_HandleMouseInputs;
@@ -703,8 +1595,17 @@ private:
 
 	td_Palette m_PaletteBase;
 	td_Palette m_Palette;
+	mutable AdvanceTable m_Advances;  // for ImGui::GetFont() at ImGui::GetFontSize(), see GetAdvances
+	uint32_t m_LayoutGeneration;  // bumped when anything all line layouts depend on changes
+	const ImFont* m_LayoutFont;
+	float m_LayoutFontSize;
+	int m_LayoutTabSize;
+	bool m_LayoutShowWhitespaces;
+	bool m_LayoutColorizerEnabled;
 	LanguageDefinition m_LanguageDefinition;
-	td_RegexList m_RegexList;
+	std::shared_ptr<const ColorizerContext> m_ColorizerContext;
+	std::unique_ptr<ColorizerWorker> m_ColorizerWorker;
+	uint64_t m_DocumentVersion; // bumped by every edit through OnLinesChanged, OnLinesInserted and OnLinesRemoved
 
 	float m_DebugBarWidth, m_DebugBarHeight;
 
@@ -720,7 +1621,8 @@ private:
 	bool m_PopupCondition_Use;
 	char m_PopupCondition_Condition[512];
 
-	bool m_CheckComments;
+	int m_LexDirtyLine;
+	int m_LexDirtyEnd; // every line up to here is lexed again, even where the state coming in didn't change
 	td_ErrorMarkers m_ErrorMarkers;
 	ImVec2 m_CharAdvance;
 	Coordinates m_InteractiveStart, m_InteractiveEnd;
@@ -731,4 +1633,19 @@ private:
 	std::chrono::steady_clock::time_point m_LastHoverTime;
 
 	float m_LastClick;
+
+	// what the line loop of the last frame added to the draw list, see RenderInternal
+	struct RenderCache
+	{
+		bool Valid = false;
+		uint64_t Hash = 0;
+		std::vector<ImDrawVert> Vertices;
+		std::vector<ImDrawIdx> Indices;   // relative to the first vertex
+		int VisibleLineBegin = 0, VisibleLineEnd = 0;
+		bool CursorDrawn = false;
+	};
+
+	RenderCache m_RenderCache;
+	RenderStats m_RenderStats;
+	bool m_RenderCacheEnabled;
 };
@@ -0,0 +1,647 @@
+#include "nzpch.hpp"
+
+#include "RegexDFA.h"
+
+#include <map>
+#include <cstring>
+
+namespace ed {
+
+	static const size_t s_MaxProgramSize = 4096;
+	static const size_t s_MaxStateCount = 4096;
+
+	class RegexDFA::Parser
+	{
+	public:
+		Parser(const std::string& pattern, std::vector<Node>& nodes)
+			: m_Pattern(pattern), m_Pos(0), m_Nodes(nodes), m_Failed(false)
+		{
+		}
+
+		// returns the root node or -1 if the pattern can't be handled
+		int Parse()
+		{
+			int root = ParseAlternate();
+
+			if (m_Failed || m_Pos != m_Pattern.size())
+				return -1;
+
+			return root;
+		}
+
+	private:
+		bool AtEnd() const { return m_Pos >= m_Pattern.size(); }
+		char Peek() const { return AtEnd() ? 0 : m_Pattern[m_Pos]; }
+
+		int Fail()
+		{
+			m_Failed = true;
+			return -1;
+		}
+
+		int AddNode(Node::Type type)
+		{
+			Node node;
+			node.NodeType = type;
+			node.Min = node.Max = 0;
+			m_Nodes.push_back(node);
+			return (int)m_Nodes.size() - 1;
+		}
+
+		int AddSet(const ByteSet& bytes)
+		{
+			int node = AddNode(Node::Set);
+			m_Nodes[node].Bytes = bytes;
+			return node;
+		}
+
+		int ParseAlternate()
+		{
+			std::vector<int> branches;
+			branches.push_back(ParseConcat());
+
+			while (!m_Failed && Peek() == '|')
+			{
+				m_Pos++;
+				branches.push_back(ParseConcat());
+			}
+
+			if (branches.size() == 1)
+				return branches[0];
+
+			int node = AddNode(Node::Alternate);
+			m_Nodes[node].Children = branches;
+			return node;
+		}
+
+		int ParseConcat()
+		{
+			std::vector<int> items;
+
+			while (!m_Failed && !AtEnd() && Peek() != '|' && Peek() != ')')
+				items.push_back(ParseRepeat());
+
+			if (items.size() == 1)
+				return items[0];
+
+			// an empty concatenation matches the empty string
+			int node = AddNode(Node::Concat);
+			m_Nodes[node].Children = items;
+			return node;
+		}
+
+		int ParseRepeat()
+		{
+			int atom = ParseAtom();
+
+			if (m_Failed || AtEnd())
+				return atom;
+
+			int min = 0, max = 0;
+			char c = Peek();
+
+			if (c == '*')
+			{
+				min = 0;
+				max = -1;
+				m_Pos++;
+			}
+			else if (c == '+')
+			{
+				min = 1;
+				max = -1;
+				m_Pos++;
+			}
+			else if (c == '?')
+			{
+				min = 0;
+				max = 1;
+				m_Pos++;
+			}
+			else if (c == '{')
+			{
+				if (!ParseBraces(min, max))
+					return Fail();
+			}
+			else
+				return atom;
+
+			// lazy and stacked quantifiers aren't supported
+			c = Peek();
+			if (c == '?' || c == '*' || c == '+' || c == '{')
+				return Fail();
+
+			int node = AddNode(Node::Repeat);
+			m_Nodes[node].Children.push_back(atom);
+			m_Nodes[node].Min = min;
+			m_Nodes[node].Max = max;
+			return node;
+		}
+
+		// parses {n}, {n,} and {n,m}
+		bool ParseBraces(int& min, int& max)
+		{
+			m_Pos++;
+
+			if (!ParseNumber(min))
+				return false;
+
+			max = min;
+
+			if (Peek() == ',')
+			{
+				m_Pos++;
+				max = -1;
+
+				if (Peek() != '}' && !ParseNumber(max))
+					return false;
+			}
+
+			if (Peek() != '}' || (max != -1 && max < min) || min > 64 || max > 64)
+				return false;
+
+			m_Pos++;
+			return true;
+		}
+
+		bool ParseNumber(int& value)
+		{
+			if (!isdigit((unsigned char)Peek()))
+				return false;
+
+			value = 0;
+			while (isdigit((unsigned char)Peek()) && value < 1000)
+				value = value * 10 + (m_Pattern[m_Pos++] - '0');
+
+			return true;
+		}
+
+		int ParseAtom()
+		{
+			char c = m_Pattern[m_Pos++];
+			ByteSet bytes;
+			int single;
+
+			switch (c)
+			{
+			case '(':
+			{
+				if (Peek() == '?')
+				{
+					// only non-capturing groups, no lookahead
+					if (m_Pos + 1 >= m_Pattern.size() || m_Pattern[m_Pos + 1] != ':')
+						return Fail();
+					m_Pos += 2;
+				}
+
+				int inner = ParseAlternate();
+
+				if (m_Failed || Peek() != ')')
+					return Fail();
+
+				m_Pos++;
+				return inner;
+			}
+			case '[':
+				return ParseClass();
+			case '.':
+				bytes.set();
+				bytes.reset('\n');
+				bytes.reset('\r');
+				return AddSet(bytes);
+			case '\\':
+				if (!ParseEscape(false, bytes, single))
+					return Fail();
+				return AddSet(bytes);
+			case '^': case '$': case ')': case '*': case '+': case '?': case '{': case '|':
+				return Fail();
+			default:
+				bytes.set((unsigned char)c);
+				return AddSet(bytes);
+			}
+		}
+
+		int ParseClass()
+		{
+			bool negate = false;
+			ByteSet bytes;
+
+			if (Peek() == '^')
+			{
+				negate = true;
+				m_Pos++;
+			}
+
+			for (;;)
+			{
+				if (AtEnd())
+					return Fail();
+
+				if (Peek() == ']')
+				{
+					m_Pos++;
+					break;
+				}
+
+				ByteSet item;
+				int low;
+
+				if (!ParseClassAtom(item, low))
+					return Fail();
+
+				if (Peek() == '-' && m_Pos + 1 < m_Pattern.size() && m_Pattern[m_Pos + 1] != ']')
+				{
+					m_Pos++;
+
+					int high;
+					if (!ParseClassAtom(item, high) || low < 0 || high < 0 || low > high)
+						return Fail();
+
+					for (int i = low; i <= high; i++)
+						bytes.set(i);
+				}
+				else
+					bytes |= item;
+			}
+
+			if (negate)
+				bytes.flip();
+
+			return AddSet(bytes);
+		}
+
+		// a single class member; single is -1 for escapes like \d that stand for more than one byte
+		bool ParseClassAtom(ByteSet& bytes, int& single)
+		{
+			char c = m_Pattern[m_Pos++];
+
+			if (c == '\\')
+				return ParseEscape(true, bytes, single);
+
+			bytes.reset();
+			bytes.set((unsigned char)c);
+			single = (unsigned char)c;
+			return true;
+		}
+
+		bool ParseEscape(bool inClass, ByteSet& bytes, int& single)
+		{
+			if (AtEnd())
+				return false;
+
+			char c = m_Pattern[m_Pos++];
+			bytes.reset();
+			single = -1;
+
+			switch (c)
+			{
+			case 'd': case 'D':
+				for (int i = '0'; i <= '9'; i++)
+					bytes.set(i);
+				break;
+			case 'w': case 'W':
+				for (int i = 0; i < 256; i++)
+					if (isalnum(i) || i == '_')
+						bytes.set(i);
+				break;
+			case 's': case 'S':
+				for (const char* s = " \t\n\v\f\r"; *s; s++)
+					bytes.set((unsigned char)*s);
+				break;
+			case 't': single = '\t'; break;
+			case 'n': single = '\n'; break;
+			case 'r': single = '\r'; break;
+			case 'f': single = '\f'; break;
+			case 'v': single = '\v'; break;
+			case 'b':
+				// word boundary outside of a class
+				if (!inClass)
+					return false;
+				single = '\b';
+				break;
+			case '0':
+				if (isdigit((unsigned char)Peek()))
+					return false;
+				single = 0;
+				break;
+			case 'x':
+			{
+				if (m_Pos + 2 > m_Pattern.size() || !isxdigit((unsigned char)m_Pattern[m_Pos]) || !isxdigit((unsigned char)m_Pattern[m_Pos + 1]))
+					return false;
+				single = (int)std::stoi(m_Pattern.substr(m_Pos, 2), nullptr, 16);
+				m_Pos += 2;
+				break;
+			}
+			default:
+				// back references, \u, \c, ... aren't supported
+				if (isalnum((unsigned char)c))
+					return false;
+				single = (unsigned char)c;
+				break;
+			}
+
+			if (single >= 0)
+				bytes.set(single);
+			else if (c == 'D' || c == 'W' || c == 'S')
+				bytes.flip();
+
+			return true;
+		}
+
+		const std::string& m_Pattern;
+		size_t m_Pos;
+		std::vector<Node>& m_Nodes;
+		bool m_Failed;
+	};
+
+	RegexDFA::RegexDFA()
+		: m_ClassCount(0), m_StateCount(0)
+	{
+		memset(m_ByteClass, 0, sizeof(m_ByteClass));
+	}
+
+	void RegexDFA::Clear()
+	{
+		m_Program.clear();
+		m_Sets.clear();
+		m_Transitions.clear();
+		m_Accept.clear();
+		m_ClassCount = 0;
+		m_StateCount = 0;
+		memset(m_ByteClass, 0, sizeof(m_ByteClass));
+	}
+
+	int RegexDFA::Emit(Inst::Op code, int x, int y)
+	{
+		Inst inst;
+		inst.Code = code;
+		inst.X = x;
+		inst.Y = y;
+		m_Program.push_back(inst);
+		return (int)m_Program.size() - 1;
+	}
+
+	void RegexDFA::Compile(const std::vector<Node>& nodes, int node)
+	{
+		const Node& n = nodes[node];
+
+		if (m_Program.size() > s_MaxProgramSize)
+			return;
+
+		switch (n.NodeType)
+		{
+		case Node::Set:
+			m_Sets.push_back(n.Bytes);
+			Emit(Inst::Set, (int)m_Sets.size() - 1);
+			break;
+		case Node::Concat:
+			for (int child : n.Children)
+				Compile(nodes, child);
+			break;
+		case Node::Alternate:
+		{
+			// earlier branches get the first Split target, which is what gives them priority
+			std::vector<int> jumps;
+
+			for (size_t i = 0; i + 1 < n.Children.size(); i++)
+			{
+				int split = Emit(Inst::Split);
+				m_Program[split].X = (int)m_Program.size();
+				Compile(nodes, n.Children[i]);
+				jumps.push_back(Emit(Inst::Jump));
+				m_Program[split].Y = (int)m_Program.size();
+			}
+
+			Compile(nodes, n.Children.back());
+
+			for (int jump : jumps)
+				m_Program[jump].X = (int)m_Program.size();
+			break;
+		}
+		case Node::Repeat:
+		{
+			for (int i = 0; i < n.Min; i++)
+				Compile(nodes, n.Children[0]);
+
+			if (n.Max == -1)
+			{
+				int loop = Emit(Inst::Split);
+				m_Program[loop].X = loop + 1;
+				Compile(nodes, n.Children[0]);
+				Emit(Inst::Jump, loop);
+				m_Program[loop].Y = (int)m_Program.size();
+			}
+			else
+			{
+				// x{0,2} is compiled as (x(x)?)? so that longer repetitions keep priority
+				std::vector<int> splits;
+
+				for (int i = n.Min; i < n.Max; i++)
+				{
+					int split = Emit(Inst::Split);
+					m_Program[split].X = split + 1;
+					splits.push_back(split);
+					Compile(nodes, n.Children[0]);
+				}
+
+				for (int split : splits)
+					m_Program[split].Y = (int)m_Program.size();
+			}
+			break;
+		}
+		}
+	}
+
+	void RegexDFA::AddThread(int pc, std::vector<int>& list, std::vector<int>& visited, int stamp, bool& matched) const
+	{
+		// threads are added in priority order, nothing after a match can win anymore
+		if (matched || visited[pc] == stamp)
+			return;
+
+		visited[pc] = stamp;
+
+		const Inst& inst = m_Program[pc];
+
+		switch (inst.Code)
+		{
+		case Inst::Jump:
+			AddThread(inst.X, list, visited, stamp, matched);
+			break;
+		case Inst::Split:
+			AddThread(inst.X, list, visited, stamp, matched);
+			AddThread(inst.Y, list, visited, stamp, matched);
+			break;
+		case Inst::Set:
+			list.push_back(pc);
+			break;
+		case Inst::Match:
+			list.push_back(pc);
+			matched = true;
+			break;
+		}
+	}
+
+	bool RegexDFA::Build(const std::vector<std::string>& patterns)
+	{
+		Clear();
+
+		if (patterns.empty())
+			return false;
+
+		std::vector<Node> nodes;
+		std::vector<int> roots;
+
+		for (const auto& pattern : patterns)
+		{
+			Parser parser(pattern, nodes);
+			int root = parser.Parse();
+
+			if (root < 0)
+				return false;
+
+			roots.push_back(root);
+		}
+
+		// pattern order is alternation priority: p0|p1|...
+		for (size_t i = 0; i < roots.size(); i++)
+		{
+			int split = -1;
+
+			if (i + 1 < roots.size())
+			{
+				split = Emit(Inst::Split);
+				m_Program[split].X = split + 1;
+			}
+
+			Compile(nodes, roots[i]);
+			Emit(Inst::Match, (int)i);
+
+			if (split >= 0)
+				m_Program[split].Y = (int)m_Program.size();
+		}
+
+		if (m_Program.size() > s_MaxProgramSize)
+		{
+			Clear();
+			return false;
+		}
+
+		// bytes that every set treats the same way share a transition column
+		std::map<std::string, int> classes;
+		std::vector<int> representative;
+
+		for (int b = 0; b < 256; b++)
+		{
+			std::string signature(m_Sets.size(), '0');
+
+			for (size_t s = 0; s < m_Sets.size(); s++)
+				if (m_Sets[s][b])
+					signature[s] = '1';
+
+			auto it = classes.find(signature);
+
+			if (it == classes.end())
+			{
+				it = classes.insert(std::make_pair(signature, (int)representative.size())).first;
+				representative.push_back(b);
+			}
+
+			m_ByteClass[b] = (unsigned char)it->second;
+		}
+
+		m_ClassCount = (int)representative.size();
+
+		// subset construction, a state is the ordered list of live threads
+		std::map<std::vector<int>, int> ids;
+		std::vector<std::vector<int>> states;
+		std::vector<int> visited(m_Program.size(), 0);
+		int stamp = 1;
+		bool matched = false;
+
+		std::vector<int> start;
+		AddThread(0, start, visited, stamp, matched);
+		ids[start] = 0;
+		states.push_back(start);
+
+		for (size_t s = 0; s < states.size(); s++)
+		{
+			for (int c = 0; c < m_ClassCount; c++)
+			{
+				std::vector<int> next;
+				stamp++;
+				matched = false;
+
+				for (int pc : states[s])
+				{
+					const Inst& inst = m_Program[pc];
+
+					if (inst.Code == Inst::Match)
+						break;
+
+					if (m_Sets[inst.X][representative[c]])
+						AddThread(pc + 1, next, visited, stamp, matched);
+				}
+
+				if (next.empty())
+				{
+					m_Transitions.push_back(-1);
+					continue;
+				}
+
+				auto it = ids.find(next);
+
+				if (it == ids.end())
+				{
+					if (states.size() >= s_MaxStateCount)
+					{
+						Clear();
+						return false;
+					}
+
+					it = ids.insert(std::make_pair(next, (int)states.size())).first;
+					states.push_back(next);
+				}
+
+				m_Transitions.push_back(it->second);
+			}
+		}
+
+		for (const auto& state : states)
+		{
+			const Inst& last = m_Program[state.back()];
+			m_Accept.push_back(last.Code == Inst::Match ? last.X : -1);
+		}
+
+		m_StateCount = (int)states.size();
+
+		return true;
+	}
+
+	bool RegexDFA::Match(const char* begin, const char* end, const char*& outEnd, int& outPattern) const
+	{
+		if (m_StateCount == 0)
+			return false;
+
+		// the last accepting state seen holds the highest priority match, see AddThread
+		int state = 0;
+		outPattern = m_Accept[0];
+		outEnd = begin;
+
+		for (const char* p = begin; p != end; p++)
+		{
+			state = m_Transitions[state * m_ClassCount + m_ByteClass[(unsigned char)*p]];
+
+			if (state < 0)
+				break;
+
+			if (m_Accept[state] >= 0)
+			{
+				outPattern = m_Accept[state];
+				outEnd = p + 1;
+			}
+		}
+
+		return outPattern >= 0;
+	}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <bitset>
+
+namespace ed {
+
+	// Compiles a list of regular expressions into a single DFA over bytes. Match() gives the same result as
+	// calling std::regex_search with match_continuous on each pattern in order and taking the first one that
+	// matches: patterns earlier in the list win, and within a pattern the ECMAScript (greedy, first alternative
+	// first) match is returned. Only the subset used by the language definitions is supported: literals, escapes,
+	// character classes, '.', groups, '|' and the greedy quantifiers * + ? {n,m}.
+	class RegexDFA
+	{
+	public:
+		RegexDFA();
+
+		// returns false if a pattern uses unsupported syntax or the automaton would get too large,
+		// the caller should then fall back to std::regex
+		bool Build(const std::vector<std::string>& patterns);
+		void Clear();
+		bool IsEmpty() const { return m_StateCount == 0; }
+
+		bool Match(const char* begin, const char* end, const char*& outEnd, int& outPattern) const;
+
+	private:
+		typedef std::bitset<256> ByteSet;
+
+		struct Node
+		{
+			enum Type { Set, Concat, Alternate, Repeat };
+
+			Type NodeType;
+			ByteSet Bytes;
+			std::vector<int> Children;
+			int Min, Max; // Max == -1 means unbounded
+		};
+
+		struct Inst
+		{
+			enum Op { Set, Split, Jump, Match };
+
+			Op Code;
+			int X, Y; // Set: byte set index, Split: both targets, Jump: X, Match: X = pattern
+		};
+
+		class Parser;
+
+		void Compile(const std::vector<Node>& nodes, int node);
+		int Emit(Inst::Op code, int x = 0, int y = 0);
+		void AddThread(int pc, std::vector<int>& list, std::vector<int>& visited, int stamp, bool& matched) const;
+
+		std::vector<Inst> m_Program;
+		std::vector<ByteSet> m_Sets;
+
+		unsigned char m_ByteClass[256];
+		int m_ClassCount;
+		int m_StateCount;
+		std::vector<int> m_Transitions; // m_StateCount * m_ClassCount, -1 is the dead state
+		std::vector<int> m_Accept;      // pattern accepted in each state or -1
+	};
+
+}